@@ -70,6 +70,12 @@ AddArchiveMailDialog::AddArchiveMailDialog(ArchiveMailInfo *info, QWidget *paren
     mRecursiveCheckBox->setChecked(true);
     ++row;
 
+    mIncrementalCheckBox = new QCheckBox(i18n("Only archive new and modified messages (incremental)"), this);
+    mIncrementalCheckBox->setObjectName(QStringLiteral("incremental_checkbox"));
+    mIncrementalCheckBox->setToolTip(i18n("A full archive is still written regularly, the following archives only contain the changes since the previous one."));
+    mainLayout->addWidget(mIncrementalCheckBox, row, 0, 1, 2, Qt::AlignLeft);
+    ++row;
+
     auto pathLabel = new QLabel(i18n("Path:"), this);
     mainLayout->addWidget(pathLabel, row, 0);
     pathLabel->setObjectName(QStringLiteral("path_label"));
@@ -135,6 +141,7 @@ void AddArchiveMailDialog::load(ArchiveMailInfo *info)
 {
     mPath->setUrl(info->url());
     mRecursiveCheckBox->setChecked(info->saveSubCollection());
+    mIncrementalCheckBox->setChecked(info->archiveMode() == ArchiveMailInfo::IncrementalArchive);
     mFolderRequester->setCollection(Akonadi::Collection(info->saveCollectionId()));
     mFormatComboBox->setFormat(info->archiveType());
     mDays->setValue(info->archiveAge());
@@ -149,6 +156,7 @@ ArchiveMailInfo *AddArchiveMailDialog::info()
         mInfo = new ArchiveMailInfo();
     }
     mInfo->setSaveSubCollection(mRecursiveCheckBox->isChecked());
+    mInfo->setArchiveMode(mIncrementalCheckBox->isChecked() ? ArchiveMailInfo::IncrementalArchive : ArchiveMailInfo::FullArchive);
     mInfo->setArchiveType(mFormatComboBox->format());
     mInfo->setSaveCollectionId(mFolderRequester->collection().id());
     mInfo->setUrl(mPath->url());
@@ -170,12 +178,12 @@ void AddArchiveMailDialog::slotFolderChanged(const Akonadi::Collection &collecti
     slotUpdateOkButton();
 }
 
-void AddArchiveMailDialog::setArchiveType(MailCommon::BackupJob::ArchiveType type)
+void AddArchiveMailDialog::setArchiveType(ArchiveMailInfo::ArchiveType type)
 {
     mFormatComboBox->setFormat(type);
 }
 
-MailCommon::BackupJob::ArchiveType AddArchiveMailDialog::archiveType() const
+ArchiveMailInfo::ArchiveType AddArchiveMailDialog::archiveType() const
 {
     return mFormatComboBox->format();
 }
@@ -8,7 +8,6 @@
 
 #include "archivemailinfo.h"
 #include <Collection>
-#include <MailCommon/BackupJob>
 #include <QDialog>
 class QUrl;
 class QCheckBox;
@@ -30,8 +29,8 @@ public:
     explicit AddArchiveMailDialog(ArchiveMailInfo *info, QWidget *parent = nullptr);
     ~AddArchiveMailDialog();
 
-    void setArchiveType(MailCommon::BackupJob::ArchiveType type);
-    MailCommon::BackupJob::ArchiveType archiveType() const;
+    void setArchiveType(ArchiveMailInfo::ArchiveType type);
+    ArchiveMailInfo::ArchiveType archiveType() const;
 
     void setRecursive(bool b);
     Q_REQUIRED_RESULT bool recursive() const;
@@ -56,6 +55,7 @@ private:
     FormatComboBox *mFormatComboBox = nullptr;
     UnitComboBox *mUnits = nullptr;
     QCheckBox *mRecursiveCheckBox = nullptr;
+    QCheckBox *mIncrementalCheckBox = nullptr;
     KUrlRequester *mPath = nullptr;
     QSpinBox *mDays = nullptr;
     QSpinBox *mMaximumArchive = nullptr;
@@ -0,0 +1,238 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "archiveindex.h"
+#include "archivemailagent_debug.h"
+#include "config-archivemailagent.h"
+
+#include <KArchiveDirectory>
+#include <KArchiveFile>
+#include <KCompressionDevice>
+#include <KZip>
+
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+
+#include <algorithm>
+
+#if HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace
+{
+// "KAMI", the file format version follows it
+constexpr quint32 IndexMagic = 0x4B414D49;
+constexpr quint32 IndexVersion = 1;
+
+QString normalizedMessageId(const QString &messageId)
+{
+    QString id = messageId.trimmed();
+    if (id.startsWith(QLatin1Char('<')) && id.endsWith(QLatin1Char('>'))) {
+        id = id.mid(1, id.length() - 2);
+    }
+    return id;
+}
+}
+
+void ArchiveIndex::setArchiveType(ArchiveMailInfo::ArchiveType type)
+{
+    mArchiveType = type;
+}
+
+ArchiveMailInfo::ArchiveType ArchiveIndex::archiveType() const
+{
+    return mArchiveType;
+}
+
+void ArchiveIndex::addEntry(const Entry &entry)
+{
+    mEntries.append(entry);
+}
+
+QVector<ArchiveIndex::Entry> ArchiveIndex::entries() const
+{
+    return mEntries;
+}
+
+void ArchiveIndex::setFrames(const QVector<Frame> &frames)
+{
+    mFrames = frames;
+}
+
+QVector<ArchiveIndex::Frame> ArchiveIndex::frames() const
+{
+    return mFrames;
+}
+
+QVector<ArchiveIndex::Entry> ArchiveIndex::search(const QString &text) const
+{
+    QVector<Entry> result;
+    const QString messageId = normalizedMessageId(text);
+    for (const Entry &entry : mEntries) {
+        if (entry.messageId == messageId || entry.from.contains(text, Qt::CaseInsensitive) || entry.subject.contains(text, Qt::CaseInsensitive)) {
+            result.append(entry);
+        }
+    }
+    return result;
+}
+
+ArchiveIndex::Entry ArchiveIndex::findMessageId(const QString &messageId) const
+{
+    const QString id = normalizedMessageId(messageId);
+    auto it = std::find_if(mEntries.cbegin(), mEntries.cend(), [&id](const Entry &entry) {
+        return entry.messageId == id;
+    });
+    return (it != mEntries.cend()) ? *it : Entry();
+}
+
+QByteArray ArchiveIndex::extract(const QString &archiveFileName, const Entry &entry) const
+{
+    switch (mArchiveType) {
+    case ArchiveMailInfo::ArchiveZip: {
+        KZip zip(archiveFileName);
+        if (!zip.open(QIODevice::ReadOnly)) {
+            return QByteArray();
+        }
+        const auto file = dynamic_cast<const KArchiveFile *>(zip.directory()->entry(entry.path));
+        return file ? file->data() : QByteArray();
+    }
+    case ArchiveMailInfo::ArchiveTar: {
+        QFile file(archiveFileName);
+        if (!file.open(QIODevice::ReadOnly) || !file.seek(entry.offset)) {
+            return QByteArray();
+        }
+        return file.read(entry.length);
+    }
+    case ArchiveMailInfo::ArchiveTarBz2:
+    case ArchiveMailInfo::ArchiveTarGz: {
+        // These formats can't be seeked, but we only decompress until the message
+        KCompressionDevice device(new QFile(archiveFileName),
+                                  true,
+                                  (mArchiveType == ArchiveMailInfo::ArchiveTarGz) ? KCompressionDevice::GZip : KCompressionDevice::BZip2);
+        if (!device.open(QIODevice::ReadOnly) || !device.seek(entry.offset)) {
+            return QByteArray();
+        }
+        return device.read(entry.length);
+    }
+    case ArchiveMailInfo::ArchiveTarZstd:
+        return extractFromZstd(archiveFileName, entry);
+    }
+    return QByteArray();
+}
+
+QByteArray ArchiveIndex::extractFromZstd(const QString &archiveFileName, const Entry &entry) const
+{
+#if HAVE_ZSTD
+    // The last frame starting before the message
+    auto frameIt = std::upper_bound(mFrames.cbegin(), mFrames.cend(), entry.offset, [](qint64 offset, const Frame &frame) {
+        return offset < frame.uncompressedOffset;
+    });
+    if (frameIt == mFrames.cbegin()) {
+        return QByteArray();
+    }
+    --frameIt;
+
+    QFile file(archiveFileName);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(frameIt->compressedOffset)) {
+        return QByteArray();
+    }
+
+    QByteArray result;
+    qint64 toSkip = entry.offset - frameIt->uncompressedOffset;
+    ZSTD_DStream *stream = ZSTD_createDStream();
+    QByteArray output(static_cast<int>(ZSTD_DStreamOutSize()), Qt::Uninitialized);
+    while (result.size() < entry.length && !file.atEnd()) {
+        const QByteArray compressed = file.read(static_cast<qint64>(ZSTD_DStreamInSize()));
+        ZSTD_inBuffer in{compressed.constData(), static_cast<size_t>(compressed.size()), 0};
+        while (in.pos < in.size && result.size() < entry.length) {
+            ZSTD_outBuffer out{output.data(), static_cast<size_t>(output.size()), 0};
+            const size_t ret = ZSTD_decompressStream(stream, &out, &in);
+            if (ZSTD_isError(ret)) {
+                qCWarning(ARCHIVEMAILAGENT_LOG) << "Unable to decompress" << archiveFileName << ZSTD_getErrorName(ret);
+                ZSTD_freeDStream(stream);
+                return QByteArray();
+            }
+            qint64 available = static_cast<qint64>(out.pos);
+            qint64 start = 0;
+            if (toSkip > 0) {
+                start = qMin(toSkip, available);
+                toSkip -= start;
+            }
+            const qint64 needed = entry.length - result.size();
+            result.append(output.constData() + start, static_cast<int>(qMin(available - start, needed)));
+        }
+    }
+    ZSTD_freeDStream(stream);
+    return (result.size() == entry.length) ? result : QByteArray();
+#else
+    Q_UNUSED(archiveFileName)
+    Q_UNUSED(entry)
+    return QByteArray();
+#endif
+}
+
+QString ArchiveIndex::indexFileName(const QString &archiveFileName)
+{
+    return archiveFileName + QLatin1String(".index");
+}
+
+bool ArchiveIndex::load(const QString &archiveFileName)
+{
+    QFile file(indexFileName(archiveFileName));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_15);
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != IndexMagic || version != IndexVersion) {
+        return false;
+    }
+    qint32 type = 0;
+    qint32 frameCount = 0;
+    stream >> type >> frameCount;
+    mArchiveType = static_cast<ArchiveMailInfo::ArchiveType>(type);
+    mFrames.clear();
+    for (qint32 i = 0; i < frameCount && stream.status() == QDataStream::Ok; ++i) {
+        Frame frame;
+        stream >> frame.uncompressedOffset >> frame.compressedOffset;
+        mFrames.append(frame);
+    }
+    qint32 entryCount = 0;
+    stream >> entryCount;
+    mEntries.clear();
+    mEntries.reserve(qMax(0, entryCount));
+    for (qint32 i = 0; i < entryCount && stream.status() == QDataStream::Ok; ++i) {
+        Entry entry;
+        stream >> entry.itemId >> entry.messageId >> entry.date >> entry.from >> entry.subject >> entry.path >> entry.offset >> entry.length;
+        mEntries.append(entry);
+    }
+    return stream.status() == QDataStream::Ok;
+}
+
+bool ArchiveIndex::save(const QString &archiveFileName) const
+{
+    QSaveFile file(indexFileName(archiveFileName));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << IndexMagic << IndexVersion;
+    stream << static_cast<qint32>(mArchiveType) << static_cast<qint32>(mFrames.count());
+    for (const Frame &frame : mFrames) {
+        stream << frame.uncompressedOffset << frame.compressedOffset;
+    }
+    stream << static_cast<qint32>(mEntries.count());
+    for (const Entry &entry : mEntries) {
+        stream << entry.itemId << entry.messageId << entry.date << entry.from << entry.subject << entry.path << entry.offset << entry.length;
+    }
+    return stream.status() == QDataStream::Ok && file.commit();
+}
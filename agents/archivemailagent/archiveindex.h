@@ -0,0 +1,80 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "archivemailinfo.h"
+
+#include <Item>
+#include <QDateTime>
+#include <QVector>
+
+/**
+ * Searchable index of the messages of one archive.
+ *
+ * It is stored next to the archive as "<archive>.index" and allows to find and
+ * extract a single message without unpacking the whole archive. For tar based
+ * archives the offsets are positions in the uncompressed tar stream, for zstd
+ * archives the frame table maps them to the compressed file, so that only the
+ * frames containing the message are decompressed. Zip archives are accessed
+ * through their central directory.
+ */
+class ArchiveIndex
+{
+public:
+    struct Entry {
+        Akonadi::Item::Id itemId = -1;
+        QString messageId;
+        QDateTime date;
+        QString from;
+        QString subject;
+        QString path; // path of the message in the archive
+        qint64 offset = -1;
+        qint64 length = 0;
+    };
+
+    struct Frame {
+        qint64 uncompressedOffset = 0;
+        qint64 compressedOffset = 0;
+    };
+
+    ArchiveIndex() = default;
+
+    void setArchiveType(ArchiveMailInfo::ArchiveType type);
+    Q_REQUIRED_RESULT ArchiveMailInfo::ArchiveType archiveType() const;
+
+    void addEntry(const Entry &entry);
+    Q_REQUIRED_RESULT QVector<Entry> entries() const;
+
+    void setFrames(const QVector<Frame> &frames);
+    Q_REQUIRED_RESULT QVector<Frame> frames() const;
+
+    /**
+     * Returns the entries whose message-id is @p text or whose sender or subject
+     * contain it.
+     */
+    Q_REQUIRED_RESULT QVector<Entry> search(const QString &text) const;
+
+    /**
+     * Returns the entry with the message-id @p messageId, with an invalid itemId if there is none.
+     */
+    Q_REQUIRED_RESULT Entry findMessageId(const QString &messageId) const;
+
+    /**
+     * Reads the message of @p entry from @p archiveFileName.
+     */
+    Q_REQUIRED_RESULT QByteArray extract(const QString &archiveFileName, const Entry &entry) const;
+
+    Q_REQUIRED_RESULT static QString indexFileName(const QString &archiveFileName);
+    Q_REQUIRED_RESULT bool load(const QString &archiveFileName);
+    Q_REQUIRED_RESULT bool save(const QString &archiveFileName) const;
+
+private:
+    Q_REQUIRED_RESULT QByteArray extractFromZstd(const QString &archiveFileName, const Entry &entry) const;
+    QVector<Entry> mEntries;
+    QVector<Frame> mFrames;
+    ArchiveMailInfo::ArchiveType mArchiveType = ArchiveMailInfo::ArchiveZip;
+};
@@ -5,6 +5,8 @@
 */
 
 #include "archivemailagent.h"
+#include "archiveindex.h"
+#include "archivemailagent_debug.h"
 #include "archivemailagentadaptor.h"
 #include "archivemailagentsettings.h"
 #include "archivemailmanager.h"
@@ -139,4 +141,37 @@ void ArchiveMailAgent::archiveFolder(const QString &path, Akonadi::Collection::I
     mArchiveManager->archiveFolder(path, collectionId);
 }
 
+QStringList ArchiveMailAgent::searchArchive(const QString &archiveFile, const QString &text) const
+{
+    QStringList messageIds;
+    ArchiveIndex index;
+    if (!index.load(archiveFile)) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "No index for archive" << archiveFile;
+        return messageIds;
+    }
+    const QVector<ArchiveIndex::Entry> entries = index.search(text);
+    for (const ArchiveIndex::Entry &entry : entries) {
+        messageIds.append(entry.messageId);
+    }
+    return messageIds;
+}
+
+QByteArray ArchiveMailAgent::extractArchivedMessage(const QString &archiveFile, const QString &messageId) const
+{
+    ArchiveIndex index;
+    if (!index.load(archiveFile)) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "No index for archive" << archiveFile;
+        return QByteArray();
+    }
+    const ArchiveIndex::Entry entry = index.findMessageId(messageId);
+    if (entry.itemId < 0) {
+        return QByteArray();
+    }
+    const QByteArray data = index.extract(archiveFile, entry);
+    if (data.isEmpty()) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Unable to extract" << messageId << "from" << archiveFile;
+    }
+    return data;
+}
+
 AKONADI_AGENT_MAIN(ArchiveMailAgent)
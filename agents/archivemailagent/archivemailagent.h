@@ -28,6 +28,19 @@ public:
 
     Q_REQUIRED_RESULT QString printCurrentListInfo() const;
     void archiveFolder(const QString &path, Akonadi::Collection::Id collectionId);
+
+    /**
+     * Returns the message-ids of the messages of @p archiveFile whose message-id
+     * is @p text or whose sender or subject contain it, using the archive index.
+     */
+    Q_REQUIRED_RESULT QStringList searchArchive(const QString &archiveFile, const QString &text) const;
+
+    /**
+     * Returns the message with the message-id @p messageId from @p archiveFile,
+     * without unpacking the rest of the archive. The caller writes it where it
+     * wants, with its own permissions. Returns an empty array if it isn't found.
+     */
+    Q_REQUIRED_RESULT QByteArray extractArchivedMessage(const QString &archiveFile, const QString &messageId) const;
 Q_SIGNALS:
     void needUpdateConfigDialogBox();
 
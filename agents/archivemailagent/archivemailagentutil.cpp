@@ -7,27 +7,34 @@
 #include "archivemailagentutil.h"
 #include "archivemailagent_debug.h"
 
-QDate ArchiveMailAgentUtil::diffDate(ArchiveMailInfo *info)
+#include <QFileInfo>
+#include <QHash>
+#include <QRandomGenerator>
+
+namespace
+{
+QDate addArchiveInterval(const ArchiveMailInfo *info, const QDate &date)
 {
-    QDate diffDate(info->lastDateSaved());
     switch (info->archiveUnit()) {
     case ArchiveMailInfo::ArchiveDays:
-        diffDate = diffDate.addDays(info->archiveAge());
-        break;
+        return date.addDays(info->archiveAge());
     case ArchiveMailInfo::ArchiveWeeks:
-        diffDate = diffDate.addDays(info->archiveAge() * 7);
-        break;
+        return date.addDays(info->archiveAge() * 7);
     case ArchiveMailInfo::ArchiveMonths:
-        diffDate = diffDate.addMonths(info->archiveAge());
-        break;
+        return date.addMonths(info->archiveAge());
     case ArchiveMailInfo::ArchiveYears:
-        diffDate = diffDate.addYears(info->archiveAge());
-        break;
+        return date.addYears(info->archiveAge());
     }
-    return diffDate;
+    return date;
+}
 }
 
-bool ArchiveMailAgentUtil::needToArchive(ArchiveMailInfo *info)
+QDate ArchiveMailAgentUtil::diffDate(ArchiveMailInfo *info)
+{
+    return addArchiveInterval(info, info->lastDateSaved());
+}
+
+bool ArchiveMailAgentUtil::needToArchive(ArchiveMailInfo *info, CatchUpPolicy policy, const QDate &today)
 {
     if (!info->isEnabled()) {
         return false;
@@ -37,10 +44,101 @@ bool ArchiveMailAgentUtil::needToArchive(ArchiveMailInfo *info)
     }
     if (!info->lastDateSaved().isValid()) {
         return true;
+    }
+    const QDate dueDate = diffDate(info);
+    if (today < dueDate) {
+        return false;
+    }
+    if (policy != CatchUpSkip || dueDate == today || info->archiveAge() <= 0) {
+        return true;
+    }
+    // Only run when today is one of the regular dates, the missed ones are dropped
+    QDate date = dueDate;
+    while (date < today) {
+        date = addArchiveInterval(info, date);
+    }
+    return date == today;
+}
+
+QVector<int> ArchiveMailAgentUtil::startDelays(int count, CatchUpPolicy policy, int windowMSecs, QRandomGenerator *generator)
+{
+    QVector<int> delays;
+    delays.reserve(count);
+    if (count <= 0) {
+        return delays;
+    }
+    if (windowMSecs <= 0) {
+        delays.fill(0, count);
+        return delays;
+    }
+    if (policy == CatchUpStagger) {
+        // One slot per archive, with a random start inside of the slot
+        const int slot = windowMSecs / count;
+        for (int i = 0; i < count; ++i) {
+            delays.append(i * slot + (slot > 0 ? static_cast<int>(generator->bounded(slot)) : 0));
+        }
     } else {
-        if (QDate::currentDate() >= diffDate(info)) {
-            return true;
+        for (int i = 0; i < count; ++i) {
+            delays.append(static_cast<int>(generator->bounded(windowMSecs)));
+        }
+    }
+    return delays;
+}
+
+int ArchiveMailAgentUtil::maximumChainLength(const ArchiveMailInfo *info)
+{
+    if (info->maximumArchiveCount() <= 0) {
+        return 0;
+    }
+    // Keep room for at least two chains, otherwise removing the oldest chain leaves only a few archives
+    return qMax(1, info->maximumArchiveCount() / 2);
+}
+
+bool ArchiveMailAgentUtil::needFullArchive(const ArchiveMailInfo *info)
+{
+    if (info->archiveMode() == ArchiveMailInfo::FullArchive) {
+        return true;
+    }
+    if (info->lastArchivedItemId() < 0 || !info->lastArchiveDateTime().isValid() || info->lastFullArchive().isEmpty()) {
+        return true;
+    }
+    if (!QFileInfo::exists(info->url().path() + QLatin1Char('/') + info->lastFullArchive())) {
+        return true;
+    }
+    const int maximumLength = maximumChainLength(info);
+    return maximumLength > 0 && (info->incrementalArchiveCount() + 1) >= maximumLength;
+}
+
+QStringList ArchiveMailAgentUtil::archivesToRemove(const QStringList &archives, const QStringList &baseArchives, int maximumArchiveCount)
+{
+    QStringList result;
+    if (maximumArchiveCount <= 0 || archives.count() <= maximumArchiveCount || archives.count() != baseArchives.count()) {
+        return result;
+    }
+
+    // Group the archives by chain, the oldest chain first
+    QStringList chainOrder;
+    QHash<QString, QStringList> chains;
+    for (int i = 0, total = archives.count(); i < total; ++i) {
+        const QString &base = baseArchives.at(i);
+        if (!chains.contains(base)) {
+            chainOrder.append(base);
+        }
+        chains[base].append(archives.at(i));
+    }
+    const QString newestChain = baseArchives.constLast();
+
+    int remaining = archives.count();
+    for (const QString &base : std::as_const(chainOrder)) {
+        if (remaining <= maximumArchiveCount) {
+            break;
+        }
+        if (base == newestChain) {
+            continue;
         }
+        const QStringList chain = chains.value(base);
+        result += chain;
+        remaining -= chain.count();
     }
-    return false;
+    return result;
 }
@@ -8,11 +8,53 @@
 
 #include "archivemailinfo.h"
 #include <QDate>
+#include <QVector>
+
+class QRandomGenerator;
 
 namespace ArchiveMailAgentUtil
 {
 static QString archivePattern = QStringLiteral("ArchiveMailCollection %1");
+
+/**
+ * What to do with the archives which became due while the agent was not running.
+ * The values match the CatchUpPolicy entry of the agent settings.
+ */
+enum CatchUpPolicy {
+    CatchUpSkip = 0, ///< drop the missed archives, wait for the next regular date
+    CatchUpRunOnce, ///< write one archive for all the missed ones, at a random time of the start window
+    CatchUpStagger, ///< like CatchUpRunOnce, but spread the archives evenly over the start window
+};
+
 Q_REQUIRED_RESULT QDate diffDate(ArchiveMailInfo *info);
-Q_REQUIRED_RESULT bool needToArchive(ArchiveMailInfo *info);
+Q_REQUIRED_RESULT bool needToArchive(ArchiveMailInfo *info, CatchUpPolicy policy = CatchUpRunOnce, const QDate &today = QDate::currentDate());
+
+/**
+ * Returns the delays in milliseconds after which @p count archives due at the same
+ * time are started, so that they don't all start at once.
+ * The archives should be sorted by due date, the oldest first.
+ */
+Q_REQUIRED_RESULT QVector<int> startDelays(int count, CatchUpPolicy policy, int windowMSecs, QRandomGenerator *generator);
+
+/**
+ * Returns the number of archives in a chain of incremental archives, including
+ * the full archive it starts with, after which a new full archive is written.
+ * 0 means the chain is never restarted.
+ */
+Q_REQUIRED_RESULT int maximumChainLength(const ArchiveMailInfo *info);
+
+/**
+ * Returns whether the next archive of @p info has to be a full archive.
+ */
+Q_REQUIRED_RESULT bool needFullArchive(const ArchiveMailInfo *info);
+
+/**
+ * Returns the archives to delete to honor @p maximumArchiveCount.
+ * @p archives are sorted from the oldest to the newest, @p baseArchives contains
+ * for each of them the full archive it depends on (itself for a full archive).
+ * An archive is only removed together with all the incremental archives based
+ * on it, and the newest chain is always kept.
+ */
+Q_REQUIRED_RESULT QStringList archivesToRemove(const QStringList &archives, const QStringList &baseArchives, int maximumArchiveCount);
 }
 
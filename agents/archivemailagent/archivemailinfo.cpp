@@ -27,6 +27,11 @@ ArchiveMailInfo::ArchiveMailInfo(const ArchiveMailInfo &info)
     mSaveSubCollection = info.saveSubCollection();
     mPath = info.url();
     mIsEnabled = info.isEnabled();
+    mArchiveMode = info.archiveMode();
+    mLastArchivedItemId = info.lastArchivedItemId();
+    mLastArchiveDateTime = info.lastArchiveDateTime();
+    mLastFullArchive = info.lastFullArchive();
+    mIncrementalArchiveCount = info.incrementalArchiveCount();
 }
 
 ArchiveMailInfo::~ArchiveMailInfo() = default;
@@ -42,6 +47,11 @@ ArchiveMailInfo &ArchiveMailInfo::operator=(const ArchiveMailInfo &old)
     mSaveSubCollection = old.saveSubCollection();
     mPath = old.url();
     mIsEnabled = old.isEnabled();
+    mArchiveMode = old.archiveMode();
+    mLastArchivedItemId = old.lastArchivedItemId();
+    mLastArchiveDateTime = old.lastArchiveDateTime();
+    mLastFullArchive = old.lastFullArchive();
+    mIncrementalArchiveCount = old.incrementalArchiveCount();
     return *this;
 }
 
@@ -66,24 +76,26 @@ QString ArchiveMailInfo::dirArchive(bool &dirExit) const
     return dirPath;
 }
 
-QUrl ArchiveMailInfo::realUrl(const QString &folderName, bool &dirExist) const
+QUrl ArchiveMailInfo::realUrl(const QString &folderName, bool &dirExist, bool incremental) const
 {
-    const int numExtensions = 4;
-    // The extensions here are also sorted, like the enum order of BackupJob::ArchiveType
-    const char *extensions[numExtensions] = {".zip", ".tar", ".tar.bz2", ".tar.gz"};
+    const int numExtensions = 5;
+    // The extensions here are also sorted, like the enum order of ArchiveType
+    const char *extensions[numExtensions] = {".zip", ".tar", ".tar.bz2", ".tar.gz", ".tar.zst"};
     const QString dirPath = dirArchive(dirExist);
 
     const QString path = dirPath + QLatin1Char('/') + i18nc("Start of the filename for a mail archive file", "Archive") + QLatin1Char('_')
-        + normalizeFolderName(folderName) + QLatin1Char('_') + QDate::currentDate().toString(Qt::ISODate) + QString::fromLatin1(extensions[mArchiveType]);
+        + normalizeFolderName(folderName) + QLatin1Char('_') + QDate::currentDate().toString(Qt::ISODate)
+        + (incremental ? QLatin1Char('_') + i18nc("Part of the filename for an incremental mail archive file", "incremental") : QString())
+        + QString::fromLatin1(extensions[mArchiveType]);
     const QUrl real(QUrl::fromLocalFile(path));
     return real;
 }
 
 QStringList ArchiveMailInfo::listOfArchive(const QString &folderName, bool &dirExist) const
 {
-    const int numExtensions = 4;
-    // The extensions here are also sorted, like the enum order of BackupJob::ArchiveType
-    const char *extensions[numExtensions] = {".zip", ".tar", ".tar.bz2", ".tar.gz"};
+    const int numExtensions = 5;
+    // The extensions here are also sorted, like the enum order of ArchiveType
+    const char *extensions[numExtensions] = {".zip", ".tar", ".tar.bz2", ".tar.gz", ".tar.zst"};
     const QString dirPath = dirArchive(dirExist);
 
     QDir dir(dirPath);
@@ -120,12 +132,12 @@ ArchiveMailInfo::ArchiveUnit ArchiveMailInfo::archiveUnit() const
     return mArchiveUnit;
 }
 
-void ArchiveMailInfo::setArchiveType(MailCommon::BackupJob::ArchiveType type)
+void ArchiveMailInfo::setArchiveType(ArchiveMailInfo::ArchiveType type)
 {
     mArchiveType = type;
 }
 
-MailCommon::BackupJob::ArchiveType ArchiveMailInfo::archiveType() const
+ArchiveMailInfo::ArchiveType ArchiveMailInfo::archiveType() const
 {
     return mArchiveType;
 }
@@ -148,7 +160,8 @@ void ArchiveMailInfo::readConfig(const KConfigGroup &config)
         mLastDateSaved = QDate::fromString(config.readEntry("lastDateSaved"), Qt::ISODate);
     }
     mSaveSubCollection = config.readEntry("saveSubCollection", false);
-    mArchiveType = static_cast<MailCommon::BackupJob::ArchiveType>(config.readEntry("archiveType", (int)MailCommon::BackupJob::Zip));
+    const int archiveType = config.readEntry("archiveType", (int)ArchiveMailInfo::ArchiveZip);
+    mArchiveType = (archiveType >= ArchiveZip && archiveType <= ArchiveTarZstd) ? static_cast<ArchiveMailInfo::ArchiveType>(archiveType) : ArchiveZip;
     mArchiveUnit = static_cast<ArchiveUnit>(config.readEntry("archiveUnit", (int)ArchiveDays));
     Akonadi::Collection::Id tId = config.readEntry("saveCollectionId", mSaveCollectionId);
     mArchiveAge = config.readEntry("archiveAge", 1);
@@ -157,6 +170,13 @@ void ArchiveMailInfo::readConfig(const KConfigGroup &config)
         mSaveCollectionId = tId;
     }
     mIsEnabled = config.readEntry("enabled", true);
+    mArchiveMode = static_cast<ArchiveMode>(config.readEntry("archiveMode", (int)FullArchive));
+    mLastArchivedItemId = config.readEntry("lastArchivedItemId", Akonadi::Item::Id(-1));
+    if (config.hasKey(QStringLiteral("lastArchiveDateTime"))) {
+        mLastArchiveDateTime = QDateTime::fromString(config.readEntry("lastArchiveDateTime"), Qt::ISODateWithMs);
+    }
+    mLastFullArchive = config.readEntry("lastFullArchive");
+    mIncrementalArchiveCount = config.readEntry("incrementalArchiveCount", 0);
 }
 
 void ArchiveMailInfo::writeConfig(KConfigGroup &config)
@@ -177,6 +197,13 @@ void ArchiveMailInfo::writeConfig(KConfigGroup &config)
     config.writeEntry("archiveAge", mArchiveAge);
     config.writeEntry("maximumArchiveCount", mMaximumArchiveCount);
     config.writeEntry("enabled", mIsEnabled);
+    config.writeEntry("archiveMode", static_cast<int>(mArchiveMode));
+    config.writeEntry("lastArchivedItemId", mLastArchivedItemId);
+    if (mLastArchiveDateTime.isValid()) {
+        config.writeEntry("lastArchiveDateTime", mLastArchiveDateTime.toString(Qt::ISODateWithMs));
+    }
+    config.writeEntry("lastFullArchive", mLastFullArchive);
+    config.writeEntry("incrementalArchiveCount", mIncrementalArchiveCount);
     config.sync();
 }
 
@@ -230,9 +257,61 @@ void ArchiveMailInfo::setEnabled(bool b)
     mIsEnabled = b;
 }
 
+void ArchiveMailInfo::setArchiveMode(ArchiveMailInfo::ArchiveMode mode)
+{
+    mArchiveMode = mode;
+}
+
+ArchiveMailInfo::ArchiveMode ArchiveMailInfo::archiveMode() const
+{
+    return mArchiveMode;
+}
+
+void ArchiveMailInfo::setLastArchivedItemId(Akonadi::Item::Id id)
+{
+    mLastArchivedItemId = id;
+}
+
+Akonadi::Item::Id ArchiveMailInfo::lastArchivedItemId() const
+{
+    return mLastArchivedItemId;
+}
+
+void ArchiveMailInfo::setLastArchiveDateTime(const QDateTime &dateTime)
+{
+    mLastArchiveDateTime = dateTime;
+}
+
+QDateTime ArchiveMailInfo::lastArchiveDateTime() const
+{
+    return mLastArchiveDateTime;
+}
+
+void ArchiveMailInfo::setLastFullArchive(const QString &fileName)
+{
+    mLastFullArchive = fileName;
+}
+
+QString ArchiveMailInfo::lastFullArchive() const
+{
+    return mLastFullArchive;
+}
+
+void ArchiveMailInfo::setIncrementalArchiveCount(int count)
+{
+    mIncrementalArchiveCount = count;
+}
+
+int ArchiveMailInfo::incrementalArchiveCount() const
+{
+    return mIncrementalArchiveCount;
+}
+
 bool ArchiveMailInfo::operator==(const ArchiveMailInfo &other) const
 {
     return saveCollectionId() == other.saveCollectionId() && saveSubCollection() == other.saveSubCollection() && url() == other.url()
         && archiveType() == other.archiveType() && archiveUnit() == other.archiveUnit() && archiveAge() == other.archiveAge()
-        && lastDateSaved() == other.lastDateSaved() && maximumArchiveCount() == other.maximumArchiveCount() && isEnabled() == other.isEnabled();
+        && lastDateSaved() == other.lastDateSaved() && maximumArchiveCount() == other.maximumArchiveCount() && isEnabled() == other.isEnabled()
+        && archiveMode() == other.archiveMode() && lastArchivedItemId() == other.lastArchivedItemId() && lastArchiveDateTime() == other.lastArchiveDateTime()
+        && lastFullArchive() == other.lastFullArchive() && incrementalArchiveCount() == other.incrementalArchiveCount();
 }
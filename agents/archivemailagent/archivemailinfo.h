@@ -6,9 +6,10 @@
 #pragma once
 
 #include <Collection>
+#include <Item>
 #include <KConfigGroup>
-#include <MailCommon/BackupJob>
 #include <QDate>
+#include <QDateTime>
 #include <QUrl>
 
 class ArchiveMailInfo
@@ -28,7 +29,21 @@ public:
         ArchiveYears,
     };
 
-    Q_REQUIRED_RESULT QUrl realUrl(const QString &folderName, bool &dirExist) const;
+    // The values match MailCommon::BackupJob::ArchiveType, which was used before
+    enum ArchiveType {
+        ArchiveZip = 0,
+        ArchiveTar,
+        ArchiveTarBz2,
+        ArchiveTarGz,
+        ArchiveTarZstd,
+    };
+
+    enum ArchiveMode {
+        FullArchive = 0,
+        IncrementalArchive,
+    };
+
+    Q_REQUIRED_RESULT QUrl realUrl(const QString &folderName, bool &dirExist, bool incremental = false) const;
 
     Q_REQUIRED_RESULT bool isValid() const;
 
@@ -44,8 +59,8 @@ public:
     void readConfig(const KConfigGroup &config);
     void writeConfig(KConfigGroup &config);
 
-    void setArchiveType(MailCommon::BackupJob::ArchiveType type);
-    Q_REQUIRED_RESULT MailCommon::BackupJob::ArchiveType archiveType() const;
+    void setArchiveType(ArchiveMailInfo::ArchiveType type);
+    Q_REQUIRED_RESULT ArchiveMailInfo::ArchiveType archiveType() const;
 
     void setArchiveUnit(ArchiveMailInfo::ArchiveUnit unit);
     Q_REQUIRED_RESULT ArchiveMailInfo::ArchiveUnit archiveUnit() const;
@@ -64,17 +79,48 @@ public:
     Q_REQUIRED_RESULT bool isEnabled() const;
     void setEnabled(bool b);
 
+    void setArchiveMode(ArchiveMailInfo::ArchiveMode mode);
+    Q_REQUIRED_RESULT ArchiveMailInfo::ArchiveMode archiveMode() const;
+
+    /**
+     * High-water mark of the last archive in incremental mode: the largest item id
+     * and the time at which the items were listed. Only items above it are written
+     * to the next incremental archive.
+     */
+    void setLastArchivedItemId(Akonadi::Item::Id id);
+    Q_REQUIRED_RESULT Akonadi::Item::Id lastArchivedItemId() const;
+
+    void setLastArchiveDateTime(const QDateTime &dateTime);
+    Q_REQUIRED_RESULT QDateTime lastArchiveDateTime() const;
+
+    /**
+     * File name of the full archive the current chain of incremental archives is based on.
+     */
+    void setLastFullArchive(const QString &fileName);
+    Q_REQUIRED_RESULT QString lastFullArchive() const;
+
+    /**
+     * Number of incremental archives written since lastFullArchive().
+     */
+    void setIncrementalArchiveCount(int count);
+    Q_REQUIRED_RESULT int incrementalArchiveCount() const;
+
     Q_REQUIRED_RESULT bool operator==(const ArchiveMailInfo &other) const;
 
 private:
     QString dirArchive(bool &dirExit) const;
     QDate mLastDateSaved;
+    QDateTime mLastArchiveDateTime;
+    QString mLastFullArchive;
+    Akonadi::Item::Id mLastArchivedItemId = -1;
     int mArchiveAge = 1;
-    MailCommon::BackupJob::ArchiveType mArchiveType = MailCommon::BackupJob::Zip;
+    ArchiveMailInfo::ArchiveType mArchiveType = ArchiveMailInfo::ArchiveZip;
     ArchiveUnit mArchiveUnit = ArchiveMailInfo::ArchiveDays;
     Akonadi::Collection::Id mSaveCollectionId = -1;
     QUrl mPath;
     int mMaximumArchiveCount = 0;
+    int mIncrementalArchiveCount = 0;
+    ArchiveMode mArchiveMode = ArchiveMailInfo::FullArchive;
     bool mSaveSubCollection = false;
     bool mIsEnabled = true;
 };
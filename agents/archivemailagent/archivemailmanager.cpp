@@ -8,6 +8,10 @@
 #include "archivemailagentutil.h"
 #include "archivemailinfo.h"
 #include "archivemailkernel.h"
+#include "archiveindex.h"
+#include "archivemailagentsettings.h"
+#include "archivemanifest.h"
+#include "archivescheduler.h"
 #include "job/archivejob.h"
 
 #include <MailCommon/MailKernel>
@@ -18,10 +22,14 @@
 
 #include <QDate>
 #include <QFile>
+#include <QRandomGenerator>
 #include <QRegularExpression>
 
+#include <algorithm>
+
 ArchiveMailManager::ArchiveMailManager(QObject *parent)
     : QObject(parent)
+    , mScheduler(new ArchiveScheduler(this))
 {
     mArchiveMailKernel = ArchiveMailKernel::self();
     CommonKernel->registerKernelIf(mArchiveMailKernel); // register KernelIf early, it is used by the Filter classes
@@ -34,19 +42,33 @@ ArchiveMailManager::~ArchiveMailManager()
     qDeleteAll(mListArchiveInfo);
 }
 
+void ArchiveMailManager::loadSchedulerSettings()
+{
+    ArchiveMailAgentSettings::self()->load();
+    mScheduler->setMaximumConcurrentArchives(ArchiveMailAgentSettings::maximumConcurrentArchives());
+    mScheduler->setMaximumArchivesPerDevice(ArchiveMailAgentSettings::maximumArchivesPerDevice());
+    mScheduler->setMaximumBytesPerSecond(ArchiveMailAgentSettings::maximumKiBPerSecond() * 1024LL);
+    mScheduler->setIdleIoPriority(ArchiveMailAgentSettings::idleIoPriority());
+}
+
 void ArchiveMailManager::load()
 {
+    loadSchedulerSettings();
+    // The queued tasks refer to the infos deleted below, they are queued again if still needed
+    mScheduler->clearPendingTasks();
     qDeleteAll(mListArchiveInfo);
     mListArchiveInfo.clear();
 
+    const auto policy = static_cast<ArchiveMailAgentUtil::CatchUpPolicy>(ArchiveMailAgentSettings::catchUpPolicy());
+    QVector<ArchiveMailInfo *> dueInfos;
     const QStringList collectionList = mConfig->groupList().filter(QRegularExpression(QStringLiteral("ArchiveMailCollection \\d+")));
     const int numberOfCollection = collectionList.count();
     for (int i = 0; i < numberOfCollection; ++i) {
         KConfigGroup group = mConfig->group(collectionList.at(i));
         auto info = new ArchiveMailInfo(group);
 
-        if (ArchiveMailAgentUtil::needToArchive(info)) {
-            for (ArchiveMailInfo *oldInfo : std::as_const(mListArchiveInfo)) {
+        if (ArchiveMailAgentUtil::needToArchive(info, policy)) {
+            for (ArchiveMailInfo *oldInfo : std::as_const(dueInfos)) {
                 if (oldInfo->saveCollectionId() == info->saveCollectionId()) {
                     // already in jobscheduler
                     delete info;
@@ -55,15 +77,29 @@ void ArchiveMailManager::load()
                 }
             }
             if (info) {
-                // Store task started
-                mListArchiveInfo.append(info);
-                auto task = new ScheduledArchiveTask(this, info, Akonadi::Collection(info->saveCollectionId()), /*immediate*/ false);
-                mArchiveMailKernel->jobScheduler()->registerTask(task);
+                dueInfos.append(info);
             }
         } else {
             delete info;
         }
     }
+
+    // After a long shutdown many archives are due at once, don't start them all at the same time.
+    // The oldest ones go first, archives which were never written count as the oldest.
+    std::stable_sort(dueInfos.begin(), dueInfos.end(), [](ArchiveMailInfo *lhs, ArchiveMailInfo *rhs) {
+        const QDate lhsDate = lhs->lastDateSaved().isValid() ? ArchiveMailAgentUtil::diffDate(lhs) : QDate(1, 1, 1);
+        const QDate rhsDate = rhs->lastDateSaved().isValid() ? ArchiveMailAgentUtil::diffDate(rhs) : QDate(1, 1, 1);
+        return lhsDate < rhsDate;
+    });
+    const QVector<int> delays =
+        ArchiveMailAgentUtil::startDelays(dueInfos.count(), policy, ArchiveMailAgentSettings::startWindowMinutes() * 60 * 1000, QRandomGenerator::global());
+    for (int i = 0, total = dueInfos.count(); i < total; ++i) {
+        ArchiveMailInfo *info = dueInfos.at(i);
+        // Store task started
+        mListArchiveInfo.append(info);
+        auto task = new ScheduledArchiveTask(this, info, Akonadi::Collection(info->saveCollectionId()), /*immediate*/ false);
+        mScheduler->registerTask(task, delays.at(i));
+    }
 }
 
 void ArchiveMailManager::removeCollection(const Akonadi::Collection &collection)
@@ -104,11 +140,24 @@ void ArchiveMailManager::backupDone(ArchiveMailInfo *info)
     if (dirExist) {
         if (info->maximumArchiveCount() != 0) {
             if (lst.count() > info->maximumArchiveCount()) {
-                const int diff = (lst.count() - info->maximumArchiveCount());
-                for (int i = 0; i < diff; ++i) {
-                    const QString fileToRemove(info->url().path() + QLatin1Char('/') + lst.at(i));
+                // Incremental archives can't be restored without the archives they are based on
+                QStringList baseArchives;
+                baseArchives.reserve(lst.count());
+                for (const QString &archive : lst) {
+                    ArchiveManifest manifest;
+                    if (manifest.load(info->url().path() + QLatin1Char('/') + archive) && !manifest.baseArchive.isEmpty()) {
+                        baseArchives.append(manifest.baseArchive);
+                    } else {
+                        baseArchives.append(archive);
+                    }
+                }
+                const QStringList filesToRemove = ArchiveMailAgentUtil::archivesToRemove(lst, baseArchives, info->maximumArchiveCount());
+                for (const QString &file : filesToRemove) {
+                    const QString fileToRemove(info->url().path() + QLatin1Char('/') + file);
                     qCDebug(ARCHIVEMAILAGENT_LOG) << " file to remove " << fileToRemove;
                     QFile::remove(fileToRemove);
+                    QFile::remove(ArchiveManifest::manifestFileName(fileToRemove));
+                    QFile::remove(ArchiveIndex::indexFileName(fileToRemove));
                 }
             }
         }
@@ -127,12 +176,12 @@ void ArchiveMailManager::collectionDoesntExist(ArchiveMailInfo *info)
 
 void ArchiveMailManager::pause()
 {
-    mArchiveMailKernel->jobScheduler()->pause();
+    mScheduler->pause();
 }
 
 void ArchiveMailManager::resume()
 {
-    mArchiveMailKernel->jobScheduler()->resume();
+    mScheduler->resume();
 }
 
 QString ArchiveMailManager::printCurrentListInfo() const
@@ -158,6 +207,10 @@ QString ArchiveMailManager::infoToStr(ArchiveMailInfo *info) const
     infoStr += QLatin1String("last Date Saved: ") + info->lastDateSaved().toString() + QLatin1Char('\n');
     infoStr += QLatin1String("maximum archive number: ") + QString::number(info->maximumArchiveCount()) + QLatin1Char('\n');
     infoStr += QLatin1String("directory: ") + info->url().toDisplayString() + QLatin1Char('\n');
+    if (info->archiveMode() == ArchiveMailInfo::IncrementalArchive) {
+        infoStr += QLatin1String("incremental archives since last full archive: ") + QString::number(info->incrementalArchiveCount()) + QLatin1Char('\n');
+        infoStr += QLatin1String("last full archive: ") + info->lastFullArchive() + QLatin1Char('\n');
+    }
     infoStr += QLatin1String("Enabled: ") + (info->isEnabled() ? QStringLiteral("true") : QStringLiteral("false"));
     return infoStr;
 }
@@ -185,5 +238,5 @@ void ArchiveMailManager::archiveFolder(const QString &path, Akonadi::Collection:
     info->setUrl(QUrl::fromLocalFile(path));
     mListArchiveInfo.append(info);
     auto task = new ScheduledArchiveTask(this, info, Akonadi::Collection(info->saveCollectionId()), true /*immediat*/);
-    mArchiveMailKernel->jobScheduler()->registerTask(task);
+    mScheduler->registerTask(task);
 }
@@ -13,6 +13,7 @@
 
 class ArchiveMailKernel;
 class ArchiveMailInfo;
+class ArchiveScheduler;
 
 class ArchiveMailManager : public QObject
 {
@@ -37,6 +38,11 @@ public:
         return mArchiveMailKernel;
     }
 
+    ArchiveScheduler *scheduler() const
+    {
+        return mScheduler;
+    }
+
 public Q_SLOTS:
     void load();
 
@@ -47,8 +53,10 @@ private:
     Q_DISABLE_COPY(ArchiveMailManager)
     QString infoToStr(ArchiveMailInfo *info) const;
     void removeCollectionId(Akonadi::Collection::Id id);
+    void loadSchedulerSettings();
     KSharedConfig::Ptr mConfig;
     QVector<ArchiveMailInfo *> mListArchiveInfo;
     ArchiveMailKernel *mArchiveMailKernel = nullptr;
+    ArchiveScheduler *const mScheduler;
 };
 
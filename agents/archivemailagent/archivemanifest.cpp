@@ -0,0 +1,98 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "archivemanifest.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+#include <algorithm>
+
+namespace
+{
+// Item ids are mostly contiguous, store them as [first, last] ranges
+QJsonArray idsToJson(QVector<Akonadi::Item::Id> ids)
+{
+    std::sort(ids.begin(), ids.end());
+    QJsonArray ranges;
+    for (int i = 0, total = ids.count(); i < total;) {
+        int j = i;
+        while (j + 1 < total && ids.at(j + 1) <= ids.at(j) + 1) {
+            ++j;
+        }
+        ranges.append(QJsonArray{ids.at(i), ids.at(j)});
+        i = j + 1;
+    }
+    return ranges;
+}
+
+QVector<Akonadi::Item::Id> idsFromJson(const QJsonArray &ranges)
+{
+    QVector<Akonadi::Item::Id> ids;
+    for (const QJsonValue &value : ranges) {
+        const QJsonArray range = value.toArray();
+        if (range.count() != 2) {
+            continue;
+        }
+        for (auto id = static_cast<Akonadi::Item::Id>(range.at(0).toDouble()), last = static_cast<Akonadi::Item::Id>(range.at(1).toDouble()); id <= last;
+             ++id) {
+            ids.append(id);
+        }
+    }
+    return ids;
+}
+}
+
+QString ArchiveManifest::manifestFileName(const QString &archiveFileName)
+{
+    return archiveFileName + QLatin1String(".manifest");
+}
+
+bool ArchiveManifest::load(const QString &archiveFileName)
+{
+    QFile file(manifestFileName(archiveFileName));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QJsonObject obj = QJsonDocument::fromJson(file.readAll()).object();
+    if (obj.isEmpty()) {
+        return false;
+    }
+    type = (obj.value(QStringLiteral("type")).toString() == QLatin1String("incremental")) ? Incremental : Full;
+    collectionId = static_cast<Akonadi::Collection::Id>(obj.value(QStringLiteral("collectionId")).toDouble(-1));
+    created = QDateTime::fromString(obj.value(QStringLiteral("created")).toString(), Qt::ISODateWithMs);
+    baseArchive = obj.value(QStringLiteral("baseArchive")).toString();
+    previousArchive = obj.value(QStringLiteral("previousArchive")).toString();
+    highWaterItemId = static_cast<Akonadi::Item::Id>(obj.value(QStringLiteral("highWaterItemId")).toDouble(-1));
+    highWaterDateTime = QDateTime::fromString(obj.value(QStringLiteral("highWaterDateTime")).toString(), Qt::ISODateWithMs);
+    archivedItems = idsFromJson(obj.value(QStringLiteral("archivedItems")).toArray());
+    presentItems = idsFromJson(obj.value(QStringLiteral("presentItems")).toArray());
+    return true;
+}
+
+bool ArchiveManifest::save(const QString &archiveFileName) const
+{
+    QJsonObject obj;
+    obj[QStringLiteral("type")] = (type == Incremental) ? QStringLiteral("incremental") : QStringLiteral("full");
+    obj[QStringLiteral("collectionId")] = collectionId;
+    obj[QStringLiteral("created")] = created.toString(Qt::ISODateWithMs);
+    obj[QStringLiteral("baseArchive")] = baseArchive;
+    obj[QStringLiteral("previousArchive")] = previousArchive;
+    obj[QStringLiteral("highWaterItemId")] = highWaterItemId;
+    obj[QStringLiteral("highWaterDateTime")] = highWaterDateTime.toString(Qt::ISODateWithMs);
+    obj[QStringLiteral("archivedItems")] = idsToJson(archivedItems);
+    obj[QStringLiteral("presentItems")] = idsToJson(presentItems);
+
+    QSaveFile file(manifestFileName(archiveFileName));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
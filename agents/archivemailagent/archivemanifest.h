@@ -0,0 +1,51 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <Collection>
+#include <Item>
+#include <QDateTime>
+#include <QVector>
+
+/**
+ * Describes the content of one archive file.
+ *
+ * It is stored next to the archive as "<archive>.manifest". A full archive
+ * contains every message of the folder, an incremental archive only the
+ * messages added or modified since the previous archive of its chain. To
+ * restore a chain, extract the base archive and then every incremental archive
+ * in order, the last manifest lists which messages still existed.
+ */
+struct ArchiveManifest {
+    enum Type {
+        Full = 0,
+        Incremental,
+    };
+
+    Type type = Full;
+    Akonadi::Collection::Id collectionId = -1;
+    QDateTime created;
+    /// file name of the full archive of the chain, the archive itself for a full archive
+    QString baseArchive;
+    /// file name of the archive this one follows in the chain, empty for a full archive
+    QString previousArchive;
+    Akonadi::Item::Id highWaterItemId = -1;
+    QDateTime highWaterDateTime;
+    /// items written to this archive
+    QVector<Akonadi::Item::Id> archivedItems;
+    /// all items of the folder when the archive was written
+    QVector<Akonadi::Item::Id> presentItems;
+
+    Q_REQUIRED_RESULT static QString manifestFileName(const QString &archiveFileName);
+
+    /**
+     * Reads the manifest of @p archiveFileName. Returns false if there is none,
+     * archives written by MailCommon::BackupJob don't have one.
+     */
+    Q_REQUIRED_RESULT bool load(const QString &archiveFileName);
+    Q_REQUIRED_RESULT bool save(const QString &archiveFileName) const;
+};
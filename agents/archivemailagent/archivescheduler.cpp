@@ -0,0 +1,214 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "archivescheduler.h"
+#include "archivemailagent_debug.h"
+#include "archivemailinfo.h"
+#include "job/archivejob.h"
+
+#include <QDateTime>
+#include <QStorageInfo>
+#include <QTimer>
+
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#if defined(Q_OS_LINUX) && defined(SYS_ioprio_set)
+// From linux/ioprio.h, which isn't installed everywhere
+constexpr int IoprioWhoProcess = 1;
+constexpr int IoprioClassShift = 13;
+constexpr int IoprioClassBestEffort = 2;
+constexpr int IoprioClassIdle = 3;
+constexpr int IoprioDefaultLevel = 4;
+#endif
+
+void setIoPriority(bool idle)
+{
+#if defined(Q_OS_LINUX) && defined(SYS_ioprio_set)
+    // The archive jobs write from the main thread, for which "0" stands here
+    const int priority = idle ? (IoprioClassIdle << IoprioClassShift) : ((IoprioClassBestEffort << IoprioClassShift) | IoprioDefaultLevel);
+    if (syscall(SYS_ioprio_set, IoprioWhoProcess, 0, priority) != 0) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Unable to change the I/O priority";
+    }
+#else
+    Q_UNUSED(idle)
+#endif
+}
+}
+
+void ArchiveThrottle::setMaximumBytesPerSecond(qint64 bytesPerSecond)
+{
+    mMaximumBytesPerSecond = qMax<qint64>(0, bytesPerSecond);
+}
+
+qint64 ArchiveThrottle::maximumBytesPerSecond() const
+{
+    return mMaximumBytesPerSecond;
+}
+
+int ArchiveThrottle::reserve(qint64 bytes)
+{
+    if (mMaximumBytesPerSecond <= 0) {
+        return 0;
+    }
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    mNextFreeTime = qMax(mNextFreeTime, now) + (bytes * 1000) / mMaximumBytesPerSecond;
+    return static_cast<int>(qMax<qint64>(0, mNextFreeTime - now));
+}
+
+ArchiveScheduler::ArchiveScheduler(QObject *parent)
+    : QObject(parent)
+{
+}
+
+ArchiveScheduler::~ArchiveScheduler()
+{
+    clearPendingTasks();
+    qDeleteAll(mThrottles);
+    if (mIoPriorityLowered) {
+        setIoPriority(false);
+    }
+}
+
+QByteArray ArchiveScheduler::deviceForPath(const QString &path)
+{
+    const QStorageInfo storage(path);
+    return storage.isValid() ? storage.device() : QByteArray();
+}
+
+void ArchiveScheduler::registerTask(ScheduledArchiveTask *task, int delayMSecs)
+{
+    PendingTask pending;
+    pending.task = task;
+    pending.device = deviceForPath(task->info()->url().path());
+    if (delayMSecs > 0) {
+        pending.notBefore = QDateTime::currentMSecsSinceEpoch() + delayMSecs;
+        // A coarse timer could fire before notBefore
+        QTimer::singleShot(delayMSecs, Qt::PreciseTimer, this, &ArchiveScheduler::startTasks);
+    }
+    if (task->isImmediate()) {
+        auto it = std::find_if(mPendingTasks.begin(), mPendingTasks.end(), [](const PendingTask &other) {
+            return !other.task->isImmediate();
+        });
+        mPendingTasks.insert(it, pending);
+    } else {
+        mPendingTasks.append(pending);
+    }
+    startTasks();
+}
+
+void ArchiveScheduler::clearPendingTasks()
+{
+    for (const PendingTask &pending : std::as_const(mPendingTasks)) {
+        delete pending.task;
+    }
+    mPendingTasks.clear();
+}
+
+void ArchiveScheduler::pause()
+{
+    mPaused = true;
+}
+
+void ArchiveScheduler::resume()
+{
+    mPaused = false;
+    startTasks();
+}
+
+void ArchiveScheduler::setMaximumConcurrentArchives(int maximum)
+{
+    mMaximumConcurrentArchives = qMax(1, maximum);
+    startTasks();
+}
+
+void ArchiveScheduler::setMaximumArchivesPerDevice(int maximum)
+{
+    mMaximumArchivesPerDevice = qMax(1, maximum);
+    startTasks();
+}
+
+void ArchiveScheduler::setMaximumBytesPerSecond(qint64 bytesPerSecond)
+{
+    mMaximumBytesPerSecond = bytesPerSecond;
+    for (ArchiveThrottle *throttle : std::as_const(mThrottles)) {
+        throttle->setMaximumBytesPerSecond(bytesPerSecond);
+    }
+}
+
+void ArchiveScheduler::setIdleIoPriority(bool idle)
+{
+    mIdleIoPriority = idle;
+    updateIoPriority();
+}
+
+ArchiveThrottle *ArchiveScheduler::throttleForPath(const QString &path)
+{
+    const QByteArray device = deviceForPath(path);
+    ArchiveThrottle *throttle = mThrottles.value(device);
+    if (!throttle) {
+        throttle = new ArchiveThrottle;
+        throttle->setMaximumBytesPerSecond(mMaximumBytesPerSecond);
+        mThrottles.insert(device, throttle);
+    }
+    return throttle;
+}
+
+void ArchiveScheduler::startTasks()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (int i = 0; i < mPendingTasks.count() && !mPaused && mRunningCount < mMaximumConcurrentArchives;) {
+        const PendingTask pending = mPendingTasks.at(i);
+        if (pending.notBefore > now) {
+            ++i;
+            continue;
+        }
+        // Immediate tasks were explicitly requested, don't make them wait for the device
+        if (!pending.task->isImmediate() && mRunningPerDevice.value(pending.device) >= mMaximumArchivesPerDevice) {
+            ++i;
+            continue;
+        }
+        mPendingTasks.remove(i);
+        MailCommon::ScheduledJob *job = pending.task->run();
+        delete pending.task;
+        if (!job) {
+            continue;
+        }
+        ++mRunningCount;
+        ++mRunningPerDevice[pending.device];
+        const QByteArray device = pending.device;
+        connect(job, &QObject::destroyed, this, [this, device]() {
+            slotJobDestroyed(device);
+        });
+        updateIoPriority();
+        job->start();
+    }
+}
+
+void ArchiveScheduler::slotJobDestroyed(const QByteArray &device)
+{
+    --mRunningCount;
+    if (--mRunningPerDevice[device] <= 0) {
+        mRunningPerDevice.remove(device);
+    }
+    updateIoPriority();
+    startTasks();
+}
+
+void ArchiveScheduler::updateIoPriority()
+{
+    const bool lower = mIdleIoPriority && mRunningCount > 0;
+    if (lower != mIoPriorityLowered) {
+        mIoPriorityLowered = lower;
+        setIoPriority(lower);
+    }
+}
@@ -0,0 +1,103 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QVector>
+
+class ScheduledArchiveTask;
+
+/**
+ * Limits the rate at which archives are written to one device.
+ *
+ * It is shared by all the archives written to the same device at the same
+ * time, so that together they don't exceed the configured rate.
+ */
+class ArchiveThrottle
+{
+public:
+    ArchiveThrottle() = default;
+
+    /// 0 means unlimited
+    void setMaximumBytesPerSecond(qint64 bytesPerSecond);
+    Q_REQUIRED_RESULT qint64 maximumBytesPerSecond() const;
+
+    /**
+     * Accounts for @p bytes just written and returns how many milliseconds the
+     * writer has to wait before writing more.
+     */
+    Q_REQUIRED_RESULT int reserve(qint64 bytes);
+
+private:
+    qint64 mMaximumBytesPerSecond = 0;
+    qint64 mNextFreeTime = 0; // msecs since epoch
+};
+
+/**
+ * Runs the scheduled archives.
+ *
+ * Several archives are written at the same time, but only a limited number per
+ * target device, so that archives going to different disks run in parallel
+ * while archives going to the same disk don't compete for it. While archives
+ * are written the agent uses the idle I/O scheduling class where supported.
+ */
+class ArchiveScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ArchiveScheduler(QObject *parent = nullptr);
+    ~ArchiveScheduler() override;
+
+    /**
+     * Queues @p task, the scheduler takes ownership of it. Immediate tasks are
+     * queued before the others. The task isn't started before @p delayMSecs.
+     */
+    void registerTask(ScheduledArchiveTask *task, int delayMSecs = 0);
+
+    /**
+     * Removes the tasks which were not started yet.
+     */
+    void clearPendingTasks();
+
+    void pause();
+    void resume();
+
+    void setMaximumConcurrentArchives(int maximum);
+    void setMaximumArchivesPerDevice(int maximum);
+    void setMaximumBytesPerSecond(qint64 bytesPerSecond);
+    void setIdleIoPriority(bool idle);
+
+    /**
+     * Returns the throttle shared by the archives written to the device of @p path.
+     */
+    Q_REQUIRED_RESULT ArchiveThrottle *throttleForPath(const QString &path);
+
+    Q_REQUIRED_RESULT static QByteArray deviceForPath(const QString &path);
+
+private:
+    struct PendingTask {
+        ScheduledArchiveTask *task = nullptr;
+        QByteArray device;
+        qint64 notBefore = 0; // msecs since epoch
+    };
+
+    void startTasks();
+    void slotJobDestroyed(const QByteArray &device);
+    void updateIoPriority();
+
+    QVector<PendingTask> mPendingTasks;
+    QHash<QByteArray, int> mRunningPerDevice;
+    QHash<QByteArray, ArchiveThrottle *> mThrottles;
+    qint64 mMaximumBytesPerSecond = 0;
+    int mRunningCount = 0;
+    int mMaximumConcurrentArchives = 2;
+    int mMaximumArchivesPerDevice = 1;
+    bool mPaused = false;
+    bool mIdleIoPriority = true;
+    bool mIoPriorityLowered = false;
+};
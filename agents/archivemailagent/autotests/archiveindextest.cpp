@@ -0,0 +1,141 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "archiveindextest.h"
+#include "../archiveindex.h"
+#include "../job/archivefilewriter.h"
+#include "config-archivemailagent.h"
+
+#include <QTemporaryDir>
+#include <QTest>
+
+namespace
+{
+ArchiveIndex::Entry createEntry(Akonadi::Item::Id id, const QString &messageId, const QString &from, const QString &subject)
+{
+    ArchiveIndex::Entry entry;
+    entry.itemId = id;
+    entry.messageId = messageId;
+    entry.from = from;
+    entry.subject = subject;
+    entry.date = QDateTime(QDate(2021, 5, 6), QTime(7, 8, 9), Qt::UTC);
+    entry.path = QStringLiteral("inbox/cur/%1").arg(id);
+    entry.offset = id * 1024;
+    entry.length = 100;
+    return entry;
+}
+
+// Writes the messages with the archive writer and indexes them the way the archive job does
+bool writeArchive(const QString &fileName, ArchiveMailInfo::ArchiveType type, const QVector<QByteArray> &messages, ArchiveIndex &index)
+{
+    ArchiveFileWriter writer(fileName, type);
+    if (!writer.open() || !writer.writeDir(QStringLiteral("inbox/new"), QDateTime::currentDateTime())) {
+        return false;
+    }
+    for (int i = 0; i < messages.count(); ++i) {
+        ArchiveIndex::Entry entry = createEntry(i + 1, QStringLiteral("%1@example.org").arg(i + 1), QString(), QString());
+        if (!writer.writeFile(entry.path, messages.at(i), QDateTime::currentDateTime(), entry.offset)) {
+            return false;
+        }
+        entry.length = messages.at(i).size();
+        index.addEntry(entry);
+    }
+    if (!writer.close()) {
+        return false;
+    }
+    index.setArchiveType(type);
+    index.setFrames(writer.frames());
+    return index.save(fileName);
+}
+}
+
+ArchiveIndexTest::ArchiveIndexTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void ArchiveIndexTest::shouldSaveAndLoad()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString archive = dir.path() + QStringLiteral("/archive.tar.zst");
+
+    ArchiveIndex index;
+    index.setArchiveType(ArchiveMailInfo::ArchiveTarZstd);
+    index.addEntry(createEntry(1, QStringLiteral("1@example.org"), QStringLiteral("Foo <foo@example.org>"), QStringLiteral("Hello")));
+    index.addEntry(createEntry(2, QStringLiteral("2@example.org"), QStringLiteral("Bar <bar@example.org>"), QStringLiteral("World")));
+    index.setFrames({{0, 0}, {4194304, 12345}});
+    QVERIFY(index.save(archive));
+
+    ArchiveIndex loaded;
+    QVERIFY(loaded.load(archive));
+    QCOMPARE(loaded.archiveType(), ArchiveMailInfo::ArchiveTarZstd);
+    QCOMPARE(loaded.entries().count(), 2);
+    QCOMPARE(loaded.entries().at(1).subject, QStringLiteral("World"));
+    QCOMPARE(loaded.entries().at(1).date, index.entries().at(1).date);
+    QCOMPARE(loaded.entries().at(1).offset, qint64(2048));
+    QCOMPARE(loaded.frames().count(), 2);
+    QCOMPARE(loaded.frames().at(1).compressedOffset, qint64(12345));
+}
+
+void ArchiveIndexTest::shouldSearch()
+{
+    ArchiveIndex index;
+    index.addEntry(createEntry(1, QStringLiteral("1@example.org"), QStringLiteral("Foo <foo@example.org>"), QStringLiteral("Hello")));
+    index.addEntry(createEntry(2, QStringLiteral("2@example.org"), QStringLiteral("Bar <bar@example.org>"), QStringLiteral("World")));
+
+    QCOMPARE(index.search(QStringLiteral("foo")).count(), 1);
+    QCOMPARE(index.search(QStringLiteral("WORLD")).constFirst().itemId, Akonadi::Item::Id(2));
+    QCOMPARE(index.search(QStringLiteral("example.org")).count(), 2);
+    QCOMPARE(index.search(QStringLiteral("<1@example.org>")).count(), 1);
+    QCOMPARE(index.findMessageId(QStringLiteral("<2@example.org>")).itemId, Akonadi::Item::Id(2));
+    QCOMPARE(index.findMessageId(QStringLiteral("3@example.org")).itemId, Akonadi::Item::Id(-1));
+}
+
+void ArchiveIndexTest::shouldExtractFromTar()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString archiveName = dir.path() + QStringLiteral("/archive.tar");
+    // The first message fills more than one tar record
+    const QVector<QByteArray> messages = {QByteArrayLiteral("Message-ID: <1@example.org>\n\n") + QByteArray(1000, 'a'),
+                                          QByteArrayLiteral("Message-ID: <2@example.org>\n\nsecond\n")};
+
+    ArchiveIndex written;
+    QVERIFY(writeArchive(archiveName, ArchiveMailInfo::ArchiveTar, messages, written));
+
+    ArchiveIndex index;
+    QVERIFY(index.load(archiveName));
+    QCOMPARE(index.extract(archiveName, index.findMessageId(QStringLiteral("1@example.org"))), messages.at(0));
+    QCOMPARE(index.extract(archiveName, index.findMessageId(QStringLiteral("2@example.org"))), messages.at(1));
+}
+
+void ArchiveIndexTest::shouldExtractFromZstd()
+{
+#if HAVE_ZSTD
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString archiveName = dir.path() + QStringLiteral("/archive.tar.zst");
+    // Larger than a compressed block, so that the last message is in another frame
+    const QVector<QByteArray> messages = {QByteArrayLiteral("Message-ID: <1@example.org>\n\nfirst\n"),
+                                          QByteArrayLiteral("Message-ID: <2@example.org>\n\n") + QByteArray(5 * 1024 * 1024, 'b'),
+                                          QByteArrayLiteral("Message-ID: <3@example.org>\n\nthird\n")};
+
+    ArchiveIndex written;
+    QVERIFY(writeArchive(archiveName, ArchiveMailInfo::ArchiveTarZstd, messages, written));
+
+    ArchiveIndex index;
+    QVERIFY(index.load(archiveName));
+    QVERIFY(index.frames().count() > 1);
+    for (int i = 0; i < messages.count(); ++i) {
+        QCOMPARE(index.extract(archiveName, index.findMessageId(QStringLiteral("%1@example.org").arg(i + 1))), messages.at(i));
+    }
+#else
+    QSKIP("Built without zstd support");
+#endif
+}
+
+QTEST_GUILESS_MAIN(ArchiveIndexTest)
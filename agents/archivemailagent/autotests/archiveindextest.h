@@ -0,0 +1,23 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+
+class ArchiveIndexTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ArchiveIndexTest(QObject *parent = nullptr);
+    ~ArchiveIndexTest() override = default;
+
+private Q_SLOTS:
+    void shouldSaveAndLoad();
+    void shouldSearch();
+    void shouldExtractFromTar();
+    void shouldExtractFromZstd();
+};
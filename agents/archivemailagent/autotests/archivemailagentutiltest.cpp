@@ -0,0 +1,141 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "archivemailagentutiltest.h"
+#include "../archivemailagentutil.h"
+#include "../archivemailinfo.h"
+#include <QFile>
+#include <QRandomGenerator>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+ArchiveMailAgentUtilTest::ArchiveMailAgentUtilTest(QObject *parent)
+    : QObject(parent)
+{
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void ArchiveMailAgentUtilTest::shouldNeedToArchive()
+{
+    ArchiveMailInfo info;
+    info.setUrl(QUrl::fromLocalFile(QStringLiteral("/tmp")));
+    info.setArchiveAge(1);
+    info.setArchiveUnit(ArchiveMailInfo::ArchiveWeeks);
+    const QDate today(2021, 6, 15);
+    // Never archived
+    QVERIFY(ArchiveMailAgentUtil::needToArchive(&info, ArchiveMailAgentUtil::CatchUpSkip, today));
+
+    info.setLastDateSaved(today.addDays(-3));
+    QVERIFY(!ArchiveMailAgentUtil::needToArchive(&info, ArchiveMailAgentUtil::CatchUpRunOnce, today));
+    info.setLastDateSaved(today.addDays(-7));
+    QVERIFY(ArchiveMailAgentUtil::needToArchive(&info, ArchiveMailAgentUtil::CatchUpSkip, today));
+
+    // Missed runs
+    info.setLastDateSaved(today.addDays(-10));
+    QVERIFY(ArchiveMailAgentUtil::needToArchive(&info, ArchiveMailAgentUtil::CatchUpRunOnce, today));
+    QVERIFY(ArchiveMailAgentUtil::needToArchive(&info, ArchiveMailAgentUtil::CatchUpStagger, today));
+    QVERIFY(!ArchiveMailAgentUtil::needToArchive(&info, ArchiveMailAgentUtil::CatchUpSkip, today));
+    // Today is a regular date again
+    info.setLastDateSaved(today.addDays(-21));
+    QVERIFY(ArchiveMailAgentUtil::needToArchive(&info, ArchiveMailAgentUtil::CatchUpSkip, today));
+
+    info.setEnabled(false);
+    QVERIFY(!ArchiveMailAgentUtil::needToArchive(&info, ArchiveMailAgentUtil::CatchUpRunOnce, today));
+}
+
+void ArchiveMailAgentUtilTest::shouldComputeStartDelays()
+{
+    QRandomGenerator generator(42);
+    QVERIFY(ArchiveMailAgentUtil::startDelays(0, ArchiveMailAgentUtil::CatchUpStagger, 1000, &generator).isEmpty());
+    QCOMPARE(ArchiveMailAgentUtil::startDelays(3, ArchiveMailAgentUtil::CatchUpStagger, 0, &generator), QVector<int>({0, 0, 0}));
+
+    const QVector<int> staggered = ArchiveMailAgentUtil::startDelays(4, ArchiveMailAgentUtil::CatchUpStagger, 4000, &generator);
+    QCOMPARE(staggered.count(), 4);
+    for (int i = 0; i < staggered.count(); ++i) {
+        QVERIFY(staggered.at(i) >= i * 1000);
+        QVERIFY(staggered.at(i) < (i + 1) * 1000);
+    }
+
+    const QVector<int> random = ArchiveMailAgentUtil::startDelays(10, ArchiveMailAgentUtil::CatchUpRunOnce, 4000, &generator);
+    QCOMPARE(random.count(), 10);
+    for (int delay : random) {
+        QVERIFY(delay >= 0);
+        QVERIFY(delay < 4000);
+    }
+}
+
+void ArchiveMailAgentUtilTest::shouldNeedFullArchive()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fullArchive = QStringLiteral("Archive_foo_2021-03-01.zip");
+    QFile file(dir.path() + QLatin1Char('/') + fullArchive);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.close();
+
+    ArchiveMailInfo info;
+    info.setUrl(QUrl::fromLocalFile(dir.path()));
+    QVERIFY(ArchiveMailAgentUtil::needFullArchive(&info));
+
+    info.setArchiveMode(ArchiveMailInfo::IncrementalArchive);
+    // No archive written yet
+    QVERIFY(ArchiveMailAgentUtil::needFullArchive(&info));
+
+    info.setLastArchivedItemId(42);
+    info.setLastArchiveDateTime(QDateTime::currentDateTimeUtc());
+    info.setLastFullArchive(fullArchive);
+    QVERIFY(!ArchiveMailAgentUtil::needFullArchive(&info));
+
+    // The chain is restarted to keep room for two chains
+    info.setMaximumArchiveCount(6);
+    info.setIncrementalArchiveCount(1);
+    QVERIFY(!ArchiveMailAgentUtil::needFullArchive(&info));
+    info.setIncrementalArchiveCount(2);
+    QVERIFY(ArchiveMailAgentUtil::needFullArchive(&info));
+
+    info.setIncrementalArchiveCount(0);
+    info.setMaximumArchiveCount(1);
+    QVERIFY(ArchiveMailAgentUtil::needFullArchive(&info));
+
+    info.setMaximumArchiveCount(0);
+    info.setLastFullArchive(QStringLiteral("Archive_foo_2021-02-01.zip"));
+    QVERIFY(ArchiveMailAgentUtil::needFullArchive(&info));
+}
+
+void ArchiveMailAgentUtilTest::shouldComputeArchivesToRemove_data()
+{
+    QTest::addColumn<QStringList>("archives");
+    QTest::addColumn<QStringList>("baseArchives");
+    QTest::addColumn<int>("maximum");
+    QTest::addColumn<QStringList>("result");
+
+    const QStringList fullArchives = {QStringLiteral("f1"), QStringLiteral("f2"), QStringLiteral("f3")};
+    QTest::newRow("unlimited") << fullArchives << fullArchives << 0 << QStringList();
+    QTest::newRow("full") << fullArchives << fullArchives << 2 << QStringList{QStringLiteral("f1")};
+    QTest::newRow("below") << fullArchives << fullArchives << 3 << QStringList();
+
+    const QStringList archives = {QStringLiteral("f1"), QStringLiteral("i1"), QStringLiteral("f2"), QStringLiteral("i2"), QStringLiteral("i3")};
+    const QStringList bases = {QStringLiteral("f1"), QStringLiteral("f1"), QStringLiteral("f2"), QStringLiteral("f2"), QStringLiteral("f2")};
+    QTest::newRow("chain") << archives << bases << 4 << QStringList{QStringLiteral("f1"), QStringLiteral("i1")};
+    QTest::newRow("keepnewestchain") << archives << bases << 1 << QStringList{QStringLiteral("f1"), QStringLiteral("i1")};
+
+    // Incremental archives whose full archive was removed are removed first
+    const QStringList orphans = {QStringLiteral("i0"), QStringLiteral("f1"), QStringLiteral("i1")};
+    const QStringList orphanBases = {QStringLiteral("f0"), QStringLiteral("f1"), QStringLiteral("f1")};
+    QTest::newRow("orphan") << orphans << orphanBases << 2 << QStringList{QStringLiteral("i0")};
+}
+
+void ArchiveMailAgentUtilTest::shouldComputeArchivesToRemove()
+{
+    QFETCH(QStringList, archives);
+    QFETCH(QStringList, baseArchives);
+    QFETCH(int, maximum);
+    QFETCH(QStringList, result);
+    QCOMPARE(ArchiveMailAgentUtil::archivesToRemove(archives, baseArchives, maximum), result);
+}
+
+QTEST_MAIN(ArchiveMailAgentUtilTest)
@@ -0,0 +1,24 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+
+class ArchiveMailAgentUtilTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ArchiveMailAgentUtilTest(QObject *parent = nullptr);
+    ~ArchiveMailAgentUtilTest() override = default;
+
+private Q_SLOTS:
+    void shouldNeedToArchive();
+    void shouldComputeStartDelays();
+    void shouldNeedFullArchive();
+    void shouldComputeArchivesToRemove_data();
+    void shouldComputeArchivesToRemove();
+};
@@ -26,12 +26,17 @@ void ArchiveMailInfoTest::shouldHaveDefaultValue()
     QCOMPARE(info.saveCollectionId(), Akonadi::Collection::Id(-1));
     QCOMPARE(info.saveSubCollection(), false);
     QCOMPARE(info.url(), QUrl());
-    QCOMPARE(info.archiveType(), MailCommon::BackupJob::Zip);
+    QCOMPARE(info.archiveType(), ArchiveMailInfo::ArchiveZip);
     QCOMPARE(info.archiveUnit(), ArchiveMailInfo::ArchiveDays);
     QCOMPARE(info.archiveAge(), 1);
     QCOMPARE(info.lastDateSaved(), QDate());
     QCOMPARE(info.maximumArchiveCount(), 0);
     QCOMPARE(info.isEnabled(), true);
+    QCOMPARE(info.archiveMode(), ArchiveMailInfo::FullArchive);
+    QCOMPARE(info.lastArchivedItemId(), Akonadi::Item::Id(-1));
+    QCOMPARE(info.lastArchiveDateTime(), QDateTime());
+    QCOMPARE(info.lastFullArchive(), QString());
+    QCOMPARE(info.incrementalArchiveCount(), 0);
 }
 
 void ArchiveMailInfoTest::shouldRestoreFromSettings()
@@ -39,12 +44,17 @@ void ArchiveMailInfoTest::shouldRestoreFromSettings()
     ArchiveMailInfo info;
     info.setSaveCollectionId(Akonadi::Collection::Id(42));
     info.setUrl(QUrl::fromLocalFile(QStringLiteral("/foo/foo")));
-    info.setArchiveType(MailCommon::BackupJob::TarBz2);
+    info.setArchiveType(ArchiveMailInfo::ArchiveTarBz2);
     info.setArchiveUnit(ArchiveMailInfo::ArchiveMonths);
     info.setArchiveAge(5);
     info.setLastDateSaved(QDate::currentDate());
     info.setMaximumArchiveCount(5);
     info.setEnabled(false);
+    info.setArchiveMode(ArchiveMailInfo::IncrementalArchive);
+    info.setLastArchivedItemId(Akonadi::Item::Id(1234));
+    info.setLastArchiveDateTime(QDateTime(QDate(2021, 3, 4), QTime(5, 6, 7, 89), Qt::UTC));
+    info.setLastFullArchive(QStringLiteral("Archive_foo_2021-03-01.tar.bz2"));
+    info.setIncrementalArchiveCount(3);
 
     KConfigGroup grp(KSharedConfig::openConfig(), "testsettings");
     info.writeConfig(grp);
@@ -58,12 +68,17 @@ void ArchiveMailInfoTest::shouldCopyArchiveInfo()
     ArchiveMailInfo info;
     info.setSaveCollectionId(Akonadi::Collection::Id(42));
     info.setUrl(QUrl::fromLocalFile(QStringLiteral("/foo/foo")));
-    info.setArchiveType(MailCommon::BackupJob::TarBz2);
+    info.setArchiveType(ArchiveMailInfo::ArchiveTarBz2);
     info.setArchiveUnit(ArchiveMailInfo::ArchiveMonths);
     info.setArchiveAge(5);
     info.setLastDateSaved(QDate::currentDate());
     info.setMaximumArchiveCount(5);
     info.setEnabled(false);
+    info.setArchiveMode(ArchiveMailInfo::IncrementalArchive);
+    info.setLastArchivedItemId(Akonadi::Item::Id(1234));
+    info.setLastArchiveDateTime(QDateTime(QDate(2021, 3, 4), QTime(5, 6, 7, 89), Qt::UTC));
+    info.setLastFullArchive(QStringLiteral("Archive_foo_2021-03-01.tar.bz2"));
+    info.setIncrementalArchiveCount(3);
 
     ArchiveMailInfo copyInfo(info);
     QCOMPARE(info, copyInfo);
@@ -6,6 +6,7 @@
 
 #include "formatcomboboxtest.h"
 #include "../widgets/formatcombobox.h"
+#include "config-archivemailagent.h"
 #include <QTest>
 
 FormatComboBoxTest::FormatComboBoxTest(QObject *parent)
@@ -18,7 +19,11 @@ FormatComboBoxTest::~FormatComboBoxTest() = default;
 void FormatComboBoxTest::shouldHaveDefaultValue()
 {
     FormatComboBox combo;
+#if HAVE_ZSTD
+    QCOMPARE(combo.count(), 5);
+#else
     QCOMPARE(combo.count(), 4);
+#endif
 }
 
 void FormatComboBoxTest::changeCurrentItem_data()
@@ -29,6 +34,9 @@ void FormatComboBoxTest::changeCurrentItem_data()
     QTest::newRow("second") << 1 << 1;
     QTest::newRow("third") << 2 << 2;
     QTest::newRow("fourth") << 3 << 3;
+#if HAVE_ZSTD
+    QTest::newRow("fifth") << 4 << 4;
+#endif
     QTest::newRow("invalid") << 5 << 0;
 }
 
@@ -37,8 +45,8 @@ void FormatComboBoxTest::changeCurrentItem()
     QFETCH(int, input);
     QFETCH(int, output);
     FormatComboBox combo;
-    combo.setFormat(static_cast<MailCommon::BackupJob::ArchiveType>(input));
-    QCOMPARE(combo.format(), static_cast<MailCommon::BackupJob::ArchiveType>(output));
+    combo.setFormat(static_cast<ArchiveMailInfo::ArchiveType>(input));
+    QCOMPARE(combo.format(), static_cast<ArchiveMailInfo::ArchiveType>(output));
 }
 
 QTEST_MAIN(FormatComboBoxTest)
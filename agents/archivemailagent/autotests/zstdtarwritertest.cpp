@@ -0,0 +1,72 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "zstdtarwritertest.h"
+#include "../job/zstdtarwriter.h"
+
+#include <KArchiveDirectory>
+#include <KArchiveFile>
+#include <KTar>
+
+#include <QBuffer>
+#include <QDateTime>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <zstd.h>
+
+ZstdTarWriterTest::ZstdTarWriterTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void ZstdTarWriterTest::shouldWriteReadableArchive()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.path() + QStringLiteral("/archive.tar.zst");
+    const QString longName = QStringLiteral(".inbox.directory/") + QString(120, QLatin1Char('a')) + QStringLiteral("/cur/2");
+    // Larger than a compressed block
+    const QByteArray bigMessage(5 * 1024 * 1024, 'x');
+
+    ZstdTarWriter writer(fileName);
+    QVERIFY(writer.open());
+    QVERIFY(writer.writeDir(QStringLiteral("inbox/new"), QDateTime::currentDateTime()));
+    QVERIFY(writer.writeFile(QStringLiteral("inbox/cur/1"), QByteArrayLiteral("Subject: foo\n\nbar\n"), QDateTime::currentDateTime()));
+    QVERIFY(writer.writeFile(longName, bigMessage, QDateTime::currentDateTime()));
+    QVERIFY(writer.close());
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QByteArray compressed = file.readAll();
+
+    QByteArray tar;
+    ZSTD_DStream *stream = ZSTD_createDStream();
+    ZSTD_inBuffer input{compressed.constData(), static_cast<size_t>(compressed.size()), 0};
+    QByteArray buffer(static_cast<int>(ZSTD_DStreamOutSize()), Qt::Uninitialized);
+    while (input.pos < input.size) {
+        ZSTD_outBuffer output{buffer.data(), static_cast<size_t>(buffer.size()), 0};
+        const size_t result = ZSTD_decompressStream(stream, &output, &input);
+        QVERIFY(!ZSTD_isError(result));
+        tar.append(buffer.constData(), static_cast<int>(output.pos));
+    }
+    ZSTD_freeDStream(stream);
+
+    QBuffer tarDevice(&tar);
+    KTar archive(&tarDevice);
+    QVERIFY(archive.open(QIODevice::ReadOnly));
+    const auto first = dynamic_cast<const KArchiveFile *>(archive.directory()->entry(QStringLiteral("inbox/cur/1")));
+    QVERIFY(first);
+    QCOMPARE(first->data(), QByteArrayLiteral("Subject: foo\n\nbar\n"));
+    const auto second = dynamic_cast<const KArchiveFile *>(archive.directory()->entry(longName));
+    QVERIFY(second);
+    QCOMPARE(second->data(), bigMessage);
+    const KArchiveEntry *emptyDir = archive.directory()->entry(QStringLiteral("inbox/new"));
+    QVERIFY(emptyDir);
+    QVERIFY(emptyDir->isDirectory());
+}
+
+QTEST_GUILESS_MAIN(ZstdTarWriterTest)
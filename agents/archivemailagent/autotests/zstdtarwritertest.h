@@ -0,0 +1,20 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+
+class ZstdTarWriterTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ZstdTarWriterTest(QObject *parent = nullptr);
+    ~ZstdTarWriterTest() override = default;
+
+private Q_SLOTS:
+    void shouldWriteReadableArchive();
+};
@@ -0,0 +1,163 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "archivefilewriter.h"
+#include "config-archivemailagent.h"
+#if HAVE_ZSTD
+#include "zstdtarwriter.h"
+#endif
+
+#include <KLocalizedString>
+#include <KTar>
+#include <KZip>
+
+#include <QFile>
+
+namespace
+{
+constexpr int TarRecordSize = 512;
+}
+
+ArchiveFileWriter::ArchiveFileWriter(const QString &fileName, ArchiveMailInfo::ArchiveType type, QObject *parent)
+    : QObject(parent)
+    , mFileName(fileName)
+    , mType(type)
+{
+}
+
+ArchiveFileWriter::~ArchiveFileWriter()
+{
+    delete mArchive;
+}
+
+bool ArchiveFileWriter::open()
+{
+    switch (mType) {
+    case ArchiveMailInfo::ArchiveZip: {
+        auto zip = new KZip(mFileName);
+        zip->setCompression(KZip::DeflateCompression);
+        mArchive = zip;
+        break;
+    }
+    case ArchiveMailInfo::ArchiveTar:
+        mArchive = new KTar(mFileName, QStringLiteral("application/x-tar"));
+        break;
+    case ArchiveMailInfo::ArchiveTarBz2:
+        mArchive = new KTar(mFileName, QStringLiteral("application/x-bzip"));
+        break;
+    case ArchiveMailInfo::ArchiveTarGz:
+        mArchive = new KTar(mFileName, QStringLiteral("application/x-gzip"));
+        break;
+    case ArchiveMailInfo::ArchiveTarZstd:
+#if HAVE_ZSTD
+        mZstdWriter = new ZstdTarWriter(mFileName, this);
+        connect(mZstdWriter, &ZstdTarWriter::blockWritten, this, &ArchiveFileWriter::blockWritten);
+        if (!mZstdWriter->open()) {
+            mErrorString = mZstdWriter->errorString();
+            return false;
+        }
+        return true;
+#else
+        mErrorString = i18n("Zstandard compressed archives are not supported by this installation.");
+        return false;
+#endif
+    }
+    if (!mArchive || !mArchive->open(QIODevice::WriteOnly)) {
+        mErrorString = mArchive ? mArchive->errorString() : QString();
+        return false;
+    }
+    return true;
+}
+
+bool ArchiveFileWriter::writeDir(const QString &name, const QDateTime &modificationTime)
+{
+#if HAVE_ZSTD
+    if (mZstdWriter) {
+        return mZstdWriter->writeDir(name, modificationTime);
+    }
+#endif
+    return mArchive->writeDir(name, QString(), QString(), 040755, modificationTime, modificationTime, modificationTime);
+}
+
+bool ArchiveFileWriter::writeFile(const QString &name, const QByteArray &data, const QDateTime &modificationTime, qint64 &offset)
+{
+    offset = -1;
+#if HAVE_ZSTD
+    if (mZstdWriter) {
+        if (!mZstdWriter->writeFile(name, data, modificationTime)) {
+            return false;
+        }
+        offset = mZstdWriter->lastFileOffset();
+        return true;
+    }
+#endif
+    if (!mArchive->writeFile(name, data, 0100644, QString(), QString(), modificationTime, modificationTime, modificationTime)) {
+        return false;
+    }
+    if (mType != ArchiveMailInfo::ArchiveZip) {
+        // KTar pads the data to the next record, the device position is the one in the uncompressed stream
+        offset = mArchive->device()->pos() - ((data.size() + TarRecordSize - 1) / TarRecordSize) * TarRecordSize;
+    }
+    return true;
+}
+
+bool ArchiveFileWriter::close()
+{
+#if HAVE_ZSTD
+    if (mZstdWriter) {
+        if (!mZstdWriter->close()) {
+            mErrorString = mZstdWriter->errorString();
+            return false;
+        }
+        return true;
+    }
+#endif
+    if (mArchive && !mArchive->close()) {
+        mErrorString = mArchive->errorString();
+        return false;
+    }
+    return true;
+}
+
+void ArchiveFileWriter::abort()
+{
+#if HAVE_ZSTD
+    if (mZstdWriter) {
+        mZstdWriter->abort();
+        return;
+    }
+#endif
+    if (mArchive) {
+        if (mArchive->isOpen()) {
+            mArchive->close();
+        }
+        QFile::remove(mFileName);
+    }
+}
+
+bool ArchiveFileWriter::isFull() const
+{
+#if HAVE_ZSTD
+    return mZstdWriter && mZstdWriter->isFull();
+#else
+    return false;
+#endif
+}
+
+QString ArchiveFileWriter::errorString() const
+{
+    return mErrorString;
+}
+
+QVector<ArchiveIndex::Frame> ArchiveFileWriter::frames() const
+{
+#if HAVE_ZSTD
+    if (mZstdWriter) {
+        return mZstdWriter->frames();
+    }
+#endif
+    return {};
+}
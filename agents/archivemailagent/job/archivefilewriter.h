@@ -0,0 +1,70 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "archiveindex.h"
+#include "archivemailinfo.h"
+
+#include <QObject>
+
+class KArchive;
+class ZstdTarWriter;
+
+/**
+ * Writes the entries of an archive file of any of the supported types.
+ *
+ * It hides the difference between the KArchive based formats and the zstd
+ * compressed tar files, and returns where the data of each written file is in
+ * the uncompressed tar stream, which is what the archive index stores.
+ */
+class ArchiveFileWriter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ArchiveFileWriter(const QString &fileName, ArchiveMailInfo::ArchiveType type, QObject *parent = nullptr);
+    ~ArchiveFileWriter() override;
+
+    Q_REQUIRED_RESULT bool open();
+
+    Q_REQUIRED_RESULT bool writeDir(const QString &name, const QDateTime &modificationTime);
+
+    /**
+     * Appends a file. @p offset is set to the position of its data in the
+     * uncompressed tar stream, or -1 for zip archives.
+     */
+    Q_REQUIRED_RESULT bool writeFile(const QString &name, const QByteArray &data, const QDateTime &modificationTime, qint64 &offset);
+
+    Q_REQUIRED_RESULT bool close();
+
+    /**
+     * Discards the archive.
+     */
+    void abort();
+
+    /**
+     * Returns true while the data written so far still has to be compressed,
+     * blockWritten() is emitted when it makes progress.
+     */
+    Q_REQUIRED_RESULT bool isFull() const;
+
+    Q_REQUIRED_RESULT QString errorString() const;
+
+    /**
+     * The zstd frames of the archive, for the index.
+     */
+    Q_REQUIRED_RESULT QVector<ArchiveIndex::Frame> frames() const;
+
+Q_SIGNALS:
+    void blockWritten();
+
+private:
+    const QString mFileName;
+    const ArchiveMailInfo::ArchiveType mType;
+    KArchive *mArchive = nullptr;
+    ZstdTarWriter *mZstdWriter = nullptr;
+    QString mErrorString;
+};
@@ -6,11 +6,13 @@
 
 #include "archivejob.h"
 #include "archivemailagent_debug.h"
+#include "archivemailagentutil.h"
 #include "archivemailinfo.h"
 #include "archivemailkernel.h"
 #include "archivemailmanager.h"
+#include "archivescheduler.h"
+#include "archivewriterjob.h"
 
-#include <MailCommon/BackupJob>
 #include <MailCommon/MailUtil>
 
 #include <AkonadiCore/EntityMimeTypeFilterModel>
@@ -49,8 +51,9 @@ void ArchiveJob::execute()
             return;
         }
 
+        const bool fullArchive = ArchiveMailAgentUtil::needFullArchive(mInfo);
         bool dirExit = true;
-        const QUrl archivePath = mInfo->realUrl(realPath, dirExit);
+        const QUrl archivePath = mInfo->realUrl(realPath, dirExit, !fullArchive);
         if (!dirExit) {
             mManager->backupDone(mInfo);
             KNotification::event(QStringLiteral("archivemailfolderdoesntexist"),
@@ -64,15 +67,7 @@ void ArchiveJob::execute()
             return;
         }
 
-        auto backupJob = new MailCommon::BackupJob();
-        backupJob->setRootFolder(Akonadi::EntityTreeModel::updatedCollection(mManager->kernel()->collectionModel(), collection));
-
-        backupJob->setSaveLocation(archivePath);
-        backupJob->setArchiveType(mInfo->archiveType());
-        backupJob->setDeleteFoldersAfterCompletion(false);
-        backupJob->setRecursive(mInfo->saveSubCollection());
-        backupJob->setDisplayMessageBox(false);
-        backupJob->setRealPath(realPath);
+        const Akonadi::Collection rootFolder = Akonadi::EntityTreeModel::updatedCollection(mManager->kernel()->collectionModel(), collection);
         const QString summary = i18n("Start to archive %1", realPath);
         KNotification::event(QStringLiteral("archivemailstarted"),
                              QString(),
@@ -81,10 +76,41 @@ void ArchiveJob::execute()
                              nullptr,
                              KNotification::CloseOnTimeout,
                              QStringLiteral("akonadi_archivemail_agent"));
-        connect(backupJob, &MailCommon::BackupJob::backupDone, this, &ArchiveJob::slotBackupDone);
-        connect(backupJob, &MailCommon::BackupJob::error, this, &ArchiveJob::slotError);
-        backupJob->start();
+        startArchiveWriter(rootFolder, realPath, archivePath, fullArchive);
+    }
+}
+
+void ArchiveJob::startArchiveWriter(const Akonadi::Collection &rootFolder, const QString &realPath, const QUrl &archivePath, bool fullArchive)
+{
+    auto writerJob = new ArchiveWriterJob(this);
+    writerJob->setRootFolder(rootFolder);
+    writerJob->setSaveLocation(archivePath);
+    writerJob->setArchiveType(mInfo->archiveType());
+    writerJob->setRecursive(mInfo->saveSubCollection());
+    writerJob->setRealPath(realPath);
+    writerJob->setThrottle(mManager->scheduler()->throttleForPath(archivePath.toLocalFile()));
+    if (!fullArchive) {
+        bool dirExist = true;
+        const QStringList archives = mInfo->listOfArchive(realPath, dirExist);
+        writerJob->setIncremental(mInfo->lastArchivedItemId(),
+                                  mInfo->lastArchiveDateTime(),
+                                  mInfo->lastFullArchive(),
+                                  archives.isEmpty() ? mInfo->lastFullArchive() : archives.constLast());
     }
+    connect(writerJob, &ArchiveWriterJob::archiveDone, this, [this, writerJob, archivePath](const QString &info) {
+        const ArchiveManifest manifest = writerJob->manifest();
+        mInfo->setLastArchivedItemId(manifest.highWaterItemId);
+        mInfo->setLastArchiveDateTime(manifest.highWaterDateTime);
+        if (manifest.type == ArchiveManifest::Full) {
+            mInfo->setLastFullArchive(archivePath.fileName());
+            mInfo->setIncrementalArchiveCount(0);
+        } else {
+            mInfo->setIncrementalArchiveCount(mInfo->incrementalArchiveCount() + 1);
+        }
+        slotBackupDone(info);
+    });
+    connect(writerJob, &ArchiveWriterJob::error, this, &ArchiveJob::slotError);
+    writerJob->start();
 }
 
 void ArchiveJob::slotError(const QString &error)
@@ -8,6 +8,7 @@
 
 #include <Collection>
 #include <MailCommon/JobScheduler>
+#include <QUrl>
 class ArchiveMailInfo;
 class ArchiveMailManager;
 
@@ -22,6 +23,7 @@ public:
     void kill() override;
 
 private:
+    void startArchiveWriter(const Akonadi::Collection &rootFolder, const QString &realPath, const QUrl &archivePath, bool fullArchive);
     void slotBackupDone(const QString &info);
     void slotError(const QString &error);
     QString mDefaultIconName;
@@ -44,6 +46,11 @@ public:
 
     ~ScheduledArchiveTask() override = default;
 
+    ArchiveMailInfo *info() const
+    {
+        return mInfo;
+    }
+
     MailCommon::ScheduledJob *run() override;
 
     int taskTypeId() const override
@@ -0,0 +1,403 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "archivewriterjob.h"
+#include "archivefilewriter.h"
+#include "archivemailagent_debug.h"
+#include "archivescheduler.h"
+
+#include <AkonadiCore/CollectionFetchJob>
+#include <AkonadiCore/ItemFetchJob>
+#include <AkonadiCore/ItemFetchScope>
+#include <KLocalizedString>
+#include <KMime/Message>
+#include <Libkdepim/ProgressManager>
+
+#include <QFileInfo>
+#include <QTimer>
+
+#include <algorithm>
+
+namespace
+{
+constexpr int ChunkSize = 100;
+}
+
+ArchiveWriterJob::ArchiveWriterJob(QObject *parent)
+    : QObject(parent)
+{
+}
+
+ArchiveWriterJob::~ArchiveWriterJob()
+{
+    if (mProgressItem) {
+        mProgressItem->setComplete();
+    }
+}
+
+void ArchiveWriterJob::setRootFolder(const Akonadi::Collection &rootFolder)
+{
+    mRootFolder = rootFolder;
+}
+
+void ArchiveWriterJob::setRecursive(bool recursive)
+{
+    mRecursive = recursive;
+}
+
+void ArchiveWriterJob::setSaveLocation(const QUrl &savePath)
+{
+    mSaveLocation = savePath;
+}
+
+void ArchiveWriterJob::setArchiveType(ArchiveMailInfo::ArchiveType type)
+{
+    mArchiveType = type;
+}
+
+void ArchiveWriterJob::setRealPath(const QString &path)
+{
+    mRealPath = path;
+}
+
+void ArchiveWriterJob::setThrottle(ArchiveThrottle *throttle)
+{
+    mThrottle = throttle;
+}
+
+void ArchiveWriterJob::setIncremental(Akonadi::Item::Id itemId, const QDateTime &dateTime, const QString &baseArchive, const QString &previousArchive)
+{
+    mManifest.type = ArchiveManifest::Incremental;
+    mSinceItemId = itemId;
+    mSinceDateTime = dateTime;
+    mManifest.baseArchive = baseArchive;
+    mManifest.previousArchive = previousArchive;
+}
+
+ArchiveManifest ArchiveWriterJob::manifest() const
+{
+    return mManifest;
+}
+
+void ArchiveWriterJob::start()
+{
+    const QString fileName = mSaveLocation.toLocalFile();
+    mArchiveTime = QDateTime::currentDateTime();
+    mProgressItem = KPIM::ProgressManager::createProgressItem(KPIM::ProgressManager::getUniqueID(), i18n("Archiving"), QString(), true);
+    mProgressItem->setUsesBusyIndicator(true);
+    connect(mProgressItem.data(), &KPIM::ProgressItem::progressItemCanceled, this, &ArchiveWriterJob::kill);
+    mWriter = new ArchiveFileWriter(fileName, mArchiveType, this);
+    connect(mWriter, &ArchiveFileWriter::blockWritten, this, &ArchiveWriterJob::slotBlockWritten);
+    if (!mWriter->open()) {
+        const QString errorString = mWriter->errorString();
+        // Nothing to remove, the file was not created
+        delete mWriter;
+        mWriter = nullptr;
+        abort(errorString.isEmpty() ? i18n("Unable to open archive for writing.") : i18n("Unable to open archive for writing: %1", errorString));
+        return;
+    }
+
+    mManifest.collectionId = mRootFolder.id();
+    mManifest.created = QDateTime::currentDateTimeUtc();
+    if (mManifest.type == ArchiveManifest::Full) {
+        mManifest.baseArchive = QFileInfo(fileName).fileName();
+    }
+    // Items modified while we list them will be part of the next archive
+    mManifest.highWaterDateTime = mManifest.created;
+    mManifest.highWaterItemId = mSinceItemId;
+
+    mCollections.insert(mRootFolder.id(), mRootFolder);
+    mCollectionsToList.append(mRootFolder);
+    if (mRecursive) {
+        auto job = new Akonadi::CollectionFetchJob(mRootFolder, Akonadi::CollectionFetchJob::Recursive, this);
+        connect(job, &Akonadi::CollectionFetchJob::result, this, &ArchiveWriterJob::slotCollectionsFetched);
+        mCurrentJob = job;
+    } else {
+        listNextCollection();
+    }
+}
+
+void ArchiveWriterJob::slotCollectionsFetched(KJob *job)
+{
+    mCurrentJob = nullptr;
+    if (job->error()) {
+        abort(job->errorString());
+        return;
+    }
+    const Akonadi::Collection::List collections = qobject_cast<Akonadi::CollectionFetchJob *>(job)->collections();
+    for (const Akonadi::Collection &collection : collections) {
+        mCollections.insert(collection.id(), collection);
+        mCollectionsToList.append(collection);
+    }
+    listNextCollection();
+}
+
+void ArchiveWriterJob::listNextCollection()
+{
+    if (mCollectionsToList.isEmpty()) {
+        std::sort(mPendingItems.begin(), mPendingItems.end(), [](const Akonadi::Item &lhs, const Akonadi::Item &rhs) {
+            return lhs.id() < rhs.id();
+        });
+        mTotalItemCount = mPendingItems.count();
+        if (mProgressItem) {
+            mProgressItem->setUsesBusyIndicator(false);
+        }
+        updateProgress();
+        fetchNextChunk();
+        return;
+    }
+    const Akonadi::Collection collection = mCollectionsToList.takeFirst();
+    if (mProgressItem) {
+        mProgressItem->setStatus(i18n("Archiving folder %1", collection.name()));
+    }
+    // Written for every folder, so that the empty ones are part of the archive too
+    if (!writeDirectories(collection)) {
+        abort(i18n("Unable to create folder structure for folder '%1' within archive file.", collection.name()));
+        return;
+    }
+    // only list the items, the payload of the ones to archive is fetched chunk by chunk
+    auto job = new Akonadi::ItemFetchJob(collection, this);
+    job->fetchScope().setFetchModificationTime(true);
+    job->fetchScope().setFetchRemoteIdentification(false);
+    job->setProperty("collectionId", collection.id());
+    connect(job, &Akonadi::ItemFetchJob::result, this, &ArchiveWriterJob::slotItemsListed);
+    mCurrentJob = job;
+}
+
+void ArchiveWriterJob::slotItemsListed(KJob *job)
+{
+    mCurrentJob = nullptr;
+    if (job->error()) {
+        abort(job->errorString());
+        return;
+    }
+    const Akonadi::Collection collection = mCollections.value(job->property("collectionId").toLongLong());
+    const bool incremental = (mManifest.type == ArchiveManifest::Incremental);
+    const Akonadi::Item::List items = qobject_cast<Akonadi::ItemFetchJob *>(job)->items();
+    for (Akonadi::Item item : items) {
+        mManifest.presentItems.append(item.id());
+        if (!incremental || item.id() > mSinceItemId || !mSinceDateTime.isValid() || item.modificationTime() > mSinceDateTime) {
+            item.setParentCollection(collection);
+            mPendingItems.append(item);
+        }
+    }
+    listNextCollection();
+}
+
+void ArchiveWriterJob::fetchNextChunk()
+{
+    if (mPendingItems.isEmpty()) {
+        finish();
+        return;
+    }
+    int chunkSize = qMin(ChunkSize, mPendingItems.count());
+    if (mChunkSizeLimit > 0) {
+        chunkSize = qMin(chunkSize, mChunkSizeLimit);
+    }
+    auto job = new Akonadi::ItemFetchJob(mPendingItems.mid(0, chunkSize), this);
+    job->fetchScope().fetchFullPayload(true);
+    job->setProperty("chunkSize", chunkSize);
+    connect(job, &Akonadi::ItemFetchJob::result, this, &ArchiveWriterJob::slotChunkFetched);
+    mCurrentJob = job;
+}
+
+void ArchiveWriterJob::slotChunkFetched(KJob *job)
+{
+    mCurrentJob = nullptr;
+    const int chunkSize = job->property("chunkSize").toInt();
+    qint64 writtenBytes = 0;
+    if (job->error()) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Unable to fetch" << chunkSize << "items for archiving" << job->errorString();
+        // Most likely an item was removed in the meantime, which makes the whole chunk fail.
+        // Retry in smaller chunks so that only that item is missing from the archive.
+        if (chunkSize > 1) {
+            mChunkSizeLimit = chunkSize / 2;
+            mFailedChunkEnd = qMax(mFailedChunkEnd, mPendingItems.at(chunkSize - 1).id());
+            fetchNextChunk();
+            return;
+        }
+        const Akonadi::Item &skippedItem = mPendingItems.constFirst();
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Skipping item" << skippedItem.id();
+        if (mFirstSkippedItemId < 0 || skippedItem.id() < mFirstSkippedItemId) {
+            mFirstSkippedItemId = skippedItem.id();
+        }
+        if (skippedItem.modificationTime().isValid()
+            && (!mFirstSkippedModificationTime.isValid() || skippedItem.modificationTime() < mFirstSkippedModificationTime)) {
+            mFirstSkippedModificationTime = skippedItem.modificationTime();
+        }
+    } else {
+        const Akonadi::Item::List items = qobject_cast<Akonadi::ItemFetchJob *>(job)->items();
+        for (int i = 0; i < chunkSize; ++i) {
+            const Akonadi::Item &pendingItem = mPendingItems.at(i);
+            auto it = std::find_if(items.cbegin(), items.cend(), [&pendingItem](const Akonadi::Item &item) {
+                return item.id() == pendingItem.id();
+            });
+            if (it == items.cend() || !it->hasPayload<KMime::Message::Ptr>()) {
+                continue;
+            }
+            const QString fileName = pathForCollection(pendingItem.parentCollection()) + QLatin1String("/cur/") + QString::number(pendingItem.id());
+            const QDateTime modificationTime = it->modificationTime();
+            const auto message = it->payload<KMime::Message::Ptr>();
+            const QByteArray data = message->encodedContent();
+            qint64 offset = -1;
+            if (!mWriter->writeFile(fileName, data, modificationTime, offset)) {
+                abort(i18n("Failed to write a message into the archive folder '%1'.", pendingItem.parentCollection().name()));
+                return;
+            }
+            mManifest.archivedItems.append(pendingItem.id());
+            addIndexEntry(pendingItem.id(), message, fileName, offset, data.size());
+            writtenBytes += data.size();
+        }
+    }
+    const Akonadi::Item::Id lastItemId = mPendingItems.at(chunkSize - 1).id();
+    mPendingItems.remove(0, chunkSize);
+    mProcessedItemCount += chunkSize;
+    if (lastItemId >= mFailedChunkEnd) {
+        mChunkSizeLimit = 0;
+        mFailedChunkEnd = -1;
+    }
+    updateProgress();
+    const int delay = mThrottle ? mThrottle->reserve(writtenBytes) : 0;
+    if (mWriter->isFull()) {
+        // Continue when the compression caught up, the throttle still accounts for these bytes
+        mWaitingForWriter = true;
+        return;
+    }
+    if (delay > 0) {
+        QTimer::singleShot(delay, this, &ArchiveWriterJob::fetchNextChunk);
+    } else {
+        fetchNextChunk();
+    }
+}
+
+void ArchiveWriterJob::slotBlockWritten()
+{
+    if (mWaitingForWriter && !mWriter->isFull()) {
+        mWaitingForWriter = false;
+        fetchNextChunk();
+    }
+}
+
+bool ArchiveWriterJob::writeDirectories(const Akonadi::Collection &collection)
+{
+    const QString path = pathForCollection(collection);
+    for (const QLatin1String subDirectory : {QLatin1String("/cur"), QLatin1String("/new"), QLatin1String("/tmp")}) {
+        if (!mWriter->writeDir(path + subDirectory, mArchiveTime)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ArchiveWriterJob::addIndexEntry(Akonadi::Item::Id itemId, const KMime::Message::Ptr &message, const QString &fileName, qint64 offset, qint64 length)
+{
+    ArchiveIndex::Entry entry;
+    entry.itemId = itemId;
+    if (auto messageId = message->messageID(false)) {
+        entry.messageId = QString::fromLatin1(messageId->identifier());
+    }
+    if (auto date = message->date(false)) {
+        entry.date = date->dateTime();
+    }
+    if (auto from = message->from(false)) {
+        entry.from = from->asUnicodeString();
+    }
+    if (auto subject = message->subject(false)) {
+        entry.subject = subject->asUnicodeString();
+    }
+    entry.path = fileName;
+    entry.offset = offset;
+    entry.length = length;
+    mIndex.addEntry(entry);
+}
+
+void ArchiveWriterJob::finish()
+{
+    if (!mWriter->close()) {
+        const QString errorString = mWriter->errorString();
+        abort(errorString.isEmpty() ? i18n("Unable to finalize the archive file.") : i18n("Unable to finalize the archive file: %1", errorString));
+        return;
+    }
+    const QString fileName = mSaveLocation.toLocalFile();
+    mIndex.setArchiveType(mArchiveType);
+    mIndex.setFrames(mWriter->frames());
+    if (!mIndex.save(fileName)) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Unable to write the index of" << fileName;
+    }
+    for (const Akonadi::Item::Id id : std::as_const(mManifest.presentItems)) {
+        // Keep the items which could not be fetched for the next incremental archive
+        if (mFirstSkippedItemId < 0 || id < mFirstSkippedItemId) {
+            mManifest.highWaterItemId = qMax(mManifest.highWaterItemId, id);
+        }
+    }
+    if (mFirstSkippedModificationTime.isValid()) {
+        mManifest.highWaterDateTime = qMin(mManifest.highWaterDateTime, mFirstSkippedModificationTime.addMSecs(-1));
+    }
+    if (!mManifest.save(fileName)) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Unable to write the manifest of" << fileName;
+    }
+    const QString info = (mManifest.type == ArchiveManifest::Incremental)
+        ? i18np("Archiving folder '%2' successfully completed. One new or modified message was written to '%3'.",
+                "Archiving folder '%2' successfully completed. %1 new or modified messages were written to '%3'.",
+                mManifest.archivedItems.count(),
+                mRealPath,
+                fileName)
+        : i18n("Archiving folder '%1' successfully completed. The archive was written to the file '%2'.", mRealPath, fileName);
+    if (mProgressItem) {
+        mProgressItem->setStatus(i18n("Archiving finished"));
+        mProgressItem->setComplete();
+        mProgressItem = nullptr;
+    }
+    Q_EMIT archiveDone(info);
+    deleteLater();
+}
+
+void ArchiveWriterJob::updateProgress()
+{
+    if (!mProgressItem || mTotalItemCount == 0) {
+        return;
+    }
+    mProgressItem->setStatus(i18n("Archiving message %1 of %2", mProcessedItemCount, mTotalItemCount));
+    mProgressItem->setProgress(mProcessedItemCount * 100 / mTotalItemCount);
+}
+
+void ArchiveWriterJob::abort(const QString &errorMessage)
+{
+    if (mCurrentJob) {
+        mCurrentJob->kill();
+        mCurrentJob = nullptr;
+    }
+    if (mWriter) {
+        mWriter->abort();
+    }
+    if (mProgressItem) {
+        mProgressItem->setStatus(i18n("Archiving failed"));
+        mProgressItem->setComplete();
+        mProgressItem = nullptr;
+    }
+    Q_EMIT error(i18n("Failed to archive the folder '%1': %2", mRealPath, errorMessage));
+    deleteLater();
+}
+
+void ArchiveWriterJob::kill()
+{
+    abort(i18n("The operation was canceled."));
+}
+
+QString ArchiveWriterJob::pathForCollection(const Akonadi::Collection &collection) const
+{
+    // Same layout as MailCommon::BackupJob, so that the archives can be imported the same way
+    if (collection.id() == mRootFolder.id()) {
+        return mRootFolder.name();
+    }
+    const Akonadi::Collection parent = mCollections.value(collection.parentCollection().id());
+    if (!parent.isValid()) {
+        return collection.name();
+    }
+    const QString parentPath = pathForCollection(parent);
+    const int slash = parentPath.lastIndexOf(QLatin1Char('/'));
+    return parentPath.left(slash + 1) + QLatin1Char('.') + parent.name() + QLatin1String(".directory/") + collection.name();
+}
@@ -0,0 +1,116 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "archiveindex.h"
+#include "archivemailinfo.h"
+#include "archivemanifest.h"
+
+#include <Collection>
+#include <Item>
+
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QUrl>
+
+class ArchiveFileWriter;
+class ArchiveThrottle;
+class KJob;
+namespace KPIM
+{
+class ProgressItem;
+}
+
+/**
+ * Writes the messages of a folder (and its subfolders) to an archive.
+ *
+ * Unlike MailCommon::BackupJob it can restrict the archive to the messages
+ * added or modified since a high-water mark, which is what incremental archives
+ * are made of, and it can write zstd compressed archives. The archive uses the
+ * same layout as the ones of BackupJob, including the cur, new and tmp
+ * directories of empty folders, and the job shows the same progress item. A
+ * manifest describing the archive and an index of its messages are written
+ * next to it.
+ */
+class ArchiveWriterJob : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ArchiveWriterJob(QObject *parent = nullptr);
+    ~ArchiveWriterJob() override;
+
+    void setRootFolder(const Akonadi::Collection &rootFolder);
+    void setRecursive(bool recursive);
+    void setSaveLocation(const QUrl &savePath);
+    void setArchiveType(ArchiveMailInfo::ArchiveType type);
+    void setRealPath(const QString &path);
+
+    /**
+     * Waits between the chunks of messages as needed to honor the rate of @p throttle.
+     */
+    void setThrottle(ArchiveThrottle *throttle);
+
+    /**
+     * Only archives the items with an id above @p itemId or modified after @p dateTime.
+     * @p baseArchive and @p previousArchive are recorded in the manifest.
+     */
+    void setIncremental(Akonadi::Item::Id itemId, const QDateTime &dateTime, const QString &baseArchive, const QString &previousArchive);
+
+    void start();
+    void kill();
+
+    /**
+     * The manifest of the written archive, valid after archiveDone() was emitted.
+     */
+    Q_REQUIRED_RESULT ArchiveManifest manifest() const;
+
+Q_SIGNALS:
+    void archiveDone(const QString &info);
+    void error(const QString &error);
+
+private:
+    void slotCollectionsFetched(KJob *job);
+    void listNextCollection();
+    void slotItemsListed(KJob *job);
+    void fetchNextChunk();
+    void slotChunkFetched(KJob *job);
+    void slotBlockWritten();
+    Q_REQUIRED_RESULT bool writeDirectories(const Akonadi::Collection &collection);
+    void addIndexEntry(Akonadi::Item::Id itemId, const KMime::Message::Ptr &message, const QString &fileName, qint64 offset, qint64 length);
+    void finish();
+    void abort(const QString &errorMessage);
+    void updateProgress();
+    Q_REQUIRED_RESULT QString pathForCollection(const Akonadi::Collection &collection) const;
+
+    Akonadi::Collection mRootFolder;
+    QHash<Akonadi::Collection::Id, Akonadi::Collection> mCollections;
+    Akonadi::Collection::List mCollectionsToList;
+    Akonadi::Item::List mPendingItems;
+    ArchiveManifest mManifest;
+    ArchiveIndex mIndex;
+    QDateTime mSinceDateTime;
+    Akonadi::Item::Id mSinceItemId = -1;
+    QUrl mSaveLocation;
+    QString mRealPath;
+    QPointer<KJob> mCurrentJob;
+    QPointer<KPIM::ProgressItem> mProgressItem;
+    QDateTime mArchiveTime;
+    int mTotalItemCount = 0;
+    int mProcessedItemCount = 0;
+    // While retrying a failed chunk, the size of the smaller chunks and the last item of the failed one
+    int mChunkSizeLimit = 0;
+    Akonadi::Item::Id mFailedChunkEnd = -1;
+    // Oldest item which could not be fetched, the next incremental archive starts from it
+    Akonadi::Item::Id mFirstSkippedItemId = -1;
+    QDateTime mFirstSkippedModificationTime;
+    ArchiveFileWriter *mWriter = nullptr;
+    ArchiveThrottle *mThrottle = nullptr;
+    ArchiveMailInfo::ArchiveType mArchiveType = ArchiveMailInfo::ArchiveZip;
+    bool mRecursive = true;
+    bool mWaitingForWriter = false;
+};
@@ -0,0 +1,235 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "zstdtarwriter.h"
+#include "archivemailagent_debug.h"
+
+#include <KLocalizedString>
+
+#include <QDateTime>
+#include <QFile>
+#include <QThread>
+
+#include <zstd.h>
+
+namespace
+{
+constexpr int BlockSize = 4 * 1024 * 1024;
+constexpr int TarRecordSize = 512;
+constexpr int CompressionLevel = 3;
+
+QByteArray octal(qint64 value, int length)
+{
+    return QByteArray::number(value, 8).rightJustified(length - 1, '0');
+}
+
+void setField(QByteArray &header, int offset, int length, const QByteArray &value)
+{
+    memcpy(header.data() + offset, value.constData(), qMin(length, value.size()));
+}
+
+QByteArray compressBlock(const QByteArray &block)
+{
+    QByteArray compressed(static_cast<int>(ZSTD_compressBound(block.size())), Qt::Uninitialized);
+    ZSTD_CCtx *context = ZSTD_createCCtx();
+    ZSTD_CCtx_setParameter(context, ZSTD_c_compressionLevel, CompressionLevel);
+    ZSTD_CCtx_setParameter(context, ZSTD_c_checksumFlag, 1);
+    const size_t size = ZSTD_compress2(context, compressed.data(), compressed.size(), block.constData(), block.size());
+    ZSTD_freeCCtx(context);
+    if (ZSTD_isError(size)) {
+        qCWarning(ARCHIVEMAILAGENT_LOG) << "Unable to compress archive block:" << ZSTD_getErrorName(size);
+        return QByteArray();
+    }
+    compressed.truncate(static_cast<int>(size));
+    return compressed;
+}
+}
+
+ZstdTarWriter::ZstdTarWriter(const QString &fileName, QObject *parent)
+    : QObject(parent)
+    , mFile(fileName)
+{
+    const int threads = qMax(1, QThread::idealThreadCount());
+    mPool.setMaxThreadCount(threads);
+    mMaximumPendingBlocks = 2 * threads;
+}
+
+ZstdTarWriter::~ZstdTarWriter()
+{
+    // The workers access the members destroyed before the pool
+    mPool.waitForDone();
+}
+
+bool ZstdTarWriter::open()
+{
+    if (!mFile.open(QIODevice::WriteOnly)) {
+        mErrorString = mFile.errorString();
+        return false;
+    }
+    mCurrentBlock.reserve(BlockSize + TarRecordSize);
+    return true;
+}
+
+void ZstdTarWriter::append(const QByteArray &data)
+{
+    mCurrentBlock += data;
+    mStreamOffset += data.size();
+    if (mCurrentBlock.size() >= BlockSize) {
+        submitBlock();
+    }
+}
+
+void ZstdTarWriter::appendHeader(const QByteArray &name, char type, int mode, qint64 size, const QDateTime &modificationTime)
+{
+    QByteArray header(TarRecordSize, '\0');
+    setField(header, 0, 100, name);
+    setField(header, 100, 8, octal(mode, 8));
+    setField(header, 108, 8, octal(0, 8));
+    setField(header, 116, 8, octal(0, 8));
+    setField(header, 124, 12, octal(size, 12));
+    setField(header, 136, 12, octal(modificationTime.isValid() ? modificationTime.toSecsSinceEpoch() : 0, 12));
+    memset(header.data() + 148, ' ', 8);
+    header[156] = type;
+    // GNU tar format, like KTar, for the long names
+    setField(header, 257, 8, QByteArrayLiteral("ustar  "));
+
+    unsigned int checksum = 0;
+    for (const char c : std::as_const(header)) {
+        checksum += static_cast<unsigned char>(c);
+    }
+    setField(header, 148, 7, octal(checksum, 7));
+    append(header);
+}
+
+void ZstdTarWriter::appendEntry(const QString &name, char type, int mode, qint64 size, const QDateTime &modificationTime)
+{
+    const QByteArray encodedName = QFile::encodeName(name);
+    if (encodedName.size() >= 100) {
+        const QByteArray longName = encodedName + '\0';
+        appendHeader(QByteArrayLiteral("././@LongLink"), 'L', 0644, longName.size(), modificationTime);
+        append(longName + QByteArray((TarRecordSize - longName.size() % TarRecordSize) % TarRecordSize, '\0'));
+    }
+    appendHeader(encodedName.left(99), type, mode, size, modificationTime);
+}
+
+bool ZstdTarWriter::writeDir(const QString &name, const QDateTime &modificationTime)
+{
+    if (mFailed) {
+        return false;
+    }
+    appendEntry(name.endsWith(QLatin1Char('/')) ? name : name + QLatin1Char('/'), '5', 0755, 0, modificationTime);
+    return !mFailed;
+}
+
+bool ZstdTarWriter::writeFile(const QString &name, const QByteArray &data, const QDateTime &modificationTime)
+{
+    if (mFailed) {
+        return false;
+    }
+    appendEntry(name, '0', 0644, data.size(), modificationTime);
+    mLastFileOffset = mStreamOffset;
+    append(data + QByteArray((TarRecordSize - data.size() % TarRecordSize) % TarRecordSize, '\0'));
+    return !mFailed;
+}
+
+void ZstdTarWriter::submitBlock()
+{
+    if (mCurrentBlock.isEmpty()) {
+        return;
+    }
+    const QByteArray block = mCurrentBlock;
+    const qint64 index = mNextBlock++;
+    mBlockOffsets.insert(index, mStreamOffset - block.size());
+    mCurrentBlock.clear();
+    mCurrentBlock.reserve(BlockSize + TarRecordSize);
+    mPool.start(QRunnable::create([this, block, index]() {
+        const QByteArray compressed = compressBlock(block);
+        {
+            QMutexLocker locker(&mMutex);
+            mCompressedBlocks.insert(index, compressed);
+        }
+        QMetaObject::invokeMethod(this, &ZstdTarWriter::writeCompressedBlocks, Qt::QueuedConnection);
+    }));
+}
+
+void ZstdTarWriter::writeCompressedBlocks()
+{
+    bool written = false;
+    for (;;) {
+        QByteArray compressed;
+        {
+            QMutexLocker locker(&mMutex);
+            auto it = mCompressedBlocks.find(mNextBlockToWrite);
+            if (it == mCompressedBlocks.end()) {
+                break;
+            }
+            compressed = it.value();
+            mCompressedBlocks.erase(it);
+        }
+        const qint64 blockOffset = mBlockOffsets.take(mNextBlockToWrite);
+        ++mNextBlockToWrite;
+        written = true;
+        if (mFailed) {
+            continue;
+        }
+        mFrames.append({blockOffset, mFile.pos()});
+        if (compressed.isNull()) {
+            mFailed = true;
+            mErrorString = i18n("Unable to compress the archive.");
+        } else if (mFile.write(compressed) != compressed.size()) {
+            mFailed = true;
+            mErrorString = mFile.errorString();
+        }
+    }
+    if (written) {
+        Q_EMIT blockWritten();
+    }
+}
+
+bool ZstdTarWriter::isFull() const
+{
+    return (mNextBlock - mNextBlockToWrite) >= mMaximumPendingBlocks;
+}
+
+bool ZstdTarWriter::close()
+{
+    // The end of the archive is marked by two empty records
+    append(QByteArray(2 * TarRecordSize, '\0'));
+    submitBlock();
+    mPool.waitForDone();
+    writeCompressedBlocks();
+    if (mFailed) {
+        mFile.cancelWriting();
+        return false;
+    }
+    if (!mFile.commit()) {
+        mErrorString = mFile.errorString();
+        return false;
+    }
+    return true;
+}
+
+void ZstdTarWriter::abort()
+{
+    mPool.clear();
+    mPool.waitForDone();
+    mFile.cancelWriting();
+}
+
+qint64 ZstdTarWriter::lastFileOffset() const
+{
+    return mLastFileOffset;
+}
+
+QVector<ArchiveIndex::Frame> ZstdTarWriter::frames() const
+{
+    return mFrames;
+}
+
+QString ZstdTarWriter::errorString() const
+{
+    return mErrorString;
+}
@@ -0,0 +1,98 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "archiveindex.h"
+
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QSaveFile>
+#include <QThreadPool>
+
+class QDateTime;
+
+/**
+ * Writes a zstd compressed tar archive.
+ *
+ * The tar stream is cut into blocks which are compressed in parallel on a
+ * thread pool, each block as an independent zstd frame, and written to the file
+ * in order as soon as they are ready. The number of blocks waiting for
+ * compression is bounded: isFull() tells the producer to wait for blockWritten()
+ * before passing more data.
+ */
+class ZstdTarWriter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ZstdTarWriter(const QString &fileName, QObject *parent = nullptr);
+    ~ZstdTarWriter() override;
+
+    Q_REQUIRED_RESULT bool open();
+
+    /**
+     * Appends a file to the archive, the data is compressed in the background.
+     */
+    Q_REQUIRED_RESULT bool writeFile(const QString &name, const QByteArray &data, const QDateTime &modificationTime);
+
+    /**
+     * Appends a directory entry, so that empty directories are kept.
+     */
+    Q_REQUIRED_RESULT bool writeDir(const QString &name, const QDateTime &modificationTime);
+
+    /**
+     * Waits for the pending blocks and finalizes the archive.
+     */
+    Q_REQUIRED_RESULT bool close();
+
+    /**
+     * Discards the archive.
+     */
+    void abort();
+
+    /**
+     * Returns true while enough blocks are waiting for compression.
+     */
+    Q_REQUIRED_RESULT bool isFull() const;
+
+    Q_REQUIRED_RESULT QString errorString() const;
+
+    /**
+     * Returns the position of the data of the last written file in the uncompressed tar stream.
+     */
+    Q_REQUIRED_RESULT qint64 lastFileOffset() const;
+
+    /**
+     * Returns where each zstd frame starts, in the tar stream and in the file.
+     */
+    Q_REQUIRED_RESULT QVector<ArchiveIndex::Frame> frames() const;
+
+Q_SIGNALS:
+    void blockWritten();
+
+private:
+    void append(const QByteArray &data);
+    void appendHeader(const QByteArray &name, char type, int mode, qint64 size, const QDateTime &modificationTime);
+    void appendEntry(const QString &name, char type, int mode, qint64 size, const QDateTime &modificationTime);
+    void submitBlock();
+    void writeCompressedBlocks();
+
+    QSaveFile mFile;
+    QThreadPool mPool;
+    QByteArray mCurrentBlock;
+    QString mErrorString;
+    QMutex mMutex;
+    QMap<qint64, QByteArray> mCompressedBlocks; // guarded by mMutex, a null array means failure
+    QMap<qint64, qint64> mBlockOffsets;
+    QVector<ArchiveIndex::Frame> mFrames;
+    qint64 mStreamOffset = 0;
+    qint64 mLastFileOffset = -1;
+    qint64 mNextBlock = 0;
+    qint64 mNextBlockToWrite = 0;
+    int mMaximumPendingBlocks = 2;
+    bool mFailed = false;
+};
@@ -5,22 +5,26 @@
 */
 
 #include "formatcombobox.h"
+#include "config-archivemailagent.h"
 #include <KLocalizedString>
 
 FormatComboBox::FormatComboBox(QWidget *parent)
     : QComboBox(parent)
 {
-    // These combobox values have to stay in sync with the ArchiveType enum from BackupJob!
-    addItem(i18n("Compressed Zip Archive (.zip)"), static_cast<int>(MailCommon::BackupJob::Zip));
-    addItem(i18n("Uncompressed Archive (.tar)"), static_cast<int>(MailCommon::BackupJob::Tar));
-    addItem(i18n("BZ2-Compressed Tar Archive (.tar.bz2)"), static_cast<int>(MailCommon::BackupJob::TarBz2));
-    addItem(i18n("GZ-Compressed Tar Archive (.tar.gz)"), static_cast<int>(MailCommon::BackupJob::TarGz));
-    setCurrentIndex(findData(static_cast<int>(MailCommon::BackupJob::TarBz2)));
+    // These combobox values have to stay in sync with the ArchiveType enum from ArchiveMailInfo!
+    addItem(i18n("Compressed Zip Archive (.zip)"), static_cast<int>(ArchiveMailInfo::ArchiveZip));
+    addItem(i18n("Uncompressed Archive (.tar)"), static_cast<int>(ArchiveMailInfo::ArchiveTar));
+    addItem(i18n("BZ2-Compressed Tar Archive (.tar.bz2)"), static_cast<int>(ArchiveMailInfo::ArchiveTarBz2));
+    addItem(i18n("GZ-Compressed Tar Archive (.tar.gz)"), static_cast<int>(ArchiveMailInfo::ArchiveTarGz));
+#if HAVE_ZSTD
+    addItem(i18n("Zstandard-Compressed Tar Archive (.tar.zst)"), static_cast<int>(ArchiveMailInfo::ArchiveTarZstd));
+#endif
+    setCurrentIndex(findData(static_cast<int>(ArchiveMailInfo::ArchiveTarBz2)));
 }
 
 FormatComboBox::~FormatComboBox() = default;
 
-void FormatComboBox::setFormat(MailCommon::BackupJob::ArchiveType type)
+void FormatComboBox::setFormat(ArchiveMailInfo::ArchiveType type)
 {
     const int index = findData(static_cast<int>(type));
     if (index != -1) {
@@ -30,7 +34,7 @@ void FormatComboBox::setFormat(MailCommon::BackupJob::ArchiveType type)
     }
 }
 
-MailCommon::BackupJob::ArchiveType FormatComboBox::format() const
+ArchiveMailInfo::ArchiveType FormatComboBox::format() const
 {
-    return static_cast<MailCommon::BackupJob::ArchiveType>(itemData(currentIndex()).toInt());
+    return static_cast<ArchiveMailInfo::ArchiveType>(itemData(currentIndex()).toInt());
 }
@@ -5,7 +5,7 @@
 */
 
 #pragma once
-#include <MailCommon/BackupJob>
+#include "archivemailinfo.h"
 
 #include <QComboBox>
 
@@ -16,7 +16,7 @@ public:
     explicit FormatComboBox(QWidget *parent = nullptr);
     ~FormatComboBox();
 
-    MailCommon::BackupJob::ArchiveType format() const;
-    void setFormat(MailCommon::BackupJob::ArchiveType type);
+    ArchiveMailInfo::ArchiveType format() const;
+    void setFormat(ArchiveMailInfo::ArchiveType type);
 };
 
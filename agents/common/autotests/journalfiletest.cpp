@@ -0,0 +1,184 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "journalfiletest.h"
+#include "journalfile.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+Q_LOGGING_CATEGORY(JOURNALFILETEST_LOG, "org.kde.pim.journalfiletest")
+
+namespace
+{
+constexpr quint32 Magic = 0x4B544A46;
+constexpr quint32 Version = 2;
+
+enum RecordType : quint8 {
+    StringRecord = 1,
+    NumberRecord,
+};
+
+JournalFile createJournal(const QString &fileName, quint32 magic = Magic, quint32 version = Version)
+{
+    return JournalFile(fileName, magic, version, JOURNALFILETEST_LOG);
+}
+
+// Replays @p journal as "s:<string>" and "n:<number>" entries
+bool replay(JournalFile &journal, QStringList &entries)
+{
+    return journal.replay([&entries](quint8 type, QDataStream &stream) {
+        if (type == StringRecord) {
+            QString value;
+            stream >> value;
+            entries.append(QStringLiteral("s:") + value);
+            return true;
+        } else if (type == NumberRecord) {
+            qint64 value;
+            stream >> value;
+            entries.append(QStringLiteral("n:%1").arg(value));
+            return true;
+        }
+        return false;
+    });
+}
+
+void appendString(JournalFile &journal, const QString &value)
+{
+    QVERIFY(journal.append(StringRecord, [value](QDataStream &stream) {
+        stream << value;
+    }));
+}
+}
+
+JournalFileTest::JournalFileTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void JournalFileTest::shouldReplayAppendedRecords()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    // The directory is created with the journal
+    const QString fileName = dir.path() + QStringLiteral("/sub/test.journal");
+    {
+        JournalFile journal = createJournal(fileName);
+        QVERIFY(!journal.exists());
+        appendString(journal, QStringLiteral("foo"));
+        QVERIFY(journal.append(NumberRecord, [](QDataStream &stream) {
+            stream << qint64(42);
+        }));
+        appendString(journal, QStringLiteral("bar"));
+        QVERIFY(journal.exists());
+    }
+
+    JournalFile journal = createJournal(fileName);
+    QStringList entries;
+    QVERIFY(replay(journal, entries));
+    QCOMPARE(entries, QStringList({QStringLiteral("s:foo"), QStringLiteral("n:42"), QStringLiteral("s:bar")}));
+
+    // An unknown record type is a damaged journal
+    QVERIFY(journal.append(7, [](QDataStream &stream) {
+        stream << qint64(1);
+    }));
+    entries.clear();
+    QVERIFY(!replay(journal, entries));
+    QCOMPARE(entries.count(), 3);
+}
+
+void JournalFileTest::shouldRejectOtherFormats()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.path() + QStringLiteral("/test.journal");
+    JournalFile journal = createJournal(fileName);
+    appendString(journal, QStringLiteral("foo"));
+
+    QStringList entries;
+    JournalFile otherMagic = createJournal(fileName, Magic + 1);
+    QVERIFY(!replay(otherMagic, entries));
+    // Written by a newer version
+    JournalFile olderVersion = createJournal(fileName, Magic, Version - 1);
+    QVERIFY(!replay(olderVersion, entries));
+    // Written by an older version
+    JournalFile newerVersion = createJournal(fileName, Magic, Version + 1);
+    QVERIFY(replay(newerVersion, entries));
+    QCOMPARE(entries, QStringList({QStringLiteral("s:foo")}));
+}
+
+void JournalFileTest::shouldStopAtTruncatedRecord()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.path() + QStringLiteral("/test.journal");
+    {
+        JournalFile journal = createJournal(fileName);
+        appendString(journal, QStringLiteral("foo"));
+        appendString(journal, QStringLiteral("bar"));
+    }
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.resize(file.size() - 3));
+    file.close();
+
+    JournalFile journal = createJournal(fileName);
+    QStringList entries;
+    QVERIFY(!replay(journal, entries));
+    QCOMPARE(entries, QStringList({QStringLiteral("s:foo")}));
+
+    // Once rewritten, the records appended later can be read
+    QVERIFY(journal.rewrite([](QDataStream &stream) {
+        stream << static_cast<quint8>(StringRecord) << QStringLiteral("foo");
+        return 1;
+    }));
+    appendString(journal, QStringLiteral("baz"));
+    entries.clear();
+    QVERIFY(replay(journal, entries));
+    QCOMPARE(entries, QStringList({QStringLiteral("s:foo"), QStringLiteral("s:baz")}));
+}
+
+void JournalFileTest::shouldRewrite()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.path() + QStringLiteral("/test.journal");
+    JournalFile journal = createJournal(fileName);
+    appendString(journal, QStringLiteral("foo"));
+    appendString(journal, QStringLiteral("bar"));
+
+    QVERIFY(journal.rewrite([](QDataStream &stream) {
+        stream << static_cast<quint8>(NumberRecord) << qint64(1);
+        stream << static_cast<quint8>(StringRecord) << QStringLiteral("baz");
+        return 2;
+    }));
+    appendString(journal, QStringLiteral("qux"));
+
+    QStringList entries;
+    QVERIFY(replay(journal, entries));
+    QCOMPARE(entries, QStringList({QStringLiteral("n:1"), QStringLiteral("s:baz"), QStringLiteral("s:qux")}));
+}
+
+void JournalFileTest::shouldNeedCompaction()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    JournalFile journal = createJournal(dir.path() + QStringLiteral("/test.journal"));
+    for (int i = 0; i < 110; ++i) {
+        appendString(journal, QString::number(i));
+    }
+    QVERIFY(!journal.needsCompaction(5));
+    QVERIFY(journal.needsCompaction(4));
+
+    QVERIFY(journal.rewrite([](QDataStream &) {
+        return 4;
+    }));
+    QVERIFY(!journal.needsCompaction(4));
+}
+
+QTEST_GUILESS_MAIN(JournalFileTest)
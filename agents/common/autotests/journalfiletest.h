@@ -0,0 +1,24 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+
+class JournalFileTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit JournalFileTest(QObject *parent = nullptr);
+    ~JournalFileTest() override = default;
+
+private Q_SLOTS:
+    void shouldReplayAppendedRecords();
+    void shouldRejectOtherFormats();
+    void shouldStopAtTruncatedRecord();
+    void shouldRewrite();
+    void shouldNeedCompaction();
+};
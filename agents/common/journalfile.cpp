@@ -0,0 +1,135 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "journalfile.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace
+{
+constexpr QDataStream::Version StreamVersion = QDataStream::Qt_5_15;
+// Rewrite when the journal has that many records more than needed
+constexpr int CompactionSlack = 100;
+}
+
+JournalFile::JournalFile(const QString &fileName, quint32 magic, quint32 version, LoggingCategory loggingCategory)
+    : mFileName(fileName)
+    , mMagic(magic)
+    , mVersion(version)
+    , mLoggingCategory(loggingCategory)
+{
+}
+
+QString JournalFile::fileName() const
+{
+    return mFileName;
+}
+
+bool JournalFile::exists() const
+{
+    return QFileInfo::exists(mFileName);
+}
+
+void JournalFile::writeHeader(QDataStream &stream) const
+{
+    stream.setVersion(StreamVersion);
+    stream << mMagic << mVersion;
+}
+
+bool JournalFile::replay(const std::function<bool(quint8 type, QDataStream &stream)> &readRecord)
+{
+    mRecordCount = 0;
+    QFile file(mFileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCWarning(mLoggingCategory) << "Unable to open" << mFileName << file.errorString();
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(StreamVersion);
+    quint32 magic;
+    quint32 version;
+    stream >> magic >> version;
+    if (stream.status() != QDataStream::Ok || magic != mMagic || version > mVersion) {
+        qCWarning(mLoggingCategory) << "Invalid journal" << mFileName;
+        return false;
+    }
+
+    while (!stream.atEnd()) {
+        quint8 type;
+        stream >> type;
+        if (stream.status() != QDataStream::Ok) {
+            break;
+        }
+        if (!readRecord(type, stream) || stream.status() != QDataStream::Ok) {
+            stream.setStatus(QDataStream::ReadCorruptData);
+            break;
+        }
+        ++mRecordCount;
+    }
+    if (stream.status() != QDataStream::Ok) {
+        // Most likely the agent was stopped while appending a record
+        qCWarning(mLoggingCategory) << "Journal" << mFileName << "is truncated, kept" << mRecordCount << "records";
+        return false;
+    }
+    return true;
+}
+
+bool JournalFile::append(quint8 type, const ContentWriter &writeContent)
+{
+    QByteArray record;
+    QDataStream recordStream(&record, QIODevice::WriteOnly);
+    recordStream.setVersion(StreamVersion);
+    recordStream << type;
+    writeContent(recordStream);
+
+    QFile file(mFileName);
+    const bool newFile = !file.exists();
+    if (newFile) {
+        QDir().mkpath(QFileInfo(mFileName).absolutePath());
+    }
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qCWarning(mLoggingCategory) << "Unable to write" << mFileName << file.errorString();
+        return false;
+    }
+    if (newFile) {
+        QDataStream stream(&file);
+        writeHeader(stream);
+    }
+    if (file.write(record) != record.size()) {
+        qCWarning(mLoggingCategory) << "Unable to write" << mFileName << file.errorString();
+        return false;
+    }
+    ++mRecordCount;
+    return true;
+}
+
+bool JournalFile::rewrite(const std::function<int(QDataStream &stream)> &writeRecords)
+{
+    QDir().mkpath(QFileInfo(mFileName).absolutePath());
+    QSaveFile file(mFileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(mLoggingCategory) << "Unable to write" << mFileName << file.errorString();
+        return false;
+    }
+    QDataStream stream(&file);
+    writeHeader(stream);
+    const int recordCount = writeRecords(stream);
+    if (stream.status() != QDataStream::Ok || !file.commit()) {
+        qCWarning(mLoggingCategory) << "Unable to write" << mFileName << file.errorString();
+        return false;
+    }
+    mRecordCount = recordCount;
+    return true;
+}
+
+bool JournalFile::needsCompaction(int liveRecords) const
+{
+    return mRecordCount > 2 * liveRecords + CompactionSlack;
+}
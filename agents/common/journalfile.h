@@ -0,0 +1,79 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QLoggingCategory>
+#include <QString>
+
+#include <functional>
+
+class QDataStream;
+
+/**
+ * Append-only journal file, the persistence of the stores of the agents.
+ *
+ * The file starts with a magic number and a format version, followed by the
+ * records. A record is a type byte and its content, written with QDataStream.
+ * Each record is appended with a single write, so that an agent stopped while
+ * writing leaves at most a truncated record at the end of the file.
+ *
+ * The store replays the records on startup to rebuild its state, and rewrites
+ * the journal from that state when it ends with a damaged record, since later
+ * records would be appended after it, or when it holds too many outdated ones.
+ */
+class JournalFile
+{
+public:
+    using LoggingCategory = const QLoggingCategory &(*)();
+    using ContentWriter = std::function<void(QDataStream &stream)>;
+
+    /**
+     * The warnings are logged in @p loggingCategory, the one of the agent.
+     */
+    JournalFile(const QString &fileName, quint32 magic, quint32 version, LoggingCategory loggingCategory);
+
+    Q_REQUIRED_RESULT QString fileName() const;
+    Q_REQUIRED_RESULT bool exists() const;
+
+    /**
+     * Passes the records, in order, to @p readRecord, which reads the content
+     * of a record of the given type and returns false if it can't.
+     *
+     * Returns false if the file can't be read, isn't a journal of this format or
+     * ends with a damaged record. The records before it were replayed, but the
+     * journal has to be rewritten before anything is appended to it.
+     */
+    Q_REQUIRED_RESULT bool replay(const std::function<bool(quint8 type, QDataStream &stream)> &readRecord);
+
+    /**
+     * Appends a record of @p type, whose content is written by @p writeContent.
+     * The file is created if needed.
+     */
+    bool append(quint8 type, const ContentWriter &writeContent);
+
+    /**
+     * Replaces the journal with the records written by @p writeRecords, each one
+     * being its type byte followed by its content. @p writeRecords returns the
+     * number of written records.
+     */
+    bool rewrite(const std::function<int(QDataStream &stream)> &writeRecords);
+
+    /**
+     * Returns true when the journal has enough outdated records to be worth
+     * rewriting, @p liveRecords being the number of records it would keep.
+     */
+    Q_REQUIRED_RESULT bool needsCompaction(int liveRecords) const;
+
+private:
+    void writeHeader(QDataStream &stream) const;
+
+    const QString mFileName;
+    const quint32 mMagic;
+    const quint32 mVersion;
+    const LoggingCategory mLoggingCategory;
+    int mRecordCount = 0;
+};
@@ -0,0 +1,176 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "followupreminderstoretest.h"
+#include "../followupreminderinfo.h"
+#include "../followupreminderstore.h"
+#include "../followupreminderutil.h"
+
+#include <KConfigGroup>
+#include <QFile>
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <memory>
+
+namespace
+{
+FollowUpReminder::FollowUpReminderInfo createInfo(const QString &messageId, int days)
+{
+    FollowUpReminder::FollowUpReminderInfo info;
+    info.setMessageId(messageId);
+    info.setTo(QStringLiteral("foo@kde.org"));
+    info.setSubject(QStringLiteral("Subject %1").arg(messageId));
+    info.setFollowUpReminderDate(QDate(2021, 3, 1).addDays(days));
+    return info;
+}
+}
+
+FollowUpReminderStoreTest::FollowUpReminderStoreTest(QObject *parent)
+    : QObject(parent)
+{
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void FollowUpReminderStoreTest::shouldPersistChanges()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.path() + QStringLiteral("/followupreminder.journal");
+    qint32 first;
+    {
+        FollowUpReminder::FollowUpReminderStore store(fileName);
+        QCOMPARE(store.count(), 0);
+        first = store.insert(createInfo(QStringLiteral("a@kde.org"), 1));
+        const qint32 second = store.insert(createInfo(QStringLiteral("b@kde.org"), 2));
+        QVERIFY(first >= 0);
+        QVERIFY(second != first);
+        QVERIFY(store.remove(second));
+        QVERIFY(!store.remove(second));
+
+        std::unique_ptr<FollowUpReminder::FollowUpReminderInfo> answered{store.info(first)};
+        answered->setAnswerWasReceived(true);
+        answered->setAnswerMessageItemId(42);
+        QCOMPARE(store.insert(*answered), first);
+        // Invalid infos are ignored
+        QCOMPARE(store.insert(FollowUpReminder::FollowUpReminderInfo()), -1);
+    }
+
+    FollowUpReminder::FollowUpReminderStore store(fileName);
+    QCOMPARE(store.count(), 1);
+    std::unique_ptr<FollowUpReminder::FollowUpReminderInfo> info{store.info(first)};
+    QVERIFY(info);
+    QCOMPARE(info->messageId(), QStringLiteral("a@kde.org"));
+    QVERIFY(info->answerWasReceived());
+    QCOMPARE(info->answerMessageItemId(), Akonadi::Item::Id(42));
+    QVERIFY(store.pendingInfos().isEmpty());
+
+    // Identifiers of removed reminders are not reused
+    QVERIFY(store.insert(createInfo(QStringLiteral("c@kde.org"), 3)) > first + 1);
+}
+
+void FollowUpReminderStoreTest::shouldOrderByDeadline()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    FollowUpReminder::FollowUpReminderStore store(dir.path() + QStringLiteral("/followupreminder.journal"));
+    const qint32 late = store.insert(createInfo(QStringLiteral("a@kde.org"), 3));
+    const qint32 early = store.insert(createInfo(QStringLiteral("b@kde.org"), 1));
+    FollowUpReminder::FollowUpReminderInfo answered = createInfo(QStringLiteral("c@kde.org"), 2);
+    answered.setAnswerWasReceived(true);
+    const qint32 middle = store.insert(answered);
+
+    const QVector<FollowUpReminder::FollowUpReminderInfo *> infos = store.infos();
+    QCOMPARE(infos.count(), 3);
+    QCOMPARE(infos.at(0)->uniqueIdentifier(), early);
+    QCOMPARE(infos.at(1)->uniqueIdentifier(), middle);
+    QCOMPARE(infos.at(2)->uniqueIdentifier(), late);
+    qDeleteAll(infos);
+
+    // Answered reminders have no deadline anymore
+    QCOMPARE(store.pendingDueBefore(QDate(2021, 3, 3)), QVector<qint32>({early}));
+    QCOMPARE(store.nextDeadlineAfter(QDate(2021, 3, 2)), QDate(2021, 3, 4));
+    QVERIFY(!store.nextDeadlineAfter(QDate(2021, 3, 4)).isValid());
+}
+
+void FollowUpReminderStoreTest::shouldRemoveOldReminders()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.path() + QStringLiteral("/followupreminder.journal");
+    {
+        FollowUpReminder::FollowUpReminderStore store(fileName);
+        store.insert(createInfo(QStringLiteral("a@kde.org"), 0));
+        FollowUpReminder::FollowUpReminderInfo answered = createInfo(QStringLiteral("b@kde.org"), 1);
+        answered.setAnswerWasReceived(true);
+        store.insert(answered);
+        store.insert(createInfo(QStringLiteral("c@kde.org"), 2));
+        QCOMPARE(store.removeDeadlinesBefore(QDate(2021, 3, 3)), 2);
+        QCOMPARE(store.removeDeadlinesBefore(QDate(2021, 3, 3)), 0);
+    }
+    FollowUpReminder::FollowUpReminderStore store(fileName);
+    QCOMPARE(store.count(), 1);
+}
+
+void FollowUpReminderStoreTest::shouldMigrateFromConfig()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.path() + QStringLiteral("/followupreminder.journal");
+    KSharedConfig::Ptr config = KSharedConfig::openConfig(dir.path() + QStringLiteral("/followupreminderrc"), KConfig::SimpleConfig);
+    FollowUpReminder::FollowUpReminderInfo first = createInfo(QStringLiteral("a@kde.org"), 1);
+    FollowUpReminder::FollowUpReminderInfo second = createInfo(QStringLiteral("b@kde.org"), 2);
+    FollowUpReminder::FollowUpReminderUtil::writeFollowupReminderInfo(config, &first, false);
+    FollowUpReminder::FollowUpReminderUtil::writeFollowupReminderInfo(config, &second, false);
+    config->group(QStringLiteral("General")).writeEntry("enabled", true);
+
+    {
+        FollowUpReminder::FollowUpReminderStore store(fileName, config);
+        QCOMPARE(store.count(), 2);
+    }
+    QVERIFY(QFile::exists(fileName));
+    QVERIFY(config->groupList().filter(QRegularExpression(QStringLiteral("FollowupReminderItem \\d+"))).isEmpty());
+    QVERIFY(config->hasGroup(QStringLiteral("General")));
+
+    // The migration is done only once
+    FollowUpReminder::FollowUpReminderUtil::writeFollowupReminderInfo(config, &first, false);
+    FollowUpReminder::FollowUpReminderStore store(fileName, config);
+    QCOMPARE(store.count(), 2);
+}
+
+void FollowUpReminderStoreTest::shouldNotWriteWhenReadOnly()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.path() + QStringLiteral("/followupreminder.journal");
+    KSharedConfig::Ptr config = KSharedConfig::openConfig(dir.path() + QStringLiteral("/followupreminderrc"), KConfig::SimpleConfig);
+    FollowUpReminder::FollowUpReminderInfo info = createInfo(QStringLiteral("a@kde.org"), 1);
+    FollowUpReminder::FollowUpReminderUtil::writeFollowupReminderInfo(config, &info, false);
+
+    // Nothing is migrated, that's up to the agent
+    {
+        FollowUpReminder::FollowUpReminderStore store(fileName, config, FollowUpReminder::FollowUpReminderStore::ReadOnly);
+        QCOMPARE(store.count(), 0);
+        QVERIFY(store.insert(info) >= 0);
+    }
+    QVERIFY(!QFile::exists(fileName));
+    QVERIFY(config->hasGroup(FollowUpReminder::FollowUpReminderUtil::followUpReminderPattern().arg(0)));
+
+    qint32 identifier;
+    {
+        FollowUpReminder::FollowUpReminderStore store(fileName);
+        identifier = store.insert(createInfo(QStringLiteral("b@kde.org"), 2));
+    }
+    FollowUpReminder::FollowUpReminderStore store(fileName, KSharedConfig::Ptr(), FollowUpReminder::FollowUpReminderStore::ReadOnly);
+    QCOMPARE(store.count(), 1);
+    QVERIFY(store.remove(identifier));
+    FollowUpReminder::FollowUpReminderStore other(fileName);
+    QVERIFY(other.contains(identifier));
+}
+
+QTEST_GUILESS_MAIN(FollowUpReminderStoreTest)
@@ -0,0 +1,24 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+
+class FollowUpReminderStoreTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FollowUpReminderStoreTest(QObject *parent = nullptr);
+
+private Q_SLOTS:
+    void shouldPersistChanges();
+    void shouldOrderByDeadline();
+    void shouldRemoveOldReminders();
+    void shouldMigrateFromConfig();
+    void shouldNotWriteWhenReadOnly();
+};
+
@@ -0,0 +1,65 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "followupreminderutiltest.h"
+#include "../followupreminderutil.h"
+
+#include <QTest>
+
+FollowUpReminderUtilTest::FollowUpReminderUtilTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void FollowUpReminderUtilTest::shouldNormalizeMessageId()
+{
+    QCOMPARE(FollowUpReminder::FollowUpReminderUtil::normalizedMessageId(QStringLiteral("<foo@kde.org>")), QStringLiteral("foo@kde.org"));
+    QCOMPARE(FollowUpReminder::FollowUpReminderUtil::normalizedMessageId(QStringLiteral(" <foo@kde.org> ")), QStringLiteral("foo@kde.org"));
+    QCOMPARE(FollowUpReminder::FollowUpReminderUtil::normalizedMessageId(QStringLiteral("foo@kde.org")), QStringLiteral("foo@kde.org"));
+    QCOMPARE(FollowUpReminder::FollowUpReminderUtil::normalizedMessageId(QString()), QString());
+}
+
+void FollowUpReminderUtilTest::shouldHaveNoAnsweredMessageIds()
+{
+    QVERIFY(FollowUpReminder::FollowUpReminderUtil::answeredMessageIds(KMime::Message::Ptr()).isEmpty());
+
+    KMime::Message::Ptr msg(new KMime::Message);
+    msg->setContent("From: foo@kde.org\nSubject: test\nMessage-ID: <new@kde.org>\n\nbody\n");
+    msg->parse();
+    QVERIFY(FollowUpReminder::FollowUpReminderUtil::answeredMessageIds(msg).isEmpty());
+}
+
+void FollowUpReminderUtilTest::shouldReturnInReplyToFirst()
+{
+    KMime::Message::Ptr msg(new KMime::Message);
+    msg->setContent(
+        "From: foo@kde.org\n"
+        "Subject: Re: test\n"
+        "In-Reply-To: <parent@kde.org>\n"
+        "References: <root@kde.org> <other@kde.org>\n"
+        "\n"
+        "body\n");
+    msg->parse();
+    const QStringList expected = {QStringLiteral("parent@kde.org"), QStringLiteral("other@kde.org"), QStringLiteral("root@kde.org")};
+    QCOMPARE(FollowUpReminder::FollowUpReminderUtil::answeredMessageIds(msg), expected);
+}
+
+void FollowUpReminderUtilTest::shouldNotDuplicateMessageIds()
+{
+    KMime::Message::Ptr msg(new KMime::Message);
+    msg->setContent(
+        "From: foo@kde.org\n"
+        "Subject: Re: test\n"
+        "In-Reply-To: <parent@kde.org>\n"
+        "References: <root@kde.org> <parent@kde.org>\n"
+        "\n"
+        "body\n");
+    msg->parse();
+    const QStringList expected = {QStringLiteral("parent@kde.org"), QStringLiteral("root@kde.org")};
+    QCOMPARE(FollowUpReminder::FollowUpReminderUtil::answeredMessageIds(msg), expected);
+}
+
+QTEST_GUILESS_MAIN(FollowUpReminderUtilTest)
@@ -0,0 +1,23 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+
+class FollowUpReminderUtilTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FollowUpReminderUtilTest(QObject *parent = nullptr);
+
+private Q_SLOTS:
+    void shouldNormalizeMessageId();
+    void shouldHaveNoAnsweredMessageIds();
+    void shouldReturnInReplyToFirst();
+    void shouldNotDuplicateMessageIds();
+};
+
@@ -11,6 +11,7 @@
 #include "followupremindermanager.h"
 #include "followupreminderutil.h"
 
+#include <Akonadi/KMime/MessageParts>
 #include <KMime/Message>
 
 #include <AkonadiCore/ChangeRecorder>
@@ -25,10 +26,6 @@
 #include <Kdelibs4ConfigMigrator>
 #endif
 #include "followupreminderagent_debug.h"
-#include <QTimer>
-#include <chrono>
-
-using namespace std::chrono_literals;
 
 FollowUpReminderAgent::FollowUpReminderAgent(const QString &id)
     : Akonadi::AgentBase(id)
@@ -48,6 +45,8 @@ FollowUpReminderAgent::FollowUpReminderAgent(const QString &id)
 
     changeRecorder()->setMimeTypeMonitored(KMime::Message::mimeType());
     changeRecorder()->itemFetchScope().setCacheOnly(true);
+    // Enough to find answers without fetching the new messages again
+    changeRecorder()->itemFetchScope().fetchPayloadPart(Akonadi::MessagePart::Envelope);
     changeRecorder()->itemFetchScope().setFetchModificationTime(false);
     changeRecorder()->fetchCollection(true);
     changeRecorder()->setChangeRecordingEnabled(false);
@@ -55,14 +54,10 @@ FollowUpReminderAgent::FollowUpReminderAgent(const QString &id)
     changeRecorder()->collectionFetchScope().setAncestorRetrieval(Akonadi::CollectionFetchScope::All);
     changeRecorder()->setCollectionMonitored(Akonadi::Collection::root(), true);
 
+    // The manager wakes itself up when a deadline is reached
     if (FollowUpReminderAgentSettings::enabled()) {
         mManager->load();
     }
-
-    mTimer = new QTimer(this);
-    connect(mTimer, &QTimer::timeout, this, &FollowUpReminderAgent::reload);
-    // Reload all each 24hours
-    mTimer->start(24h);
 }
 
 FollowUpReminderAgent::~FollowUpReminderAgent() = default;
@@ -77,9 +72,8 @@ void FollowUpReminderAgent::setEnableAgent(bool enabled)
     FollowUpReminderAgentSettings::self()->save();
     if (enabled) {
         mManager->load();
-        mTimer->start();
     } else {
-        mTimer->stop();
+        mManager->stop();
     }
 }
 
@@ -105,7 +99,6 @@ void FollowUpReminderAgent::reload()
 {
     if (enabledAgent()) {
         mManager->load(true);
-        mTimer->start();
     }
 }
 
@@ -127,6 +120,11 @@ void FollowUpReminderAgent::addReminder(const QString &messageId,
     mManager->addReminder(info);
 }
 
+void FollowUpReminderAgent::removeReminders(const QList<qint32> &identifiers)
+{
+    mManager->removeReminders(identifiers);
+}
+
 QString FollowUpReminderAgent::printDebugInfo() const
 {
     return mManager->printDebugInfo();
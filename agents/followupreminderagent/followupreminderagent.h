@@ -29,12 +29,12 @@ public Q_SLOTS:
                      const QString &subject,
                      QDate followupDate,
                      Akonadi::Item::Id todoId);
+    void removeReminders(const QList<qint32> &identifiers);
 
 protected:
     void itemAdded(const Akonadi::Item &item, const Akonadi::Collection &collection) override;
 
 private:
     FollowUpReminderManager *const mManager;
-    QTimer *mTimer = nullptr;
 };
 
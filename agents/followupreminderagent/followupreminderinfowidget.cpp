@@ -6,12 +6,12 @@
 #include "followupreminderinfowidget.h"
 #include "followupreminderagent_debug.h"
 #include "followupreminderinfo.h"
+#include "followupreminderstore.h"
 #include "followupreminderutil.h"
 #include "jobs/followupremindershowmessagejob.h"
 
 #include <KLocalizedString>
 #include <KMessageBox>
-#include <KSharedConfig>
 #include <QHBoxLayout>
 #include <QHeaderView>
 #include <QIcon>
@@ -20,13 +20,6 @@
 #include <QTreeWidget>
 
 // #define DEBUG_MESSAGE_ID
-namespace
-{
-inline QString followUpItemPattern()
-{
-    return QStringLiteral("FollowupReminderItem \\d+");
-}
-}
 
 FollowUpReminderInfoItem::FollowUpReminderInfoItem(QTreeWidget *parent)
     : QTreeWidgetItem(parent)
@@ -90,18 +83,13 @@ void FollowUpReminderInfoWidget::setInfo(const QList<FollowUpReminder::FollowUpR
 
 void FollowUpReminderInfoWidget::load()
 {
-    auto config = FollowUpReminder::FollowUpReminderUtil::defaultConfig();
-    const QStringList filterGroups = config->groupList().filter(QRegularExpression(followUpItemPattern()));
-    const int numberOfItem = filterGroups.count();
-    for (int i = 0; i < numberOfItem; ++i) {
-        KConfigGroup group = config->group(filterGroups.at(i));
-
-        auto info = new FollowUpReminder::FollowUpReminderInfo(group);
-        if (info->isValid()) {
-            createOrUpdateItem(info);
-        } else {
-            delete info;
-        }
+    // The journal belongs to the agent, only read it here
+    const FollowUpReminder::FollowUpReminderStore store(FollowUpReminder::FollowUpReminderStore::defaultFileName(),
+                                                        KSharedConfig::Ptr(),
+                                                        FollowUpReminder::FollowUpReminderStore::ReadOnly);
+    const QVector<FollowUpReminder::FollowUpReminderInfo *> infos = store.infos();
+    for (FollowUpReminder::FollowUpReminderInfo *info : infos) {
+        createOrUpdateItem(info);
     }
 }
 
@@ -141,28 +129,11 @@ bool FollowUpReminderInfoWidget::save() const
     if (!mChanged) {
         return false;
     }
-    KSharedConfig::Ptr config = KSharedConfig::openConfig();
-
-    // first, delete all filter groups:
-    const QStringList filterGroups = config->groupList().filter(QRegularExpression(followUpItemPattern()));
-
-    for (const QString &group : filterGroups) {
-        config->deleteGroup(group);
-    }
-
-    const int numberOfItem(mTreeWidget->topLevelItemCount());
-    int i = 0;
-    for (; i < numberOfItem; ++i) {
-        auto mailItem = static_cast<FollowUpReminderInfoItem *>(mTreeWidget->topLevelItem(i));
-        if (mailItem->info()) {
-            KConfigGroup group = config->group(FollowUpReminder::FollowUpReminderUtil::followUpReminderPattern().arg(i));
-            mailItem->info()->writeConfig(group, i);
-        }
+    // Only removing reminders is possible here, the agent does it
+    if (!FollowUpReminder::FollowUpReminderUtil::removeReminders(mListRemoveId)) {
+        qCWarning(FOLLOWUPREMINDERAGENT_LOG) << "Unable to remove the follow up reminders, the agent isn't running";
+        return false;
     }
-    ++i;
-    KConfigGroup general = config->group(QStringLiteral("General"));
-    general.writeEntry("Number", i);
-    config->sync();
     return true;
 }
 
@@ -6,25 +6,41 @@
 
 #include "followupremindermanager.h"
 #include "followupreminderagent_debug.h"
+#include "followupreminderagentsettings.h"
 #include "followupreminderinfo.h"
 #include "followupremindernoanswerdialog.h"
+#include "followupreminderstore.h"
 #include "followupreminderutil.h"
 #include "jobs/followupreminderfinishtaskjob.h"
 #include "jobs/followupreminderjob.h"
 
 #include <Akonadi/KMime/SpecialMailCollections>
 
-#include <KConfig>
-#include <KConfigGroup>
 #include <KLocalizedString>
 #include <KNotification>
-#include <QRegularExpression>
+#include <QDateTime>
+#include <QTimer>
 using namespace FollowUpReminder;
 
+namespace
+{
+// A mailbox sync adds many messages at once, fetch their envelopes together
+constexpr int CheckBatchDelayMSecs = 500;
+constexpr int MaximumCheckBatchSize = 250;
+// Deadlines are days, but old reminders are removed at least once a day
+constexpr qint64 MaximumDeadlineTimerInterval = 24 * 60 * 60 * 1000;
+}
+
 FollowUpReminderManager::FollowUpReminderManager(QObject *parent)
     : QObject(parent)
 {
-    mConfig = KSharedConfig::openConfig();
+    mDeadlineTimer = new QTimer(this);
+    mDeadlineTimer->setSingleShot(true);
+    connect(mDeadlineTimer, &QTimer::timeout, this, &FollowUpReminderManager::checkDeadlines);
+    mCheckTimer = new QTimer(this);
+    mCheckTimer->setSingleShot(true);
+    mCheckTimer->setInterval(CheckBatchDelayMSecs);
+    connect(mCheckTimer, &QTimer::timeout, this, &FollowUpReminderManager::startCheckJob);
 }
 
 FollowUpReminderManager::~FollowUpReminderManager()
@@ -35,34 +51,54 @@ FollowUpReminderManager::~FollowUpReminderManager()
 
 void FollowUpReminderManager::load(bool forceReloadConfig)
 {
+    FollowUpReminderStore *store = FollowUpReminderStore::self();
     if (forceReloadConfig) {
-        mConfig->reparseConfiguration();
-    }
-    const QStringList itemList = mConfig->groupList().filter(QRegularExpression(QStringLiteral("FollowupReminderItem \\d+")));
-    const int numberOfItems = itemList.count();
-    QList<FollowUpReminder::FollowUpReminderInfo *> noAnswerList;
-    for (int i = 0; i < numberOfItems; ++i) {
-        KConfigGroup group = mConfig->group(itemList.at(i));
-
-        auto info = new FollowUpReminderInfo(group);
-        if (info->isValid()) {
-            if (!info->answerWasReceived()) {
-                mFollowUpReminderInfoList.append(info);
-                if (!mInitialize) {
-                    auto noAnswerInfo = new FollowUpReminderInfo(*info);
-                    noAnswerList.append(noAnswerInfo);
-                } else {
-                    delete info;
-                }
-            } else {
-                delete info;
-            }
-        } else {
-            delete info;
+        store->reload();
+    }
+    qDeleteAll(mFollowUpReminderInfoList);
+    mFollowUpReminderInfoList.clear();
+    mMessageIdIndex.clear();
+    const QVector<FollowUpReminderInfo *> infos = store->pendingInfos();
+    for (FollowUpReminderInfo *info : infos) {
+        addToIndex(info);
+    }
+    checkDeadlines();
+}
+
+void FollowUpReminderManager::stop()
+{
+    mDeadlineTimer->stop();
+    mCheckTimer->stop();
+    mPendingItems.clear();
+    qDeleteAll(mFollowUpReminderInfoList);
+    mFollowUpReminderInfoList.clear();
+    mMessageIdIndex.clear();
+}
+
+void FollowUpReminderManager::checkDeadlines()
+{
+    mDeadlineTimer->stop();
+    FollowUpReminderStore *store = FollowUpReminderStore::self();
+    const QDate today = QDate::currentDate();
+
+    if (store->removeDeadlinesBefore(today.addDays(-FollowUpReminderAgentSettings::keepRemindersDays())) > 0) {
+        dropRemovedReminders();
+    }
+
+    bool newDueReminder = false;
+    const QVector<qint32> dueReminders = store->pendingDueBefore(today);
+    for (const qint32 identifier : dueReminders) {
+        if (!mNotifiedReminders.contains(identifier)) {
+            mNotifiedReminders.insert(identifier);
+            newDueReminder = true;
         }
     }
-    if (!noAnswerList.isEmpty()) {
-        mInitialize = true;
+    if (newDueReminder) {
+        // The dialog lists again the ones it already showed
+        QList<FollowUpReminder::FollowUpReminderInfo *> noAnswerList;
+        for (const qint32 identifier : dueReminders) {
+            noAnswerList.append(store->info(identifier));
+        }
         if (!mNoAnswerDialog.data()) {
             mNoAnswerDialog = new FollowUpReminderNoAnswerDialog;
             connect(mNoAnswerDialog.data(),
@@ -73,20 +109,70 @@ void FollowUpReminderManager::load(bool forceReloadConfig)
         mNoAnswerDialog->setInfo(noAnswerList);
         mNoAnswerDialog->wakeUp();
     }
+
+    // Wake up when the next deadline is reached instead of polling
+    qint64 msecs = MaximumDeadlineTimerInterval;
+    const QDate nextDeadline = store->nextDeadlineAfter(today);
+    if (nextDeadline.isValid()) {
+        msecs = qMin(msecs, QDateTime::currentDateTime().msecsTo(nextDeadline.startOfDay()));
+    }
+    mDeadlineTimer->start(static_cast<int>(qMax<qint64>(0, msecs)));
+}
+
+void FollowUpReminderManager::addToIndex(FollowUpReminder::FollowUpReminderInfo *info)
+{
+    mFollowUpReminderInfoList.append(info);
+    mMessageIdIndex.insert(FollowUpReminderUtil::normalizedMessageId(info->messageId()), info);
+}
+
+void FollowUpReminderManager::dropRemovedReminders()
+{
+    const FollowUpReminderStore *store = FollowUpReminderStore::self();
+    for (auto it = mFollowUpReminderInfoList.begin(); it != mFollowUpReminderInfoList.end();) {
+        FollowUpReminderInfo *info = *it;
+        if (store->contains(info->uniqueIdentifier())) {
+            ++it;
+            continue;
+        }
+        const QString messageId = FollowUpReminderUtil::normalizedMessageId(info->messageId());
+        if (mMessageIdIndex.value(messageId) == info) {
+            mMessageIdIndex.remove(messageId);
+        }
+        mNotifiedReminders.remove(info->uniqueIdentifier());
+        delete info;
+        it = mFollowUpReminderInfoList.erase(it);
+    }
 }
 
 void FollowUpReminderManager::addReminder(FollowUpReminder::FollowUpReminderInfo *info)
 {
-    if (info->isValid()) {
-        FollowUpReminderUtil::writeFollowupReminderInfo(FollowUpReminderUtil::defaultConfig(), info, true);
+    const qint32 identifier = FollowUpReminderStore::self()->insert(*info);
+    if (identifier >= 0) {
+        // No need to reload everything, the new reminder is indexed right away
+        info->setUniqueIdentifier(identifier);
+        addToIndex(info);
+        checkDeadlines();
     } else {
         delete info;
     }
 }
 
+void FollowUpReminderManager::removeReminders(const QList<qint32> &identifiers)
+{
+    bool removed = false;
+    for (const qint32 identifier : identifiers) {
+        removed |= FollowUpReminderStore::self()->remove(identifier);
+    }
+    if (removed) {
+        dropRemovedReminders();
+        checkDeadlines();
+    }
+}
+
 void FollowUpReminderManager::slotReparseConfiguration()
 {
-    load(true);
+    // The dialog changed the store of this process, nothing to read again
+    load();
 }
 
 void FollowUpReminderManager::checkFollowUp(const Akonadi::Item &item, const Akonadi::Collection &col)
@@ -107,33 +193,70 @@ void FollowUpReminderManager::checkFollowUp(const Akonadi::Item &item, const Ako
         break;
     }
 
+    // The envelope is usually in the cache already, then there's nothing to fetch
+    if (item.hasPayload<KMime::Message::Ptr>()) {
+        const QStringList answeredMessageIds = FollowUpReminderUtil::answeredMessageIds(item.payload<KMime::Message::Ptr>());
+        if (!answeredMessageIds.isEmpty()) {
+            slotCheckFollowUpFinished(answeredMessageIds, item.id());
+        }
+        return;
+    }
+
+    mPendingItems.append(item);
+    if (mPendingItems.count() >= MaximumCheckBatchSize) {
+        startCheckJob();
+    } else if (!mCheckTimer->isActive()) {
+        // Not restarted by the next messages, so that a steady flow is still checked in time
+        mCheckTimer->start();
+    }
+}
+
+void FollowUpReminderManager::startCheckJob()
+{
+    mCheckTimer->stop();
+    // The running job starts the next batch once done
+    if (mCheckJob || mPendingItems.isEmpty()) {
+        return;
+    }
+    if (mFollowUpReminderInfoList.isEmpty()) {
+        mPendingItems.clear();
+        return;
+    }
+
     auto job = new FollowUpReminderJob(this);
     connect(job, &FollowUpReminderJob::finished, this, &FollowUpReminderManager::slotCheckFollowUpFinished);
-    job->setItem(item);
+    connect(job, &FollowUpReminderJob::allItemsChecked, this, [this]() {
+        mCheckJob = nullptr;
+        startCheckJob();
+    });
+    job->setItems(mPendingItems.mid(0, MaximumCheckBatchSize));
+    mPendingItems.remove(0, qMin(MaximumCheckBatchSize, mPendingItems.count()));
+    mCheckJob = job;
     job->start();
 }
 
-void FollowUpReminderManager::slotCheckFollowUpFinished(const QString &messageId, Akonadi::Item::Id id)
+void FollowUpReminderManager::slotCheckFollowUpFinished(const QStringList &answeredMessageIds, Akonadi::Item::Id id)
 {
-    for (FollowUpReminderInfo *info : std::as_const(mFollowUpReminderInfoList)) {
-        qCDebug(FOLLOWUPREMINDERAGENT_LOG) << "FollowUpReminderManager::slotCheckFollowUpFinished info:" << info;
+    for (const QString &messageId : answeredMessageIds) {
+        FollowUpReminderInfo *info = mMessageIdIndex.take(messageId);
         if (!info) {
             continue;
         }
-        if (info->messageId() == messageId) {
-            info->setAnswerMessageItemId(id);
-            info->setAnswerWasReceived(true);
-            answerReceived(info->to());
-            if (info->todoId() != -1) {
-                auto job = new FollowUpReminderFinishTaskJob(info->todoId(), this);
-                connect(job, &FollowUpReminderFinishTaskJob::finishTaskDone, this, &FollowUpReminderManager::slotFinishTaskDone);
-                connect(job, &FollowUpReminderFinishTaskJob::finishTaskFailed, this, &FollowUpReminderManager::slotFinishTaskFailed);
-                job->start();
-            }
-            // Save item
-            FollowUpReminder::FollowUpReminderUtil::writeFollowupReminderInfo(FollowUpReminder::FollowUpReminderUtil::defaultConfig(), info, true);
-            break;
+        qCDebug(FOLLOWUPREMINDERAGENT_LOG) << "FollowUpReminderManager::slotCheckFollowUpFinished info:" << info;
+        info->setAnswerMessageItemId(id);
+        info->setAnswerWasReceived(true);
+        answerReceived(info->to());
+        if (info->todoId() != -1) {
+            auto job = new FollowUpReminderFinishTaskJob(info->todoId(), this);
+            connect(job, &FollowUpReminderFinishTaskJob::finishTaskDone, this, &FollowUpReminderManager::slotFinishTaskDone);
+            connect(job, &FollowUpReminderFinishTaskJob::finishTaskFailed, this, &FollowUpReminderManager::slotFinishTaskFailed);
+            job->start();
         }
+        // Save item, it's no longer waiting for an answer
+        FollowUpReminderStore::self()->insert(*info);
+        mNotifiedReminders.remove(info->uniqueIdentifier());
+        mFollowUpReminderInfoList.removeOne(info);
+        delete info;
     }
 }
 
@@ -7,9 +7,12 @@
 #pragma once
 
 #include <AkonadiCore/Item>
-#include <KSharedConfig>
+#include <QHash>
 #include <QObject>
 #include <QPointer>
+#include <QSet>
+class QTimer;
+class FollowUpReminderJob;
 namespace FollowUpReminder
 {
 class FollowUpReminderInfo;
@@ -23,14 +26,20 @@ public:
     ~FollowUpReminderManager() override;
 
     void load(bool forceReloadConfig = false);
+    void stop();
     void addReminder(FollowUpReminder::FollowUpReminderInfo *reminder); // takes ownership
+    void removeReminders(const QList<qint32> &identifiers);
     void checkFollowUp(const Akonadi::Item &item, const Akonadi::Collection &col);
 
     Q_REQUIRED_RESULT QString printDebugInfo() const;
 
 private:
     Q_DISABLE_COPY(FollowUpReminderManager)
-    void slotCheckFollowUpFinished(const QString &messageId, Akonadi::Item::Id id);
+    void slotCheckFollowUpFinished(const QStringList &answeredMessageIds, Akonadi::Item::Id id);
+    void addToIndex(FollowUpReminder::FollowUpReminderInfo *info);
+    void dropRemovedReminders();
+    void checkDeadlines();
+    void startCheckJob();
 
     void slotFinishTaskDone();
     void slotFinishTaskFailed();
@@ -38,9 +47,16 @@ private:
     void answerReceived(const QString &from);
     Q_REQUIRED_RESULT QString infoToStr(FollowUpReminder::FollowUpReminderInfo *info) const;
 
-    KSharedConfig::Ptr mConfig;
     QList<FollowUpReminder::FollowUpReminderInfo *> mFollowUpReminderInfoList;
+    // Normalized message-id of the reminded messages to their info
+    QHash<QString, FollowUpReminder::FollowUpReminderInfo *> mMessageIdIndex;
     QPointer<FollowUpReminderNoAnswerDialog> mNoAnswerDialog;
-    bool mInitialize = false;
+    // New messages whose envelope still has to be fetched, checked in batches
+    Akonadi::Item::List mPendingItems;
+    QTimer *mCheckTimer = nullptr;
+    QPointer<FollowUpReminderJob> mCheckJob;
+    QTimer *mDeadlineTimer = nullptr;
+    // Reminders already shown in the no answer dialog
+    QSet<qint32> mNotifiedReminders;
 };
 
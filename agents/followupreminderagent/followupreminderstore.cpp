@@ -0,0 +1,317 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "followupreminderstore.h"
+#include "followupreminderagent_debug.h"
+#include "followupreminderinfo.h"
+#include "followupreminderutil.h"
+
+#include <KConfigGroup>
+
+#include <QDataStream>
+#include <QRegularExpression>
+#include <QStandardPaths>
+
+using namespace FollowUpReminder;
+
+namespace
+{
+// "KFRJ", the file format version follows it
+constexpr quint32 JournalMagic = 0x4B46524A;
+constexpr quint32 JournalVersion = 1;
+
+void writeInfo(QDataStream &stream, const FollowUpReminderInfo &info)
+{
+    stream << info.uniqueIdentifier() << info.originalMessageItemId() << info.answerMessageItemId() << info.todoId() << info.messageId()
+           << info.followUpReminderDate() << info.to() << info.subject() << info.answerWasReceived();
+}
+
+FollowUpReminderInfo *readInfo(QDataStream &stream)
+{
+    qint32 identifier;
+    Akonadi::Item::Id originalMessageItemId;
+    Akonadi::Item::Id answerMessageItemId;
+    Akonadi::Item::Id todoId;
+    QString messageId;
+    QDate followUpReminderDate;
+    QString to;
+    QString subject;
+    bool answerWasReceived;
+    stream >> identifier >> originalMessageItemId >> answerMessageItemId >> todoId >> messageId >> followUpReminderDate >> to >> subject >> answerWasReceived;
+    if (stream.status() != QDataStream::Ok) {
+        return nullptr;
+    }
+    auto info = new FollowUpReminderInfo;
+    info->setUniqueIdentifier(identifier);
+    info->setOriginalMessageItemId(originalMessageItemId);
+    info->setAnswerMessageItemId(answerMessageItemId);
+    info->setTodoId(todoId);
+    info->setMessageId(messageId);
+    info->setFollowUpReminderDate(followUpReminderDate);
+    info->setTo(to);
+    info->setSubject(subject);
+    info->setAnswerWasReceived(answerWasReceived);
+    return info;
+}
+}
+
+FollowUpReminderStore::FollowUpReminderStore(const QString &fileName, const KSharedConfig::Ptr &legacyConfig, OpenMode mode)
+    : mJournal(fileName, JournalMagic, JournalVersion, FOLLOWUPREMINDERAGENT_LOG)
+    , mMode(mode)
+{
+    if (mJournal.exists()) {
+        if (!load() && mMode == ReadWrite) {
+            // Drop the damaged tail, later records would be appended after it
+            compact();
+        }
+    } else if (legacyConfig && mMode == ReadWrite) {
+        migrateFromConfig(legacyConfig);
+    }
+}
+
+FollowUpReminderStore::~FollowUpReminderStore()
+{
+    qDeleteAll(mInfos);
+}
+
+FollowUpReminderStore *FollowUpReminderStore::self()
+{
+    static FollowUpReminderStore s_self(defaultFileName(), FollowUpReminderUtil::defaultConfig());
+    return &s_self;
+}
+
+QString FollowUpReminderStore::defaultFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QStringLiteral("/akonadi_followupreminder_agent/followupreminder.journal");
+}
+
+bool FollowUpReminderStore::contains(qint32 identifier) const
+{
+    return mInfos.contains(identifier);
+}
+
+int FollowUpReminderStore::count() const
+{
+    return mInfos.count();
+}
+
+FollowUpReminderInfo *FollowUpReminderStore::info(qint32 identifier) const
+{
+    const FollowUpReminderInfo *info = mInfos.value(identifier);
+    return info ? new FollowUpReminderInfo(*info) : nullptr;
+}
+
+QVector<FollowUpReminderInfo *> FollowUpReminderStore::infos() const
+{
+    QVector<FollowUpReminderInfo *> result;
+    result.reserve(mDeadlines.count());
+    for (const qint32 identifier : mDeadlines) {
+        result.append(new FollowUpReminderInfo(*mInfos.value(identifier)));
+    }
+    return result;
+}
+
+QVector<FollowUpReminderInfo *> FollowUpReminderStore::pendingInfos() const
+{
+    QVector<FollowUpReminderInfo *> result;
+    for (const qint32 identifier : mDeadlines) {
+        const FollowUpReminderInfo *info = mInfos.value(identifier);
+        if (!info->answerWasReceived()) {
+            result.append(new FollowUpReminderInfo(*info));
+        }
+    }
+    return result;
+}
+
+QVector<qint32> FollowUpReminderStore::pendingDueBefore(QDate date) const
+{
+    QVector<qint32> result;
+    for (auto it = mDeadlines.cbegin(), end = mDeadlines.upperBound(date); it != end; ++it) {
+        if (!mInfos.value(it.value())->answerWasReceived()) {
+            result.append(it.value());
+        }
+    }
+    return result;
+}
+
+QDate FollowUpReminderStore::nextDeadlineAfter(QDate date) const
+{
+    for (auto it = mDeadlines.upperBound(date), end = mDeadlines.cend(); it != end; ++it) {
+        if (!mInfos.value(it.value())->answerWasReceived()) {
+            return it.key();
+        }
+    }
+    return QDate();
+}
+
+qint32 FollowUpReminderStore::insert(const FollowUpReminderInfo &info)
+{
+    if (!info.isValid()) {
+        return -1;
+    }
+    auto newInfo = new FollowUpReminderInfo(info);
+    if (newInfo->uniqueIdentifier() < 0) {
+        newInfo->setUniqueIdentifier(mNextIdentifier);
+    }
+    insertInMemory(newInfo);
+    appendRecord(PutRecord, [newInfo](QDataStream &stream) {
+        writeInfo(stream, *newInfo);
+    });
+    return newInfo->uniqueIdentifier();
+}
+
+bool FollowUpReminderStore::remove(qint32 identifier)
+{
+    if (!mInfos.contains(identifier)) {
+        return false;
+    }
+    removeFromMemory(identifier);
+    appendRemoveRecord(identifier);
+    return true;
+}
+
+int FollowUpReminderStore::removeDeadlinesBefore(QDate date)
+{
+    QVector<qint32> identifiers;
+    for (auto it = mDeadlines.cbegin(), end = mDeadlines.lowerBound(date); it != end; ++it) {
+        identifiers.append(it.value());
+    }
+    for (const qint32 identifier : std::as_const(identifiers)) {
+        removeFromMemory(identifier);
+        appendRemoveRecord(identifier);
+    }
+    return identifiers.count();
+}
+
+void FollowUpReminderStore::reload()
+{
+    clearInMemory();
+    if (mJournal.exists() && !load() && mMode == ReadWrite) {
+        compact();
+    }
+}
+
+void FollowUpReminderStore::clearInMemory()
+{
+    qDeleteAll(mInfos);
+    mInfos.clear();
+    mDeadlines.clear();
+    mNextIdentifier = 0;
+}
+
+void FollowUpReminderStore::insertInMemory(FollowUpReminderInfo *info)
+{
+    const qint32 identifier = info->uniqueIdentifier();
+    removeFromMemory(identifier);
+    mInfos.insert(identifier, info);
+    mDeadlines.insert(info->followUpReminderDate(), identifier);
+    mNextIdentifier = qMax(mNextIdentifier, identifier + 1);
+}
+
+void FollowUpReminderStore::removeFromMemory(qint32 identifier)
+{
+    FollowUpReminderInfo *info = mInfos.take(identifier);
+    if (info) {
+        mDeadlines.remove(info->followUpReminderDate(), identifier);
+        delete info;
+    }
+}
+
+bool FollowUpReminderStore::load()
+{
+    return mJournal.replay([this](quint8 type, QDataStream &stream) {
+        if (type == PutRecord) {
+            FollowUpReminderInfo *info = readInfo(stream);
+            if (!info) {
+                return false;
+            }
+            insertInMemory(info);
+            return true;
+        } else if (type == RemoveRecord) {
+            qint32 identifier;
+            stream >> identifier;
+            if (stream.status() != QDataStream::Ok) {
+                return false;
+            }
+            removeFromMemory(identifier);
+            // Never reuse the identifier of a removed reminder
+            mNextIdentifier = qMax(mNextIdentifier, identifier + 1);
+            return true;
+        }
+        return false;
+    });
+}
+
+void FollowUpReminderStore::migrateFromConfig(const KSharedConfig::Ptr &config)
+{
+    const QStringList itemList = config->groupList().filter(QRegularExpression(QStringLiteral("FollowupReminderItem \\d+")));
+    QVector<FollowUpReminderInfo *> withoutIdentifier;
+    for (const QString &groupName : itemList) {
+        auto info = new FollowUpReminderInfo(config->group(groupName));
+        if (!info->isValid()) {
+            delete info;
+        } else if (info->uniqueIdentifier() < 0 || mInfos.contains(info->uniqueIdentifier())) {
+            withoutIdentifier.append(info);
+        } else {
+            insertInMemory(info);
+        }
+    }
+    for (FollowUpReminderInfo *info : std::as_const(withoutIdentifier)) {
+        info->setUniqueIdentifier(mNextIdentifier);
+        insertInMemory(info);
+    }
+    // Also creates the journal when there is nothing to migrate, so that it's done only once
+    if (!compact()) {
+        return;
+    }
+    for (const QString &groupName : itemList) {
+        config->deleteGroup(groupName);
+    }
+    config->group(QStringLiteral("General")).deleteEntry("Number");
+    config->sync();
+    if (!itemList.isEmpty()) {
+        qCDebug(FOLLOWUPREMINDERAGENT_LOG) << "Migrated" << mInfos.count() << "follow up reminders to" << mJournal.fileName();
+    }
+}
+
+void FollowUpReminderStore::appendRemoveRecord(qint32 identifier)
+{
+    appendRecord(RemoveRecord, [identifier](QDataStream &stream) {
+        stream << identifier;
+    });
+}
+
+void FollowUpReminderStore::appendRecord(quint8 type, const JournalFile::ContentWriter &writeContent)
+{
+    if (mMode == ReadOnly) {
+        return;
+    }
+    mJournal.append(type, writeContent);
+    if (mJournal.needsCompaction(mInfos.count())) {
+        compact();
+    }
+}
+
+bool FollowUpReminderStore::compact()
+{
+    if (mMode == ReadOnly) {
+        return false;
+    }
+    return mJournal.rewrite([this](QDataStream &stream) {
+        int recordCount = 0;
+        // Keep a tombstone for the highest identifier, so that it isn't reused after its reminder was dropped
+        if (mNextIdentifier > 0 && !mInfos.contains(mNextIdentifier - 1)) {
+            stream << static_cast<quint8>(RemoveRecord) << (mNextIdentifier - 1);
+            ++recordCount;
+        }
+        for (const FollowUpReminderInfo *info : std::as_const(mInfos)) {
+            stream << static_cast<quint8>(PutRecord);
+            writeInfo(stream, *info);
+            ++recordCount;
+        }
+        return recordCount;
+    });
+}
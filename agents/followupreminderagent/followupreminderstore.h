@@ -0,0 +1,121 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "journalfile.h"
+
+#include <KSharedConfig>
+
+#include <QDate>
+#include <QHash>
+#include <QMultiMap>
+#include <QVector>
+
+namespace FollowUpReminder
+{
+class FollowUpReminderInfo;
+
+/**
+ * Persistent store of the follow up reminders.
+ *
+ * The reminders are kept in memory, indexed by identifier and by deadline.
+ * Every change is appended to a journal file, removed reminders leave a
+ * tombstone record there until the journal is compacted. The reminders used to
+ * be stored as "FollowupReminderItem N" groups of the agent configuration, they
+ * are moved to the journal the first time it is created.
+ */
+class FollowUpReminderStore
+{
+public:
+    enum OpenMode {
+        ReadWrite,
+        /// For other processes than the agent, which owns the journal: changes are only made in memory
+        ReadOnly,
+    };
+
+    /**
+     * Opens the journal @p fileName. If it doesn't exist yet the reminders are
+     * migrated from @p legacyConfig.
+     */
+    explicit FollowUpReminderStore(const QString &fileName, const KSharedConfig::Ptr &legacyConfig = KSharedConfig::Ptr(), OpenMode mode = ReadWrite);
+    ~FollowUpReminderStore();
+
+    static FollowUpReminderStore *self();
+    Q_REQUIRED_RESULT static QString defaultFileName();
+
+    Q_REQUIRED_RESULT bool contains(qint32 identifier) const;
+    Q_REQUIRED_RESULT int count() const;
+
+    /**
+     * Returns a copy of the reminder @p identifier, or nullptr. The caller owns it.
+     */
+    Q_REQUIRED_RESULT FollowUpReminderInfo *info(qint32 identifier) const;
+
+    /**
+     * Returns copies of all reminders, ordered by deadline. The caller owns them.
+     */
+    Q_REQUIRED_RESULT QVector<FollowUpReminderInfo *> infos() const;
+
+    /**
+     * Returns copies of the reminders still waiting for an answer, ordered by
+     * deadline. The caller owns them.
+     */
+    Q_REQUIRED_RESULT QVector<FollowUpReminderInfo *> pendingInfos() const;
+
+    /**
+     * Returns the reminders still waiting for an answer whose deadline is @p date or earlier.
+     */
+    Q_REQUIRED_RESULT QVector<qint32> pendingDueBefore(QDate date) const;
+
+    /**
+     * Returns the first deadline after @p date of a reminder still waiting for
+     * an answer, or an invalid date if there is none.
+     */
+    Q_REQUIRED_RESULT QDate nextDeadlineAfter(QDate date) const;
+
+    /**
+     * Adds or replaces @p info. A new identifier is assigned if it has none.
+     * Returns the identifier, or -1 if @p info is invalid.
+     */
+    qint32 insert(const FollowUpReminderInfo &info);
+    bool remove(qint32 identifier);
+
+    /**
+     * Removes the reminders whose deadline is before @p date, answered or not.
+     * Returns the number of removed reminders.
+     */
+    int removeDeadlinesBefore(QDate date);
+
+    /**
+     * Reads the journal again, for changes made by another process.
+     */
+    void reload();
+
+private:
+    Q_DISABLE_COPY(FollowUpReminderStore)
+    enum RecordType : quint8 {
+        PutRecord = 1,
+        RemoveRecord,
+    };
+
+    void clearInMemory();
+    bool load();
+    void migrateFromConfig(const KSharedConfig::Ptr &config);
+    void insertInMemory(FollowUpReminderInfo *info);
+    void removeFromMemory(qint32 identifier);
+    void appendRemoveRecord(qint32 identifier);
+    void appendRecord(quint8 type, const JournalFile::ContentWriter &writeContent);
+    bool compact();
+
+    JournalFile mJournal;
+    const OpenMode mMode;
+    QHash<qint32, FollowUpReminderInfo *> mInfos;
+    QMultiMap<QDate, qint32> mDeadlines;
+    qint32 mNextIdentifier = 0;
+};
+}
+
@@ -43,6 +43,16 @@ void FollowUpReminder::FollowUpReminderUtil::reload()
     }
 }
 
+bool FollowUpReminder::FollowUpReminderUtil::removeReminders(const QList<qint32> &identifiers)
+{
+    QDBusInterface interface(serviceName(), dbusPath());
+    if (!interface.isValid()) {
+        return false;
+    }
+    const QDBusMessage reply = interface.call(QStringLiteral("removeReminders"), QVariant::fromValue(identifiers));
+    return reply.type() != QDBusMessage::ErrorMessage;
+}
+
 void FollowUpReminder::FollowUpReminderUtil::forceReparseConfiguration()
 {
     FollowUpReminderAgentSettings::self()->save();
@@ -127,3 +137,38 @@ QString FollowUpReminder::FollowUpReminderUtil::followUpReminderPattern()
 {
     return QStringLiteral("FollowupReminderItem %1");
 }
+
+QString FollowUpReminder::FollowUpReminderUtil::normalizedMessageId(const QString &messageId)
+{
+    QString id = messageId.trimmed();
+    if (id.startsWith(QLatin1Char('<')) && id.endsWith(QLatin1Char('>'))) {
+        id = id.mid(1, id.length() - 2);
+    }
+    return id;
+}
+
+QStringList FollowUpReminder::FollowUpReminderUtil::answeredMessageIds(const KMime::Message::Ptr &message)
+{
+    QStringList ids;
+    if (!message) {
+        return ids;
+    }
+    if (auto inReplyTo = message->inReplyTo(false)) {
+        const auto identifiers = inReplyTo->identifiers();
+        for (const QByteArray &identifier : identifiers) {
+            ids.append(normalizedMessageId(QString::fromLatin1(identifier)));
+        }
+    }
+    // Some clients only set References, or put another message in In-Reply-To
+    if (auto references = message->references(false)) {
+        const auto identifiers = references->identifiers();
+        // The last reference is the answered message, most likely
+        for (auto it = identifiers.crbegin(), end = identifiers.crend(); it != end; ++it) {
+            const QString id = normalizedMessageId(QString::fromLatin1(*it));
+            if (!ids.contains(id)) {
+                ids.append(id);
+            }
+        }
+    }
+    return ids;
+}
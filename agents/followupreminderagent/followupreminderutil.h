@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <KMime/Message>
 #include <KSharedConfig>
 
 namespace FollowUpReminder
@@ -21,6 +22,11 @@ Q_REQUIRED_RESULT bool followupReminderAgentEnabled();
 
 void reload();
 
+/**
+ * Asks the agent to remove the reminders @p identifiers. Returns false if it can't be reached.
+ */
+Q_REQUIRED_RESULT bool removeReminders(const QList<qint32> &identifiers);
+
 void forceReparseConfiguration();
 
 KSharedConfig::Ptr defaultConfig();
@@ -30,6 +36,17 @@ void writeFollowupReminderInfo(KSharedConfig::Ptr config, FollowUpReminder::Foll
 Q_REQUIRED_RESULT bool removeFollowupReminderInfo(KSharedConfig::Ptr config, const QList<qint32> &listRemove, bool forceReload = false);
 
 Q_REQUIRED_RESULT QString followUpReminderPattern();
+
+/**
+ * Returns @p messageId without surrounding whitespace and angle brackets.
+ */
+Q_REQUIRED_RESULT QString normalizedMessageId(const QString &messageId);
+
+/**
+ * Returns the normalized ids of the messages @p message answers, from its
+ * In-Reply-To header first and then from its References header.
+ */
+Q_REQUIRED_RESULT QStringList answeredMessageIds(const KMime::Message::Ptr &message);
 }
 }
 
@@ -5,6 +5,7 @@
 */
 
 #include "followupreminderjob.h"
+#include "followupreminderutil.h"
 
 #include <Akonadi/KMime/MessageParts>
 #include <AkonadiCore/ItemFetchJob>
@@ -23,52 +24,79 @@ FollowUpReminderJob::~FollowUpReminderJob() = default;
 
 void FollowUpReminderJob::start()
 {
-    if (!mItem.isValid()) {
-        qCDebug(FOLLOWUPREMINDERAGENT_LOG) << " item is not valid";
-        deleteLater();
+    if (mBatches.isEmpty()) {
+        qCDebug(FOLLOWUPREMINDERAGENT_LOG) << " no item to check";
+        done();
         return;
     }
-    auto job = new Akonadi::ItemFetchJob(mItem);
-    job->fetchScope().fetchPayloadPart(Akonadi::MessagePart::Envelope, true);
-    job->fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
+    fetchNextBatch();
+}
 
-    connect(job, &Akonadi::ItemFetchJob::result, this, &FollowUpReminderJob::slotItemFetchJobDone);
+void FollowUpReminderJob::setItems(const Akonadi::Item::List &items)
+{
+    Akonadi::Item::List validItems;
+    validItems.reserve(items.count());
+    for (const Akonadi::Item &item : items) {
+        if (item.isValid()) {
+            validItems.append(item);
+        } else {
+            qCDebug(FOLLOWUPREMINDERAGENT_LOG) << " item is not valid";
+        }
+    }
+    mBatches.clear();
+    if (!validItems.isEmpty()) {
+        mBatches.append(validItems);
+    }
 }
 
-void FollowUpReminderJob::setItem(const Akonadi::Item &item)
+void FollowUpReminderJob::fetchNextBatch()
 {
-    mItem = item;
+    if (mBatches.isEmpty()) {
+        done();
+        return;
+    }
+    mCurrentBatch = mBatches.takeFirst();
+    auto job = new Akonadi::ItemFetchJob(mCurrentBatch);
+    job->fetchScope().fetchPayloadPart(Akonadi::MessagePart::Envelope, true);
+    job->fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
+
+    connect(job, &Akonadi::ItemFetchJob::result, this, &FollowUpReminderJob::slotItemFetchJobDone);
 }
 
 void FollowUpReminderJob::slotItemFetchJobDone(KJob *job)
 {
     if (job->error()) {
-        qCCritical(FOLLOWUPREMINDERAGENT_LOG) << "Error while fetching item. " << job->error() << job->errorString();
-        deleteLater();
+        // One removed message makes the whole fetch fail, split the batch to check the other ones
+        if (mCurrentBatch.count() > 1) {
+            const int half = mCurrentBatch.count() / 2;
+            mBatches.prepend(mCurrentBatch.mid(half));
+            mBatches.prepend(mCurrentBatch.mid(0, half));
+        } else {
+            qCCritical(FOLLOWUPREMINDERAGENT_LOG) << "Error while fetching item. " << job->error() << job->errorString();
+        }
+        fetchNextBatch();
         return;
     }
 
-    const Akonadi::ItemFetchJob *fetchJob = qobject_cast<Akonadi::ItemFetchJob *>(job);
-
-    const Akonadi::Item::List items = fetchJob->items();
+    const Akonadi::Item::List items = qobject_cast<Akonadi::ItemFetchJob *>(job)->items();
     if (items.isEmpty()) {
         qCCritical(FOLLOWUPREMINDERAGENT_LOG) << "Error while fetching item: item not found";
-        deleteLater();
-        return;
     }
-    const Akonadi::Item item = items.at(0);
-    if (!item.hasPayload<KMime::Message::Ptr>()) {
-        qCCritical(FOLLOWUPREMINDERAGENT_LOG) << "Item has not payload";
-        deleteLater();
-        return;
-    }
-    const auto msg = item.payload<KMime::Message::Ptr>();
-    if (msg) {
-        KMime::Headers::InReplyTo *replyTo = msg->inReplyTo(false);
-        if (replyTo) {
-            const QString replyToIdStr = replyTo->asUnicodeString();
-            Q_EMIT finished(replyToIdStr, item.id());
+    for (const Akonadi::Item &item : items) {
+        if (!item.hasPayload<KMime::Message::Ptr>()) {
+            qCCritical(FOLLOWUPREMINDERAGENT_LOG) << "Item has not payload";
+            continue;
+        }
+        const QStringList answeredMessageIds = FollowUpReminder::FollowUpReminderUtil::answeredMessageIds(item.payload<KMime::Message::Ptr>());
+        if (!answeredMessageIds.isEmpty()) {
+            Q_EMIT finished(answeredMessageIds, item.id());
         }
     }
+    fetchNextBatch();
+}
+
+void FollowUpReminderJob::done()
+{
+    Q_EMIT allItemsChecked();
     deleteLater();
 }
@@ -7,9 +7,14 @@
 #pragma once
 
 #include <QObject>
+#include <QVector>
 
 #include <AkonadiCore/Item>
 
+/**
+ * Fetches the envelopes of a batch of new messages and reports the messages
+ * they answer. The job deletes itself once done.
+ */
 class FollowUpReminderJob : public QObject
 {
     Q_OBJECT
@@ -17,16 +22,20 @@ public:
     explicit FollowUpReminderJob(QObject *parent = nullptr);
     ~FollowUpReminderJob() override;
 
-    void setItem(const Akonadi::Item &item);
+    void setItems(const Akonadi::Item::List &items);
 
     void start();
 
 Q_SIGNALS:
-    void finished(const QString &messageId, Akonadi::Item::Id id);
+    void finished(const QStringList &answeredMessageIds, Akonadi::Item::Id id);
+    void allItemsChecked();
 
 private:
     Q_DISABLE_COPY(FollowUpReminderJob)
+    void fetchNextBatch();
     void slotItemFetchJobDone(KJob *job);
-    Akonadi::Item mItem;
+    void done();
+    QVector<Akonadi::Item::List> mBatches;
+    Akonadi::Item::List mCurrentBatch;
 };
 
@@ -0,0 +1,220 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "filterprefiltertest.h"
+#include "filterprefilter.h"
+
+#include <AkonadiCore/Item>
+#include <MailCommon/MailFilter>
+#include <MailCommon/SearchPattern>
+
+#include <QTest>
+
+using namespace MailCommon;
+
+namespace
+{
+MailFilter *createFilter(SearchPattern::Operator op, const QVector<SearchRule::Ptr> &rules)
+{
+    auto filter = new MailFilter;
+    filter->pattern()->setOp(op);
+    for (const SearchRule::Ptr &rule : rules) {
+        filter->pattern()->append(rule);
+    }
+    return filter;
+}
+
+SearchRule::Ptr rule(const char *field, SearchRule::Function function, const QString &contents)
+{
+    return SearchRule::createInstance(field, function, contents);
+}
+
+KMime::Message::Ptr createMessage(const QByteArray &headers)
+{
+    KMime::Message::Ptr message(new KMime::Message);
+    message->setContent(headers + "\n\nbody\n");
+    message->parse();
+    return message;
+}
+
+Akonadi::Item createItem(const KMime::Message::Ptr &message)
+{
+    Akonadi::Item item;
+    item.setMimeType(KMime::Message::mimeType());
+    item.setPayload<KMime::Message::Ptr>(message);
+    return item;
+}
+
+// Owns the filters and keeps the prefilter built from them
+class Filters
+{
+public:
+    explicit Filters(const QVector<MailFilter *> &filters)
+        : mFilters(filters)
+    {
+        mPrefilter.build(mFilters);
+    }
+
+    ~Filters()
+    {
+        mPrefilter.clear();
+        qDeleteAll(mFilters);
+    }
+
+    bool mayMatch(int filterIndex, const KMime::Message::Ptr &message) const
+    {
+        return mPrefilter.mayMatch(mPrefilter.candidates(message), mFilters.at(filterIndex));
+    }
+
+    const QVector<MailFilter *> &filters() const
+    {
+        return mFilters;
+    }
+
+    const FilterPrefilter &prefilter() const
+    {
+        return mPrefilter;
+    }
+
+private:
+    QVector<MailFilter *> mFilters;
+    FilterPrefilter mPrefilter;
+};
+}
+
+QTEST_GUILESS_MAIN(FilterPrefilterTest)
+
+FilterPrefilterTest::FilterPrefilterTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void FilterPrefilterTest::shouldAlwaysReportUnindexedFilters()
+{
+    const Filters filters({
+        createFilter(SearchPattern::OpAnd, {}),
+        createFilter(SearchPattern::OpAll, {rule("subject", SearchRule::FuncContains, QStringLiteral("foo"))}),
+        createFilter(SearchPattern::OpOr,
+                     {rule("subject", SearchRule::FuncContains, QStringLiteral("foo")),
+                      rule("from", SearchRule::FuncRegExp, QStringLiteral("^bar.*"))}),
+        createFilter(SearchPattern::OpAnd, {rule("subject", SearchRule::FuncContainsNot, QStringLiteral("foo"))}),
+        createFilter(SearchPattern::OpAnd, {rule("<recipients>", SearchRule::FuncContains, QStringLiteral("foo"))}),
+    });
+
+    const KMime::Message::Ptr message = createMessage("Subject: nothing\nFrom: someone@example.org");
+    for (int i = 0; i < filters.filters().count(); ++i) {
+        QVERIFY2(filters.mayMatch(i, message), qPrintable(QString::number(i)));
+    }
+}
+
+void FilterPrefilterTest::shouldSkipFiltersWithoutTerms()
+{
+    const Filters filters({
+        createFilter(SearchPattern::OpAnd, {rule("subject", SearchRule::FuncContains, QStringLiteral("invoice"))}),
+        createFilter(SearchPattern::OpAnd, {rule("from", SearchRule::FuncEquals, QStringLiteral("boss@example.org"))}),
+        createFilter(SearchPattern::OpAnd, {rule("subject", SearchRule::FuncStartWith, QStringLiteral("[kde]"))}),
+    });
+
+    const KMime::Message::Ptr message = createMessage("Subject: holiday pictures\nFrom: friend@example.org");
+    QVERIFY(!filters.mayMatch(0, message));
+    QVERIFY(!filters.mayMatch(1, message));
+    QVERIFY(!filters.mayMatch(2, message));
+
+    // a term of one header doesn't make a filter on another header a candidate
+    const KMime::Message::Ptr otherHeader = createMessage("Subject: boss@example.org\nFrom: friend@example.org");
+    QVERIFY(!filters.mayMatch(1, otherHeader));
+
+    // filters unknown to the prefilter are always evaluated
+    MailFilter unknown;
+    QVERIFY(filters.prefilter().mayMatch(filters.prefilter().candidates(message), &unknown));
+}
+
+void FilterPrefilterTest::shouldMatchCaseInsensitively()
+{
+    const Filters filters({
+        createFilter(SearchPattern::OpAnd, {rule("subject", SearchRule::FuncContains, QStringLiteral("URGENT"))}),
+        createFilter(SearchPattern::OpAnd, {rule("From", SearchRule::FuncEndWith, QStringLiteral("@Example.ORG"))}),
+    });
+
+    const KMime::Message::Ptr message = createMessage("Subject: Re: urgent request\nFrom: someone@example.org");
+    QVERIFY(filters.mayMatch(0, message));
+    QVERIFY(filters.mayMatch(1, message));
+}
+
+void FilterPrefilterTest::shouldRequireAllTermsOfAndPatterns()
+{
+    const Filters filters({
+        createFilter(SearchPattern::OpAnd,
+                     {rule("subject", SearchRule::FuncContains, QStringLiteral("report")),
+                      rule("from", SearchRule::FuncContains, QStringLiteral("monitoring")),
+                      // not indexable, only evaluated on the candidates
+                      rule("to", SearchRule::FuncRegExp, QStringLiteral("admin.*"))}),
+    });
+
+    QVERIFY(filters.mayMatch(0, createMessage("Subject: daily report\nFrom: monitoring@example.org")));
+    QVERIFY(!filters.mayMatch(0, createMessage("Subject: daily report\nFrom: someone@example.org")));
+    QVERIFY(!filters.mayMatch(0, createMessage("Subject: hello\nFrom: monitoring@example.org")));
+}
+
+void FilterPrefilterTest::shouldRequireOneTermOfOrPatterns()
+{
+    const Filters filters({
+        createFilter(SearchPattern::OpOr,
+                     {rule("subject", SearchRule::FuncContains, QStringLiteral("report")),
+                      rule("from", SearchRule::FuncContains, QStringLiteral("monitoring"))}),
+    });
+
+    QVERIFY(filters.mayMatch(0, createMessage("Subject: daily report\nFrom: someone@example.org")));
+    QVERIFY(filters.mayMatch(0, createMessage("Subject: hello\nFrom: monitoring@example.org")));
+    QVERIFY(!filters.mayMatch(0, createMessage("Subject: hello\nFrom: someone@example.org")));
+}
+
+void FilterPrefilterTest::shouldReportSupersetOfMatches_data()
+{
+    QTest::addColumn<QByteArray>("headers");
+    QTest::newRow("plain") << QByteArray("Subject: daily report\nFrom: monitoring@example.org\nTo: admin@example.org");
+    QTest::newRow("upper case") << QByteArray("Subject: DAILY REPORT\nFrom: Monitoring@Example.org\nTo: Admin@example.org");
+    QTest::newRow("overlapping terms") << QByteArray("Subject: reporting the reports\nFrom: monmonitoring@example.org");
+    QTest::newRow("encoded") << QByteArray("Subject: =?UTF-8?Q?caf=C3=A9_report?=\nFrom: =?UTF-8?Q?Ren=C3=A9?= <rene@example.org>");
+    QTest::newRow("no match") << QByteArray("Subject: holiday pictures\nFrom: friend@example.net");
+    QTest::newRow("missing headers") << QByteArray("X-Spam-Flag: YES");
+}
+
+void FilterPrefilterTest::shouldReportSupersetOfMatches()
+{
+    QFETCH(QByteArray, headers);
+
+    const Filters filters({
+        createFilter(SearchPattern::OpAnd, {rule("subject", SearchRule::FuncContains, QStringLiteral("report"))}),
+        createFilter(SearchPattern::OpAnd, {rule("subject", SearchRule::FuncContains, QStringLiteral("Café"))}),
+        createFilter(SearchPattern::OpAnd, {rule("subject", SearchRule::FuncEquals, QStringLiteral("daily report"))}),
+        createFilter(SearchPattern::OpAnd, {rule("subject", SearchRule::FuncStartWith, QStringLiteral("reporting"))}),
+        createFilter(SearchPattern::OpAnd, {rule("from", SearchRule::FuncEndWith, QStringLiteral("example.org"))}),
+        createFilter(SearchPattern::OpAnd,
+                     {rule("subject", SearchRule::FuncContains, QStringLiteral("report")),
+                      rule("from", SearchRule::FuncContains, QStringLiteral("monitoring"))}),
+        createFilter(SearchPattern::OpOr,
+                     {rule("subject", SearchRule::FuncContains, QStringLiteral("pictures")),
+                      rule("to", SearchRule::FuncContains, QStringLiteral("admin"))}),
+        createFilter(SearchPattern::OpAnd,
+                     {rule("subject", SearchRule::FuncContains, QStringLiteral("report")),
+                      rule("to", SearchRule::FuncRegExp, QStringLiteral("^admin@"))}),
+        createFilter(SearchPattern::OpOr, {rule("subject", SearchRule::FuncRegExp, QStringLiteral("rep.rt"))}),
+        createFilter(SearchPattern::OpAnd, {rule("subject", SearchRule::FuncContainsNot, QStringLiteral("report"))}),
+        createFilter(SearchPattern::OpAnd, {rule("x-spam-flag", SearchRule::FuncContains, QStringLiteral("yes"))}),
+        createFilter(SearchPattern::OpAnd, {rule("<recipients>", SearchRule::FuncContains, QStringLiteral("admin"))}),
+    });
+
+    const KMime::Message::Ptr message = createMessage(headers);
+    const Akonadi::Item item = createItem(message);
+    const QBitArray candidates = filters.prefilter().candidates(message);
+    for (int i = 0; i < filters.filters().count(); ++i) {
+        const MailFilter *filter = filters.filters().at(i);
+        if (filter->pattern()->matches(item)) {
+            QVERIFY2(filters.prefilter().mayMatch(candidates, filter), qPrintable(QStringLiteral("filter %1 matches but was skipped").arg(i)));
+        }
+    }
+}
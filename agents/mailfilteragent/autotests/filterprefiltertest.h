@@ -0,0 +1,25 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+
+class FilterPrefilterTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FilterPrefilterTest(QObject *parent = nullptr);
+
+private Q_SLOTS:
+    void shouldAlwaysReportUnindexedFilters();
+    void shouldSkipFiltersWithoutTerms();
+    void shouldMatchCaseInsensitively();
+    void shouldRequireAllTermsOfAndPatterns();
+    void shouldRequireOneTermOfOrPatterns();
+    void shouldReportSupersetOfMatches_data();
+    void shouldReportSupersetOfMatches();
+};
@@ -0,0 +1,188 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "filterstatisticstest.h"
+#include "filterstatistics.h"
+
+#include <MailCommon/MailFilter>
+#include <MailCommon/SearchPattern>
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTest>
+
+#include <memory>
+
+using namespace MailCommon;
+
+namespace
+{
+MailFilter *createFilter(const QString &name)
+{
+    auto filter = new MailFilter;
+    filter->pattern()->setName(name);
+    return filter;
+}
+
+QJsonObject counters(const FilterStatistics &statistics, const QString &identifier)
+{
+    const QJsonArray filters = QJsonDocument::fromJson(statistics.toJson()).array();
+    for (const QJsonValue &value : filters) {
+        const QJsonObject obj = value.toObject();
+        if (obj.value(QLatin1String("identifier")).toString() == identifier) {
+            return obj;
+        }
+    }
+    return {};
+}
+}
+
+QTEST_GUILESS_MAIN(FilterStatisticsTest)
+
+FilterStatisticsTest::FilterStatisticsTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void FilterStatisticsTest::shouldBeEmpty()
+{
+    FilterStatistics statistics;
+    QVERIFY(QJsonDocument::fromJson(statistics.toJson()).array().isEmpty());
+}
+
+void FilterStatisticsTest::shouldCountEvents()
+{
+    std::unique_ptr<MailFilter> first(createFilter(QStringLiteral("first")));
+    std::unique_ptr<MailFilter> second(createFilter(QStringLiteral("second")));
+    FilterStatistics statistics;
+    statistics.setFilters({first.get(), second.get()});
+
+    const int slot = statistics.slot(first.get());
+    QVERIFY(slot >= 0);
+    QVERIFY(statistics.slot(second.get()) != slot);
+    QCOMPARE(statistics.filterSlots({second.get(), first.get()}), QVector<int>({statistics.slot(second.get()), slot}));
+
+    statistics.recordEvaluation(slot, true, 3000);
+    statistics.recordEvaluation(slot, false, 5000);
+    statistics.recordSkipped(slot);
+    statistics.recordSkipped(slot);
+    statistics.recordSkipped(slot);
+    statistics.recordActionsExecuted(slot);
+
+    const QJsonObject obj = counters(statistics, first->identifier());
+    QCOMPARE(obj.value(QLatin1String("name")).toString(), QStringLiteral("first"));
+    QCOMPARE(obj.value(QLatin1String("evaluations")).toInt(), 2);
+    QCOMPARE(obj.value(QLatin1String("matches")).toInt(), 1);
+    QCOMPARE(obj.value(QLatin1String("skippedByPrefilter")).toInt(), 3);
+    QCOMPARE(obj.value(QLatin1String("actionsExecuted")).toInt(), 1);
+    QCOMPARE(obj.value(QLatin1String("totalMatchTimeUSecs")).toInt(), 8);
+
+    const QJsonObject untouched = counters(statistics, second->identifier());
+    QCOMPARE(untouched.value(QLatin1String("name")).toString(), QStringLiteral("second"));
+    QCOMPARE(untouched.value(QLatin1String("evaluations")).toInt(), 0);
+    QCOMPARE(untouched.value(QLatin1String("skippedByPrefilter")).toInt(), 0);
+}
+
+void FilterStatisticsTest::shouldIgnoreUnknownFilters()
+{
+    std::unique_ptr<MailFilter> known(createFilter(QStringLiteral("known")));
+    std::unique_ptr<MailFilter> unknown(createFilter(QStringLiteral("unknown")));
+    FilterStatistics statistics;
+    statistics.setFilters({known.get()});
+
+    QCOMPARE(statistics.slot(unknown.get()), -1);
+    statistics.recordEvaluation(-1, true, 1000);
+    statistics.recordSkipped(-1);
+    statistics.recordActionsExecuted(-1);
+
+    QCOMPARE(QJsonDocument::fromJson(statistics.toJson()).array().count(), 1);
+    QCOMPARE(counters(statistics, known->identifier()).value(QLatin1String("evaluations")).toInt(), 0);
+}
+
+void FilterStatisticsTest::shouldKeepCountersWhenFiltersAreReloaded()
+{
+    std::unique_ptr<MailFilter> kept(createFilter(QStringLiteral("kept")));
+    std::unique_ptr<MailFilter> removed(createFilter(QStringLiteral("removed")));
+    FilterStatistics statistics;
+    statistics.setFilters({kept.get(), removed.get()});
+    statistics.recordEvaluation(statistics.slot(kept.get()), true, 1000);
+    statistics.recordEvaluation(statistics.slot(removed.get()), true, 1000);
+
+    // Reloading the configuration creates new filter objects with the same identifiers
+    std::unique_ptr<MailFilter> reloaded(new MailFilter(*kept));
+    reloaded->pattern()->setName(QStringLiteral("renamed"));
+    std::unique_ptr<MailFilter> added(createFilter(QStringLiteral("added")));
+    const int oldSlot = statistics.slot(kept.get());
+    // FilterManager::readConfig() drops the old filters first
+    statistics.setFilters({});
+    QCOMPARE(statistics.slot(kept.get()), -1);
+    statistics.setFilters({added.get(), reloaded.get()});
+
+    QCOMPARE(statistics.slot(reloaded.get()), oldSlot);
+    QCOMPARE(statistics.slot(kept.get()), -1);
+    QCOMPARE(statistics.slot(removed.get()), -1);
+    QVERIFY(statistics.slot(added.get()) >= 0);
+    QVERIFY(statistics.slot(added.get()) != oldSlot);
+
+    statistics.recordEvaluation(statistics.slot(reloaded.get()), false, 1000);
+    const QJsonObject obj = counters(statistics, kept->identifier());
+    QCOMPARE(obj.value(QLatin1String("name")).toString(), QStringLiteral("renamed"));
+    QCOMPARE(obj.value(QLatin1String("evaluations")).toInt(), 2);
+    QCOMPARE(obj.value(QLatin1String("matches")).toInt(), 1);
+    // the counters of a removed filter are still reported
+    QCOMPARE(counters(statistics, removed->identifier()).value(QLatin1String("evaluations")).toInt(), 1);
+    QCOMPARE(counters(statistics, added->identifier()).value(QLatin1String("evaluations")).toInt(), 0);
+}
+
+void FilterStatisticsTest::shouldClearCounters()
+{
+    std::unique_ptr<MailFilter> filter(createFilter(QStringLiteral("filter")));
+    FilterStatistics statistics;
+    statistics.setFilters({filter.get()});
+    const int slot = statistics.slot(filter.get());
+    statistics.recordEvaluation(slot, true, 1000);
+    statistics.recordSkipped(slot);
+    statistics.recordActionsExecuted(slot);
+
+    statistics.clear();
+    QCOMPARE(statistics.slot(filter.get()), slot);
+    QJsonObject obj = counters(statistics, filter->identifier());
+    QCOMPARE(obj.value(QLatin1String("name")).toString(), QStringLiteral("filter"));
+    QCOMPARE(obj.value(QLatin1String("evaluations")).toInt(), 0);
+    QCOMPARE(obj.value(QLatin1String("matches")).toInt(), 0);
+    QCOMPARE(obj.value(QLatin1String("skippedByPrefilter")).toInt(), 0);
+    QCOMPARE(obj.value(QLatin1String("actionsExecuted")).toInt(), 0);
+    QCOMPARE(obj.value(QLatin1String("totalMatchTimeUSecs")).toInt(), 0);
+    QCOMPARE(obj.value(QLatin1String("p99MatchTimeUSecs")).toInt(), 0);
+
+    // the slot is still usable
+    statistics.recordEvaluation(slot, true, 1000);
+    obj = counters(statistics, filter->identifier());
+    QCOMPARE(obj.value(QLatin1String("evaluations")).toInt(), 1);
+}
+
+void FilterStatisticsTest::shouldComputePercentile()
+{
+    std::unique_ptr<MailFilter> filter(createFilter(QStringLiteral("filter")));
+    FilterStatistics statistics;
+    statistics.setFilters({filter.get()});
+    const int slot = statistics.slot(filter.get());
+    for (int i = 100; i >= 1; --i) {
+        statistics.recordEvaluation(slot, false, i * 1000);
+    }
+    QJsonObject obj = counters(statistics, filter->identifier());
+    QCOMPARE(obj.value(QLatin1String("p99MatchTimeUSecs")).toInt(), 100);
+    QCOMPARE(obj.value(QLatin1String("totalMatchTimeUSecs")).toInt(), 5050);
+
+    // only the most recent evaluations are kept for the percentile
+    for (int i = 0; i < 2000; ++i) {
+        statistics.recordEvaluation(slot, false, 1000);
+    }
+    obj = counters(statistics, filter->identifier());
+    QCOMPARE(obj.value(QLatin1String("p99MatchTimeUSecs")).toInt(), 1);
+    QCOMPARE(obj.value(QLatin1String("evaluations")).toInt(), 2100);
+}
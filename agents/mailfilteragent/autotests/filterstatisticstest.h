@@ -0,0 +1,24 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+
+class FilterStatisticsTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FilterStatisticsTest(QObject *parent = nullptr);
+
+private Q_SLOTS:
+    void shouldBeEmpty();
+    void shouldCountEvents();
+    void shouldIgnoreUnknownFilters();
+    void shouldKeepCountersWhenFiltersAreReloaded();
+    void shouldClearCounters();
+    void shouldComputePercentile();
+};
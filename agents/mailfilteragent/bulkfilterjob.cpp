@@ -0,0 +1,373 @@
+/*
+    SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "bulkfilterjob.h"
+
+#include "mailfilteragent_debug.h"
+#include <Akonadi/KMime/MessageParts>
+#include <AkonadiCore/itemfetchjob.h>
+#include <AkonadiCore/itemfetchscope.h>
+#include <KConfigGroup>
+#include <KLocalizedString>
+#include <KSharedConfig>
+
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTimer>
+
+#include <algorithm>
+
+static const char myConfigGroupName[] = "BulkFilter";
+
+namespace
+{
+constexpr int ChunkSize = 200;
+// The checkpoint is written to disk at most this often while filtering a collection
+constexpr int CheckpointSyncInterval = 5000;
+
+QString taskGroupName(int index)
+{
+    return QStringLiteral("BulkFilterTask %1").arg(index);
+}
+}
+
+BulkFilterJob::BulkFilterJob(FilterManager *filterManager, QObject *parent)
+    : QObject(parent)
+    , mFilterManager(filterManager)
+{
+    KConfigGroup group(KSharedConfig::openConfig(), myConfigGroupName);
+    mPaused = group.readEntry("Paused", false);
+    mMaximumItemsPerSecond = group.readEntry("MaximumItemsPerSecond", 0);
+
+    mCheckpointTimer.setSingleShot(true);
+    mCheckpointTimer.setInterval(CheckpointSyncInterval);
+    connect(&mCheckpointTimer, &QTimer::timeout, this, &BulkFilterJob::syncCheckpoint);
+}
+
+BulkFilterJob::~BulkFilterJob()
+{
+    if (mCheckpointTimer.isActive()) {
+        syncCheckpoint();
+    }
+}
+
+void BulkFilterJob::addCollections(const QList<qint64> &collections, const QStringList &listFilters, FilterManager::FilterSet filterSet)
+{
+    for (qint64 id : collections) {
+        Task task;
+        task.collectionId = id;
+        task.listFilters = listFilters;
+        task.filterSet = filterSet;
+        mTasks.append(task);
+    }
+    saveTasks();
+    startNextTask();
+}
+
+void BulkFilterJob::restore()
+{
+    KSharedConfig::Ptr config = KSharedConfig::openStateConfig();
+    // saveTasks() always numbers the tasks from 0 in queue order
+    for (int i = 0; config->hasGroup(taskGroupName(i)); ++i) {
+        KConfigGroup group = config->group(taskGroupName(i));
+        Task task;
+        task.collectionId = group.readEntry("Collection", Akonadi::Collection::Id(-1));
+        task.listFilters = group.readEntry("Filters", QStringList());
+        task.filterSet = static_cast<FilterManager::FilterSet>(group.readEntry("FilterSet", static_cast<int>(FilterManager::Explicit)));
+        task.lastItemId = group.readEntry("LastItemId", Akonadi::Item::Id(-1));
+        if (task.collectionId >= 0) {
+            mTasks.append(task);
+        }
+    }
+    if (!mTasks.isEmpty()) {
+        qCDebug(MAILFILTERAGENT_LOG) << "Resuming filtering of" << mTasks.count() << "collections";
+        QTimer::singleShot(0, this, &BulkFilterJob::startNextTask);
+    }
+}
+
+void BulkFilterJob::pause()
+{
+    mPaused = true;
+    saveSettings();
+    if (mCheckpointTimer.isActive()) {
+        syncCheckpoint();
+    }
+}
+
+void BulkFilterJob::resume()
+{
+    mPaused = false;
+    saveSettings();
+    startNextTask();
+}
+
+void BulkFilterJob::cancel()
+{
+    if (mCurrentJob) {
+        mCurrentJob->kill();
+        mCurrentJob = nullptr;
+    }
+    mTasks.clear();
+    mPendingItems.clear();
+    mTaskListed = false;
+    mListedItemCount = 0;
+    mProcessedItemCount = 0;
+    mSkippedItemCount = 0;
+    mChunkSizeLimit = 0;
+    mFailedChunkEnd = -1;
+    mPaused = false;
+    saveSettings();
+    saveTasks();
+    Q_EMIT progressMessage(QString());
+    Q_EMIT percent(0);
+}
+
+bool BulkFilterJob::isPaused() const
+{
+    return mPaused;
+}
+
+void BulkFilterJob::setMaximumItemsPerSecond(int itemsPerSecond)
+{
+    mMaximumItemsPerSecond = qMax(0, itemsPerSecond);
+    saveSettings();
+}
+
+int BulkFilterJob::maximumItemsPerSecond() const
+{
+    return mMaximumItemsPerSecond;
+}
+
+void BulkFilterJob::startNextTask()
+{
+    if (mPaused || mCurrentJob || mScheduled || mTasks.isEmpty()) {
+        return;
+    }
+    if (mTaskListed) {
+        fetchNextChunk();
+        return;
+    }
+
+    // only list the items, the payload is fetched chunk by chunk
+    auto job = new Akonadi::ItemFetchJob(Akonadi::Collection(mTasks.constFirst().collectionId), this);
+    job->fetchScope().setFetchModificationTime(false);
+    job->fetchScope().setFetchRemoteIdentification(false);
+    connect(job, &Akonadi::ItemFetchJob::result, this, &BulkFilterJob::slotItemsListed);
+    mCurrentJob = job;
+}
+
+void BulkFilterJob::slotItemsListed(KJob *job)
+{
+    mCurrentJob = nullptr;
+    if (job->error()) {
+        qCWarning(MAILFILTERAGENT_LOG) << "Unable to list collection" << mTasks.constFirst().collectionId << job->errorString();
+        finishTask();
+        startNextTask();
+        return;
+    }
+
+    const Akonadi::Item::Id lastItemId = mTasks.constFirst().lastItemId;
+    const Akonadi::Item::List items = qobject_cast<Akonadi::ItemFetchJob *>(job)->items();
+    mPendingItems.clear();
+    mPendingItems.reserve(items.count());
+    for (const Akonadi::Item &item : items) {
+        if (item.id() > lastItemId) {
+            mPendingItems.append(item);
+        }
+    }
+    std::sort(mPendingItems.begin(), mPendingItems.end(), [](const Akonadi::Item &lhs, const Akonadi::Item &rhs) {
+        return lhs.id() < rhs.id();
+    });
+    mListedItemCount = mPendingItems.count();
+    mProcessedItemCount = 0;
+    mSkippedItemCount = 0;
+    mChunkSizeLimit = 0;
+    mFailedChunkEnd = -1;
+    mTaskListed = true;
+    fetchNextChunk();
+}
+
+void BulkFilterJob::fetchNextChunk()
+{
+    if (mPendingItems.isEmpty()) {
+        finishTask();
+        startNextTask();
+        return;
+    }
+    if (mPaused) {
+        return;
+    }
+
+    const Task &task = mTasks.constFirst();
+    int chunkSize = (mMaximumItemsPerSecond > 0) ? qMin(ChunkSize, mMaximumItemsPerSecond) : ChunkSize;
+    if (mChunkSizeLimit > 0) {
+        chunkSize = qMin(chunkSize, mChunkSizeLimit);
+    }
+    const MailCommon::SearchRule::RequiredPart requiredPart = mFilterManager->requiredPartForFilters(task.listFilters);
+
+    auto job = new Akonadi::ItemFetchJob(mPendingItems.mid(0, chunkSize), this);
+    if (requiredPart == MailCommon::SearchRule::CompleteMessage) {
+        job->fetchScope().fetchFullPayload(true);
+    } else if (requiredPart == MailCommon::SearchRule::Header) {
+        job->fetchScope().fetchPayloadPart(Akonadi::MessagePart::Header, true);
+    } else {
+        job->fetchScope().fetchPayloadPart(Akonadi::MessagePart::Envelope, true);
+    }
+    job->fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
+    job->setProperty("chunkSize", qMin(chunkSize, mPendingItems.count()));
+    job->setProperty("needsFullPayload", requiredPart != MailCommon::SearchRule::Envelope);
+    job->setProperty("startTime", QDateTime::currentMSecsSinceEpoch());
+    connect(job, &Akonadi::ItemFetchJob::result, this, &BulkFilterJob::slotChunkFetched);
+    mCurrentJob = job;
+}
+
+void BulkFilterJob::slotChunkFetched(KJob *job)
+{
+    mCurrentJob = nullptr;
+    Task &task = mTasks.first();
+    const int chunkSize = job->property("chunkSize").toInt();
+    if (job->error()) {
+        // Most likely some of the items were removed in the meantime. Fetch the
+        // chunk again in halves, down to single items, and only skip those.
+        qCWarning(MAILFILTERAGENT_LOG) << "Unable to fetch" << chunkSize << "items of collection" << task.collectionId << job->errorString();
+        if (chunkSize > 1) {
+            mChunkSizeLimit = chunkSize / 2;
+            mFailedChunkEnd = qMax(mFailedChunkEnd, mPendingItems.at(chunkSize - 1).id());
+            scheduleNextChunk(0);
+            return;
+        }
+        qCWarning(MAILFILTERAGENT_LOG) << "Skipping item" << mPendingItems.constFirst().id();
+        ++mSkippedItemCount;
+    } else {
+        const Akonadi::Item::List items = qobject_cast<Akonadi::ItemFetchJob *>(job)->items();
+        mFilterManager->applySpecificFiltersOnFetchedItems(items, job->property("needsFullPayload").toBool(), task.listFilters, task.filterSet);
+    }
+
+    task.lastItemId = mPendingItems.at(chunkSize - 1).id();
+    mPendingItems.remove(0, chunkSize);
+    mProcessedItemCount += chunkSize;
+    if (task.lastItemId >= mFailedChunkEnd) {
+        mChunkSizeLimit = 0;
+        mFailedChunkEnd = -1;
+    }
+    saveCheckpoint();
+
+    if (mSkippedItemCount > 0) {
+        Q_EMIT progressMessage(i18n("Filtering messages: %1 of %2, %3 could not be fetched", mProcessedItemCount, mListedItemCount, mSkippedItemCount));
+    } else {
+        Q_EMIT progressMessage(i18n("Filtering messages: %1 of %2", mProcessedItemCount, mListedItemCount));
+    }
+    Q_EMIT percent(mProcessedItemCount * 100 / mListedItemCount);
+
+    int delay = 0;
+    if (mMaximumItemsPerSecond > 0) {
+        const qint64 elapsed = QDateTime::currentMSecsSinceEpoch() - job->property("startTime").toLongLong();
+        delay = qMax<qint64>(0, (chunkSize * 1000LL) / mMaximumItemsPerSecond - elapsed);
+    }
+    scheduleNextChunk(delay);
+}
+
+void BulkFilterJob::scheduleNextChunk(int delay)
+{
+    mScheduled = true;
+    QTimer::singleShot(delay, this, [this]() {
+        mScheduled = false;
+        startNextTask();
+    });
+}
+
+void BulkFilterJob::finishTask()
+{
+    if (!mTasks.isEmpty()) {
+        mTasks.removeFirst();
+    }
+    mPendingItems.clear();
+    mTaskListed = false;
+    mListedItemCount = 0;
+    mProcessedItemCount = 0;
+    mSkippedItemCount = 0;
+    mChunkSizeLimit = 0;
+    mFailedChunkEnd = -1;
+    saveTasks();
+    if (mTasks.isEmpty()) {
+        Q_EMIT progressMessage(QString());
+        Q_EMIT percent(0);
+    }
+}
+
+void BulkFilterJob::saveTasks()
+{
+    KSharedConfig::Ptr config = KSharedConfig::openStateConfig();
+    for (int i = 0, total = mTasks.count(); i < total; ++i) {
+        const Task &task = mTasks.at(i);
+        KConfigGroup group = config->group(taskGroupName(i));
+        group.writeEntry("Collection", task.collectionId);
+        group.writeEntry("Filters", task.listFilters);
+        group.writeEntry("FilterSet", static_cast<int>(task.filterSet));
+        group.writeEntry("LastItemId", task.lastItemId);
+    }
+    for (int i = mTasks.count(); config->hasGroup(taskGroupName(i)); ++i) {
+        config->deleteGroup(taskGroupName(i));
+    }
+    syncCheckpoint();
+}
+
+void BulkFilterJob::saveCheckpoint()
+{
+    if (mTasks.isEmpty()) {
+        return;
+    }
+    KConfigGroup group(KSharedConfig::openStateConfig(), taskGroupName(0));
+    group.writeEntry("LastItemId", mTasks.constFirst().lastItemId);
+    if (!mCheckpointTimer.isActive()) {
+        mCheckpointTimer.start();
+    }
+}
+
+void BulkFilterJob::syncCheckpoint()
+{
+    mCheckpointTimer.stop();
+    KSharedConfig::openStateConfig()->sync();
+}
+
+void BulkFilterJob::saveSettings()
+{
+    KConfigGroup group(KSharedConfig::openConfig(), myConfigGroupName);
+    group.writeEntry("Paused", mPaused);
+    group.writeEntry("MaximumItemsPerSecond", mMaximumItemsPerSecond);
+    group.sync();
+}
+
+QByteArray BulkFilterJob::progressAsJson() const
+{
+    QJsonObject obj;
+    QString state;
+    if (mTasks.isEmpty()) {
+        state = QStringLiteral("idle");
+    } else if (mPaused) {
+        state = QStringLiteral("paused");
+    } else {
+        state = QStringLiteral("running");
+    }
+    obj[QStringLiteral("state")] = state;
+    obj[QStringLiteral("maximumItemsPerSecond")] = mMaximumItemsPerSecond;
+    if (!mTasks.isEmpty()) {
+        const Task &task = mTasks.constFirst();
+        obj[QStringLiteral("currentCollection")] = task.collectionId;
+        obj[QStringLiteral("lastItemId")] = task.lastItemId;
+        obj[QStringLiteral("processedItems")] = mProcessedItemCount;
+        obj[QStringLiteral("skippedItems")] = mSkippedItemCount;
+        obj[QStringLiteral("totalItems")] = mListedItemCount;
+    }
+    QJsonArray queued;
+    for (int i = 1, total = mTasks.count(); i < total; ++i) {
+        queued.append(mTasks.at(i).collectionId);
+    }
+    obj[QStringLiteral("queuedCollections")] = queued;
+    return QJsonDocument(obj).toJson(QJsonDocument::Indented);
+}
@@ -0,0 +1,107 @@
+/*
+    SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "filtermanager.h"
+
+#include <AkonadiCore/collection.h>
+#include <AkonadiCore/item.h>
+
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QVector>
+
+class KJob;
+
+/**
+ * Re-filters whole collections in the background.
+ *
+ * The collections are processed one after another in chunks. After each chunk
+ * the id of the last processed item is stored in the agent state file, so
+ * that a run interrupted by a restart of the agent continues where it stopped
+ * instead of starting over. The run can be paused, resumed and canceled, and
+ * the number of filtered items per second can be limited.
+ *
+ * When a chunk can't be fetched it is split and fetched again, so that only
+ * the items which can't be fetched on their own are skipped.
+ */
+class BulkFilterJob : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BulkFilterJob(FilterManager *filterManager, QObject *parent = nullptr);
+    ~BulkFilterJob() override;
+
+    /**
+     * Queues the filtering of @p collections with the filters in @p listFilters,
+     * or all filters of @p filterSet if the list is empty.
+     */
+    void addCollections(const QList<qint64> &collections, const QStringList &listFilters, FilterManager::FilterSet filterSet);
+
+    /**
+     * Restores the queued collections from the last checkpoint.
+     */
+    void restore();
+
+    void pause();
+    void resume();
+    void cancel();
+
+    Q_REQUIRED_RESULT bool isPaused() const;
+
+    /**
+     * Limits the throughput to @p itemsPerSecond, 0 means no limit.
+     */
+    void setMaximumItemsPerSecond(int itemsPerSecond);
+    Q_REQUIRED_RESULT int maximumItemsPerSecond() const;
+
+    /**
+     * Returns the state of the run as a JSON document.
+     */
+    Q_REQUIRED_RESULT QByteArray progressAsJson() const;
+
+Q_SIGNALS:
+    void progressMessage(const QString &message);
+    void percent(int progress);
+
+private:
+    struct Task {
+        Akonadi::Collection::Id collectionId = -1;
+        QStringList listFilters;
+        FilterManager::FilterSet filterSet = FilterManager::Explicit;
+        Akonadi::Item::Id lastItemId = -1;
+    };
+
+    void startNextTask();
+    void slotItemsListed(KJob *job);
+    void fetchNextChunk();
+    void slotChunkFetched(KJob *job);
+    void scheduleNextChunk(int delay);
+    void finishTask();
+    void saveTasks();
+    void saveCheckpoint();
+    void syncCheckpoint();
+    void saveSettings();
+
+    FilterManager *const mFilterManager;
+    QVector<Task> mTasks;
+    Akonadi::Item::List mPendingItems;
+    QPointer<KJob> mCurrentJob;
+    QTimer mCheckpointTimer;
+    int mListedItemCount = 0;
+    int mProcessedItemCount = 0;
+    int mSkippedItemCount = 0;
+    // While retrying a failed chunk, the size of the smaller chunks and the last item of the failed one
+    int mChunkSizeLimit = 0;
+    Akonadi::Item::Id mFailedChunkEnd = -1;
+    int mMaximumItemsPerSecond = 0;
+    bool mPaused = false;
+    bool mScheduled = false;
+    bool mTaskListed = false;
+};
+
@@ -0,0 +1,212 @@
+/*
+    SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "filtereventlog.h"
+
+#include <KLocalizedString>
+#include <KMime/Message>
+#include <MailCommon/FilterLog>
+#include <MailCommon/MailFilter>
+#include <MailCommon/SearchPattern>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QLocale>
+#include <QSaveFile>
+
+using namespace MailCommon;
+
+namespace
+{
+// "KFEL", the file format version follows it
+constexpr quint32 ExportMagic = 0x4B46454C;
+constexpr quint32 ExportVersion = 2;
+}
+
+FilterEventLog *FilterEventLog::self()
+{
+    static FilterEventLog s_self;
+    return &s_self;
+}
+
+FilterEventLog::FilterEventLog(QObject *parent)
+    : QObject(parent)
+{
+}
+
+FilterEventLog::~FilterEventLog() = default;
+
+void FilterEventLog::add(EventType type, const Akonadi::Item &item, const MailCommon::MailFilter *filter, qint64 durationNSecs)
+{
+    Record record;
+    record.timestamp = QDateTime::currentMSecsSinceEpoch();
+    record.itemId = item.id();
+    record.type = type;
+    record.durationNSecs = durationNSecs;
+    if (type == FilteringStarted && item.hasPayload<KMime::Message::Ptr>()) {
+        const auto msg = item.payload<KMime::Message::Ptr>();
+        record.subject = msg->subject()->asUnicodeString();
+        record.from = msg->from()->asUnicodeString();
+        record.messageDate = msg->date()->dateTime().toMSecsSinceEpoch();
+    }
+    if (filter) {
+        auto it = mFilterIndexes.constFind(filter);
+        if (it == mFilterIndexes.constEnd()) {
+            const FilterInfo info{filter->identifier(), filter->name(), filter->pattern()->asString()};
+            // A filter reloaded without changes shares the entry of its previous instance
+            int index = mFilters.indexOf(info);
+            if (index < 0) {
+                index = mFilters.count();
+                mFilters.append(info);
+            }
+            it = mFilterIndexes.insert(filter, index);
+        }
+        record.filterIndex = it.value();
+    }
+
+    if (mRecords.count() < mCapacity) {
+        mRecords.append(record);
+    } else {
+        mRecords[mNextRecord] = record;
+        mNextRecord = (mNextRecord + 1) % mCapacity;
+    }
+    Q_EMIT recordAdded(record);
+}
+
+QVector<FilterEventLog::Record> FilterEventLog::records() const
+{
+    if (mNextRecord == 0) {
+        return mRecords;
+    }
+    return mRecords.mid(mNextRecord) + mRecords.mid(0, mNextRecord);
+}
+
+void FilterEventLog::clear()
+{
+    mRecords.clear();
+    mNextRecord = 0;
+    mFilters.clear();
+    mFilterIndexes.clear();
+}
+
+void FilterEventLog::filtersChanged()
+{
+    mFilterIndexes.clear();
+
+    // Only keep the filters the existing records still refer to
+    QVector<int> newIndexes(mFilters.count(), -1);
+    for (const Record &record : std::as_const(mRecords)) {
+        if (record.filterIndex >= 0) {
+            newIndexes[record.filterIndex] = 0;
+        }
+    }
+    QVector<FilterInfo> filters;
+    for (int i = 0, count = mFilters.count(); i < count; ++i) {
+        if (newIndexes.at(i) == 0) {
+            newIndexes[i] = filters.count();
+            filters.append(mFilters.at(i));
+        }
+    }
+    if (filters.count() == mFilters.count()) {
+        return;
+    }
+    for (Record &record : mRecords) {
+        if (record.filterIndex >= 0) {
+            record.filterIndex = newIndexes.at(record.filterIndex);
+        }
+    }
+    mFilters = filters;
+}
+
+void FilterEventLog::setCapacity(int capacity)
+{
+    if (capacity <= 0 || capacity == mCapacity) {
+        return;
+    }
+    QVector<Record> ordered = records();
+    if (ordered.count() > capacity) {
+        ordered.remove(0, ordered.count() - capacity);
+    }
+    mRecords = ordered;
+    mNextRecord = 0;
+    mCapacity = capacity;
+}
+
+int FilterEventLog::capacity() const
+{
+    return mCapacity;
+}
+
+QString FilterEventLog::toHtml(const Record &record) const
+{
+    FilterLog::ContentType contentType = FilterLog::PatternDescription;
+    QString text;
+    const bool hasFilter = record.filterIndex >= 0 && record.filterIndex < mFilters.count();
+    const QString filterName = hasFilter ? mFilters.at(record.filterIndex).name : QString();
+    // Like the log lines of MailCommon::FilterLog, the rules come before their result
+    QString patternDescription;
+    if ((record.type == PatternNotMatched || record.type == PatternMatched) && hasFilter
+        && FilterLog::instance()->isContentTypeEnabled(FilterLog::PatternDescription)) {
+        patternDescription = i18n("<b>Evaluating filter rules:</b> ") + mFilters.at(record.filterIndex).patternDescription.toHtmlEscaped();
+    }
+    switch (record.type) {
+    case FilteringStarted:
+        if (record.messageDate != 0 || !record.subject.isEmpty() || !record.from.isEmpty()) {
+            const QString date = QLocale().toString(QDateTime::fromMSecsSinceEpoch(record.messageDate), QLocale::LongFormat);
+            text = i18n("<b>Begin filtering on message \"%1\" from \"%2\" at \"%3\" :</b>",
+                        record.subject.toHtmlEscaped(),
+                        record.from.toHtmlEscaped(),
+                        date);
+        } else {
+            text = i18n("<b>Begin filtering on message %1</b>", record.itemId);
+        }
+        break;
+    case PatternNotMatched:
+        text = i18n("Filter <b>%1</b> did not match (evaluated in %2 ms).", filterName.toHtmlEscaped(), QString::number(record.durationNSecs / 1000000.0, 'f', 3));
+        break;
+    case PatternMatched:
+        contentType = FilterLog::PatternResult;
+        text = i18n("<b>Filter rules of %1 have matched</b> (evaluated in %2 ms).", filterName.toHtmlEscaped(), QString::number(record.durationNSecs / 1000000.0, 'f', 3));
+        break;
+    case SkippedByPrefilter:
+        text = i18n("Filter <b>%1</b> skipped, the message does not contain its header terms.", filterName.toHtmlEscaped());
+        break;
+    case ActionsExecuted:
+        contentType = FilterLog::AppliedAction;
+        text = i18n("Executing the actions of filter <b>%1</b>.", filterName.toHtmlEscaped());
+        break;
+    }
+    const QString time = QLatin1Char('[') + QLocale().toString(QDateTime::fromMSecsSinceEpoch(record.timestamp).time(), QLocale::LongFormat) + QLatin1String("] ");
+    if (!FilterLog::instance()->isContentTypeEnabled(contentType)) {
+        return patternDescription.isEmpty() ? QString() : time + patternDescription;
+    }
+    if (!patternDescription.isEmpty()) {
+        return time + patternDescription + QLatin1String("<br>") + time + text;
+    }
+    return time + text;
+}
+
+bool FilterEventLog::exportToFile(const QString &fileName) const
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << ExportMagic << ExportVersion;
+    stream << static_cast<qint32>(mFilters.count());
+    for (const FilterInfo &filter : std::as_const(mFilters)) {
+        stream << filter.identifier << filter.name << filter.patternDescription;
+    }
+    const QVector<Record> allRecords = records();
+    stream << static_cast<qint32>(allRecords.count());
+    for (const Record &record : allRecords) {
+        stream << record.timestamp << record.itemId << record.filterIndex << static_cast<quint8>(record.type) << record.durationNSecs;
+        stream << record.subject << record.from << record.messageDate;
+    }
+    return stream.status() == QDataStream::Ok && file.commit();
+}
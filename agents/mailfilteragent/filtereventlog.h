@@ -0,0 +1,114 @@
+/*
+    SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <AkonadiCore/item.h>
+
+#include <QHash>
+#include <QObject>
+#include <QVector>
+
+namespace MailCommon
+{
+class MailFilter;
+}
+
+/**
+ * Structured, fixed-size log of what the filter manager did.
+ *
+ * Instead of building translated HTML for every rule evaluation, the filter
+ * manager appends small binary records to a ring buffer. They are only turned
+ * into text when the filter log dialog shows them, and can be exported to a
+ * compact file for later analysis.
+ *
+ * The subject, sender and date of a message are kept in the record that starts
+ * its filtering, the name and rule description of a filter are kept once for
+ * all the records referring to it.
+ */
+class FilterEventLog : public QObject
+{
+    Q_OBJECT
+public:
+    enum EventType : quint8 {
+        FilteringStarted = 0,
+        PatternNotMatched,
+        PatternMatched,
+        SkippedByPrefilter,
+        ActionsExecuted,
+    };
+
+    struct Record {
+        qint64 timestamp = 0; // msecs since epoch
+        Akonadi::Item::Id itemId = -1;
+        qint32 filterIndex = -1; // index in filterIdentifiers(), -1 if not related to a filter
+        EventType type = FilteringStarted;
+        qint64 durationNSecs = 0;
+        // Only set for FilteringStarted, if the message headers were fetched
+        QString subject;
+        QString from;
+        qint64 messageDate = 0; // msecs since epoch
+    };
+
+    static FilterEventLog *self();
+    ~FilterEventLog() override;
+
+    void add(EventType type, const Akonadi::Item &item, const MailCommon::MailFilter *filter = nullptr, qint64 durationNSecs = 0);
+
+    /**
+     * Returns the records, oldest first.
+     */
+    Q_REQUIRED_RESULT QVector<Record> records() const;
+
+    void clear();
+
+    /**
+     * Must be called before the filters are deleted, the records added later
+     * refer to the new filters even if they have the same identifiers.
+     */
+    void filtersChanged();
+
+    /**
+     * Sets the number of records kept, older records are overwritten.
+     */
+    void setCapacity(int capacity);
+    Q_REQUIRED_RESULT int capacity() const;
+
+    /**
+     * Returns @p record formatted for the filter log dialog, or an empty string
+     * if its content type is disabled in MailCommon::FilterLog.
+     */
+    Q_REQUIRED_RESULT QString toHtml(const Record &record) const;
+
+    /**
+     * Writes all records to @p fileName in a compact binary format, stored with
+     * the ".kfel" suffix. Use the filter log dialog to save them as text.
+     */
+    Q_REQUIRED_RESULT bool exportToFile(const QString &fileName) const;
+
+Q_SIGNALS:
+    void recordAdded(const FilterEventLog::Record &record);
+
+private:
+    explicit FilterEventLog(QObject *parent = nullptr);
+
+    QVector<Record> mRecords;
+    int mNextRecord = 0;
+    int mCapacity = 10000;
+    struct FilterInfo {
+        QString identifier;
+        QString name;
+        QString patternDescription;
+
+        bool operator==(const FilterInfo &other) const
+        {
+            return identifier == other.identifier && name == other.name && patternDescription == other.patternDescription;
+        }
+    };
+    QVector<FilterInfo> mFilters;
+    QHash<const MailCommon::MailFilter *, int> mFilterIndexes;
+};
+
@@ -26,6 +26,7 @@
 #include <QPointer>
 #include <QSpinBox>
 #include <QStringList>
+#include <QTimer>
 
 #include <KConfigGroup>
 #include <KGuiItem>
@@ -37,6 +38,13 @@
 
 using namespace MailCommon;
 
+namespace
+{
+// Formatting this many records takes a few milliseconds, the dialog stays responsive in between
+constexpr int RecordBatchSize = 200;
+constexpr int RecordBatchDelay = 100;
+}
+
 FilterLogDialog::FilterLogDialog(QWidget *parent)
     : QDialog(parent)
 {
@@ -54,6 +62,9 @@ FilterLogDialog::FilterLogDialog(QWidget *parent)
     buttonBox->button(QDialogButtonBox::Close)->setDefault(true);
     KGuiItem::assign(mUser1Button, KStandardGuiItem::clear());
     KGuiItem::assign(mUser2Button, KStandardGuiItem::saveAs());
+    mExportButton = new QPushButton(i18n("Export Records..."), this);
+    mExportButton->setToolTip(i18n("Save the recorded filter events in a compact binary file"));
+    buttonBox->addButton(mExportButton, QDialogButtonBox::ActionRole);
     auto page = new QFrame(this);
 
     auto pageVBoxLayout = new QVBoxLayout;
@@ -71,6 +82,13 @@ FilterLogDialog::FilterLogDialog(QWidget *parent)
     for (QStringList::ConstIterator it = logEntries.constBegin(); it != end; ++it) {
         mTextEdit->editor()->appendHtml(*it);
     }
+    mPendingRecordsTimer = new QTimer(this);
+    mPendingRecordsTimer->setSingleShot(true);
+    connect(mPendingRecordsTimer, &QTimer::timeout, this, &FilterLogDialog::slotShowPendingRecords);
+    mPendingRecords = FilterEventLog::self()->records();
+    if (!mPendingRecords.isEmpty()) {
+        mPendingRecordsTimer->start(0);
+    }
 
     auto purposeMenu = new MailfilterPurposeMenuWidget(this, this);
     auto mShareButton = new QPushButton(i18n("Share..."), this);
@@ -154,11 +172,13 @@ FilterLogDialog::FilterLogDialog(QWidget *parent)
     connect(FilterLog::instance(), &FilterLog::logEntryAdded, this, &FilterLogDialog::slotLogEntryAdded);
     connect(FilterLog::instance(), &FilterLog::logShrinked, this, &FilterLogDialog::slotLogShrinked);
     connect(FilterLog::instance(), &FilterLog::logStateChanged, this, &FilterLogDialog::slotLogStateChanged);
+    connect(FilterEventLog::self(), &FilterEventLog::recordAdded, this, &FilterLogDialog::slotEventRecordAdded);
 
     mainLayout->addWidget(buttonBox);
 
     connect(mUser1Button, &QPushButton::clicked, this, &FilterLogDialog::slotUser1);
     connect(mUser2Button, &QPushButton::clicked, this, &FilterLogDialog::slotUser2);
+    connect(mExportButton, &QPushButton::clicked, this, &FilterLogDialog::slotExportRecords);
     connect(mTextEdit->editor(), &KPIMTextEdit::PlainTextEditor::textChanged, this, &FilterLogDialog::slotTextChanged);
 
     slotTextChanged();
@@ -239,9 +259,47 @@ void FilterLogDialog::writeConfig()
 
 void FilterLogDialog::slotLogEntryAdded(const QString &logEntry)
 {
+    // Show the records logged before this entry first, to keep the order
+    while (!mPendingRecords.isEmpty()) {
+        slotShowPendingRecords();
+    }
+    mPendingRecordsTimer->stop();
     mTextEdit->editor()->appendHtml(logEntry);
 }
 
+void FilterLogDialog::slotEventRecordAdded(const FilterEventLog::Record &record)
+{
+    // Older records are gone from the log too, don't show more than it keeps
+    if (mPendingRecords.count() >= FilterEventLog::self()->capacity()) {
+        mPendingRecords.removeFirst();
+    }
+    mPendingRecords.append(record);
+    if (!mPendingRecordsTimer->isActive()) {
+        mPendingRecordsTimer->start(RecordBatchDelay);
+    }
+}
+
+void FilterLogDialog::slotShowPendingRecords()
+{
+    // records are only formatted here, when they are shown
+    const int count = qMin(RecordBatchSize, mPendingRecords.count());
+    QStringList lines;
+    lines.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const QString text = FilterEventLog::self()->toHtml(mPendingRecords.at(i));
+        if (!text.isEmpty()) {
+            lines.append(text);
+        }
+    }
+    mPendingRecords.remove(0, count);
+    if (!lines.isEmpty()) {
+        mTextEdit->editor()->appendHtml(lines.join(QLatin1String("<br>")));
+    }
+    if (!mPendingRecords.isEmpty()) {
+        mPendingRecordsTimer->start(0);
+    }
+}
+
 void FilterLogDialog::slotLogShrinked()
 {
     // limit the size of the shown log lines as soon as
@@ -308,6 +366,9 @@ void FilterLogDialog::slotChangeLogMemLimit(int value)
 void FilterLogDialog::slotUser1()
 {
     FilterLog::instance()->clear();
+    FilterEventLog::self()->clear();
+    mPendingRecords.clear();
+    mPendingRecordsTimer->stop();
     mTextEdit->editor()->clear();
 }
 
@@ -333,6 +394,15 @@ void FilterLogDialog::slotUser2()
     delete fdlg;
 }
 
+void FilterLogDialog::slotExportRecords()
+{
+    const QString fileName =
+        QFileDialog::getSaveFileName(this, i18n("Export Filter Log Records"), QStringLiteral("kmail-filter.kfel"), i18n("Binary Filter Log Records (*.kfel)"));
+    if (!fileName.isEmpty() && !FilterEventLog::self()->exportToFile(fileName)) {
+        KMessageBox::error(this, i18n("Could not write the file %1.", fileName), i18n("KMail Error"));
+    }
+}
+
 FilterLogTextEdit::FilterLogTextEdit(QWidget *parent)
     : KPIMTextEdit::PlainTextEditor(parent)
 {
@@ -6,6 +6,8 @@
 */
 #pragma once
 
+#include "filtereventlog.h"
+
 #include <QDialog>
 
 #include <KPIMTextEdit/PlainTextEditor>
@@ -14,6 +16,7 @@ class QCheckBox;
 class QSpinBox;
 class QGroupBox;
 class QPushButton;
+class QTimer;
 /**
   @short KMail Filter Log Collector.
   @author Andreas Gungl <a.gungl@gmx.de>
@@ -49,6 +52,9 @@ public:
 private:
     void slotTextChanged();
     void slotLogEntryAdded(const QString &logEntry);
+    void slotEventRecordAdded(const FilterEventLog::Record &record);
+    void slotShowPendingRecords();
+    void slotExportRecords();
     void slotLogShrinked();
     void slotLogStateChanged();
     void slotChangeLogDetail();
@@ -71,6 +77,10 @@ private:
     QSpinBox *mLogMemLimitSpin = nullptr;
     QPushButton *mUser1Button = nullptr;
     QPushButton *mUser2Button = nullptr;
+    QPushButton *mExportButton = nullptr;
+    // Records not shown yet, they are formatted in batches
+    QVector<FilterEventLog::Record> mPendingRecords;
+    QTimer *mPendingRecordsTimer = nullptr;
 
     bool mIsInitialized = false;
 };
@@ -6,6 +6,9 @@
  *
  */
 #include "filtermanager.h"
+#include "filtereventlog.h"
+#include "filterprefilter.h"
+#include "filterstatistics.h"
 
 #include "mailfilteragent_debug.h"
 #include <Akonadi/KMime/MessageParts>
@@ -22,6 +25,7 @@
 #include <AkonadiCore/itemmovejob.h>
 #include <KLocalizedString>
 #include <KNotification>
+#include <MailCommon/FilterAction>
 #include <MailCommon/FilterImporterExporter>
 #include <MailCommon/FilterLog>
 #include <MailCommon/MailFilter>
@@ -30,9 +34,17 @@
 
 // other headers
 #include <KSharedConfig>
-#include <QLocale>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QQueue>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
+#include <QTimer>
 #include <algorithm>
 #include <cerrno>
+#include <memory>
+#include <vector>
 
 using namespace MailCommon;
 
@@ -49,68 +61,163 @@ public:
     void moveJobResult(KJob *);
     void modifyJobResult(KJob *);
     void deleteJobResult(KJob *);
-    void slotItemsFetchedForFilter(const Akonadi::Item::List &items);
+    // Progress of one applySpecificFilters() call, shared by its batches
+    struct FilterProgress {
+        int total = 0;
+        int current = 0;
+        int remainingBatches = 0;
+    };
+    void slotItemsFetchedForFilter(const Akonadi::Item::List &items, FilterProgress *progress);
+    void filterItems(const Akonadi::Item::List &items,
+                     const QStringList &listFilters,
+                     bool needsFullPayload,
+                     FilterManager::FilterSet filterSet,
+                     FilterProgress *progress = nullptr);
     void showNotification(const QString &errorMsg, const QString &jobErrorString);
-
-    bool isMatching(const Akonadi::Item &item, const MailCommon::MailFilter *filter);
+    void schedulePendingJobs();
+    void flushPendingJobs();
+    void moveItems(const Akonadi::Item::List &items, Akonadi::Collection::Id destination);
+    void deleteItems(const Akonadi::Item::List &items);
+    void startNextBatches();
+
+    bool isMatching(const Akonadi::Item &item, const MailCommon::MailFilter *filter, int statisticsSlot);
+    void recordSkipped(const Akonadi::Item &item, const MailCommon::MailFilter *filter, int statisticsSlot);
+    void recordActionsExecuted(const Akonadi::Item &item, const MailCommon::MailFilter *filter, int statisticsSlot);
     void beginFiltering(const Akonadi::Item &item) const;
     void endFiltering(const Akonadi::Item &item) const;
     bool atLeastOneFilterAppliesTo(const QString &accountId) const;
     bool atLeastOneIncomingFilterAppliesTo(const QString &accountId) const;
+    static bool filterAppliesTo(const MailCommon::MailFilter *filter, FilterManager::FilterSet set, bool account, const QString &accountId);
+    const QVector<MailCommon::MailFilter *> &applicableFilters(FilterManager::FilterSet set, bool account, const QString &accountId) const;
+    void clearFilterIndex();
+    // Result of evaluating the rules of a list of filters on one item, computed ahead
+    // of time on a worker thread
+    enum MatchResult : qint8 {
+        NotMatched,
+        Matched,
+        SkippedByPrefilter,
+    };
+    struct MatchResults {
+        QVector<qint8> results;
+        QVector<qint64> nsecs;
+    };
+    MatchResults matchFilters(const QVector<MailCommon::MailFilter *> &filters, const Akonadi::Item &item) const;
+    bool canMatchInParallel(const QVector<MailCommon::MailFilter *> &filters, int itemCount) const;
+    void updateThreadUnsafeFilters();
+    bool processFilters(const QVector<MailCommon::MailFilter *> &applicable,
+                        const Akonadi::Item &item,
+                        bool needsFullPayload,
+                        FilterManager::FilterSet set,
+                        const MatchResults *precomputed = nullptr,
+                        const QVector<int> *statisticsSlots = nullptr);
     FilterManager *const q;
     QVector<MailCommon::MailFilter *> mFilters;
     QMap<QString, SearchRule::RequiredPart> mRequiredParts;
+    // ((filter set, restricted to an account), account) => enabled filters which apply to it, in filter order.
+    // The account part of the key is only set when filtering is restricted to an account.
+    using ApplicableFiltersKey = QPair<QPair<int, bool>, QString>;
+    mutable QHash<ApplicableFiltersKey, QVector<MailCommon::MailFilter *>> mApplicableFilters;
+    FilterPrefilter mPrefilter;
+    FilterStatistics mStatistics;
+    // Filters whose rules need the main thread (Akonadi lookups), see updateThreadUnsafeFilters()
+    QSet<const MailCommon::MailFilter *> mThreadUnsafeFilters;
+    QThreadPool mMatchingPool;
     SearchRule::RequiredPart mRequiredPartsBasedOnAll = SearchRule::Envelope;
-    int mTotalProgressCount = 0;
-    int mCurrentProgressCount = 0;
+    // Writes resulting from filter actions, grouped so that a batch of filtered
+    // items turns into one job per action type and destination.
+    QMap<Akonadi::Collection::Id, Akonadi::Item::List> mPendingMoves;
+    QVector<QPair<Akonadi::Item, bool>> mPendingModifies;
+    Akonadi::Item::List mPendingDeletes;
+    // Pending writes are flushed right away once that many items are waiting
+    static constexpr int MaximumPendingJobItems = 1000;
+    int mPendingJobItemCount = 0;
+    bool mPendingJobsScheduled = false;
+    // Items waiting for their payload to be fetched and filtered
+    struct FilterBatch {
+        Akonadi::Item::List items;
+        SearchRule::RequiredPart requiredPart = SearchRule::Envelope;
+        QStringList listFilters;
+        FilterManager::FilterSet filterSet = FilterManager::Explicit;
+        std::shared_ptr<FilterProgress> progress;
+    };
+    static constexpr int FilterBatchSize = 500;
+    static constexpr int MaximumRunningBatches = 2;
+    QQueue<FilterBatch> mPendingBatches;
+    int mRunningBatches = 0;
     bool mInboundFiltersExist = false;
     bool mAllFoldersFiltersExist = false;
 };
 
-void FilterManager::Private::slotItemsFetchedForFilter(const Akonadi::Item::List &items)
+void FilterManager::Private::slotItemsFetchedForFilter(const Akonadi::Item::List &items, FilterProgress *progress)
 {
     FilterManager::FilterSet filterSet = FilterManager::Inbound;
     if (q->sender()->property("filterSet").isValid()) {
         filterSet = static_cast<FilterManager::FilterSet>(q->sender()->property("filterSet").toInt());
     }
 
-    QVector<MailFilter *> listMailFilters;
+    QStringList listFilters;
     if (q->sender()->property("listFilters").isValid()) {
-        const QStringList listFilters = q->sender()->property("listFilters").toStringList();
-        // TODO improve it
-        for (const QString &filterId : listFilters) {
-            for (MailCommon::MailFilter *filter : std::as_const(mFilters)) {
-                if (filter->identifier() == filterId) {
-                    listMailFilters << filter;
-                    break;
-                }
+        listFilters = q->sender()->property("listFilters").toStringList();
+    }
+
+    const bool needsFullPayload = q->sender()->property("needsFullPayload").toBool();
+
+    filterItems(items, listFilters, needsFullPayload, filterSet, progress);
+}
+
+void FilterManager::Private::filterItems(const Akonadi::Item::List &items,
+                                         const QStringList &listFilters,
+                                         bool needsFullPayload,
+                                         FilterManager::FilterSet filterSet,
+                                         FilterProgress *progress)
+{
+    QVector<MailFilter *> listMailFilters;
+    // TODO improve it
+    for (const QString &filterId : listFilters) {
+        for (MailCommon::MailFilter *filter : std::as_const(mFilters)) {
+            if (filter->identifier() == filterId) {
+                listMailFilters << filter;
+                break;
             }
         }
     }
 
     if (listMailFilters.isEmpty()) {
-        listMailFilters = mFilters;
+        listMailFilters = applicableFilters(filterSet, false, QString());
+    } else {
+        listMailFilters.erase(std::remove_if(listMailFilters.begin(),
+                                             listMailFilters.end(),
+                                             [filterSet](const MailCommon::MailFilter *filter) {
+                                                 return !filterAppliesTo(filter, filterSet, false, QString());
+                                             }),
+                              listMailFilters.end());
+    }
+
+    // Matching the rules is pure CPU work, so do it for the whole batch on worker
+    // threads first. Actions are executed below, in order, on this thread.
+    std::vector<MatchResults> precomputed;
+    if (canMatchInParallel(listMailFilters, items.count())) {
+        precomputed.resize(items.count());
+        for (int i = 0, total = items.count(); i < total; ++i) {
+            mMatchingPool.start(QRunnable::create([this, &precomputed, &listMailFilters, &items, i]() {
+                precomputed[i] = matchFilters(listMailFilters, items.at(i));
+            }));
+        }
+        mMatchingPool.waitForDone();
     }
 
-    bool needsFullPayload = q->sender()->property("needsFullPayload").toBool();
-
-    for (const Akonadi::Item &item : std::as_const(items)) {
-        ++mCurrentProgressCount;
-
-        if ((mTotalProgressCount > 0) && (mCurrentProgressCount != mTotalProgressCount)) {
-            const QString statusMsg = i18n("Filtering message %1 of %2", mCurrentProgressCount, mTotalProgressCount);
+    const QVector<int> statisticsSlots = mStatistics.filterSlots(listMailFilters);
+    for (int i = 0, total = items.count(); i < total; ++i) {
+        const Akonadi::Item &item = items.at(i);
+        if (progress && progress->current < progress->total) {
+            ++progress->current;
+            const QString statusMsg = i18n("Filtering message %1 of %2", progress->current, progress->total);
             Q_EMIT q->progressMessage(statusMsg);
-            Q_EMIT q->percent(mCurrentProgressCount * 100 / mTotalProgressCount);
-        } else {
-            Q_EMIT q->percent(0);
+            Q_EMIT q->percent(progress->current * 100 / progress->total);
         }
 
-        const bool filterResult = q->process(listMailFilters, item, needsFullPayload, filterSet);
-
-        if (mCurrentProgressCount == mTotalProgressCount) {
-            mTotalProgressCount = 0;
-            mCurrentProgressCount = 0;
-        }
+        const bool filterResult =
+            processFilters(listMailFilters, item, needsFullPayload, filterSet, precomputed.empty() ? nullptr : &precomputed[i], &statisticsSlots);
 
         if (!filterResult) {
             Q_EMIT q->filteringFailed(item);
@@ -127,6 +234,44 @@ void FilterManager::Private::itemsFetchJobForFilterDone(KJob *job)
     }
 }
 
+void FilterManager::Private::startNextBatches()
+{
+    while (mRunningBatches < MaximumRunningBatches && !mPendingBatches.isEmpty()) {
+        const FilterBatch batch = mPendingBatches.dequeue();
+
+        auto itemFetchJob = new Akonadi::ItemFetchJob(batch.items, q);
+        if (batch.requiredPart == SearchRule::CompleteMessage) {
+            itemFetchJob->fetchScope().fetchFullPayload(true);
+        } else if (batch.requiredPart == SearchRule::Header) {
+            itemFetchJob->fetchScope().fetchPayloadPart(Akonadi::MessagePart::Header, true);
+        } else {
+            itemFetchJob->fetchScope().fetchPayloadPart(Akonadi::MessagePart::Envelope, true);
+        }
+
+        itemFetchJob->fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
+        if (!batch.listFilters.isEmpty()) {
+            itemFetchJob->setProperty("listFilters", QVariant::fromValue(batch.listFilters));
+        }
+        itemFetchJob->setProperty("filterSet", QVariant::fromValue(static_cast<int>(batch.filterSet)));
+        itemFetchJob->setProperty("needsFullPayload", batch.requiredPart != SearchRule::Envelope);
+
+        const std::shared_ptr<FilterProgress> progress = batch.progress;
+        QObject::connect(itemFetchJob, &Akonadi::ItemFetchJob::itemsReceived, q, [this, progress](const Akonadi::Item::List &lst) {
+            slotItemsFetchedForFilter(lst, progress.get());
+        });
+        QObject::connect(itemFetchJob, &Akonadi::ItemFetchJob::result, q, [this, progress](KJob *job) {
+            itemsFetchJobForFilterDone(job);
+            --mRunningBatches;
+            // Also done when a fetch failed and some items never arrived
+            if (progress && --progress->remainingBatches == 0) {
+                Q_EMIT q->percent(0);
+            }
+            startNextBatches();
+        });
+        ++mRunningBatches;
+    }
+}
+
 void FilterManager::Private::itemFetchJobForFilterDone(KJob *job)
 {
     if (job->error()) {
@@ -214,39 +359,163 @@ void FilterManager::Private::showNotification(const QString &errorMsg, const QSt
     notify->sendEvent();
 }
 
-bool FilterManager::Private::isMatching(const Akonadi::Item &item, const MailCommon::MailFilter *filter)
+void FilterManager::Private::schedulePendingJobs()
 {
-    bool result = false;
-    if (FilterLog::instance()->isLogging()) {
-        QString logText(i18n("<b>Evaluating filter rules:</b> "));
-        logText.append(filter->pattern()->asString());
-        FilterLog::instance()->add(logText, FilterLog::PatternDescription);
+    // Flush right away once the batch grows large, otherwise wait until the
+    // current batch of items has been processed.
+    if (++mPendingJobItemCount >= MaximumPendingJobItems) {
+        flushPendingJobs();
+    } else if (!mPendingJobsScheduled) {
+        mPendingJobsScheduled = true;
+        QTimer::singleShot(0, q, [this]() {
+            flushPendingJobs();
+        });
     }
+}
 
-    if (filter->pattern()->matches(item)) {
-        if (FilterLog::instance()->isLogging()) {
-            FilterLog::instance()->add(i18n("<b>Filter rules have matched.</b>"), FilterLog::PatternResult);
+void FilterManager::Private::flushPendingJobs()
+{
+    mPendingJobsScheduled = false;
+    mPendingJobItemCount = 0;
+
+    // All jobs run in the same session, so moves are done before the items are modified.
+    for (auto it = mPendingMoves.cbegin(), end = mPendingMoves.cend(); it != end; ++it) {
+        moveItems(it.value(), it.key());
+    }
+    mPendingMoves.clear();
+
+    for (const auto &pending : std::as_const(mPendingModifies)) {
+        auto modifyJob = new Akonadi::ItemModifyJob(pending.first, q);
+        modifyJob->disableRevisionCheck(); // no conflict handling for mails as no other process could change the mail body and we don't care about flag
+                                           // conflicts
+        // The below is a safety check to ignore modifying payloads if it was not requested,
+        // as in that case we might change the payload to an invalid one
+        modifyJob->setIgnorePayload(!pending.second);
+        QObject::connect(modifyJob, &Akonadi::ItemModifyJob::result, q, [this](KJob *job) {
+            modifyJobResult(job);
+        });
+    }
+    mPendingModifies.clear();
+
+    if (!mPendingDeletes.isEmpty()) {
+        deleteItems(mPendingDeletes);
+        mPendingDeletes.clear();
+    }
+}
+
+void FilterManager::Private::moveItems(const Akonadi::Item::List &items, Akonadi::Collection::Id destination)
+{
+    auto moveJob = new Akonadi::ItemMoveJob(items, Akonadi::Collection(destination), q);
+    QObject::connect(moveJob, &Akonadi::ItemMoveJob::result, q, [this, items, destination](KJob *job) {
+        // One item removed in the meantime makes the whole job fail, split it to move the other ones
+        if (job->error() && items.count() > 1) {
+            const int half = items.count() / 2;
+            moveItems(items.mid(0, half), destination);
+            moveItems(items.mid(half), destination);
+            return;
         }
+        moveJobResult(job);
+    });
+}
 
-        result = true;
+void FilterManager::Private::deleteItems(const Akonadi::Item::List &items)
+{
+    auto deleteJob = new Akonadi::ItemDeleteJob(items, q);
+    QObject::connect(deleteJob, &Akonadi::ItemDeleteJob::result, q, [this, items](KJob *job) {
+        if (job->error() && items.count() > 1) {
+            const int half = items.count() / 2;
+            deleteItems(items.mid(0, half));
+            deleteItems(items.mid(half));
+            return;
+        }
+        deleteJobResult(job);
+    });
+}
+
+void FilterManager::Private::updateThreadUnsafeFilters()
+{
+    mThreadUnsafeFilters.clear();
+    for (const MailCommon::MailFilter *filter : std::as_const(mFilters)) {
+        const SearchPattern *pattern = filter->pattern();
+        for (const SearchRule::Ptr &rule : *pattern) {
+            // tags and address book lookups run Akonadi jobs
+            if (rule->field() == "<tag>" || rule->function() == SearchRule::FuncIsInAddressbook || rule->function() == SearchRule::FuncIsNotInAddressbook
+                || rule->function() == SearchRule::FuncIsInCategory || rule->function() == SearchRule::FuncIsNotInCategory) {
+                mThreadUnsafeFilters.insert(filter);
+                break;
+            }
+        }
     }
+}
 
-    return result;
+bool FilterManager::Private::canMatchInParallel(const QVector<MailCommon::MailFilter *> &filters, int itemCount) const
+{
+    if (itemCount < 2 || mMatchingPool.maxThreadCount() < 2 || FilterLog::instance()->isLogging()) {
+        return false;
+    }
+    return std::none_of(filters.cbegin(), filters.cend(), [this](const MailCommon::MailFilter *filter) {
+        return mThreadUnsafeFilters.contains(filter);
+    });
+}
+
+FilterManager::Private::MatchResults FilterManager::Private::matchFilters(const QVector<MailCommon::MailFilter *> &filters, const Akonadi::Item &item) const
+{
+    MatchResults matchResults;
+    if (!item.hasPayload<KMime::Message::Ptr>()) {
+        return matchResults;
+    }
+    const QBitArray candidates = mPrefilter.candidates(item.payload<KMime::Message::Ptr>());
+    matchResults.results.reserve(filters.count());
+    matchResults.nsecs.reserve(filters.count());
+    for (const MailCommon::MailFilter *filter : filters) {
+        if (!mPrefilter.mayMatch(candidates, filter)) {
+            matchResults.results.append(SkippedByPrefilter);
+            matchResults.nsecs.append(0);
+            continue;
+        }
+        QElapsedTimer timer;
+        timer.start();
+        const bool matches = filter->pattern()->matches(item);
+        matchResults.nsecs.append(timer.nsecsElapsed());
+        matchResults.results.append(matches ? Matched : NotMatched);
+    }
+    return matchResults;
+}
+
+bool FilterManager::Private::isMatching(const Akonadi::Item &item, const MailCommon::MailFilter *filter, int statisticsSlot)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const bool matches = filter->pattern()->matches(item);
+    const qint64 elapsed = timer.nsecsElapsed();
+    mStatistics.recordEvaluation(statisticsSlot, matches, elapsed);
+    if (FilterLog::instance()->isLogging()) {
+        FilterEventLog::self()->add(matches ? FilterEventLog::PatternMatched : FilterEventLog::PatternNotMatched, item, filter, elapsed);
+    }
+
+    return matches;
+}
+
+void FilterManager::Private::recordSkipped(const Akonadi::Item &item, const MailCommon::MailFilter *filter, int statisticsSlot)
+{
+    mStatistics.recordSkipped(statisticsSlot);
+    if (FilterLog::instance()->isLogging()) {
+        FilterEventLog::self()->add(FilterEventLog::SkippedByPrefilter, item, filter);
+    }
+}
+
+void FilterManager::Private::recordActionsExecuted(const Akonadi::Item &item, const MailCommon::MailFilter *filter, int statisticsSlot)
+{
+    mStatistics.recordActionsExecuted(statisticsSlot);
+    if (FilterLog::instance()->isLogging()) {
+        FilterEventLog::self()->add(FilterEventLog::ActionsExecuted, item, filter);
+    }
 }
 
 void FilterManager::Private::beginFiltering(const Akonadi::Item &item) const
 {
     if (FilterLog::instance()->isLogging()) {
-        FilterLog::instance()->addSeparator();
-        if (item.hasPayload<KMime::Message::Ptr>()) {
-            auto msg = item.payload<KMime::Message::Ptr>();
-            const QString subject = msg->subject()->asUnicodeString();
-            const QString from = msg->from()->asUnicodeString();
-            const QDateTime dateTime = msg->date()->dateTime();
-            const QString date = QLocale().toString(dateTime, QLocale::LongFormat);
-            const QString logText(i18n("<b>Begin filtering on message \"%1\" from \"%2\" at \"%3\" :</b>", subject, from, date));
-            FilterLog::instance()->add(logText, FilterLog::PatternDescription);
-        }
+        FilterEventLog::self()->add(FilterEventLog::FilteringStarted, item);
     }
 }
 
@@ -267,13 +536,44 @@ bool FilterManager::Private::atLeastOneFilterAppliesTo(const QString &accountId)
 
 bool FilterManager::Private::atLeastOneIncomingFilterAppliesTo(const QString &accountId) const
 {
-    for (const MailCommon::MailFilter *filter : std::as_const(mFilters)) {
-        if (filter->applyOnInbound() && filter->applyOnAccount(accountId)) {
-            return true;
+    return !applicableFilters(FilterManager::Inbound, true, accountId).isEmpty();
+}
+
+bool FilterManager::Private::filterAppliesTo(const MailCommon::MailFilter *filter, FilterManager::FilterSet set, bool account, const QString &accountId)
+{
+    if (!filter->isEnabled()) {
+        return false;
+    }
+    const bool inboundOk = ((set & Inbound) && filter->applyOnInbound());
+    const bool outboundOk = ((set & Outbound) && filter->applyOnOutbound());
+    const bool beforeOutboundOk = ((set & BeforeOutbound) && filter->applyBeforeOutbound());
+    const bool explicitOk = ((set & Explicit) && filter->applyOnExplicit());
+    const bool allFoldersOk = ((set & AllFolders) && filter->applyOnAllFoldersInbound());
+    const bool accountOk = (!account || filter->applyOnAccount(accountId));
+
+    return (inboundOk && accountOk) || (allFoldersOk && accountOk) || outboundOk || beforeOutboundOk || explicitOk;
+}
+
+const QVector<MailCommon::MailFilter *> &
+FilterManager::Private::applicableFilters(FilterManager::FilterSet set, bool account, const QString &accountId) const
+{
+    const ApplicableFiltersKey key(qMakePair(int(set), account), account ? accountId : QString());
+    auto it = mApplicableFilters.constFind(key);
+    if (it == mApplicableFilters.constEnd()) {
+        QVector<MailCommon::MailFilter *> filters;
+        for (MailCommon::MailFilter *filter : std::as_const(mFilters)) {
+            if (filterAppliesTo(filter, set, account, accountId)) {
+                filters.append(filter);
+            }
         }
+        it = mApplicableFilters.insert(key, filters);
     }
+    return it.value();
+}
 
-    return false;
+void FilterManager::Private::clearFilterIndex()
+{
+    mApplicableFilters.clear();
 }
 
 FilterManager::FilterManager(QObject *parent)
@@ -290,8 +590,13 @@ FilterManager::~FilterManager()
 
 void FilterManager::clear()
 {
+    FilterEventLog::self()->filtersChanged();
     qDeleteAll(d->mFilters);
     d->mFilters.clear();
+    d->clearFilterIndex();
+    d->mPrefilter.clear();
+    d->mStatistics.setFilters({});
+    d->mThreadUnsafeFilters.clear();
 }
 
 void FilterManager::readConfig()
@@ -302,6 +607,9 @@ void FilterManager::readConfig()
 
     QStringList emptyFilters;
     d->mFilters = FilterImporterExporter::readFiltersFromConfig(config, emptyFilters);
+    d->mPrefilter.build(d->mFilters);
+    d->mStatistics.setFilters(d->mFilters);
+    d->updateThreadUnsafeFilters();
     d->mRequiredParts.clear();
 
     d->mRequiredPartsBasedOnAll = SearchRule::Envelope;
@@ -309,6 +617,8 @@ void FilterManager::readConfig()
         const Akonadi::AgentInstance::List agents = Akonadi::AgentManager::self()->instances();
         for (const Akonadi::AgentInstance &agent : agents) {
             const QString id = agent.identifier();
+            // Build the index for incoming mail up front, other combinations are added on first use
+            d->applicableFilters(Inbound, true, id);
 
             auto it = std::max_element(d->mFilters.constBegin(), d->mFilters.constEnd(), [id](MailCommon::MailFilter *lhs, MailCommon::MailFilter *rhs) {
                 return lhs->requiredPart(id) < rhs->requiredPart(id);
@@ -318,7 +628,8 @@ void FilterManager::readConfig()
         }
     }
     // check if at least one filter is to be applied on inbound mail
-
+    d->mInboundFiltersExist = false;
+    d->mAllFoldersFiltersExist = false;
     for (auto i = d->mFilters.cbegin(), e = d->mFilters.cend(); i != e && (!d->mInboundFiltersExist || !d->mAllFoldersFiltersExist); ++i) {
         if ((*i)->applyOnInbound()) {
             d->mInboundFiltersExist = true;
@@ -345,6 +656,7 @@ void FilterManager::agentRemoved(const QString &identifier)
     for (QVector<MailCommon::MailFilter *>::const_iterator it = d->mFilters.constBegin(); it != end; ++it) {
         (*it)->agentRemoved(identifier);
     }
+    d->clearFilterIndex();
 }
 
 void FilterManager::filter(const Akonadi::Item &item, FilterManager::FilterSet set, const QString &resourceId)
@@ -403,7 +715,8 @@ bool FilterManager::process(const Akonadi::Item &item, bool needsFullPayload, co
         return false;
     }
 
-    if (d->isMatching(item, filter)) {
+    const int statisticsSlot = d->mStatistics.slot(filter);
+    if (d->isMatching(item, filter, statisticsSlot)) {
         // do the actual filtering stuff
         d->beginFiltering(item);
 
@@ -411,6 +724,7 @@ bool FilterManager::process(const Akonadi::Item &item, bool needsFullPayload, co
 
         bool stopIt = false;
         bool applyOnOutbound = false;
+        d->recordActionsExecuted(item, filter, statisticsSlot);
         if (filter->execActions(context, stopIt, applyOnOutbound) == MailCommon::MailFilter::CriticalError) {
             return false;
         }
@@ -434,20 +748,16 @@ bool FilterManager::processContextItem(ItemContext context)
     const bool itemCanDelete = (col.rights() & Akonadi::Collection::CanDeleteItem);
     if (context.deleteItem()) {
         if (itemCanDelete) {
-            auto deleteJob = new Akonadi::ItemDeleteJob(context.item(), this);
-            connect(deleteJob, &Akonadi::ItemDeleteJob::result, this, [this](KJob *job) {
-                d->deleteJobResult(job);
-            });
+            d->mPendingDeletes.append(context.item());
+            d->schedulePendingJobs();
         } else {
             return false;
         }
     } else {
         if (context.moveTargetCollection().isValid() && context.item().storageCollectionId() != context.moveTargetCollection().id()) {
             if (itemCanDelete) {
-                auto moveJob = new Akonadi::ItemMoveJob(context.item(), context.moveTargetCollection(), this);
-                connect(moveJob, &Akonadi::ItemMoveJob::result, this, [this](KJob *job) {
-                    d->moveJobResult(job);
-                });
+                d->mPendingMoves[context.moveTargetCollection().id()].append(context.item());
+                d->schedulePendingJobs();
             } else {
                 return false;
             }
@@ -459,27 +769,20 @@ bool FilterManager::processContextItem(ItemContext context)
             // remoteid still holds the old one. Without clearing it, we try to enforce that on the new location, which is
             // anything but good (and the server replies with "NO Only resources can modify remote identifiers"
             item.setRemoteId(QString());
-            auto modifyJob = new Akonadi::ItemModifyJob(item, this);
-            modifyJob->disableRevisionCheck(); // no conflict handling for mails as no other process could change the mail body and we don't care about flag
-                                               // conflicts
-            // The below is a safety check to ignore modifying payloads if it was not requested,
-            // as in that case we might change the payload to an invalid one
-            modifyJob->setIgnorePayload(!context.needsFullPayload());
-            connect(modifyJob, &Akonadi::ItemModifyJob::result, this, [this](KJob *job) {
-                d->modifyJobResult(job);
-            });
+            d->mPendingModifies.append({item, context.needsFullPayload()});
+            d->schedulePendingJobs();
         }
     }
 
     return true;
 }
 
-bool FilterManager::process(const QVector<MailFilter *> &mailFilters,
-                            const Akonadi::Item &item,
-                            bool needsFullPayload,
-                            FilterManager::FilterSet set,
-                            bool account,
-                            const QString &accountId)
+bool FilterManager::Private::processFilters(const QVector<MailCommon::MailFilter *> &applicable,
+                                            const Akonadi::Item &item,
+                                            bool needsFullPayload,
+                                            FilterManager::FilterSet set,
+                                            const MatchResults *precomputed,
+                                            const QVector<int> *statisticsSlots)
 {
     if (set == NoSet) {
         qCDebug(MAILFILTERAGENT_LOG) << "FilterManager: process() called with not filter set selected";
@@ -493,46 +796,80 @@ bool FilterManager::process(const QVector<MailFilter *> &mailFilters,
 
     bool stopIt = false;
 
-    d->beginFiltering(item);
+    beginFiltering(item);
 
     ItemContext context(item, needsFullPayload);
-    QVector<MailCommon::MailFilter *>::const_iterator end(mailFilters.constEnd());
+    QVector<MailCommon::MailFilter *>::const_iterator end(applicable.constEnd());
 
     const bool applyOnOutbound = ((set & Outbound) || (set & BeforeOutbound));
 
-    for (QVector<MailCommon::MailFilter *>::const_iterator it = mailFilters.constBegin(); !stopIt && it != end; ++it) {
-        if ((*it)->isEnabled()) {
-            const bool inboundOk = ((set & Inbound) && (*it)->applyOnInbound());
-            const bool outboundOk = ((set & Outbound) && (*it)->applyOnOutbound());
-            const bool beforeOutboundOk = ((set & BeforeOutbound) && (*it)->applyBeforeOutbound());
-            const bool explicitOk = ((set & Explicit) && (*it)->applyOnExplicit());
-            const bool allFoldersOk = ((set & AllFolders) && (*it)->applyOnAllFoldersInbound());
-            const bool accountOk = (!account || (*it)->applyOnAccount(accountId));
-
-            if ((inboundOk && accountOk) || (allFoldersOk && accountOk) || outboundOk || beforeOutboundOk || explicitOk) {
-                // filter is applicable
-
-                if (d->isMatching(context.item(), *it)) {
-                    // execute actions:
-                    if ((*it)->execActions(context, stopIt, applyOnOutbound) == MailCommon::MailFilter::CriticalError) {
-                        return false;
-                    }
-                }
+    // precomputed results are only valid as long as no action modified the message
+    bool usePrecomputed = precomputed && (precomputed->results.size() == applicable.size());
+    QBitArray candidates;
+    if (!usePrecomputed) {
+        candidates = mPrefilter.candidates(item.payload<KMime::Message::Ptr>());
+    }
+    const QVector<int> slotsOfFilters = statisticsSlots ? *statisticsSlots : mStatistics.filterSlots(applicable);
+    for (QVector<MailCommon::MailFilter *>::const_iterator it = applicable.constBegin(); !stopIt && it != end; ++it) {
+        bool matches = false;
+        const int index = it - applicable.constBegin();
+        const int statisticsSlot = slotsOfFilters.at(index);
+        if (usePrecomputed) {
+            const qint8 result = precomputed->results.at(index);
+            if (result == SkippedByPrefilter) {
+                recordSkipped(item, *it, statisticsSlot);
+                continue;
+            }
+            matches = (result == Matched);
+            mStatistics.recordEvaluation(statisticsSlot, matches, precomputed->nsecs.at(index));
+        } else {
+            if (!mPrefilter.mayMatch(candidates, *it)) {
+                // none of the header terms this filter requires are present
+                recordSkipped(item, *it, statisticsSlot);
+                continue;
+            }
+            matches = isMatching(context.item(), *it, statisticsSlot);
+        }
+        if (matches) {
+            // execute actions:
+            recordActionsExecuted(item, *it, statisticsSlot);
+            if ((*it)->execActions(context, stopIt, applyOnOutbound) == MailCommon::MailFilter::CriticalError) {
+                return false;
             }
+            // actions may have rewritten the headers the prefilter and the rules looked at
+            usePrecomputed = false;
+            candidates = mPrefilter.candidates(context.item().payload<KMime::Message::Ptr>());
         }
     }
 
-    d->endFiltering(item);
-    if (!processContextItem(context)) {
+    endFiltering(item);
+    if (!q->processContextItem(context)) {
         return false;
     }
 
     return true;
 }
 
+bool FilterManager::process(const QVector<MailFilter *> &mailFilters,
+                            const Akonadi::Item &item,
+                            bool needsFullPayload,
+                            FilterManager::FilterSet set,
+                            bool account,
+                            const QString &accountId)
+{
+    QVector<MailCommon::MailFilter *> applicable;
+    applicable.reserve(mailFilters.size());
+    for (MailCommon::MailFilter *filter : mailFilters) {
+        if (Private::filterAppliesTo(filter, set, account, accountId)) {
+            applicable.append(filter);
+        }
+    }
+    return d->processFilters(applicable, item, needsFullPayload, set);
+}
+
 bool FilterManager::process(const Akonadi::Item &item, bool needsFullPayload, FilterSet set, bool account, const QString &accountId)
 {
-    return process(d->mFilters, item, needsFullPayload, set, account, accountId);
+    return d->processFilters(d->applicableFilters(set, account, accountId), item, needsFullPayload, set);
 }
 
 QString FilterManager::createUniqueName(const QString &name) const
@@ -578,58 +915,68 @@ void FilterManager::applySpecificFilters(const Akonadi::Item::List &selectedMess
                                          const QStringList &listFilters,
                                          FilterSet filterSet)
 {
-    Q_EMIT progressMessage(i18n("Filtering messages"));
-    d->mTotalProgressCount = selectedMessages.size();
-    d->mCurrentProgressCount = 0;
-
-    auto itemFetchJob = new Akonadi::ItemFetchJob(selectedMessages, this);
-    if (requiredPart == SearchRule::CompleteMessage) {
-        itemFetchJob->fetchScope().fetchFullPayload(true);
-    } else if (requiredPart == SearchRule::Header) {
-        itemFetchJob->fetchScope().fetchPayloadPart(Akonadi::MessagePart::Header, true);
-    } else {
-        itemFetchJob->fetchScope().fetchPayloadPart(Akonadi::MessagePart::Envelope, true);
+    if (selectedMessages.isEmpty()) {
+        return;
     }
+    Q_EMIT progressMessage(i18n("Filtering messages"));
+    auto progress = std::make_shared<Private::FilterProgress>();
+    progress->total = selectedMessages.size();
+
+    // Fetch the payloads in bounded chunks, with only a few fetches in flight,
+    // so that filtering a huge folder does not hold all of it in memory.
+    for (int i = 0, count = selectedMessages.size(); i < count; i += Private::FilterBatchSize) {
+        Private::FilterBatch batch;
+        batch.items = selectedMessages.mid(i, Private::FilterBatchSize);
+        batch.requiredPart = requiredPart;
+        batch.listFilters = listFilters;
+        batch.filterSet = filterSet;
+        batch.progress = progress;
+        ++progress->remainingBatches;
+        d->mPendingBatches.enqueue(batch);
+    }
+    d->startNextBatches();
+}
 
-    itemFetchJob->fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
-    itemFetchJob->setProperty("listFilters", QVariant::fromValue(listFilters));
-    itemFetchJob->setProperty("filterSet", QVariant::fromValue(static_cast<int>(filterSet)));
-    itemFetchJob->setProperty("needsFullPayload", requiredPart != SearchRule::Envelope);
+void FilterManager::applyFilters(const Akonadi::Item::List &selectedMessages, FilterSet filterSet)
+{
+    applySpecificFilters(selectedMessages, requiredPart(QString()), QStringList(), filterSet);
+}
 
-    connect(itemFetchJob, &Akonadi::ItemFetchJob::itemsReceived, this, [this](const Akonadi::Item::List &lst) {
-        d->slotItemsFetchedForFilter(lst);
-    });
-    connect(itemFetchJob, &Akonadi::ItemFetchJob::result, this, [this](KJob *job) {
-        d->itemsFetchJobForFilterDone(job);
-    });
+void FilterManager::applySpecificFiltersOnFetchedItems(const Akonadi::Item::List &items,
+                                                      bool needsFullPayload,
+                                                      const QStringList &listFilters,
+                                                      FilterSet filterSet)
+{
+    d->filterItems(items, listFilters, needsFullPayload, filterSet);
 }
 
-void FilterManager::applyFilters(const Akonadi::Item::List &selectedMessages, FilterSet filterSet)
+SearchRule::RequiredPart FilterManager::requiredPartForFilters(const QStringList &listFilters) const
 {
-    Q_EMIT progressMessage(i18n("Filtering messages"));
-    d->mTotalProgressCount = selectedMessages.size();
-    d->mCurrentProgressCount = 0;
-
-    auto itemFetchJob = new Akonadi::ItemFetchJob(selectedMessages, this);
-    SearchRule::RequiredPart requiredParts = requiredPart(QString());
-    if (requiredParts == SearchRule::CompleteMessage) {
-        itemFetchJob->fetchScope().fetchFullPayload(true);
-    } else if (requiredParts == SearchRule::Header) {
-        itemFetchJob->fetchScope().fetchPayloadPart(Akonadi::MessagePart::Header, true);
-    } else {
-        itemFetchJob->fetchScope().fetchPayloadPart(Akonadi::MessagePart::Envelope, true);
+    int part = SearchRule::Envelope;
+    for (const MailCommon::MailFilter *filter : std::as_const(d->mFilters)) {
+        if (!filter->isEnabled() || (!listFilters.isEmpty() && !listFilters.contains(filter->identifier()))) {
+            continue;
+        }
+        part = qMax(part, static_cast<int>(filter->pattern()->requiredPart()));
+        const QList<FilterAction *> actions = *filter->actions();
+        for (const FilterAction *action : actions) {
+            part = qMax(part, static_cast<int>(action->requiredPart()));
+        }
+        if (part == SearchRule::CompleteMessage) {
+            break;
+        }
     }
+    return static_cast<SearchRule::RequiredPart>(part);
+}
 
-    itemFetchJob->fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
-    itemFetchJob->setProperty("filterSet", QVariant::fromValue(static_cast<int>(filterSet)));
-    itemFetchJob->setProperty("needsFullPayload", requiredParts != SearchRule::Envelope);
+QByteArray FilterManager::statisticsAsJson() const
+{
+    return d->mStatistics.toJson();
+}
 
-    connect(itemFetchJob, &Akonadi::ItemFetchJob::itemsReceived, this, [this](const Akonadi::Item::List &lst) {
-        d->slotItemsFetchedForFilter(lst);
-    });
-    connect(itemFetchJob, &Akonadi::ItemFetchJob::result, this, [this](KJob *job) {
-        d->itemsFetchJobForFilterDone(job);
-    });
+void FilterManager::resetStatistics()
+{
+    d->mStatistics.clear();
 }
 
 bool FilterManager::hasAllFoldersFilter() const
@@ -108,6 +108,15 @@ public:
                               const QStringList &listFilters,
                               FilterSet set = Explicit);
 
+    /**
+     * Like applySpecificFilters(), but for @p items which have already been fetched
+     * with the payload part returned by requiredPartForFilters().
+     */
+    void applySpecificFiltersOnFetchedItems(const Akonadi::Item::List &items,
+                                            bool needsFullPayload,
+                                            const QStringList &listFilters,
+                                            FilterSet set = Explicit);
+
     /**
      * Applies the filters on the given @p messages.
      */
@@ -118,6 +127,12 @@ public:
      */
     Q_REQUIRED_RESULT MailCommon::SearchRule::RequiredPart requiredPart(const QString &id) const;
 
+    /**
+     * Returns the message part needed to evaluate the filters with the given
+     * identifiers and run their actions, or all filters if @p listFilters is empty.
+     */
+    Q_REQUIRED_RESULT MailCommon::SearchRule::RequiredPart requiredPartForFilters(const QStringList &listFilters) const;
+
     void mailCollectionRemoved(const Akonadi::Collection &collection);
     void agentRemoved(const QString &identifier);
 
@@ -128,6 +143,17 @@ public:
      */
     void dump() const;
 
+    /**
+     * Returns per filter evaluation counts, match counts, match times and
+     * executed actions as a JSON document.
+     */
+    Q_REQUIRED_RESULT QByteArray statisticsAsJson() const;
+
+    /**
+     * Resets the per filter statistics.
+     */
+    void resetStatistics();
+
 protected:
     Q_REQUIRED_RESULT bool processContextItem(MailCommon::ItemContext context);
 
@@ -0,0 +1,228 @@
+/*
+    SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "filterprefilter.h"
+
+#include <MailCommon/MailFilter>
+#include <MailCommon/SearchPattern>
+
+#include <QQueue>
+
+using namespace MailCommon;
+
+namespace
+{
+bool isLiteralRule(const SearchRule::Ptr &rule)
+{
+    if (rule->field().isEmpty() || rule->field().startsWith('<') || rule->contents().isEmpty()) {
+        return false;
+    }
+    switch (rule->function()) {
+    case SearchRule::FuncContains:
+    case SearchRule::FuncEquals:
+    case SearchRule::FuncStartWith:
+    case SearchRule::FuncEndWith:
+        // All of them imply that the (case insensitive) header value contains the rule contents
+        return true;
+    default:
+        return false;
+    }
+}
+
+QString headerText(const KMime::Message::Ptr &message, const QByteArray &field)
+{
+    QString text;
+    const auto headers = message->headersByType(field.constData());
+    for (const KMime::Headers::Base *header : headers) {
+        text += header->asUnicodeString();
+        text += QLatin1Char('\n');
+    }
+    return text;
+}
+}
+
+// Aho-Corasick automaton over case folded strings
+class FilterPrefilter::Matcher
+{
+public:
+    Matcher()
+        : mNodes(1)
+    {
+    }
+
+    void addPattern(const QString &pattern, int termId)
+    {
+        int state = 0;
+        for (const QChar c : pattern) {
+            int next = mNodes[state].next.value(c, -1);
+            if (next < 0) {
+                next = mNodes.size();
+                mNodes[state].next.insert(c, next);
+                mNodes.append(Node());
+            }
+            state = next;
+        }
+        mNodes[state].terms.append(termId);
+    }
+
+    void finalize()
+    {
+        QQueue<int> queue;
+        for (const int child : std::as_const(mNodes[0].next)) {
+            mNodes[child].fail = 0;
+            queue.enqueue(child);
+        }
+        while (!queue.isEmpty()) {
+            const int state = queue.dequeue();
+            for (auto it = mNodes[state].next.cbegin(), end = mNodes[state].next.cend(); it != end; ++it) {
+                const int child = it.value();
+                int fail = mNodes[state].fail;
+                while (fail > 0 && !mNodes[fail].next.contains(it.key())) {
+                    fail = mNodes[fail].fail;
+                }
+                const int failTarget = mNodes[fail].next.value(it.key(), 0);
+                mNodes[child].fail = (failTarget == child) ? 0 : failTarget;
+                mNodes[child].terms += mNodes[mNodes[child].fail].terms;
+                queue.enqueue(child);
+            }
+        }
+    }
+
+    void match(const QString &text, QBitArray &termHits) const
+    {
+        int state = 0;
+        for (const QChar c : text) {
+            while (state > 0 && !mNodes[state].next.contains(c)) {
+                state = mNodes[state].fail;
+            }
+            state = mNodes[state].next.value(c, 0);
+            for (const int termId : mNodes[state].terms) {
+                termHits.setBit(termId);
+            }
+        }
+    }
+
+private:
+    struct Node {
+        QHash<QChar, int> next;
+        int fail = 0;
+        QVector<int> terms;
+    };
+    QVector<Node> mNodes;
+};
+
+FilterPrefilter::FilterPrefilter() = default;
+
+FilterPrefilter::~FilterPrefilter()
+{
+    clear();
+}
+
+void FilterPrefilter::clear()
+{
+    qDeleteAll(mMatchers);
+    mMatchers.clear();
+    mTerms.clear();
+    mFilterTerms.clear();
+    mFilterIndexes.clear();
+    mUnindexedFilters.clear();
+}
+
+void FilterPrefilter::addTerm(const QByteArray &field, const QString &contents, int filterIndex)
+{
+    const QByteArray key = field.toLower();
+    Matcher *matcher = mMatchers.value(key);
+    if (!matcher) {
+        matcher = new Matcher;
+        mMatchers.insert(key, matcher);
+    }
+    matcher->addPattern(contents.toCaseFolded(), mTerms.size());
+    mTerms.append({filterIndex});
+    ++mFilterTerms[filterIndex].termCount;
+}
+
+void FilterPrefilter::build(const QVector<MailCommon::MailFilter *> &filters)
+{
+    clear();
+
+    const int count = filters.size();
+    mFilterTerms.resize(count);
+    mUnindexedFilters.resize(count);
+    for (int i = 0; i < count; ++i) {
+        const MailFilter *filter = filters.at(i);
+        mFilterIndexes.insert(filter, i);
+
+        const SearchPattern *pattern = filter->pattern();
+        bool indexable = !pattern->isEmpty() && pattern->op() != SearchPattern::OpAll;
+        QVector<SearchRule::Ptr> literalRules;
+        if (indexable) {
+            for (const SearchRule::Ptr &rule : *pattern) {
+                if (isLiteralRule(rule)) {
+                    literalRules.append(rule);
+                } else if (pattern->op() == SearchPattern::OpOr) {
+                    // any other rule could match on its own
+                    indexable = false;
+                    break;
+                }
+            }
+        }
+        if (!indexable || literalRules.isEmpty()) {
+            mUnindexedFilters.setBit(i);
+            continue;
+        }
+
+        mFilterTerms[i].requireAll = (pattern->op() == SearchPattern::OpAnd);
+        for (const SearchRule::Ptr &rule : std::as_const(literalRules)) {
+            addTerm(rule->field(), rule->contents(), i);
+        }
+    }
+
+    for (Matcher *matcher : std::as_const(mMatchers)) {
+        matcher->finalize();
+    }
+}
+
+QBitArray FilterPrefilter::candidates(const KMime::Message::Ptr &message) const
+{
+    QBitArray result = mUnindexedFilters;
+    if (mTerms.isEmpty()) {
+        return result;
+    }
+
+    QBitArray termHits(mTerms.size());
+    for (auto it = mMatchers.cbegin(), end = mMatchers.cend(); it != end; ++it) {
+        const QString text = headerText(message, it.key());
+        if (!text.isEmpty()) {
+            it.value()->match(text.toCaseFolded(), termHits);
+        }
+    }
+
+    QVector<int> hitCounts(mFilterTerms.size(), 0);
+    for (int termId = 0, termCount = mTerms.size(); termId < termCount; ++termId) {
+        if (termHits.testBit(termId)) {
+            ++hitCounts[mTerms.at(termId).filterIndex];
+        }
+    }
+    for (int i = 0, count = mFilterTerms.size(); i < count; ++i) {
+        const FilterTerms &terms = mFilterTerms.at(i);
+        if (terms.termCount == 0) {
+            continue;
+        }
+        if (terms.requireAll ? (hitCounts.at(i) == terms.termCount) : (hitCounts.at(i) > 0)) {
+            result.setBit(i);
+        }
+    }
+    return result;
+}
+
+bool FilterPrefilter::mayMatch(const QBitArray &candidates, const MailCommon::MailFilter *filter) const
+{
+    const int index = mFilterIndexes.value(filter, -1);
+    if (index < 0 || index >= candidates.size()) {
+        return true;
+    }
+    return candidates.testBit(index);
+}
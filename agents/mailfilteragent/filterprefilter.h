@@ -0,0 +1,72 @@
+/*
+    SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <KMime/Message>
+
+#include <QBitArray>
+#include <QHash>
+#include <QVector>
+
+namespace MailCommon
+{
+class MailFilter;
+}
+
+/**
+ * Cheap first pass run before the full MailCommon::SearchPattern evaluation.
+ *
+ * When the filters are loaded, the literal header terms ("Subject contains foo",
+ * "From equals bar@example.org", ...) are extracted from their patterns and
+ * compiled into one Aho-Corasick automaton per header field. For a message, each
+ * interesting header is scanned once and only the filters whose terms were found
+ * are reported as candidates. Filters from which no such term can be extracted
+ * are always candidates.
+ */
+class FilterPrefilter
+{
+public:
+    FilterPrefilter();
+    ~FilterPrefilter();
+
+    /**
+     * Rebuilds the index from @p filters. The filters must stay alive until the next
+     * call to build() or clear().
+     */
+    void build(const QVector<MailCommon::MailFilter *> &filters);
+    void clear();
+
+    /**
+     * Returns the set of filters which may match @p message, indexed like the list
+     * passed to build().
+     */
+    Q_REQUIRED_RESULT QBitArray candidates(const KMime::Message::Ptr &message) const;
+
+    /**
+     * Returns whether @p filter has to be fully evaluated according to @p candidates.
+     */
+    Q_REQUIRED_RESULT bool mayMatch(const QBitArray &candidates, const MailCommon::MailFilter *filter) const;
+
+private:
+    class Matcher;
+    struct Term {
+        int filterIndex;
+    };
+    struct FilterTerms {
+        int termCount = 0;
+        bool requireAll = false;
+    };
+
+    void addTerm(const QByteArray &field, const QString &contents, int filterIndex);
+
+    QHash<QByteArray, Matcher *> mMatchers;
+    QVector<Term> mTerms;
+    QVector<FilterTerms> mFilterTerms;
+    QHash<const MailCommon::MailFilter *, int> mFilterIndexes;
+    QBitArray mUnindexedFilters;
+};
+
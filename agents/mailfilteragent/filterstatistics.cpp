@@ -0,0 +1,126 @@
+/*
+    SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "filterstatistics.h"
+
+#include <MailCommon/MailFilter>
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+
+namespace
+{
+constexpr int MaximumSamples = 1000;
+}
+
+FilterStatistics::FilterStatistics() = default;
+
+FilterStatistics::~FilterStatistics() = default;
+
+void FilterStatistics::setFilters(const QVector<MailCommon::MailFilter *> &filters)
+{
+    mSlots.clear();
+    for (const MailCommon::MailFilter *filter : filters) {
+        auto it = mSlotsByIdentifier.constFind(filter->identifier());
+        if (it == mSlotsByIdentifier.constEnd()) {
+            it = mSlotsByIdentifier.insert(filter->identifier(), mCounters.count());
+            mCounters.append(Counters());
+            mCounters.last().identifier = filter->identifier();
+        }
+        mCounters[it.value()].name = filter->name();
+        mSlots.insert(filter, it.value());
+    }
+}
+
+int FilterStatistics::slot(const MailCommon::MailFilter *filter) const
+{
+    return mSlots.value(filter, -1);
+}
+
+QVector<int> FilterStatistics::filterSlots(const QVector<MailCommon::MailFilter *> &filters) const
+{
+    QVector<int> result;
+    result.reserve(filters.count());
+    for (const MailCommon::MailFilter *filter : filters) {
+        result.append(slot(filter));
+    }
+    return result;
+}
+
+void FilterStatistics::recordEvaluation(int slot, bool matched, qint64 elapsedNSecs)
+{
+    if (slot < 0) {
+        return;
+    }
+    Counters &c = mCounters[slot];
+    ++c.evaluations;
+    if (matched) {
+        ++c.matches;
+    }
+    c.totalMatchTimeNSecs += elapsedNSecs;
+    if (c.samples.size() < MaximumSamples) {
+        c.samples.append(elapsedNSecs);
+    } else {
+        c.samples[c.nextSample] = elapsedNSecs;
+        c.nextSample = (c.nextSample + 1) % MaximumSamples;
+    }
+}
+
+void FilterStatistics::recordSkipped(int slot)
+{
+    if (slot >= 0) {
+        ++mCounters[slot].skipped;
+    }
+}
+
+void FilterStatistics::recordActionsExecuted(int slot)
+{
+    if (slot >= 0) {
+        ++mCounters[slot].actionsExecuted;
+    }
+}
+
+void FilterStatistics::clear()
+{
+    for (Counters &c : mCounters) {
+        Counters cleared;
+        cleared.identifier = c.identifier;
+        cleared.name = c.name;
+        c = cleared;
+    }
+}
+
+qint64 FilterStatistics::percentile(const Counters &counters, int percent)
+{
+    if (counters.samples.isEmpty()) {
+        return 0;
+    }
+    QVector<qint64> samples = counters.samples;
+    const int index = std::min<int>(samples.size() - 1, (samples.size() * percent) / 100);
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples.at(index);
+}
+
+QByteArray FilterStatistics::toJson() const
+{
+    QJsonArray filters;
+    for (const Counters &c : mCounters) {
+        QJsonObject obj;
+        obj[QStringLiteral("identifier")] = c.identifier;
+        obj[QStringLiteral("name")] = c.name;
+        obj[QStringLiteral("evaluations")] = c.evaluations;
+        obj[QStringLiteral("matches")] = c.matches;
+        obj[QStringLiteral("skippedByPrefilter")] = c.skipped;
+        obj[QStringLiteral("actionsExecuted")] = c.actionsExecuted;
+        obj[QStringLiteral("totalMatchTimeUSecs")] = c.totalMatchTimeNSecs / 1000;
+        obj[QStringLiteral("p99MatchTimeUSecs")] = percentile(c, 99) / 1000;
+        filters.append(obj);
+    }
+    return QJsonDocument(filters).toJson(QJsonDocument::Indented);
+}
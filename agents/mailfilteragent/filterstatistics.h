@@ -0,0 +1,77 @@
+/*
+    SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+namespace MailCommon
+{
+class MailFilter;
+}
+
+/**
+ * Collects per filter performance counters, keyed by filter identifier so that
+ * they survive a reload of the filter configuration.
+ *
+ * The counters of a filter live in a slot which is looked up once when the
+ * filter list is loaded, the filtering code records through the slot.
+ */
+class FilterStatistics
+{
+public:
+    FilterStatistics();
+    ~FilterStatistics();
+
+    /**
+     * Assigns a slot to each of @p filters, reusing the slot of a filter with
+     * the same identifier. Call it whenever the filter list is loaded.
+     */
+    void setFilters(const QVector<MailCommon::MailFilter *> &filters);
+
+    /**
+     * Returns the slot of @p filter, or -1 if it wasn't passed to setFilters().
+     */
+    Q_REQUIRED_RESULT int slot(const MailCommon::MailFilter *filter) const;
+    Q_REQUIRED_RESULT QVector<int> filterSlots(const QVector<MailCommon::MailFilter *> &filters) const;
+
+    void recordEvaluation(int slot, bool matched, qint64 elapsedNSecs);
+    void recordSkipped(int slot);
+    void recordActionsExecuted(int slot);
+
+    /**
+     * Resets the counters, the slots stay valid.
+     */
+    void clear();
+
+    /**
+     * Returns the statistics of all filters as a JSON array.
+     */
+    Q_REQUIRED_RESULT QByteArray toJson() const;
+
+private:
+    struct Counters {
+        QString identifier;
+        QString name;
+        qint64 evaluations = 0;
+        qint64 matches = 0;
+        qint64 skipped = 0;
+        qint64 actionsExecuted = 0;
+        qint64 totalMatchTimeNSecs = 0;
+        // last evaluation times, used to compute the percentile
+        QVector<qint64> samples;
+        int nextSample = 0;
+    };
+
+    static qint64 percentile(const Counters &counters, int percent);
+
+    QVector<Counters> mCounters;
+    QHash<QString, int> mSlotsByIdentifier;
+    QHash<const MailCommon::MailFilter *, int> mSlots;
+};
+
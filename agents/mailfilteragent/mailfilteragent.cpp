@@ -6,7 +6,9 @@
 
 #include "mailfilteragent.h"
 
+#include "bulkfilterjob.h"
 #include "dummykernel.h"
+#include "filtereventlog.h"
 #include "filterlogdialog.h"
 #include "filtermanager.h"
 #include "mailfilteragentadaptor.h"
@@ -37,8 +39,18 @@
 #include <QTimer>
 
 #include <chrono>
+#include <utility>
 
 using namespace std::chrono_literals;
+
+namespace
+{
+// New items are collected for this long before being fetched in one job...
+constexpr auto PendingItemsDelay = 500ms;
+// ...unless that many items are already waiting.
+constexpr int MaximumPendingItems = 500;
+}
+
 #include <kcoreaddons_version.h>
 #if KCOREADDONS_VERSION < QT_VERSION_CHECK(6, 0, 0)
 #include <Kdelibs4ConfigMigrator>
@@ -73,6 +85,11 @@ MailFilterAgent::MailFilterAgent(const QString &id)
     connect(m_filterManager, &FilterManager::percent, this, &MailFilterAgent::emitProgress);
     connect(m_filterManager, &FilterManager::progressMessage, this, &MailFilterAgent::emitProgressMessage);
 
+    mBulkFilterJob = new BulkFilterJob(m_filterManager, this);
+    connect(mBulkFilterJob, &BulkFilterJob::progressMessage, this, &MailFilterAgent::emitProgressMessage);
+    connect(mBulkFilterJob, &BulkFilterJob::percent, this, &MailFilterAgent::emitProgress);
+    mBulkFilterJob->restore();
+
     auto collectionMonitor = new Akonadi::Monitor(this);
     collectionMonitor->setObjectName(QStringLiteral("MailFilterCollectionMonitor"));
     collectionMonitor->fetchCollection(true);
@@ -101,6 +118,7 @@ MailFilterAgent::MailFilterAgent(const QString &id)
     KSharedConfig::Ptr config = KSharedConfig::openConfig();
     if (config->hasGroup("FilterLog")) {
         KConfigGroup group(config, "FilterLog");
+        FilterEventLog::self()->setCapacity(group.readEntry("MaxRecords", 10000));
         if (group.readEntry("Enabled", false)) {
             auto notify = new KNotification(QStringLiteral("mailfilterlogenabled"));
             notify->setComponentName(QApplication::applicationDisplayName());
@@ -126,6 +144,11 @@ MailFilterAgent::MailFilterAgent(const QString &id)
     itemMonitor->itemFetchScope().setFetchRemoteIdentification(true);
     itemMonitor->itemFetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
     connect(itemMonitor, &Akonadi::Monitor::itemChanged, this, &MailFilterAgent::slotItemChanged);
+
+    mPendingItemsTimer = new QTimer(this);
+    mPendingItemsTimer->setSingleShot(true);
+    mPendingItemsTimer->setInterval(PendingItemsDelay);
+    connect(mPendingItemsTimer, &QTimer::timeout, this, &MailFilterAgent::flushPendingItems);
 }
 
 MailFilterAgent::~MailFilterAgent()
@@ -211,9 +234,29 @@ void MailFilterAgent::slotItemChanged(const Akonadi::Item &item)
 
 void MailFilterAgent::filterItem(const Akonadi::Item &item, const Akonadi::Collection &collection)
 {
-    MailCommon::SearchRule::RequiredPart requiredPart = m_filterManager->requiredPart(collection.resource());
+    mPendingItems[collection.resource()].append(item);
+    if (++mPendingItemsCount >= MaximumPendingItems) {
+        flushPendingItems();
+    } else if (!mPendingItemsTimer->isActive()) {
+        mPendingItemsTimer->start();
+    }
+}
 
-    auto job = new Akonadi::ItemFetchJob(item);
+void MailFilterAgent::flushPendingItems()
+{
+    mPendingItemsTimer->stop();
+    const auto pendingItems = std::exchange(mPendingItems, {});
+    mPendingItemsCount = 0;
+    for (auto it = pendingItems.cbegin(), end = pendingItems.cend(); it != end; ++it) {
+        fetchItemsForFiltering(it.value(), it.key());
+    }
+}
+
+void MailFilterAgent::fetchItemsForFiltering(const Akonadi::Item::List &items, const QString &resource)
+{
+    MailCommon::SearchRule::RequiredPart requiredPart = m_filterManager->requiredPart(resource);
+
+    auto job = new Akonadi::ItemFetchJob(items, this);
     connect(job, &Akonadi::ItemFetchJob::itemsReceived, this, &MailFilterAgent::itemsReceiviedForFiltering);
     if (requiredPart == MailCommon::SearchRule::CompleteMessage) {
         job->fetchScope().fetchFullPayload();
@@ -224,9 +267,21 @@ void MailFilterAgent::filterItem(const Akonadi::Item &item, const Akonadi::Colle
     }
     job->fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
     job->fetchScope().fetchAttribute<Akonadi::Pop3ResourceAttribute>();
-    job->setProperty("resource", collection.resource());
-
-    // TODO: Error handling?
+    job->setDeliveryOption(Akonadi::ItemFetchJob::EmitItemsInBatches);
+    job->setProperty("resource", resource);
+    connect(job, &Akonadi::ItemFetchJob::result, this, [this, items, resource](KJob *job) {
+        if (!job->error()) {
+            return;
+        }
+        // One item removed in the meantime makes the whole fetch fail, split the batch to filter the other ones
+        if (items.count() > 1) {
+            const int half = items.count() / 2;
+            fetchItemsForFiltering(items.mid(0, half), resource);
+            fetchItemsForFiltering(items.mid(half), resource);
+        } else {
+            qCWarning(MAILFILTERAGENT_LOG) << "Error while fetching items for filtering:" << job->errorString();
+        }
+    });
 }
 
 void MailFilterAgent::itemsReceiviedForFiltering(const Akonadi::Item::List &items)
@@ -236,33 +291,39 @@ void MailFilterAgent::itemsReceiviedForFiltering(const Akonadi::Item::List &item
         return;
     }
 
-    Akonadi::Item item = items.first();
-    /*
-     * happens when item no longer exists etc, and queue compression didn't happen yet
-     */
-    if (!item.hasPayload()) {
-        qCDebug(MAILFILTERAGENT_LOG) << "MailFilterAgent::itemsReceiviedForFiltering item has no payload!";
-        return;
-    }
+    const QString jobResource = sender()->property("resource").toString();
+    QString lastResource;
+    for (const Akonadi::Item &item : items) {
+        /*
+         * happens when item no longer exists etc, and queue compression didn't happen yet
+         */
+        if (!item.hasPayload()) {
+            qCDebug(MAILFILTERAGENT_LOG) << "MailFilterAgent::itemsReceiviedForFiltering item has no payload!";
+            continue;
+        }
 
-    Akonadi::MessageStatus status;
-    status.setStatusFromFlags(item.flags());
-    if (status.isRead() || status.isSpam() || status.isIgnored()) {
-        return;
-    }
+        Akonadi::MessageStatus status;
+        status.setStatusFromFlags(item.flags());
+        if (status.isRead() || status.isSpam() || status.isIgnored()) {
+            continue;
+        }
 
-    QString resource = sender()->property("resource").toString();
-    const Akonadi::Pop3ResourceAttribute *pop3ResourceAttribute = item.attribute<Akonadi::Pop3ResourceAttribute>();
-    if (pop3ResourceAttribute) {
-        resource = pop3ResourceAttribute->pop3AccountName();
-    }
+        QString resource = jobResource;
+        const Akonadi::Pop3ResourceAttribute *pop3ResourceAttribute = item.attribute<Akonadi::Pop3ResourceAttribute>();
+        if (pop3ResourceAttribute) {
+            resource = pop3ResourceAttribute->pop3AccountName();
+        }
 
-    emitProgressMessage(i18n("Filtering in %1", Akonadi::AgentManager::self()->instance(resource).name()));
-    if (!m_filterManager->process(item, m_filterManager->requiredPart(resource), FilterManager::Inbound, true, resource)) {
-        qCWarning(MAILFILTERAGENT_LOG) << "Impossible to process mails";
-    }
+        if (resource != lastResource) {
+            emitProgressMessage(i18n("Filtering in %1", Akonadi::AgentManager::self()->instance(resource).name()));
+            lastResource = resource;
+        }
+        if (!m_filterManager->process(item, m_filterManager->requiredPart(resource), FilterManager::Inbound, true, resource)) {
+            qCWarning(MAILFILTERAGENT_LOG) << "Impossible to process mails";
+        }
 
-    emitProgress(++mProgressCounter);
+        emitProgress(++mProgressCounter);
+    }
 
     mProgressTimer->start(1000);
 }
@@ -303,13 +364,7 @@ void MailFilterAgent::filterItems(const QList<qint64> &itemIds, int filterSet)
 
 void MailFilterAgent::filterCollections(const QList<qint64> &collections, int filterSet)
 {
-    for (qint64 id : collections) {
-        auto ifj = new Akonadi::ItemFetchJob{Akonadi::Collection{id}, this};
-        ifj->setDeliveryOption(Akonadi::ItemFetchJob::EmitItemsInBatches);
-        connect(ifj, &Akonadi::ItemFetchJob::itemsReceived, this, [=](const Akonadi::Item::List &items) {
-            m_filterManager->applyFilters(items, static_cast<FilterManager::FilterSet>(filterSet));
-        });
-    }
+    mBulkFilterJob->addCollections(collections, QStringList(), static_cast<FilterManager::FilterSet>(filterSet));
 }
 
 void MailFilterAgent::applySpecificFilters(const QList<qint64> &itemIds, int requiresPart, const QStringList &listFilters)
@@ -325,16 +380,32 @@ void MailFilterAgent::applySpecificFilters(const QList<qint64> &itemIds, int req
 
 void MailFilterAgent::applySpecificFiltersOnCollections(const QList<qint64> &colIds, const QStringList &listFilters, int filterSet)
 {
-    // TODO: Actually calculate this based on the listFilters' requirements
-    const auto requiresParts = MailCommon::SearchRule::CompleteMessage;
+    mBulkFilterJob->addCollections(colIds, listFilters, static_cast<FilterManager::FilterSet>(filterSet));
+}
 
-    for (qint64 id : colIds) {
-        auto ifj = new Akonadi::ItemFetchJob{Akonadi::Collection{id}, this};
-        ifj->setDeliveryOption(Akonadi::ItemFetchJob::EmitItemsInBatches);
-        connect(ifj, &Akonadi::ItemFetchJob::itemsReceived, this, [=](const Akonadi::Item::List &items) {
-            m_filterManager->applySpecificFilters(items, requiresParts, listFilters, static_cast<FilterManager::FilterSet>(filterSet));
-        });
-    }
+void MailFilterAgent::pauseBulkFiltering()
+{
+    mBulkFilterJob->pause();
+}
+
+void MailFilterAgent::resumeBulkFiltering()
+{
+    mBulkFilterJob->resume();
+}
+
+void MailFilterAgent::cancelBulkFiltering()
+{
+    mBulkFilterJob->cancel();
+}
+
+QString MailFilterAgent::bulkFilteringProgress() const
+{
+    return QString::fromUtf8(mBulkFilterJob->progressAsJson());
+}
+
+void MailFilterAgent::setBulkFilteringThroughput(int itemsPerSecond)
+{
+    mBulkFilterJob->setMaximumItemsPerSecond(itemsPerSecond);
 }
 
 void MailFilterAgent::filterItem(qint64 item, int filterSet, const QString &resourceId)
@@ -369,6 +440,11 @@ void MailFilterAgent::showFilterLogDialog(qlonglong windowId)
     m_filterLogDialog->setModal(false);
 }
 
+bool MailFilterAgent::exportFilterLog(const QString &fileName) const
+{
+    return FilterEventLog::self()->exportToFile(fileName);
+}
+
 void MailFilterAgent::emitProgress(int p)
 {
     if (p == 0) {
@@ -402,6 +478,16 @@ QString MailFilterAgent::printCollectionMonitored() const
     return printDebugCollection;
 }
 
+QString MailFilterAgent::filterStatistics() const
+{
+    return QString::fromUtf8(m_filterManager->statisticsAsJson());
+}
+
+void MailFilterAgent::resetFilterStatistics()
+{
+    m_filterManager->resetStatistics();
+}
+
 void MailFilterAgent::expunge(qint64 collectionId)
 {
     mMailFilterKernel->expunge(collectionId, false);
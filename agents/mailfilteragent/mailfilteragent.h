@@ -14,6 +14,9 @@
 
 #include <AkonadiCore/AgentInstance>
 
+#include <QHash>
+
+class BulkFilterJob;
 class FilterLogDialog;
 class FilterManager;
 class KJob;
@@ -41,10 +44,19 @@ public:
     void applySpecificFilters(const QList<qint64> &itemIds, int requiresPart, const QStringList &listFilters);
     void applySpecificFiltersOnCollections(const QList<qint64> &colIds, const QStringList &listFilters, int filterSet);
 
+    void pauseBulkFiltering();
+    void resumeBulkFiltering();
+    void cancelBulkFiltering();
+    Q_REQUIRED_RESULT QString bulkFilteringProgress() const;
+    void setBulkFilteringThroughput(int itemsPerSecond);
+
     void reload();
 
     void showFilterLogDialog(qlonglong windowId = 0);
+    Q_REQUIRED_RESULT bool exportFilterLog(const QString &fileName) const;
     Q_REQUIRED_RESULT QString printCollectionMonitored() const;
+    Q_REQUIRED_RESULT QString filterStatistics() const;
+    void resetFilterStatistics();
 
     void expunge(qint64 collectionId);
 
@@ -63,6 +75,7 @@ private Q_SLOTS:
     void clearMessage();
     void slotInstanceRemoved(const Akonadi::AgentInstance &instance);
     void slotItemChanged(const Akonadi::Item &item);
+    void flushPendingItems();
 
 public Q_SLOTS:
     void configure(WId windowId) override;
@@ -71,13 +84,19 @@ private:
     bool isFilterableCollection(const Akonadi::Collection &collection) const;
 
     FilterManager *m_filterManager = nullptr;
+    BulkFilterJob *mBulkFilterJob = nullptr;
 
     FilterLogDialog *m_filterLogDialog = nullptr;
     QTimer *mProgressTimer = nullptr;
     DummyKernel *mMailFilterKernel = nullptr;
     int mProgressCounter;
     Akonadi::Monitor *itemMonitor = nullptr;
+    // new items waiting to be fetched and filtered, grouped by resource
+    QHash<QString, Akonadi::Item::List> mPendingItems;
+    QTimer *mPendingItemsTimer = nullptr;
+    int mPendingItemsCount = 0;
 
     void filterItem(const Akonadi::Item &item, const Akonadi::Collection &collection);
+    void fetchItemsForFiltering(const Akonadi::Item::List &items, const QString &resource);
 };
 
@@ -0,0 +1,153 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "sendlaterqueuetest.h"
+#include "sendlaterqueue.h"
+
+#include <MessageComposer/SendLaterInfo>
+
+#include <QTest>
+
+#include <memory>
+
+namespace
+{
+MessageComposer::SendLaterInfo *createInfo(Akonadi::Item::Id id, int minutes)
+{
+    auto info = new MessageComposer::SendLaterInfo;
+    info->setItemId(id);
+    info->setDateTime(QDateTime(QDate(2021, 3, 1), QTime(12, 0)).addSecs(minutes * 60));
+    return info;
+}
+}
+
+SendLaterQueueTest::SendLaterQueueTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void SendLaterQueueTest::shouldBeEmptyByDefault()
+{
+    SendLaterQueue queue;
+    QVERIFY(queue.isEmpty());
+    QCOMPARE(queue.count(), 0);
+    QVERIFY(!queue.top());
+    QVERIFY(!queue.takeTop());
+    QVERIFY(!queue.find(1));
+}
+
+void SendLaterQueueTest::shouldReturnInfosBySendTime()
+{
+    SendLaterQueue queue;
+    const QList<int> minutes = {50, 10, 40, 30, 20, 70, 60, 0};
+    for (int i = 0; i < minutes.count(); ++i) {
+        queue.insert(createInfo(i + 1, minutes.at(i)));
+    }
+    QCOMPARE(queue.count(), minutes.count());
+    QCOMPARE(queue.sortedInfos().constFirst()->itemId(), Akonadi::Item::Id(8));
+
+    QDateTime previous;
+    while (!queue.isEmpty()) {
+        std::unique_ptr<MessageComposer::SendLaterInfo> info{queue.takeTop()};
+        QVERIFY(!previous.isValid() || previous <= info->dateTime());
+        previous = info->dateTime();
+    }
+}
+
+void SendLaterQueueTest::shouldTakeById()
+{
+    SendLaterQueue queue;
+    for (int i = 0; i < 10; ++i) {
+        queue.insert(createInfo(i, (i * 7) % 10));
+    }
+    std::unique_ptr<MessageComposer::SendLaterInfo> info{queue.take(3)};
+    QVERIFY(info);
+    QCOMPARE(info->itemId(), Akonadi::Item::Id(3));
+    QVERIFY(!queue.find(3));
+    QVERIFY(!queue.take(3));
+    QCOMPARE(queue.count(), 9);
+
+    const QVector<MessageComposer::SendLaterInfo *> sorted = queue.sortedInfos();
+    for (MessageComposer::SendLaterInfo *expected : sorted) {
+        std::unique_ptr<MessageComposer::SendLaterInfo> top{queue.takeTop()};
+        QCOMPARE(top->dateTime(), expected->dateTime());
+    }
+}
+
+void SendLaterQueueTest::shouldUpdateSendTime()
+{
+    SendLaterQueue queue;
+    queue.insert(createInfo(1, 10));
+    queue.insert(createInfo(2, 20));
+    queue.insert(createInfo(3, 30));
+    QCOMPARE(queue.top()->itemId(), Akonadi::Item::Id(1));
+
+    MessageComposer::SendLaterInfo *info = queue.find(1);
+    info->setDateTime(info->dateTime().addSecs(60 * 60));
+    queue.update(1);
+    QCOMPARE(queue.top()->itemId(), Akonadi::Item::Id(2));
+
+    info = queue.find(3);
+    info->setDateTime(info->dateTime().addSecs(-60 * 60));
+    queue.update(3);
+    QCOMPARE(queue.top()->itemId(), Akonadi::Item::Id(3));
+}
+
+void SendLaterQueueTest::shouldReplaceInfoWithSameId()
+{
+    SendLaterQueue queue;
+    queue.insert(createInfo(1, 10));
+    queue.insert(createInfo(2, 20));
+    MessageComposer::SendLaterInfo *info = createInfo(1, 30);
+    queue.insert(info);
+    QCOMPARE(queue.count(), 2);
+    QCOMPARE(queue.find(1), info);
+    QCOMPARE(queue.top()->itemId(), Akonadi::Item::Id(2));
+
+    // Inserting the same info again keeps it
+    queue.insert(info);
+    QCOMPARE(queue.count(), 2);
+    QCOMPARE(queue.find(1), info);
+}
+
+void SendLaterQueueTest::shouldReturnInfosDueBefore()
+{
+    SendLaterQueue queue;
+    const QList<int> minutes = {50, 10, 40, 30, 20, 70, 60, 0, 35, 5};
+    for (int i = 0; i < minutes.count(); ++i) {
+        queue.insert(createInfo(i + 1, minutes.at(i)));
+    }
+    const QDateTime before = QDateTime(QDate(2021, 3, 1), QTime(12, 35));
+
+    QVector<Akonadi::Item::Id> ids;
+    const QVector<MessageComposer::SendLaterInfo *> infos = queue.infosDueBefore(before, 100);
+    for (const MessageComposer::SendLaterInfo *info : infos) {
+        ids.append(info->itemId());
+    }
+    QCOMPARE(ids, QVector<Akonadi::Item::Id>({8, 10, 2, 5, 4, 9}));
+
+    QCOMPARE(queue.infosDueBefore(before, 2), QVector<MessageComposer::SendLaterInfo *>({queue.find(8), queue.find(10)}));
+    QVERIFY(queue.infosDueBefore(before, 0).isEmpty());
+    QVERIFY(queue.infosDueBefore(before.addSecs(-60 * 60), 100).isEmpty());
+    QCOMPARE(queue.count(), minutes.count());
+}
+
+void SendLaterQueueTest::shouldReturnNextSendTimeAfter()
+{
+    SendLaterQueue queue;
+    QVERIFY(!queue.nextSendTimeAfter(QDateTime(QDate(2021, 3, 1), QTime(12, 0))).isValid());
+
+    const QList<int> minutes = {50, 10, 40, 30, 20, 70, 60, 0};
+    for (int i = 0; i < minutes.count(); ++i) {
+        queue.insert(createInfo(i + 1, minutes.at(i)));
+    }
+    QCOMPARE(queue.nextSendTimeAfter(QDateTime(QDate(2021, 3, 1), QTime(12, 10))), QDateTime(QDate(2021, 3, 1), QTime(12, 20)));
+    QCOMPARE(queue.nextSendTimeAfter(QDateTime(QDate(2021, 3, 1), QTime(11, 0))), QDateTime(QDate(2021, 3, 1), QTime(12, 0)));
+    QCOMPARE(queue.nextSendTimeAfter(QDateTime(QDate(2021, 3, 1), QTime(12, 55))), QDateTime(QDate(2021, 3, 1), QTime(13, 0)));
+    QVERIFY(!queue.nextSendTimeAfter(QDateTime(QDate(2021, 3, 1), QTime(13, 10))).isValid());
+}
+
+QTEST_GUILESS_MAIN(SendLaterQueueTest)
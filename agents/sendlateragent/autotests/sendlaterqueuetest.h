@@ -0,0 +1,25 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+
+class SendLaterQueueTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SendLaterQueueTest(QObject *parent = nullptr);
+
+private Q_SLOTS:
+    void shouldBeEmptyByDefault();
+    void shouldReturnInfosBySendTime();
+    void shouldTakeById();
+    void shouldUpdateSendTime();
+    void shouldReplaceInfoWithSameId();
+    void shouldReturnInfosDueBefore();
+    void shouldReturnNextSendTimeAfter();
+};
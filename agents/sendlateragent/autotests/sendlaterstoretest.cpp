@@ -0,0 +1,142 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "sendlaterstoretest.h"
+#include "sendlaterstore.h"
+#include "sendlaterutil.h"
+
+#include <MessageComposer/SendLaterInfo>
+
+#include <KConfigGroup>
+#include <QFile>
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <memory>
+
+namespace
+{
+MessageComposer::SendLaterInfo createInfo(Akonadi::Item::Id id, int minutes)
+{
+    MessageComposer::SendLaterInfo info;
+    info.setItemId(id);
+    info.setSubject(QStringLiteral("Subject %1").arg(id));
+    info.setTo(QStringLiteral("foo@kde.org"));
+    info.setDateTime(QDateTime(QDate(2021, 3, 1), QTime(12, 0)).addSecs(minutes * 60));
+    return info;
+}
+}
+
+SendLaterStoreTest::SendLaterStoreTest(QObject *parent)
+    : QObject(parent)
+{
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void SendLaterStoreTest::shouldPersistChanges()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.path() + QStringLiteral("/sendlater.journal");
+    {
+        SendLaterStore store(fileName);
+        QCOMPARE(store.count(), 0);
+        store.insert(createInfo(1, 10));
+        store.insert(createInfo(2, 20));
+        store.insert(createInfo(3, 30));
+        QVERIFY(store.remove(2));
+        QVERIFY(!store.remove(2));
+        MessageComposer::SendLaterInfo changed = createInfo(1, 40);
+        changed.setRecurrence(true);
+        store.insert(changed);
+        // Invalid infos are ignored
+        store.insert(MessageComposer::SendLaterInfo());
+    }
+
+    SendLaterStore store(fileName);
+    QCOMPARE(store.count(), 2);
+    QVERIFY(!store.contains(2));
+    std::unique_ptr<MessageComposer::SendLaterInfo> info{store.info(1)};
+    QVERIFY(info);
+    QCOMPARE(info->dateTime(), createInfo(1, 40).dateTime());
+    QCOMPARE(info->subject(), QStringLiteral("Subject 1"));
+    QVERIFY(info->isRecurrence());
+}
+
+void SendLaterStoreTest::shouldOrderBySendTime()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    SendLaterStore store(dir.path() + QStringLiteral("/sendlater.journal"));
+    store.insert(createInfo(1, 30));
+    store.insert(createInfo(2, 10));
+    store.insert(createInfo(3, 20));
+
+    const QVector<MessageComposer::SendLaterInfo *> infos = store.infos();
+    QCOMPARE(infos.count(), 3);
+    QCOMPARE(infos.at(0)->itemId(), Akonadi::Item::Id(2));
+    QCOMPARE(infos.at(1)->itemId(), Akonadi::Item::Id(3));
+    QCOMPARE(infos.at(2)->itemId(), Akonadi::Item::Id(1));
+    qDeleteAll(infos);
+}
+
+void SendLaterStoreTest::shouldMigrateFromConfig()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.path() + QStringLiteral("/sendlater.journal");
+    KSharedConfig::Ptr config = KSharedConfig::openConfig(dir.path() + QStringLiteral("/sendlaterrc"), KConfig::SimpleConfig);
+    MessageComposer::SendLaterInfo first = createInfo(1, 10);
+    MessageComposer::SendLaterInfo second = createInfo(2, 20);
+    SendLaterUtil::writeSendLaterInfo(config, &first);
+    SendLaterUtil::writeSendLaterInfo(config, &second);
+    config->group(QStringLiteral("General")).writeEntry("enabled", true);
+
+    {
+        SendLaterStore store(fileName, config);
+        QCOMPARE(store.count(), 2);
+    }
+    QVERIFY(QFile::exists(fileName));
+    QVERIFY(config->groupList().filter(QRegularExpression(QStringLiteral("SendLaterItem \\d+"))).isEmpty());
+    QVERIFY(config->hasGroup(QStringLiteral("General")));
+
+    // The migration is done only once
+    SendLaterUtil::writeSendLaterInfo(config, &first);
+    SendLaterStore store(fileName, config);
+    QCOMPARE(store.count(), 2);
+    QVERIFY(config->hasGroup(SendLaterUtil::sendLaterPattern().arg(1)));
+}
+
+void SendLaterStoreTest::shouldIgnoreTruncatedRecord()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.path() + QStringLiteral("/sendlater.journal");
+    {
+        SendLaterStore store(fileName);
+        store.insert(createInfo(1, 10));
+        store.insert(createInfo(2, 20));
+    }
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.resize(file.size() - 5));
+    file.close();
+
+    {
+        SendLaterStore store(fileName);
+        QCOMPARE(store.count(), 1);
+        QVERIFY(store.contains(1));
+        store.insert(createInfo(3, 30));
+    }
+    // The damaged record was dropped, later records can be read
+    SendLaterStore store(fileName);
+    QCOMPARE(store.count(), 2);
+    QVERIFY(store.contains(3));
+}
+
+QTEST_GUILESS_MAIN(SendLaterStoreTest)
@@ -0,0 +1,22 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+
+class SendLaterStoreTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SendLaterStoreTest(QObject *parent = nullptr);
+
+private Q_SLOTS:
+    void shouldPersistChanges();
+    void shouldOrderBySendTime();
+    void shouldMigrateFromConfig();
+    void shouldIgnoreTruncatedRecord();
+};
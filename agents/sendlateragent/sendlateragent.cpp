@@ -12,6 +12,7 @@
 #include "sendlaterinfo.h"
 #include "sendlatermanager.h"
 #include "sendlaterremovemessagejob.h"
+#include "sendlaterstore.h"
 #include "sendlaterutil.h"
 #include <AgentInstance>
 #include <AgentManager>
@@ -148,8 +149,8 @@ void SendLaterAgent::configure(WId windowId)
 
 void SendLaterAgent::removeItem(qint64 item)
 {
-    if (mManager->itemRemoved(item)) {
-        reload();
+    if (!mManager->itemRemoved(item)) {
+        qCDebug(SENDLATERAGENT_LOG) << "No message to send later with id" << item;
     }
 }
 
@@ -161,17 +162,17 @@ void SendLaterAgent::addItem(qint64 timestamp,
                              const QString &subject,
                              const QString &to)
 {
-    auto info = new MessageComposer::SendLaterInfo;
-    info->setDateTime(QDateTime::fromSecsSinceEpoch(timestamp));
-    info->setRecurrence(recurrence);
-    info->setRecurrenceEachValue(recurrenceValue);
-    info->setRecurrenceUnit(static_cast<MessageComposer::SendLaterInfo::RecurrenceUnit>(recurrenceUnit));
-    info->setItemId(id);
-    info->setSubject(subject);
-    info->setTo(to);
-
-    SendLaterUtil::writeSendLaterInfo(SendLaterUtil::defaultConfig(), info);
-    reload();
+    MessageComposer::SendLaterInfo info;
+    info.setDateTime(QDateTime::fromSecsSinceEpoch(timestamp));
+    info.setRecurrence(recurrence);
+    info.setRecurrenceEachValue(recurrenceValue);
+    info.setRecurrenceUnit(static_cast<MessageComposer::SendLaterInfo::RecurrenceUnit>(recurrenceUnit));
+    info.setItemId(id);
+    info.setSubject(subject);
+    info.setTo(to);
+
+    SendLaterStore::self()->insert(info);
+    mManager->itemAdded(id);
 }
 
 void SendLaterAgent::slotSendNow(Akonadi::Item::Id id)
@@ -181,14 +182,9 @@ void SendLaterAgent::slotSendNow(Akonadi::Item::Id id)
 
 void SendLaterAgent::itemsRemoved(const Akonadi::Item::List &items)
 {
-    bool needToReload = false;
     for (const Akonadi::Item &item : items) {
-        if (mManager->itemRemoved(item.id())) {
-            needToReload = true;
-        }
-    }
-    if (needToReload) {
-        reload();
+        // The manager drops the queued message itself, no need to reload
+        (void)mManager->itemRemoved(item.id());
     }
 }
 
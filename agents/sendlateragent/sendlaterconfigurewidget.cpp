@@ -6,7 +6,7 @@
 
 #include "sendlaterconfigurewidget.h"
 #include "sendlaterdialog.h"
-#include "sendlaterutil.h"
+#include "sendlaterstore.h"
 
 #include <MessageComposer/SendLaterDialog>
 #include <MessageComposer/SendLaterInfo>
@@ -17,14 +17,6 @@
 #include <QMenu>
 #include <QPointer>
 
-namespace
-{
-inline QString sendLaterItemPattern()
-{
-    return QStringLiteral("SendLaterItem \\d+");
-}
-}
-
 //#define DEBUG_MESSAGE_ID
 
 SendLaterItem::SendLaterItem(QTreeWidget *parent)
@@ -133,19 +125,11 @@ void SendLaterWidget::updateButtons()
 
 void SendLaterWidget::load()
 {
-    KSharedConfig::Ptr config = SendLaterUtil::defaultConfig();
-    const QStringList filterGroups = config->groupList().filter(QRegularExpression(sendLaterItemPattern()));
-    const int numberOfItem = filterGroups.count();
-    for (int i = 0; i < numberOfItem; ++i) {
-        KConfigGroup group = config->group(filterGroups.at(i));
-        auto info = SendLaterUtil::readSendLaterInfo(group);
-        if (info->isValid()) {
-            createOrUpdateItem(info);
-        } else {
-            delete info;
-        }
+    const QVector<MessageComposer::SendLaterInfo *> infos = SendLaterStore::self()->infos();
+    for (MessageComposer::SendLaterInfo *info : infos) {
+        createOrUpdateItem(info);
     }
-    mWidget->treeWidget->setShowDefaultText(numberOfItem == 0);
+    mWidget->treeWidget->setShowDefaultText(infos.isEmpty());
 }
 
 void SendLaterWidget::createOrUpdateItem(MessageComposer::SendLaterInfo *info, SendLaterItem *item)
@@ -169,24 +153,16 @@ void SendLaterWidget::save()
     if (!mChanged) {
         return;
     }
-    KSharedConfig::Ptr config = SendLaterUtil::defaultConfig();
-
-    // first, delete all filter groups:
-    const QStringList filterGroups = config->groupList().filter(QRegularExpression(sendLaterItemPattern()));
-
-    for (const QString &group : filterGroups) {
-        config->deleteGroup(group);
-    }
-
+    QVector<MessageComposer::SendLaterInfo *> infos;
     const int numberOfItem(mWidget->treeWidget->topLevelItemCount());
+    infos.reserve(numberOfItem);
     for (int i = 0; i < numberOfItem; ++i) {
         auto mailItem = static_cast<SendLaterItem *>(mWidget->treeWidget->topLevelItem(i));
         if (mailItem->info()) {
-            SendLaterUtil::writeSendLaterInfo(config, mailItem->info());
+            infos.append(mailItem->info());
         }
     }
-    config->sync();
-    config->reparseConfiguration();
+    SendLaterStore::self()->replaceAll(infos);
 }
 
 void SendLaterWidget::slotRemoveItem()
@@ -249,8 +225,6 @@ void SendLaterWidget::slotModifyItem()
 void SendLaterWidget::needToReload()
 {
     mWidget->treeWidget->clear();
-    KSharedConfig::Ptr config = SendLaterUtil::defaultConfig();
-    config->reparseConfiguration();
     load();
 }
 
@@ -23,6 +23,8 @@
 #include <KLocalizedString>
 #include <KNotification>
 
+#include <QTimer>
+
 SendLaterJob::SendLaterJob(SendLaterManager *manager, MessageComposer::SendLaterInfo *info, QObject *parent)
     : QObject(parent)
     , mManager(manager)
@@ -36,17 +38,31 @@ SendLaterJob::~SendLaterJob()
     qCDebug(SENDLATERAGENT_LOG) << " SendLaterJob::~SendLaterJob()" << this;
 }
 
+Akonadi::ItemFetchScope SendLaterJob::fetchScope()
+{
+    Akonadi::ItemFetchScope scope;
+    scope.fetchAttribute<MailTransport::TransportAttribute>();
+    scope.fetchAttribute<MailTransport::SentBehaviourAttribute>();
+    scope.setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
+    scope.fetchFullPayload(true);
+    return scope;
+}
+
+void SendLaterJob::setPrefetchedItem(const Akonadi::Item &item)
+{
+    mItem = item;
+}
+
 void SendLaterJob::start()
 {
     if (mInfo) {
-        if (mInfo->itemId() > -1) {
-            const Akonadi::Item item = Akonadi::Item(mInfo->itemId());
-            auto fetch = new Akonadi::ItemFetchJob(item, this);
-            mFetchScope.fetchAttribute<MailTransport::TransportAttribute>();
-            mFetchScope.fetchAttribute<MailTransport::SentBehaviourAttribute>();
-            mFetchScope.setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
-            mFetchScope.fetchFullPayload(true);
-            fetch->setFetchScope(mFetchScope);
+        if (mItem.isValid() && mItem.id() == mInfo->itemId() && mItem.hasPayload<KMime::Message::Ptr>()) {
+            // Don't send from the caller's stack, an error could open a dialog
+            QTimer::singleShot(0, this, &SendLaterJob::sendItem);
+        } else if (mInfo->itemId() > -1) {
+            mItem = Akonadi::Item();
+            auto fetch = new Akonadi::ItemFetchJob(Akonadi::Item(mInfo->itemId()), this);
+            fetch->setFetchScope(fetchScope());
             connect(fetch, &Akonadi::ItemFetchJob::itemsReceived, this, &SendLaterJob::slotMessageTransfered);
             connect(fetch, &Akonadi::ItemFetchJob::result, this, &SendLaterJob::slotJobFinished);
             fetch->start();
@@ -62,6 +78,9 @@ void SendLaterJob::start()
 
 void SendLaterJob::slotMessageTransfered(const Akonadi::Item::List &items)
 {
+    if (mFinished) {
+        return;
+    }
     if (items.isEmpty()) {
         sendError(i18n("No message found."), SendLaterManager::ItemNotFound);
         qCDebug(SENDLATERAGENT_LOG) << " slotMessageTransfered failed !";
@@ -77,10 +96,22 @@ void SendLaterJob::slotMessageTransfered(const Akonadi::Item::List &items)
 
 void SendLaterJob::slotJobFinished(KJob *job)
 {
+    if (mFinished) { // slotMessageTransfered() already reported an error
+        return;
+    }
     if (job->error()) {
         sendError(i18n("Cannot fetch message. %1", job->errorString()), SendLaterManager::CanNotFetchItem);
         return;
     }
+    if (!mItem.isValid()) {
+        sendError(i18n("No message found."), SendLaterManager::ItemNotFound);
+        return;
+    }
+    sendItem();
+}
+
+void SendLaterJob::sendItem()
+{
     if (!MailTransport::TransportManager::self()->showTransportCreationDialog(nullptr, MailTransport::TransportManager::IfNoTransportExists)) {
         qCDebug(SENDLATERAGENT_LOG) << " we can't create transport ";
         sendError(i18n("We can't create transport"), SendLaterManager::CanNotCreateTransport);
@@ -126,6 +157,7 @@ void SendLaterJob::slotDeleteItem(KJob *job)
 
 void SendLaterJob::sendDone()
 {
+    mFinished = true;
     KNotification::event(QStringLiteral("mailsend"),
                          QString(),
                          i18n("Message sent"),
@@ -139,6 +171,7 @@ void SendLaterJob::sendDone()
 
 void SendLaterJob::sendError(const QString &error, SendLaterManager::ErrorType type)
 {
+    mFinished = true;
     KNotification::event(QStringLiteral("mailsendfailed"),
                          QString(),
                          error,
@@ -26,18 +26,28 @@ public:
     SendLaterJob(SendLaterManager *manager, MessageComposer::SendLaterInfo *info, QObject *parent = nullptr);
     ~SendLaterJob() override;
 
+    /**
+     * Uses @p item, fetched ahead of the send time with fetchScope(), instead of fetching it.
+     */
+    void setPrefetchedItem(const Akonadi::Item &item);
     void start();
 
+    /**
+     * Returns the fetch scope needed to send a message.
+     */
+    Q_REQUIRED_RESULT static Akonadi::ItemFetchScope fetchScope();
+
 private:
+    void sendItem();
     void sendDone();
     void sendError(const QString &error, SendLaterManager::ErrorType type);
     void slotMessageTransfered(const Akonadi::Item::List &);
     void slotJobFinished(KJob *);
     void slotDeleteItem(KJob *);
     void updateAndCleanMessageBeforeSending(const KMime::Message::Ptr &msg);
-    Akonadi::ItemFetchScope mFetchScope;
     SendLaterManager *const mManager;
     MessageComposer::SendLaterInfo *const mInfo;
     Akonadi::Item mItem;
+    bool mFinished = false;
 };
 
@@ -5,98 +5,216 @@
 */
 
 #include "sendlatermanager.h"
+#include "sendlateragentsettings.h"
 #include "sendlaterjob.h"
+#include "sendlaterstore.h"
 #include "sendlaterutil.h"
 
 #include <MessageComposer/AkonadiSender>
 #include <MessageComposer/SendLaterInfo>
 #include <MessageComposer/Util>
 
+#include <MailTransport/TransportManager>
+
+#include <ItemFetchJob>
+
 #include "sendlateragent_debug.h"
-#include <KConfigGroup>
 #include <KLocalizedString>
 #include <KMessageBox>
 
-#include <QRegularExpression>
-#include <QStringList>
 #include <QTimer>
 
+namespace
+{
+// Messages due within this window are sent together with the first one
+constexpr qint64 DispatchWindowMSecs = 1000;
+// The agent reloads the list every hour anyway, and QTimer takes an int
+constexpr qint64 MaximumTimerInterval = 60 * 60 * 1000;
+// Maximum number of messages fetched ahead of their send time by one job
+constexpr int PrefetchBatchSize = 50;
+}
+
 SendLaterManager::SendLaterManager(QObject *parent)
     : QObject(parent)
     , mSender(new MessageComposer::AkonadiSender)
 {
-    mConfig = SendLaterUtil::defaultConfig();
     mTimer = new QTimer(this);
-    connect(mTimer, &QTimer::timeout, this, &SendLaterManager::slotCreateJob);
+    mTimer->setSingleShot(true);
+    // Scheduled announcements are expected on time, a coarse timer may fire a few seconds late
+    mTimer->setTimerType(Qt::PreciseTimer);
+    connect(mTimer, &QTimer::timeout, this, &SendLaterManager::dispatch);
+    mPrefetchTimer = new QTimer(this);
+    mPrefetchTimer->setSingleShot(true);
+    connect(mPrefetchTimer, &QTimer::timeout, this, &SendLaterManager::prefetch);
 }
 
 SendLaterManager::~SendLaterManager()
 {
     stopAll();
+    // The jobs are our children, they don't use their info once destroyed
+    qDeleteAll(mRunningInfos);
     delete mSender;
 }
 
 void SendLaterManager::stopAll()
+{
+    stopDispatching();
+    mPrefetchedItems.clear();
+}
+
+void SendLaterManager::stopDispatching()
 {
     stopTimer();
-    qDeleteAll(mListSendLaterInfo);
-    mListSendLaterInfo.clear();
-    mCurrentJob = nullptr;
-    mCurrentInfo = nullptr;
+    mPrefetchTimer->stop();
+    if (mPrefetchJob) {
+        // kill() deletes the job later, don't wait for it to prefetch again
+        mPrefetchJob->kill();
+        mPrefetchJob = nullptr;
+    }
+    mPrefetchRequest.clear();
+    mQueue.clear();
+    mSendNowQueue.clear();
+    mLoaded = false;
 }
 
 void SendLaterManager::load(bool forcereload)
 {
-    stopAll();
+    // The prefetched messages are kept, the ones no longer to send are dropped below
+    stopDispatching();
     if (forcereload) {
-        mConfig->reparseConfiguration();
+        SendLaterAgentSettings::self()->load();
     }
+    mMaximumConcurrentSends = SendLaterAgentSettings::maximumConcurrentSends();
+    mPrefetchMSecs = SendLaterAgentSettings::prefetchMinutes() * 60 * 1000;
 
-    const QStringList itemList = mConfig->groupList().filter(QRegularExpression(QStringLiteral("SendLaterItem \\d+")));
-    const int numberOfItems = itemList.count();
-    for (int i = 0; i < numberOfItems; ++i) {
-        KConfigGroup group = mConfig->group(itemList.at(i));
-        auto *info = SendLaterUtil::readSendLaterInfo(group);
-        if (info->isValid()) {
-            mListSendLaterInfo.append(info);
+    const QVector<MessageComposer::SendLaterInfo *> infos = SendLaterStore::self()->infos();
+    for (MessageComposer::SendLaterInfo *info : infos) {
+        // Messages being sent are put back in the queue once done if needed
+        if (!mRunningInfos.contains(info->itemId())) {
+            mQueue.insert(info);
         } else {
             delete info;
         }
     }
-    createSendInfoList();
+    for (auto it = mPrefetchedItems.begin(); it != mPrefetchedItems.end();) {
+        if (mQueue.find(it.key())) {
+            ++it;
+        } else {
+            it = mPrefetchedItems.erase(it);
+        }
+    }
+    mLoaded = true;
+    dispatch();
 }
 
-void SendLaterManager::createSendInfoList()
+void SendLaterManager::dispatch()
 {
-    mCurrentInfo = nullptr;
-    std::sort(mListSendLaterInfo.begin(), mListSendLaterInfo.end(), SendLaterUtil::compareSendLaterInfo);
-
-    // Look at QQueue
-    if (mSendLaterQueue.isEmpty()) {
-        if (!mListSendLaterInfo.isEmpty()) {
-            mCurrentInfo = mListSendLaterInfo.constFirst();
-            const QDateTime now = QDateTime::currentDateTime();
-            const qint64 seconds = now.secsTo(mCurrentInfo->dateTime());
-            if (seconds > 0) {
-                // qCDebug(SENDLATERAGENT_LOG)<<" seconds"<<seconds;
-                mTimer->start(seconds * 1000);
-            } else {
-                // Create job when seconds <0
-                slotCreateJob();
+    stopTimer();
+    if (!mLoaded) {
+        return;
+    }
+    const QDateTime dispatchEnd = QDateTime::currentDateTime().addMSecs(DispatchWindowMSecs);
+    while (mRunningInfos.count() < mMaximumConcurrentSends) {
+        MessageComposer::SendLaterInfo *info = nullptr;
+        if (!mSendNowQueue.isEmpty()) {
+            info = mQueue.take(mSendNowQueue.dequeue());
+            if (!info) { // removed in the meantime
+                continue;
             }
+        } else if (!mQueue.isEmpty() && mQueue.top()->dateTime() <= dispatchEnd) {
+            info = mQueue.takeTop();
         } else {
-            qCDebug(SENDLATERAGENT_LOG) << " list is empty";
-            mTimer->stop();
+            break;
         }
-    } else {
-        MessageComposer::SendLaterInfo *info = searchInfo(mSendLaterQueue.dequeue());
-        if (info) {
-            mCurrentInfo = info;
-            slotCreateJob();
-        } else { // If removed.
-            createSendInfoList();
+        startJob(info);
+    }
+
+    // When all slots are busy the next finished job dispatches again
+    if (mRunningInfos.count() < mMaximumConcurrentSends && !mQueue.isEmpty()) {
+        const qint64 msecs = QDateTime::currentDateTime().msecsTo(mQueue.top()->dateTime());
+        mTimer->start(static_cast<int>(qBound<qint64>(0, msecs, MaximumTimerInterval)));
+    } else if (mQueue.isEmpty()) {
+        qCDebug(SENDLATERAGENT_LOG) << " list is empty";
+    }
+    prefetch();
+}
+
+void SendLaterManager::startJob(MessageComposer::SendLaterInfo *info)
+{
+    mRunningInfos.insert(info->itemId(), info);
+    auto job = new SendLaterJob(this, info, this);
+    const auto it = mPrefetchedItems.constFind(info->itemId());
+    if (it != mPrefetchedItems.constEnd()) {
+        job->setPrefetchedItem(it.value());
+        mPrefetchedItems.erase(it);
+    }
+    job->start();
+}
+
+void SendLaterManager::prefetch()
+{
+    mPrefetchTimer->stop();
+    if (!mLoaded || mPrefetchMSecs <= 0 || mPrefetchJob || mQueue.isEmpty()) {
+        return;
+    }
+
+    const QDateTime windowEnd = QDateTime::currentDateTime().addMSecs(mPrefetchMSecs);
+    // The prefetched messages stay in the queue until sent, skip them
+    const QVector<MessageComposer::SendLaterInfo *> dueInfos = mQueue.infosDueBefore(windowEnd, mPrefetchedItems.count() + PrefetchBatchSize);
+    Akonadi::Item::List items;
+    for (const MessageComposer::SendLaterInfo *info : dueInfos) {
+        if (!mPrefetchedItems.contains(info->itemId())) {
+            items.append(Akonadi::Item(info->itemId()));
+            if (items.count() == PrefetchBatchSize) {
+                break;
+            }
+        }
+    }
+
+    if (items.isEmpty()) {
+        // Wake up when the next message enters the window
+        const QDateTime next = mQueue.nextSendTimeAfter(windowEnd);
+        if (next.isValid()) {
+            const qint64 msecs = windowEnd.msecsTo(next);
+            mPrefetchTimer->start(static_cast<int>(qBound<qint64>(0, msecs, MaximumTimerInterval)));
+        }
+        return;
+    }
+
+    auto job = new Akonadi::ItemFetchJob(items, this);
+    job->setFetchScope(SendLaterJob::fetchScope());
+    connect(job, &Akonadi::ItemFetchJob::itemsReceived, this, &SendLaterManager::slotItemsPrefetched);
+    connect(job, &Akonadi::ItemFetchJob::result, this, &SendLaterManager::slotPrefetchDone);
+    mPrefetchJob = job;
+    mPrefetchRequest = items;
+
+    // Sending needs the transport passwords, don't wait for the wallet at the send time
+    MailTransport::TransportManager::self()->loadPasswordsAsync();
+}
+
+void SendLaterManager::slotItemsPrefetched(const Akonadi::Item::List &items)
+{
+    for (const Akonadi::Item &item : items) {
+        if (mQueue.find(item.id())) {
+            mPrefetchedItems.insert(item.id(), item);
+        }
+    }
+}
+
+void SendLaterManager::slotPrefetchDone(KJob *job)
+{
+    mPrefetchJob = nullptr;
+    if (job->error()) {
+        qCDebug(SENDLATERAGENT_LOG) << "Unable to prefetch messages:" << job->errorString();
+    }
+    // Don't fetch the missing ones again, their jobs fetch them at the send time
+    for (const Akonadi::Item &item : std::as_const(mPrefetchRequest)) {
+        if (mQueue.find(item.id()) && !mPrefetchedItems.contains(item.id())) {
+            mPrefetchedItems.insert(item.id(), Akonadi::Item());
         }
     }
+    mPrefetchRequest.clear();
+    prefetch();
 }
 
 void SendLaterManager::stopTimer()
@@ -106,72 +224,61 @@ void SendLaterManager::stopTimer()
     }
 }
 
-MessageComposer::SendLaterInfo *SendLaterManager::searchInfo(Akonadi::Item::Id id)
+void SendLaterManager::sendNow(Akonadi::Item::Id id)
 {
-    for (MessageComposer::SendLaterInfo *info : std::as_const(mListSendLaterInfo)) {
-        if (info->itemId() == id) {
-            return info;
+    if (mRunningInfos.contains(id)) {
+        qCDebug(SENDLATERAGENT_LOG) << " message is already being sent: " << id;
+        return;
+    }
+    if (mQueue.find(id)) {
+        mSendNowQueue.enqueue(id);
+        dispatch();
+    } else {
+        qCDebug(SENDLATERAGENT_LOG) << " can't find info about current id: " << id;
+        if (!itemRemoved(id)) {
+            qCWarning(SENDLATERAGENT_LOG) << "Impossible to remove id" << id;
         }
     }
-    return nullptr;
 }
 
-void SendLaterManager::sendNow(Akonadi::Item::Id id)
+void SendLaterManager::itemAdded(Akonadi::Item::Id id)
 {
-    if (!mCurrentJob) {
-        MessageComposer::SendLaterInfo *info = searchInfo(id);
+    // A message being sent is queued again when its job finishes if it's still in the store
+    if (mLoaded && !mRunningInfos.contains(id)) {
+        MessageComposer::SendLaterInfo *info = SendLaterStore::self()->info(id);
+        // The message itself may have changed too
+        mPrefetchedItems.remove(id);
         if (info) {
-            mCurrentInfo = info;
-            slotCreateJob();
+            mQueue.insert(info);
         } else {
-            qCDebug(SENDLATERAGENT_LOG) << " can't find info about current id: " << id;
-            if (!itemRemoved(id)) {
-                qCWarning(SENDLATERAGENT_LOG) << "Impossible to remove id" << id;
-            }
+            delete mQueue.take(id);
         }
-    } else {
-        // Add to QQueue
-        mSendLaterQueue.enqueue(id);
+        dispatch();
     }
-}
-
-void SendLaterManager::slotCreateJob()
-{
-    if (mCurrentJob) {
-        qCDebug(SENDLATERAGENT_LOG) << " Problem we have already a job" << mCurrentJob;
-        return;
-    }
-    mCurrentJob = new SendLaterJob(this, mCurrentInfo);
-    mCurrentJob->start();
+    Q_EMIT needUpdateConfigDialogBox();
 }
 
 bool SendLaterManager::itemRemoved(Akonadi::Item::Id id)
 {
-    if (mConfig->hasGroup(SendLaterUtil::sendLaterPattern().arg(id))) {
-        removeInfo(id);
-        mConfig->reparseConfiguration();
+    if (SendLaterStore::self()->remove(id)) {
+        // A message being sent is dropped when its job finishes
+        delete mQueue.take(id);
+        mPrefetchedItems.remove(id);
         Q_EMIT needUpdateConfigDialogBox();
         return true;
     }
     return false;
 }
 
-void SendLaterManager::removeInfo(Akonadi::Item::Id id)
-{
-    KConfigGroup group = mConfig->group(SendLaterUtil::sendLaterPattern().arg(id));
-    group.deleteGroup();
-    group.sync();
-}
-
 void SendLaterManager::sendError(MessageComposer::SendLaterInfo *info, ErrorType type)
 {
-    mCurrentJob = nullptr;
+    bool keep = true;
     if (info) {
         switch (type) {
         case UnknownError:
         case ItemNotFound:
             // Don't try to resend it. Remove it.
-            removeLaterInfo(info);
+            keep = false;
             break;
         case MailDispatchDoesntWork:
             // Force to make online maildispatcher
@@ -180,56 +287,61 @@ void SendLaterManager::sendError(MessageComposer::SendLaterInfo *info, ErrorType
                 qCWarning(SENDLATERAGENT_LOG) << " Impossible to make online send dispatcher";
             }
             // Remove item which create error ?
-            if (!info->isRecurrence()) {
-                removeLaterInfo(info);
-            }
+            keep = info->isRecurrence();
             break;
         case TooManyItemFound:
         case CanNotFetchItem:
         case CanNotCreateTransport:
             if (KMessageBox::No == KMessageBox::questionYesNo(nullptr, i18n("An error was found. Do you want to resend it?"), i18n("Error found"))) {
-                removeLaterInfo(info);
+                keep = false;
             }
             break;
         }
     }
-    recreateSendList();
+    jobFinished(info, keep);
 }
 
-void SendLaterManager::recreateSendList()
+void SendLaterManager::sendDone(MessageComposer::SendLaterInfo *info)
 {
-    mCurrentJob = nullptr;
-    Q_EMIT needUpdateConfigDialogBox();
-    QTimer::singleShot(0, this, &SendLaterManager::createSendInfoList);
+    const bool keep = info && info->isRecurrence() && SendLaterStore::self()->contains(info->itemId());
+    if (keep) {
+        SendLaterUtil::changeRecurrentDate(info);
+    }
+    jobFinished(info, keep);
 }
 
-void SendLaterManager::sendDone(MessageComposer::SendLaterInfo *info)
+void SendLaterManager::jobFinished(MessageComposer::SendLaterInfo *info, bool keep)
 {
     if (info) {
-        if (info->isRecurrence()) {
-            SendLaterUtil::changeRecurrentDate(info);
-            load(true);
+        mRunningInfos.remove(info->itemId());
+        if (!keep || !SendLaterStore::self()->contains(info->itemId())) {
+            SendLaterStore::self()->remove(info->itemId());
+            delete info;
+        } else if (mLoaded) {
+            mQueue.insert(info);
         } else {
-            removeLaterInfo(info);
+            // Stopped while sending, the next load() reads it again
+            delete info;
         }
     }
-    recreateSendList();
-}
-
-void SendLaterManager::removeLaterInfo(MessageComposer::SendLaterInfo *info)
-{
-    mListSendLaterInfo.removeAll(mCurrentInfo);
-    mCurrentInfo = nullptr;
-    removeInfo(info->itemId());
+    Q_EMIT needUpdateConfigDialogBox();
+    // Don't start the next job from the finished job's call stack
+    QTimer::singleShot(0, this, &SendLaterManager::dispatch);
 }
 
 QString SendLaterManager::printDebugInfo() const
 {
     QString infoStr;
-    if (mListSendLaterInfo.isEmpty()) {
+    QVector<MessageComposer::SendLaterInfo *> infos;
+    infos.reserve(mRunningInfos.count() + mQueue.count());
+    for (MessageComposer::SendLaterInfo *info : std::as_const(mRunningInfos)) {
+        infos.append(info);
+    }
+    infos += mQueue.sortedInfos();
+    if (infos.isEmpty()) {
         infoStr = QStringLiteral("No mail");
     } else {
-        for (MessageComposer::SendLaterInfo *info : std::as_const(mListSendLaterInfo)) {
+        for (MessageComposer::SendLaterInfo *info : infos) {
             if (!infoStr.isEmpty()) {
                 infoStr += QLatin1Char('\n');
             }
@@ -6,19 +6,22 @@
 
 #pragma once
 
+#include "sendlaterqueue.h"
+
+#include <QHash>
 #include <QObject>
+#include <QPointer>
 #include <QQueue>
 
 #include <Item>
 
-#include <KSharedConfig>
-
 namespace MessageComposer
 {
 class AkonadiSender;
 class SendLaterInfo;
 }
 
+class KJob;
 class QTimer;
 class SendLaterJob;
 class SendLaterManager : public QObject
@@ -44,6 +47,11 @@ public:
     void stopAll();
     Q_REQUIRED_RESULT bool itemRemoved(Akonadi::Item::Id id);
 
+    /**
+     * Queues the message @p id after it was added to or changed in the store.
+     */
+    void itemAdded(Akonadi::Item::Id id);
+
     MessageComposer::AkonadiSender *sender() const;
 
     void sendNow(Akonadi::Item::Id id);
@@ -56,20 +64,31 @@ public Q_SLOTS:
 
 private:
     Q_DISABLE_COPY(SendLaterManager)
-    void slotCreateJob();
-    void createSendInfoList();
+    void stopDispatching();
+    void dispatch();
+    void startJob(MessageComposer::SendLaterInfo *info);
+    void prefetch();
+    void slotItemsPrefetched(const Akonadi::Item::List &items);
+    void slotPrefetchDone(KJob *job);
+    void jobFinished(MessageComposer::SendLaterInfo *info, bool keep);
     QString infoToStr(MessageComposer::SendLaterInfo *info) const;
-    void removeLaterInfo(MessageComposer::SendLaterInfo *info);
-    MessageComposer::SendLaterInfo *searchInfo(Akonadi::Item::Id id);
-    void recreateSendList();
     void stopTimer();
-    void removeInfo(Akonadi::Item::Id id);
-    KSharedConfig::Ptr mConfig;
-    QList<MessageComposer::SendLaterInfo *> mListSendLaterInfo;
-    MessageComposer::SendLaterInfo *mCurrentInfo = nullptr;
-    SendLaterJob *mCurrentJob = nullptr;
+    // Messages waiting for their send time
+    SendLaterQueue mQueue;
+    // Messages being sent, the manager owns their infos
+    QHash<Akonadi::Item::Id, MessageComposer::SendLaterInfo *> mRunningInfos;
+    // Messages due soon, fetched ahead of their send time. An invalid item
+    // means that it couldn't be fetched, its job fetches it again.
+    QHash<Akonadi::Item::Id, Akonadi::Item> mPrefetchedItems;
+    Akonadi::Item::List mPrefetchRequest;
+    QPointer<KJob> mPrefetchJob;
     QTimer *mTimer = nullptr;
+    QTimer *mPrefetchTimer = nullptr;
     MessageComposer::AkonadiSender *const mSender;
-    QQueue<Akonadi::Item::Id> mSendLaterQueue;
+    // Messages to send right away, before the due ones
+    QQueue<Akonadi::Item::Id> mSendNowQueue;
+    int mMaximumConcurrentSends = 4;
+    qint64 mPrefetchMSecs = 0;
+    bool mLoaded = false;
 };
 
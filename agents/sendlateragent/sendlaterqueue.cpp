@@ -0,0 +1,203 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "sendlaterqueue.h"
+#include "sendlaterutil.h"
+
+#include <MessageComposer/SendLaterInfo>
+
+#include <algorithm>
+#include <queue>
+#include <vector>
+
+SendLaterQueue::~SendLaterQueue()
+{
+    clear();
+}
+
+void SendLaterQueue::insert(MessageComposer::SendLaterInfo *info)
+{
+    MessageComposer::SendLaterInfo *oldInfo = take(info->itemId());
+    if (oldInfo != info) {
+        delete oldInfo;
+    }
+    mHeap.append(info);
+    mPositions.insert(info->itemId(), mHeap.count() - 1);
+    siftUp(mHeap.count() - 1);
+}
+
+MessageComposer::SendLaterInfo *SendLaterQueue::top() const
+{
+    return mHeap.isEmpty() ? nullptr : mHeap.constFirst();
+}
+
+MessageComposer::SendLaterInfo *SendLaterQueue::takeTop()
+{
+    return mHeap.isEmpty() ? nullptr : removeAt(0);
+}
+
+MessageComposer::SendLaterInfo *SendLaterQueue::find(Akonadi::Item::Id id) const
+{
+    const int index = mPositions.value(id, -1);
+    return (index >= 0) ? mHeap.at(index) : nullptr;
+}
+
+MessageComposer::SendLaterInfo *SendLaterQueue::take(Akonadi::Item::Id id)
+{
+    const int index = mPositions.value(id, -1);
+    return (index >= 0) ? removeAt(index) : nullptr;
+}
+
+void SendLaterQueue::update(Akonadi::Item::Id id)
+{
+    const int index = mPositions.value(id, -1);
+    if (index >= 0) {
+        siftUp(index);
+        siftDown(mPositions.value(id));
+    }
+}
+
+void SendLaterQueue::clear()
+{
+    qDeleteAll(mHeap);
+    mHeap.clear();
+    mPositions.clear();
+}
+
+bool SendLaterQueue::isEmpty() const
+{
+    return mHeap.isEmpty();
+}
+
+int SendLaterQueue::count() const
+{
+    return mHeap.count();
+}
+
+QVector<MessageComposer::SendLaterInfo *> SendLaterQueue::sortedInfos() const
+{
+    QVector<MessageComposer::SendLaterInfo *> infos = mHeap;
+    std::stable_sort(infos.begin(), infos.end(), SendLaterUtil::compareSendLaterInfo);
+    return infos;
+}
+
+QVector<MessageComposer::SendLaterInfo *> SendLaterQueue::infosDueBefore(const QDateTime &dateTime, int maximumCount) const
+{
+    QVector<MessageComposer::SendLaterInfo *> result;
+    // Best first walk of the heap: the children of a node are never due before it,
+    // so only the nodes due before dateTime and their direct children are visited.
+    const auto greater = [this](int left, int right) {
+        return lessThan(right, left);
+    };
+    std::priority_queue<int, std::vector<int>, decltype(greater)> candidates(greater);
+    if (!mHeap.isEmpty()) {
+        candidates.push(0);
+    }
+    while (!candidates.empty() && result.count() < maximumCount) {
+        const int index = candidates.top();
+        candidates.pop();
+        MessageComposer::SendLaterInfo *info = mHeap.at(index);
+        if (info->dateTime() > dateTime) {
+            continue;
+        }
+        result.append(info);
+        for (const int child : {2 * index + 1, 2 * index + 2}) {
+            if (child < mHeap.count()) {
+                candidates.push(child);
+            }
+        }
+    }
+    return result;
+}
+
+QDateTime SendLaterQueue::nextSendTimeAfter(const QDateTime &dateTime) const
+{
+    QDateTime next;
+    QVector<int> indexes;
+    if (!mHeap.isEmpty()) {
+        indexes.append(0);
+    }
+    while (!indexes.isEmpty()) {
+        const int index = indexes.takeLast();
+        const QDateTime sendTime = mHeap.at(index)->dateTime();
+        if (sendTime > dateTime) {
+            // Nothing below it is sent earlier
+            if (!next.isValid() || sendTime < next) {
+                next = sendTime;
+            }
+            continue;
+        }
+        for (const int child : {2 * index + 1, 2 * index + 2}) {
+            if (child < mHeap.count()) {
+                indexes.append(child);
+            }
+        }
+    }
+    return next;
+}
+
+bool SendLaterQueue::lessThan(int left, int right) const
+{
+    return SendLaterUtil::compareSendLaterInfo(mHeap.at(left), mHeap.at(right));
+}
+
+void SendLaterQueue::swapNodes(int left, int right)
+{
+    std::swap(mHeap[left], mHeap[right]);
+    mPositions[mHeap.at(left)->itemId()] = left;
+    mPositions[mHeap.at(right)->itemId()] = right;
+}
+
+void SendLaterQueue::siftUp(int index)
+{
+    while (index > 0) {
+        const int parent = (index - 1) / 2;
+        if (!lessThan(index, parent)) {
+            break;
+        }
+        swapNodes(index, parent);
+        index = parent;
+    }
+}
+
+void SendLaterQueue::siftDown(int index)
+{
+    const int total = mHeap.count();
+    for (;;) {
+        int smallest = index;
+        const int left = 2 * index + 1;
+        const int right = left + 1;
+        if (left < total && lessThan(left, smallest)) {
+            smallest = left;
+        }
+        if (right < total && lessThan(right, smallest)) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            break;
+        }
+        swapNodes(index, smallest);
+        index = smallest;
+    }
+}
+
+MessageComposer::SendLaterInfo *SendLaterQueue::removeAt(int index)
+{
+    MessageComposer::SendLaterInfo *info = mHeap.at(index);
+    const int last = mHeap.count() - 1;
+    if (index != last) {
+        swapNodes(index, last);
+    }
+    mHeap.removeLast();
+    mPositions.remove(info->itemId());
+    if (index < mHeap.count()) {
+        // The last node took the place of the removed one
+        const Akonadi::Item::Id movedId = mHeap.at(index)->itemId();
+        siftUp(index);
+        siftDown(mPositions.value(movedId));
+    }
+    return info;
+}
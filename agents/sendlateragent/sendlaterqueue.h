@@ -0,0 +1,91 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <Item>
+
+#include <QDateTime>
+#include <QHash>
+#include <QVector>
+
+namespace MessageComposer
+{
+class SendLaterInfo;
+}
+
+/**
+ * Queue of the messages to send, ordered by send time.
+ *
+ * It is a binary min-heap with an index by item id, so that the next message is
+ * found in constant time and a message is added, removed or rescheduled in
+ * logarithmic time. The queue owns the infos it contains.
+ */
+class SendLaterQueue
+{
+public:
+    SendLaterQueue() = default;
+    ~SendLaterQueue();
+
+    /**
+     * Adds @p info, an info with the same item id is replaced.
+     */
+    void insert(MessageComposer::SendLaterInfo *info);
+
+    /**
+     * Returns the info to send first, or nullptr if the queue is empty.
+     */
+    Q_REQUIRED_RESULT MessageComposer::SendLaterInfo *top() const;
+
+    /**
+     * Removes the info to send first and passes its ownership to the caller.
+     */
+    Q_REQUIRED_RESULT MessageComposer::SendLaterInfo *takeTop();
+
+    Q_REQUIRED_RESULT MessageComposer::SendLaterInfo *find(Akonadi::Item::Id id) const;
+
+    /**
+     * Removes the info of @p id and passes its ownership to the caller, returns nullptr if there is none.
+     */
+    Q_REQUIRED_RESULT MessageComposer::SendLaterInfo *take(Akonadi::Item::Id id);
+
+    /**
+     * Moves the info of @p id to its new place after its send time changed.
+     */
+    void update(Akonadi::Item::Id id);
+
+    void clear();
+
+    Q_REQUIRED_RESULT bool isEmpty() const;
+    Q_REQUIRED_RESULT int count() const;
+
+    /**
+     * Returns all infos ordered by send time.
+     */
+    Q_REQUIRED_RESULT QVector<MessageComposer::SendLaterInfo *> sortedInfos() const;
+
+    /**
+     * Returns at most @p maximumCount infos to send up to @p dateTime, the first one first.
+     * Only the part of the heap before @p dateTime is visited.
+     */
+    Q_REQUIRED_RESULT QVector<MessageComposer::SendLaterInfo *> infosDueBefore(const QDateTime &dateTime, int maximumCount) const;
+
+    /**
+     * Returns the first send time after @p dateTime, or an invalid date if there is none.
+     */
+    Q_REQUIRED_RESULT QDateTime nextSendTimeAfter(const QDateTime &dateTime) const;
+
+private:
+    Q_DISABLE_COPY(SendLaterQueue)
+    Q_REQUIRED_RESULT bool lessThan(int left, int right) const;
+    void swapNodes(int left, int right);
+    void siftUp(int index);
+    void siftDown(int index);
+    MessageComposer::SendLaterInfo *removeAt(int index);
+
+    QVector<MessageComposer::SendLaterInfo *> mHeap;
+    QHash<Akonadi::Item::Id, int> mPositions;
+};
@@ -0,0 +1,228 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "sendlaterstore.h"
+#include "sendlateragent_debug.h"
+#include "sendlaterutil.h"
+
+#include <MessageComposer/SendLaterInfo>
+
+#include <KConfigGroup>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QRegularExpression>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+namespace
+{
+// "KSLJ", the file format version follows it
+constexpr quint32 JournalMagic = 0x4B534C4A;
+constexpr quint32 JournalVersion = 1;
+
+void writeInfo(QDataStream &stream, const MessageComposer::SendLaterInfo &info)
+{
+    stream << info.itemId() << info.dateTime() << info.lastDateTimeSend() << info.isRecurrence() << static_cast<qint32>(info.recurrenceEachValue())
+           << static_cast<qint32>(info.recurrenceUnit()) << info.subject() << info.to();
+}
+
+MessageComposer::SendLaterInfo *readInfo(QDataStream &stream)
+{
+    Akonadi::Item::Id itemId;
+    QDateTime dateTime;
+    QDateTime lastDateTimeSend;
+    bool recurrence;
+    qint32 recurrenceEachValue;
+    qint32 recurrenceUnit;
+    QString subject;
+    QString to;
+    stream >> itemId >> dateTime >> lastDateTimeSend >> recurrence >> recurrenceEachValue >> recurrenceUnit >> subject >> to;
+    if (stream.status() != QDataStream::Ok) {
+        return nullptr;
+    }
+    auto info = new MessageComposer::SendLaterInfo;
+    info->setItemId(itemId);
+    info->setDateTime(dateTime);
+    info->setLastDateTimeSend(lastDateTimeSend);
+    info->setRecurrence(recurrence);
+    info->setRecurrenceEachValue(recurrenceEachValue);
+    info->setRecurrenceUnit(static_cast<MessageComposer::SendLaterInfo::RecurrenceUnit>(recurrenceUnit));
+    info->setSubject(subject);
+    info->setTo(to);
+    return info;
+}
+}
+
+SendLaterStore::SendLaterStore(const QString &fileName, const KSharedConfig::Ptr &legacyConfig)
+    : mJournal(fileName, JournalMagic, JournalVersion, SENDLATERAGENT_LOG)
+{
+    if (mJournal.exists()) {
+        if (!load()) {
+            // Drop the damaged tail, later records would be appended after it
+            compact();
+        }
+    } else if (legacyConfig) {
+        migrateFromConfig(legacyConfig);
+    }
+}
+
+SendLaterStore::~SendLaterStore()
+{
+    qDeleteAll(mInfos);
+}
+
+SendLaterStore *SendLaterStore::self()
+{
+    static SendLaterStore s_self(defaultFileName(), SendLaterUtil::defaultConfig());
+    return &s_self;
+}
+
+QString SendLaterStore::defaultFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QStringLiteral("/akonadi_sendlater_agent/sendlater.journal");
+}
+
+bool SendLaterStore::contains(Akonadi::Item::Id id) const
+{
+    return mInfos.contains(id);
+}
+
+int SendLaterStore::count() const
+{
+    return mInfos.count();
+}
+
+MessageComposer::SendLaterInfo *SendLaterStore::info(Akonadi::Item::Id id) const
+{
+    const MessageComposer::SendLaterInfo *info = mInfos.value(id);
+    return info ? new MessageComposer::SendLaterInfo(*info) : nullptr;
+}
+
+QVector<MessageComposer::SendLaterInfo *> SendLaterStore::infos() const
+{
+    QVector<MessageComposer::SendLaterInfo *> result;
+    result.reserve(mInfos.count());
+    for (const MessageComposer::SendLaterInfo *info : mInfos) {
+        result.append(new MessageComposer::SendLaterInfo(*info));
+    }
+    std::stable_sort(result.begin(), result.end(), SendLaterUtil::compareSendLaterInfo);
+    return result;
+}
+
+void SendLaterStore::insert(const MessageComposer::SendLaterInfo &info)
+{
+    if (!info.isValid()) {
+        return;
+    }
+    insertInMemory(new MessageComposer::SendLaterInfo(info));
+    appendRecord(PutRecord, [&info](QDataStream &stream) {
+        writeInfo(stream, info);
+    });
+}
+
+bool SendLaterStore::remove(Akonadi::Item::Id id)
+{
+    if (!mInfos.contains(id)) {
+        return false;
+    }
+    removeFromMemory(id);
+    appendRecord(RemoveRecord, [id](QDataStream &stream) {
+        stream << id;
+    });
+    return true;
+}
+
+void SendLaterStore::replaceAll(const QVector<MessageComposer::SendLaterInfo *> &infos)
+{
+    qDeleteAll(mInfos);
+    mInfos.clear();
+    for (const MessageComposer::SendLaterInfo *info : infos) {
+        if (info && info->isValid()) {
+            insertInMemory(new MessageComposer::SendLaterInfo(*info));
+        }
+    }
+    compact();
+}
+
+void SendLaterStore::insertInMemory(MessageComposer::SendLaterInfo *info)
+{
+    removeFromMemory(info->itemId());
+    mInfos.insert(info->itemId(), info);
+}
+
+void SendLaterStore::removeFromMemory(Akonadi::Item::Id id)
+{
+    delete mInfos.take(id);
+}
+
+bool SendLaterStore::load()
+{
+    return mJournal.replay([this](quint8 type, QDataStream &stream) {
+        if (type == PutRecord) {
+            MessageComposer::SendLaterInfo *info = readInfo(stream);
+            if (!info) {
+                return false;
+            }
+            insertInMemory(info);
+            return true;
+        } else if (type == RemoveRecord) {
+            Akonadi::Item::Id id;
+            stream >> id;
+            if (stream.status() != QDataStream::Ok) {
+                return false;
+            }
+            removeFromMemory(id);
+            return true;
+        }
+        return false;
+    });
+}
+
+void SendLaterStore::migrateFromConfig(const KSharedConfig::Ptr &config)
+{
+    const QStringList itemList = config->groupList().filter(QRegularExpression(QStringLiteral("SendLaterItem \\d+")));
+    for (const QString &groupName : itemList) {
+        KConfigGroup group = config->group(groupName);
+        MessageComposer::SendLaterInfo *info = SendLaterUtil::readSendLaterInfo(group);
+        if (info->isValid()) {
+            insertInMemory(info);
+        } else {
+            delete info;
+        }
+    }
+    // Also creates the journal when there is nothing to migrate, so that it's done only once
+    if (!compact()) {
+        return;
+    }
+    for (const QString &groupName : itemList) {
+        config->deleteGroup(groupName);
+    }
+    config->sync();
+    if (!itemList.isEmpty()) {
+        qCDebug(SENDLATERAGENT_LOG) << "Migrated" << mInfos.count() << "send later items to" << mJournal.fileName();
+    }
+}
+
+void SendLaterStore::appendRecord(quint8 type, const JournalFile::ContentWriter &writeContent)
+{
+    mJournal.append(type, writeContent);
+    if (mJournal.needsCompaction(mInfos.count())) {
+        compact();
+    }
+}
+
+bool SendLaterStore::compact()
+{
+    return mJournal.rewrite([this](QDataStream &stream) {
+        for (const MessageComposer::SendLaterInfo *info : std::as_const(mInfos)) {
+            stream << static_cast<quint8>(PutRecord);
+            writeInfo(stream, *info);
+        }
+        return mInfos.count();
+    });
+}
@@ -0,0 +1,85 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "journalfile.h"
+
+#include <Item>
+#include <KSharedConfig>
+
+#include <QHash>
+#include <QVector>
+
+namespace MessageComposer
+{
+class SendLaterInfo;
+}
+
+/**
+ * Persistent store of the messages to send later.
+ *
+ * The infos are kept in memory, indexed by item id, ordering them by send time
+ * is left to the SendLaterQueue of the manager. Every change is appended to a
+ * journal file, which is replayed on startup and compacted once it contains too
+ * many outdated records. The infos used to be stored as "SendLaterItem N"
+ * groups of the agent configuration, they are moved to the journal the first
+ * time it is created.
+ */
+class SendLaterStore
+{
+public:
+    /**
+     * Opens the journal @p fileName. If it doesn't exist yet the infos are
+     * migrated from @p legacyConfig.
+     */
+    explicit SendLaterStore(const QString &fileName, const KSharedConfig::Ptr &legacyConfig = KSharedConfig::Ptr());
+    ~SendLaterStore();
+
+    static SendLaterStore *self();
+    Q_REQUIRED_RESULT static QString defaultFileName();
+
+    Q_REQUIRED_RESULT bool contains(Akonadi::Item::Id id) const;
+    Q_REQUIRED_RESULT int count() const;
+
+    /**
+     * Returns a copy of the info of @p id, or nullptr. The caller owns it.
+     */
+    Q_REQUIRED_RESULT MessageComposer::SendLaterInfo *info(Akonadi::Item::Id id) const;
+
+    /**
+     * Returns copies of all infos, ordered by send time. The caller owns them.
+     */
+    Q_REQUIRED_RESULT QVector<MessageComposer::SendLaterInfo *> infos() const;
+
+    /**
+     * Adds or replaces the info of @p info's item. Invalid infos are ignored.
+     */
+    void insert(const MessageComposer::SendLaterInfo &info);
+    bool remove(Akonadi::Item::Id id);
+
+    /**
+     * Replaces all infos by @p infos.
+     */
+    void replaceAll(const QVector<MessageComposer::SendLaterInfo *> &infos);
+
+private:
+    Q_DISABLE_COPY(SendLaterStore)
+    enum RecordType : quint8 {
+        PutRecord = 1,
+        RemoveRecord,
+    };
+
+    bool load();
+    void migrateFromConfig(const KSharedConfig::Ptr &config);
+    void insertInMemory(MessageComposer::SendLaterInfo *info);
+    void removeFromMemory(Akonadi::Item::Id id);
+    void appendRecord(quint8 type, const JournalFile::ContentWriter &writeContent);
+    bool compact();
+
+    JournalFile mJournal;
+    QHash<Akonadi::Item::Id, MessageComposer::SendLaterInfo *> mInfos;
+};
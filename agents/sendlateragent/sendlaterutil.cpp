@@ -7,6 +7,7 @@
 #include "sendlaterutil.h"
 #include "sendlateragent_debug.h"
 #include "sendlateragentsettings.h"
+#include "sendlaterstore.h"
 
 #include <MessageComposer/SendLaterInfo>
 
@@ -58,7 +59,7 @@ void SendLaterUtil::changeRecurrentDate(MessageComposer::SendLaterInfo *info)
         info->setDateTime(newInfoDateTime);
         qCDebug(SENDLATERAGENT_LOG) << "AFTER SendLaterUtil::changeRecurrentDate " << info->dateTime().toString() << " info" << info << "New date"
                                     << newInfoDateTime;
-        writeSendLaterInfo(defaultConfig(), info);
+        SendLaterStore::self()->insert(*info);
     }
 }
 
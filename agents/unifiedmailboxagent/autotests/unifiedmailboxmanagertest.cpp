@@ -380,6 +380,53 @@ private Q_SLOTS:
         QCOMPARE(linkedCol, inboxBoxCol);
     }
 
+    void testPendingLinksSentOnDestruction()
+    {
+        // Setup
+        auto kcfg = KSharedConfig::openConfig(QString::fromUtf8(QTest::currentTestFunction()));
+        auto manager = std::make_unique<UnifiedMailboxManager>(kcfg);
+        EntityDeleter deleter;
+
+        const auto parentCol = collectionForRid(Common::AgentIdentifier);
+        QVERIFY(parentCol.isValid());
+
+        const auto inboxBoxCol = createCollection(Common::InboxBoxId, parentCol, deleter);
+        QVERIFY(inboxBoxCol.isValid());
+
+        bool loadingDone = false;
+        manager->loadBoxes([&loadingDone]() {
+            loadingDone = true;
+        });
+        QTRY_VERIFY_WITH_TIMEOUT(loadingDone, milliseconds(10s).count());
+
+        const auto inboxSourceCol = collectionForRid(QStringLiteral("res1_inbox"));
+        QVERIFY(inboxSourceCol.isValid());
+
+        Akonadi::Monitor monitor;
+        monitor.setCollectionMonitored(inboxBoxCol);
+        QSignalSpy itemLinkedSignalSpy(&monitor, &Akonadi::Monitor::itemsLinked);
+        QVERIFY(QSignalSpy(&monitor, &Akonadi::Monitor::monitorReady).wait());
+
+        // The manager queues the link as soon as it sees the new Item...
+        QSignalSpy itemAddedSignalSpy(&manager->changeRecorder(), &Akonadi::Monitor::itemAdded);
+        Akonadi::Item item;
+        item.setMimeType(QStringLiteral("application/octet-stream"));
+        item.setParentCollection(inboxSourceCol);
+        item.setPayload(QByteArray{"Hello world!"});
+        auto createItem = new Akonadi::ItemCreateJob(item, inboxSourceCol, this);
+        AKVERIFYEXEC(createItem);
+        item = createItem->item();
+        deleter << item;
+        QTRY_COMPARE(itemAddedSignalSpy.size(), 1);
+
+        // ...and still sends it when destroyed before the batch is due, without waiting for it
+        manager.reset();
+        QTRY_COMPARE(itemLinkedSignalSpy.size(), 1);
+        const auto linkedItems = itemLinkedSignalSpy.at(0).at(0).value<Akonadi::Item::List>();
+        QCOMPARE(linkedItems.size(), 1);
+        QCOMPARE(linkedItems.at(0), item);
+    }
+
     void testItemMovedFromSourceCollection()
     {
         // Setup
@@ -11,6 +11,8 @@
 
 #include <KConfigGroup>
 
+#include <algorithm>
+
 bool UnifiedMailbox::operator==(const UnifiedMailbox &other) const
 {
     return mId == other.mId;
@@ -24,6 +26,16 @@ void UnifiedMailbox::load(const KConfigGroup &group)
     mSources = listToSet(group.readEntry("sources", QList<qint64>{}));
     // This is not authoritative, we will do collection discovery anyway
     mCollectionId = group.readEntry("collectionId", -1ll);
+
+    mSyncMarks.clear();
+    const auto syncSources = group.readEntry("syncSources", QList<qint64>{});
+    const auto syncMarks = group.readEntry("syncMarks", QList<qint64>{});
+    for (int i = 0, count = std::min(syncSources.size(), syncMarks.size()); i < count; ++i) {
+        if (mSources.contains(syncSources.at(i))) {
+            mSyncMarks.insert(syncSources.at(i), QDateTime::fromMSecsSinceEpoch(syncMarks.at(i), Qt::UTC));
+        }
+    }
+    mNeedsFullSync = group.readEntry("needsFullSync", true);
 }
 
 void UnifiedMailbox::save(KConfigGroup &group) const
@@ -33,6 +45,16 @@ void UnifiedMailbox::save(KConfigGroup &group) const
     group.writeEntry("sources", setToList(sourceCollections()));
     // just for caching, we will do collection discovery on next start anyway
     group.writeEntry("collectionId", collectionId());
+
+    QList<qint64> syncSources;
+    QList<qint64> syncMarks;
+    for (auto it = mSyncMarks.cbegin(), end = mSyncMarks.cend(); it != end; ++it) {
+        syncSources.push_back(it.key());
+        syncMarks.push_back(it.value().toMSecsSinceEpoch());
+    }
+    group.writeEntry("syncSources", syncSources);
+    group.writeEntry("syncMarks", syncMarks);
+    group.writeEntry("needsFullSync", mNeedsFullSync);
 }
 
 bool UnifiedMailbox::isSpecial() const
@@ -91,7 +113,11 @@ void UnifiedMailbox::addSourceCollection(qint64 source)
 
 void UnifiedMailbox::removeSourceCollection(qint64 source)
 {
-    mSources.remove(source);
+    // Its items have to be unlinked from the box
+    if (mSources.remove(source)) {
+        mSyncMarks.remove(source);
+        mNeedsFullSync = true;
+    }
     if (mManager) {
         mManager->mMonitor.setCollectionMonitored(Akonadi::Collection{source}, false);
         mManager->mSourceToBoxMap.erase(source);
@@ -100,11 +126,17 @@ void UnifiedMailbox::removeSourceCollection(qint64 source)
 
 void UnifiedMailbox::setSourceCollections(const QSet<qint64> &sources)
 {
-    while (!mSources.empty()) {
-        removeSourceCollection(*mSources.begin());
+    // Only touch the sources that changed, so that the others keep their sync mark
+    const auto currentSources = mSources;
+    for (auto source : currentSources) {
+        if (!sources.contains(source)) {
+            removeSourceCollection(source);
+        }
     }
     for (auto source : sources) {
-        addSourceCollection(source);
+        if (!mSources.contains(source)) {
+            addSourceCollection(source);
+        }
     }
 }
 
@@ -113,6 +145,36 @@ QSet<qint64> UnifiedMailbox::sourceCollections() const
     return mSources;
 }
 
+QDateTime UnifiedMailbox::syncMark(qint64 source) const
+{
+    return mSyncMarks.value(source);
+}
+
+void UnifiedMailbox::setSyncMark(qint64 source, const QDateTime &mark)
+{
+    if (!mSources.contains(source)) {
+        return;
+    }
+    if (mark.isValid()) {
+        mSyncMarks.insert(source, mark);
+    } else {
+        mSyncMarks.remove(source);
+    }
+}
+
+bool UnifiedMailbox::needsFullSync() const
+{
+    return mNeedsFullSync;
+}
+
+void UnifiedMailbox::setNeedsFullSync(bool fullSync)
+{
+    mNeedsFullSync = fullSync;
+    if (fullSync) {
+        mSyncMarks.clear();
+    }
+}
+
 void UnifiedMailbox::attachManager(UnifiedMailboxManager *manager)
 {
     if (mManager != manager) {
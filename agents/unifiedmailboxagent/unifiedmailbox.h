@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <QDateTime>
+#include <QHash>
 #include <QMetaType>
 #include <QSet>
 #include <QString>
@@ -50,6 +52,20 @@ public:
     void setSourceCollections(const QSet<qint64> &sources);
     Q_REQUIRED_RESULT QSet<qint64> sourceCollections() const;
 
+    /**
+     * Returns the time up to which the changed items of @p source were linked
+     * into the box, or an invalid time if all its items have to be checked.
+     */
+    Q_REQUIRED_RESULT QDateTime syncMark(qint64 source) const;
+    void setSyncMark(qint64 source, const QDateTime &mark);
+
+    /**
+     * Whether the next sync has to check all items of the sources and of the
+     * box itself, for example because a source was removed.
+     */
+    Q_REQUIRED_RESULT bool needsFullSync() const;
+    void setNeedsFullSync(bool fullSync);
+
 private:
     void attachManager(UnifiedMailboxManager *manager);
 
@@ -58,6 +74,8 @@ private:
     QString mName;
     QString mIcon;
     QSet<qint64> mSources;
+    QHash<qint64, QDateTime> mSyncMarks;
+    bool mNeedsFullSync = true;
 
     UnifiedMailboxManager *mManager = nullptr;
 };
@@ -38,6 +38,12 @@
 #include <memory>
 #include <unordered_set>
 
+namespace
+{
+// Items are checked again from a bit before the previous sync started
+constexpr int SyncMarkMarginSecs = 5 * 60;
+}
+
 UnifiedMailboxAgent::UnifiedMailboxAgent(const QString &id)
     : Akonadi::ResourceBase(id)
     , mBoxManager(config())
@@ -173,12 +179,47 @@ void UnifiedMailboxAgent::retrieveItems(const Akonadi::Collection &c)
         return;
     }
 
+    // The change recorder links and unlinks the Items while we are running, so
+    // usually only the Items changed since the previous sync have to be checked.
+    // Items changed while the source fetch runs are checked again next time.
+    struct SyncState {
+        int pendingJobs = 0;
+        bool failed = false;
+        bool fullSync = false;
+        QDateTime syncStart;
+        QHash<qint64, QDateTime> newMarks;
+    };
+    auto state = std::make_shared<SyncState>();
+    state->fullSync = unifiedBox->needsFullSync();
+    state->syncStart = QDateTime::currentDateTimeUtc().addSecs(-SyncMarkMarginSecs);
+
+    const auto finishJob = [this, state, c]() {
+        if (--state->pendingJobs > 0) {
+            return;
+        }
+        // The box may have been removed or changed in the meantime
+        if (auto box = mBoxManager.unifiedMailboxFromCollection(c); box && !state->failed) {
+            for (auto it = state->newMarks.cbegin(), end = state->newMarks.cend(); it != end; ++it) {
+                box->setSyncMark(it.key(), it.value());
+            }
+            if (state->fullSync) {
+                box->setNeedsFullSync(false);
+            }
+            mBoxManager.saveBoxes();
+        }
+        itemsRetrievedIncremental({}, {}); // fake incremental retrieval
+    };
+
     const auto sources = unifiedBox->sourceCollections();
     for (auto source : sources) {
+        const auto mark = state->fullSync ? QDateTime() : unifiedBox->syncMark(source);
         auto fetch = new Akonadi::ItemFetchJob(Akonadi::Collection(source), this);
         fetch->setDeliveryOption(Akonadi::ItemFetchJob::EmitItemsInBatches);
         fetch->fetchScope().setFetchVirtualReferences(true);
         fetch->fetchScope().setCacheOnly(true);
+        if (mark.isValid()) {
+            fetch->fetchScope().setFetchChangedSince(mark);
+        }
         connect(fetch, &Akonadi::ItemFetchJob::itemsReceived, this, [this, c](const Akonadi::Item::List &items) {
             Akonadi::Item::List toLink;
             std::copy_if(items.cbegin(), items.cend(), std::back_inserter(toLink), [&c](const Akonadi::Item &item) {
@@ -188,24 +229,56 @@ void UnifiedMailboxAgent::retrieveItems(const Akonadi::Collection &c)
                 new Akonadi::LinkJob(c, toLink, this);
             }
         });
+        connect(fetch, &Akonadi::ItemFetchJob::result, this, [state, source, finishJob](KJob *job) {
+            if (job->error()) {
+                qCWarning(UNIFIEDMAILBOXAGENT_LOG) << "Failed to fetch Items of source collection" << source << job->errorString();
+                state->failed = true;
+            } else {
+                state->newMarks.insert(source, state->syncStart);
+            }
+            finishJob();
+        });
+        ++state->pendingJobs;
     }
 
-    auto fetch = new Akonadi::ItemFetchJob(c, this);
-    fetch->setDeliveryOption(Akonadi::ItemFetchJob::EmitItemsInBatches);
-    fetch->fetchScope().setCacheOnly(true);
-    fetch->fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
-    connect(fetch, &Akonadi::ItemFetchJob::itemsReceived, this, [this, unifiedBox, c](const Akonadi::Item::List &items) {
-        Akonadi::Item::List toUnlink;
-        std::copy_if(items.cbegin(), items.cend(), std::back_inserter(toUnlink), [&unifiedBox](const Akonadi::Item &item) {
-            return !unifiedBox->sourceCollections().contains(item.storageCollectionId());
+    // Unlinking is only needed when a source was removed or on request, the
+    // change recorder takes care of Items moved away from the sources
+    if (state->fullSync) {
+        auto fetch = new Akonadi::ItemFetchJob(c, this);
+        fetch->setDeliveryOption(Akonadi::ItemFetchJob::EmitItemsInBatches);
+        fetch->fetchScope().setCacheOnly(true);
+        fetch->fetchScope().setAncestorRetrieval(Akonadi::ItemFetchScope::Parent);
+        connect(fetch, &Akonadi::ItemFetchJob::itemsReceived, this, [this, unifiedBox, c](const Akonadi::Item::List &items) {
+            Akonadi::Item::List toUnlink;
+            std::copy_if(items.cbegin(), items.cend(), std::back_inserter(toUnlink), [&unifiedBox](const Akonadi::Item &item) {
+                return !unifiedBox->sourceCollections().contains(item.storageCollectionId());
+            });
+            if (!toUnlink.isEmpty()) {
+                new Akonadi::UnlinkJob(c, toUnlink, this);
+            }
         });
-        if (!toUnlink.isEmpty()) {
-            new Akonadi::UnlinkJob(c, toUnlink, this);
-        }
-    });
-    connect(fetch, &Akonadi::ItemFetchJob::result, this, [this]() {
+        connect(fetch, &Akonadi::ItemFetchJob::result, this, [state, finishJob](KJob *job) {
+            if (job->error()) {
+                qCWarning(UNIFIEDMAILBOXAGENT_LOG) << "Failed to fetch Items of unified mailbox" << job->errorString();
+                state->failed = true;
+            }
+            finishJob();
+        });
+        ++state->pendingJobs;
+    }
+
+    if (state->pendingJobs == 0) {
         itemsRetrievedIncremental({}, {}); // fake incremental retrieval
-    });
+    }
+}
+
+void UnifiedMailboxAgent::fullSynchronize()
+{
+    for (const auto &boxIt : mBoxManager) {
+        boxIt.second->setNeedsFullSync(true);
+    }
+    mBoxManager.saveBoxes();
+    synchronize();
 }
 
 bool UnifiedMailboxAgent::retrieveItem(const Akonadi::Item &item, const QSet<QByteArray> &parts)
@@ -33,6 +33,12 @@ public:
     void setEnableAgent(bool enable);
     Q_REQUIRED_RESULT bool enabledAgent() const;
 
+    /**
+     * Synchronizes all boxes, checking every Item of their source collections
+     * instead of only the ones changed since the previous sync.
+     */
+    void fullSynchronize();
+
     void retrieveCollections() override;
     void retrieveItems(const Akonadi::Collection &collection) override;
     Q_REQUIRED_RESULT bool retrieveItem(const Akonadi::Item &item, const QSet<QByteArray> &parts) override;
@@ -20,12 +20,28 @@
 #include <AkonadiCore/SpecialCollectionAttribute>
 #include <AkonadiCore/UnlinkJob>
 
+#include <QCoreApplication>
 #include <QTimer>
 
 #include <stdexcept> // for std::out_of_range
 
 namespace
 {
+// Links and unlinks of a sync are sent together, as one job per box
+constexpr int LinkBatchDelayMSecs = 100;
+constexpr int MaximumLinkBatchSize = 500;
+
+// Without parent, so that the jobs outlive the manager
+Akonadi::Job *createLinkJob(qint64 boxColId, const Akonadi::Item::List &items, bool link)
+{
+    qCDebug(UNIFIEDMAILBOXAGENT_LOG) << (link ? "Linking" : "Unlinking") << items.size() << "items to box collection" << boxColId;
+    if (link) {
+        return new Akonadi::LinkJob(Akonadi::Collection{boxColId}, items);
+    } else {
+        return new Akonadi::UnlinkJob(Akonadi::Collection{boxColId}, items);
+    }
+}
+
 /**
  * A little RAII helper to make sure changeProcessed() and replayNext() gets
  * called on the ChangeRecorder whenever we are done with handling a change.
@@ -72,6 +88,10 @@ UnifiedMailboxManager::UnifiedMailboxManager(const KSharedConfigPtr &config, QOb
     mMonitor.itemFetchScope().setFetchRemoteIdentification(false);
     mMonitor.itemFetchScope().setFetchModificationTime(false);
     mMonitor.collectionFetchScope().fetchAttribute<Akonadi::SpecialCollectionAttribute>();
+    mLinkTimer.setSingleShot(true);
+    mLinkTimer.setInterval(LinkBatchDelayMSecs);
+    connect(&mLinkTimer, &QTimer::timeout, this, &UnifiedMailboxManager::flushAllLinkOperations);
+    connect(qApp, &QCoreApplication::aboutToQuit, this, &UnifiedMailboxManager::flushAllLinkOperationsAndWait);
     connect(&mMonitor, &Akonadi::Monitor::itemAdded, this, [this](const Akonadi::Item &item, const Akonadi::Collection &collection) {
         ReplayNextOnExit replayNext(mMonitor);
 
@@ -87,7 +107,7 @@ UnifiedMailboxManager::UnifiedMailboxManager(const KSharedConfigPtr &config, QOb
             return;
         }
 
-        new Akonadi::LinkJob(Akonadi::Collection{box->collectionId()}, {item}, this);
+        queueLinkOperation(box->collectionId(), {item}, true);
     });
     connect(&mMonitor, &Akonadi::Monitor::itemsRemoved, this, [this](const Akonadi::Item::List &items) {
         ReplayNextOnExit replayNext(mMonitor);
@@ -109,7 +129,7 @@ UnifiedMailboxManager::UnifiedMailboxManager(const KSharedConfigPtr &config, QOb
             return;
         }
 
-        new Akonadi::UnlinkJob(Akonadi::Collection{box->collectionId()}, items, this);
+        queueLinkOperation(box->collectionId(), items, false);
     });
     connect(&mMonitor,
             &Akonadi::Monitor::itemsMoved,
@@ -119,11 +139,11 @@ UnifiedMailboxManager::UnifiedMailboxManager(const KSharedConfigPtr &config, QOb
 
                 if (const auto srcBox = unifiedMailboxForSource(srcCollection.id())) {
                     // Move source collection was our source, unlink the Item from a box
-                    new Akonadi::UnlinkJob(Akonadi::Collection{srcBox->collectionId()}, items, this);
+                    queueLinkOperation(srcBox->collectionId(), items, false);
                 }
                 if (const auto dstBox = unifiedMailboxForSource(dstCollection.id())) {
                     // Move destination collection is our source, link the Item into a box
-                    new Akonadi::LinkJob(Akonadi::Collection{dstBox->collectionId()}, items, this);
+                    queueLinkOperation(dstBox->collectionId(), items, true);
                 }
             });
 
@@ -186,7 +206,89 @@ UnifiedMailboxManager::UnifiedMailboxManager(const KSharedConfigPtr &config, QOb
             });
 }
 
-UnifiedMailboxManager::~UnifiedMailboxManager() = default;
+UnifiedMailboxManager::~UnifiedMailboxManager()
+{
+    // The jobs don't belong to us, they still run once we are gone
+    flushAllLinkOperations();
+}
+
+void UnifiedMailboxManager::queueLinkOperation(qint64 boxColId, const Akonadi::Item::List &items, bool link)
+{
+    // The jobs of our session run in order, so sending what was queued before
+    // keeps the link and unlink operations of a box in the order of the changes
+    const auto pending = mPendingLinkOperations.constFind(boxColId);
+    if (pending != mPendingLinkOperations.cend() && pending->link != link) {
+        flushLinkOperations(boxColId);
+    }
+    auto &operation = mPendingLinkOperations[boxColId];
+    operation.link = link;
+    operation.items += items;
+    if (operation.items.size() >= MaximumLinkBatchSize) {
+        flushLinkOperations(boxColId);
+    } else if (!mLinkTimer.isActive()) {
+        mLinkTimer.start();
+    }
+}
+
+void UnifiedMailboxManager::flushLinkOperations(qint64 boxColId)
+{
+    const auto operation = mPendingLinkOperations.take(boxColId);
+    if (!operation.items.isEmpty()) {
+        startLinkJob(boxColId, operation.items, operation.link);
+    }
+}
+
+void UnifiedMailboxManager::flushAllLinkOperations()
+{
+    mLinkTimer.stop();
+    const auto boxColIds = mPendingLinkOperations.keys();
+    for (const auto boxColId : boxColIds) {
+        flushLinkOperations(boxColId);
+    }
+}
+
+void UnifiedMailboxManager::flushAllLinkOperationsAndWait()
+{
+    mLinkTimer.stop();
+    const auto boxColIds = mPendingLinkOperations.keys();
+    for (const auto boxColId : boxColIds) {
+        const auto operation = mPendingLinkOperations.take(boxColId);
+        if (!operation.items.isEmpty()) {
+            execLinkJob(boxColId, operation.items, operation.link);
+        }
+    }
+}
+
+void UnifiedMailboxManager::startLinkJob(qint64 boxColId, const Akonadi::Item::List &items, bool link)
+{
+    connect(createLinkJob(boxColId, items, link), &KJob::result, this, [this, boxColId, items, link](KJob *job) {
+        if (!job->error()) {
+            return;
+        }
+        if (items.size() > 1) {
+            const int half = items.size() / 2;
+            startLinkJob(boxColId, items.mid(0, half), link);
+            startLinkJob(boxColId, items.mid(half), link);
+        } else {
+            qCWarning(UNIFIEDMAILBOXAGENT_LOG) << "Failed to update box collection" << boxColId << ":" << job->errorString();
+        }
+    });
+}
+
+void UnifiedMailboxManager::execLinkJob(qint64 boxColId, const Akonadi::Item::List &items, bool link)
+{
+    auto job = createLinkJob(boxColId, items, link);
+    if (job->exec()) {
+        return;
+    }
+    if (items.size() > 1) {
+        const int half = items.size() / 2;
+        execLinkJob(boxColId, items.mid(0, half), link);
+        execLinkJob(boxColId, items.mid(half), link);
+    } else {
+        qCWarning(UNIFIEDMAILBOXAGENT_LOG) << "Failed to update box collection" << boxColId << ":" << job->errorString();
+    }
+}
 
 Akonadi::ChangeRecorder &UnifiedMailboxManager::changeRecorder()
 {
@@ -8,9 +8,11 @@
 
 #include "utils.h"
 
+#include <QHash>
 #include <QObject>
 #include <QSet>
 #include <QSettings>
+#include <QTimer>
 
 #include <KSharedConfig>
 
@@ -66,6 +68,24 @@ private:
     const UnifiedMailbox *unregisterSpecialSourceCollection(qint64 colId);
     const UnifiedMailbox *registerSpecialSourceCollection(const Akonadi::Collection &col);
 
+    /**
+     * Queues linking (or unlinking) @p items to the box collection @p boxColId.
+     * The queued operations are sent as one LinkJob or UnlinkJob per box.
+     *
+     * The change recorder already considers the queued changes processed, so
+     * they are also sent when the agent quits, waiting for the jobs to finish.
+     */
+    void queueLinkOperation(qint64 boxColId, const Akonadi::Item::List &items, bool link);
+    void flushLinkOperations(qint64 boxColId);
+    void flushAllLinkOperations();
+    void flushAllLinkOperationsAndWait();
+    /**
+     * Sends one LinkJob or UnlinkJob for @p items. One removed item makes the
+     * whole job fail, so a failed job is retried in halves.
+     */
+    void startLinkJob(qint64 boxColId, const Akonadi::Item::List &items, bool link);
+    void execLinkJob(qint64 boxColId, const Akonadi::Item::List &items, bool link);
+
     // Using std::unique_ptr because QScopedPointer is not movable
     // Using std::unordered_map because Qt containers do not support movable-only types,
     std::unordered_map<QString, std::unique_ptr<UnifiedMailbox>> mMailboxes;
@@ -74,5 +94,12 @@ private:
     Akonadi::ChangeRecorder mMonitor;
     QSettings mMonitorSettings;
 
+    struct PendingLinkOperation {
+        Akonadi::Item::List items;
+        bool link = true;
+    };
+    QHash<qint64, PendingLinkOperation> mPendingLinkOperations;
+    QTimer mLinkTimer;
+
     KSharedConfigPtr mConfig;
 };
@@ -0,0 +1,143 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "fetchschedulertest.h"
+#include "job/fetchscheduler.h"
+#include <QTest>
+QTEST_GUILESS_MAIN(FetchSchedulerTest)
+
+FetchSchedulerTest::FetchSchedulerTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void FetchSchedulerTest::shouldHaveDefaultValues()
+{
+    FetchScheduler scheduler;
+    QCOMPARE(scheduler.maximumConcurrentFetches(), 4);
+    QCOMPARE(scheduler.runningFetches(), 0);
+    QCOMPARE(scheduler.pendingFetches(), 0);
+    scheduler.setMaximumConcurrentFetches(0);
+    QCOMPARE(scheduler.maximumConcurrentFetches(), 1);
+}
+
+void FetchSchedulerTest::shouldLimitConcurrentFetches()
+{
+    FetchScheduler scheduler;
+    scheduler.setMaximumConcurrentFetches(2);
+    QObject first;
+    QObject second;
+    QObject third;
+    QStringList started;
+    scheduler.enqueue(&first, [&started]() {
+        started << QStringLiteral("first");
+    });
+    scheduler.enqueue(&second, [&started]() {
+        started << QStringLiteral("second");
+    });
+    scheduler.enqueue(&third, [&started]() {
+        started << QStringLiteral("third");
+    });
+    QCOMPARE(started, QStringList({QStringLiteral("first"), QStringLiteral("second")}));
+    QCOMPARE(scheduler.runningFetches(), 2);
+    QCOMPARE(scheduler.pendingFetches(&third), 1);
+
+    scheduler.release(&first);
+    QCOMPARE(started.last(), QStringLiteral("third"));
+    QCOMPARE(scheduler.runningFetches(), 2);
+    QCOMPARE(scheduler.pendingFetches(), 0);
+
+    // Releasing more than started is ignored
+    scheduler.release(&first);
+    QCOMPARE(scheduler.runningFetches(), 2);
+}
+
+void FetchSchedulerTest::shouldServeClientsInTurn()
+{
+    FetchScheduler scheduler;
+    scheduler.setMaximumConcurrentFetches(1);
+    QObject busy;
+    QObject other;
+    QStringList started;
+    for (int i = 0; i < 3; ++i) {
+        scheduler.enqueue(&busy, [&started]() {
+            started << QStringLiteral("busy");
+        });
+    }
+    scheduler.enqueue(&other, [&started]() {
+        started << QStringLiteral("other");
+    });
+    QCOMPARE(started, QStringList({QStringLiteral("busy")}));
+
+    scheduler.release(&busy);
+    // The other client doesn't wait for all the fetches of the first one
+    QCOMPARE(started.last(), QStringLiteral("other"));
+    scheduler.release(&other);
+    scheduler.release(&busy);
+    scheduler.release(&busy);
+    QCOMPARE(started, QStringList({QStringLiteral("busy"), QStringLiteral("other"), QStringLiteral("busy"), QStringLiteral("busy")}));
+    QCOMPARE(scheduler.runningFetches(), 1);
+    scheduler.release(&busy);
+    QCOMPARE(scheduler.runningFetches(), 0);
+}
+
+void FetchSchedulerTest::shouldForgetCanceledClients()
+{
+    FetchScheduler scheduler;
+    scheduler.setMaximumConcurrentFetches(1);
+    QObject first;
+    QObject second;
+    int secondStarted = 0;
+    scheduler.enqueue(&first, []() { });
+    scheduler.enqueue(&second, [&secondStarted]() {
+        ++secondStarted;
+    });
+    scheduler.enqueue(&second, [&secondStarted]() {
+        ++secondStarted;
+    });
+    QCOMPARE(scheduler.pendingFetches(&second), 2);
+
+    scheduler.cancel(&second);
+    QCOMPARE(scheduler.pendingFetches(), 0);
+    scheduler.cancel(&first);
+    QCOMPARE(scheduler.runningFetches(), 0);
+    QCOMPARE(secondStarted, 0);
+}
+
+void FetchSchedulerTest::shouldForgetDestroyedClients()
+{
+    FetchScheduler scheduler;
+    scheduler.setMaximumConcurrentFetches(1);
+    auto first = new QObject;
+    QObject second;
+    bool secondStarted = false;
+    scheduler.enqueue(first, []() { });
+    scheduler.enqueue(&second, [&secondStarted]() {
+        secondStarted = true;
+    });
+    QVERIFY(!secondStarted);
+
+    delete first;
+    QVERIFY(secondStarted);
+    QCOMPARE(scheduler.runningFetches(), 1);
+}
+
+void FetchSchedulerTest::shouldAcceptSynchronousRelease()
+{
+    FetchScheduler scheduler;
+    scheduler.setMaximumConcurrentFetches(1);
+    QObject client;
+    int started = 0;
+    for (int i = 0; i < 3; ++i) {
+        scheduler.enqueue(&client, [&scheduler, &client, &started]() {
+            ++started;
+            scheduler.release(&client);
+        });
+    }
+    QCOMPARE(started, 3);
+    QCOMPARE(scheduler.runningFetches(), 0);
+    QCOMPARE(scheduler.pendingFetches(), 0);
+}
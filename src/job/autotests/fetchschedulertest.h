@@ -0,0 +1,24 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+
+class FetchSchedulerTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FetchSchedulerTest(QObject *parent = nullptr);
+    ~FetchSchedulerTest() override = default;
+private Q_SLOTS:
+    void shouldHaveDefaultValues();
+    void shouldLimitConcurrentFetches();
+    void shouldServeClientsInTurn();
+    void shouldForgetCanceledClients();
+    void shouldForgetDestroyedClients();
+    void shouldAcceptSynchronousRelease();
+};
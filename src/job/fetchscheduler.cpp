@@ -0,0 +1,141 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "fetchscheduler.h"
+
+FetchScheduler::FetchScheduler(QObject *parent)
+    : QObject(parent)
+{
+}
+
+FetchScheduler::~FetchScheduler()
+{
+    for (const Client &client : std::as_const(mClients)) {
+        disconnect(client.destroyedConnection);
+    }
+}
+
+FetchScheduler *FetchScheduler::self()
+{
+    static FetchScheduler s_self;
+    return &s_self;
+}
+
+void FetchScheduler::setMaximumConcurrentFetches(int maximum)
+{
+    mMaximumConcurrentFetches = qMax(1, maximum);
+    startFetches();
+}
+
+int FetchScheduler::maximumConcurrentFetches() const
+{
+    return mMaximumConcurrentFetches;
+}
+
+void FetchScheduler::enqueue(QObject *client, const std::function<void()> &start)
+{
+    auto it = mClients.find(client);
+    if (it == mClients.end()) {
+        it = mClients.insert(client, Client());
+        it->arrival = ++mSequence;
+        it->destroyedConnection = connect(client, &QObject::destroyed, this, [this, client]() {
+            cancel(client);
+        });
+    }
+    it->pending.enqueue(start);
+    startFetches();
+}
+
+void FetchScheduler::release(QObject *client)
+{
+    auto it = mClients.find(client);
+    if (it == mClients.end() || it->running == 0) {
+        return;
+    }
+    --it->running;
+    --mRunning;
+    removeClientIfIdle(client);
+    startFetches();
+}
+
+void FetchScheduler::cancel(QObject *client)
+{
+    const auto it = mClients.constFind(client);
+    if (it == mClients.constEnd()) {
+        return;
+    }
+    mRunning -= it->running;
+    disconnect(it->destroyedConnection);
+    mClients.erase(it);
+    startFetches();
+}
+
+int FetchScheduler::runningFetches() const
+{
+    return mRunning;
+}
+
+int FetchScheduler::pendingFetches(QObject *client) const
+{
+    if (client) {
+        return mClients.value(client).pending.count();
+    }
+    int count = 0;
+    for (const Client &c : std::as_const(mClients)) {
+        count += c.pending.count();
+    }
+    return count;
+}
+
+void FetchScheduler::removeClientIfIdle(QObject *client)
+{
+    const auto it = mClients.constFind(client);
+    if (it != mClients.constEnd() && it->running == 0 && it->pending.isEmpty()) {
+        disconnect(it->destroyedConnection);
+        mClients.erase(it);
+    }
+}
+
+QObject *FetchScheduler::nextClient() const
+{
+    QObject *next = nullptr;
+    const Client *nextState = nullptr;
+    for (auto it = mClients.constBegin(), end = mClients.constEnd(); it != end; ++it) {
+        const Client &state = it.value();
+        if (state.pending.isEmpty()) {
+            continue;
+        }
+        if (!nextState || state.running < nextState->running
+            || (state.running == nextState->running
+                && (state.lastServed < nextState->lastServed || (state.lastServed == nextState->lastServed && state.arrival < nextState->arrival)))) {
+            next = it.key();
+            nextState = &state;
+        }
+    }
+    return next;
+}
+
+void FetchScheduler::startFetches()
+{
+    // The started fetches may release or cancel synchronously, the loop picks that up
+    if (mStarting) {
+        return;
+    }
+    mStarting = true;
+    while (mRunning < mMaximumConcurrentFetches) {
+        QObject *client = nextClient();
+        if (!client) {
+            break;
+        }
+        Client &state = mClients[client];
+        const std::function<void()> start = state.pending.dequeue();
+        state.lastServed = ++mSequence;
+        ++state.running;
+        ++mRunning;
+        start();
+    }
+    mStarting = false;
+}
@@ -0,0 +1,77 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "kmail_private_export.h"
+
+#include <QHash>
+#include <QObject>
+#include <QQueue>
+
+#include <functional>
+
+/**
+ * Limits the number of message fetches running at the same time.
+ *
+ * The commands ask for a slot before starting a fetch job and give it back
+ * when the job is done. When all the slots are busy the requests are queued.
+ * A free slot goes to the waiting client with the fewest running fetches, then
+ * to the one served least recently, so that a command fetching many chunks
+ * doesn't hold back the commands started after it.
+ */
+class KMAILTESTS_TESTS_EXPORT FetchScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FetchScheduler(QObject *parent = nullptr);
+    ~FetchScheduler() override;
+
+    static FetchScheduler *self();
+
+    void setMaximumConcurrentFetches(int maximum);
+    Q_REQUIRED_RESULT int maximumConcurrentFetches() const;
+
+    /**
+     * Calls @p start once @p client may start a fetch, which can be right away.
+     * The client has to call release() when that fetch is done.
+     */
+    void enqueue(QObject *client, const std::function<void()> &start);
+
+    /**
+     * Gives back the slot of a fetch of @p client.
+     */
+    void release(QObject *client);
+
+    /**
+     * Forgets the queued requests and the running fetches of @p client.
+     * This is done automatically when the client is destroyed.
+     */
+    void cancel(QObject *client);
+
+    Q_REQUIRED_RESULT int runningFetches() const;
+    Q_REQUIRED_RESULT int pendingFetches(QObject *client = nullptr) const;
+
+private:
+    Q_DISABLE_COPY(FetchScheduler)
+    struct Client {
+        QQueue<std::function<void()>> pending;
+        QMetaObject::Connection destroyedConnection;
+        quint64 arrival = 0;
+        quint64 lastServed = 0; // 0 until served once
+        int running = 0;
+    };
+
+    void startFetches();
+    Q_REQUIRED_RESULT QObject *nextClient() const;
+    void removeClientIfIdle(QObject *client);
+
+    QHash<QObject *, Client> mClients;
+    quint64 mSequence = 0;
+    int mRunning = 0;
+    int mMaximumConcurrentFetches = 4;
+    bool mStarting = false;
+};
@@ -34,6 +34,7 @@
 
 #include "kmail_debug.h"
 #include "kmreadermainwin.h"
+#include "mbox/mboxfilereader.h"
 #include "secondarywindow.h"
 #include "settings/kmailsettings.h"
 #include "util.h"
@@ -41,6 +42,7 @@
 
 #include "job/createforwardmessagejob.h"
 #include "job/createreplymessagejob.h"
+#include "job/fetchscheduler.h"
 
 #include "editor/composer.h"
 #include "kmmainwidget.h"
@@ -51,6 +53,8 @@
 #include <KMime/MDN>
 #include <KMime/Message>
 
+#include <KMbox/MBox>
+
 #include <AkonadiCore/ItemCopyJob>
 #include <AkonadiCore/ItemCreateJob>
 #include <AkonadiCore/ItemDeleteJob>
@@ -105,6 +109,7 @@
 
 #include <KEmailAddress>
 #include <KFileWidget>
+#include <KFormat>
 #include <KLocalizedString>
 #include <KMessageBox>
 #include <KRecentDirs>
@@ -120,6 +125,8 @@
 #include <QFontDatabase>
 #include <QProgressDialog>
 #include <QStandardPaths>
+#include <QTemporaryFile>
+#include <QTimer>
 
 using KMail::SecondaryWindow;
 using MailTransport::TransportManager;
@@ -131,6 +138,14 @@ using namespace KMime;
 
 using namespace MailCommon;
 
+namespace
+{
+// KMCommand retrieves the messages in chunks of at most that many messages
+constexpr int MaximumChunkMsgs = 100;
+// and of at most that many bytes, unless a single message is larger
+constexpr qint64 MaximumChunkSize = 16 * 1024 * 1024;
+}
+
 /// Helper to sanely show an error message for a job
 static void showJobError(KJob *job)
 {
@@ -223,7 +238,26 @@ void KMCommand::setResult(KMCommand::Result result)
     mResult = result;
 }
 
-int KMCommand::mCountJobs = 0;
+bool KMCommand::processesChunks() const
+{
+    return mProcessesChunks;
+}
+
+void KMCommand::setProcessesChunks(bool processesChunks)
+{
+    mProcessesChunks = processesChunks;
+}
+
+KMCommand::Result KMCommand::prepareChunks()
+{
+    return OK;
+}
+
+KMCommand::Result KMCommand::processChunk(const Akonadi::Item::List &msgs)
+{
+    Q_UNUSED(msgs)
+    return OK;
+}
 
 void KMCommand::start()
 {
@@ -237,8 +271,7 @@ void KMCommand::start()
     // Special case of operating on message that isn't in a folder
     const Akonadi::Item mb = mMsgList.constFirst();
     if ((mMsgList.count() == 1) && MessageComposer::Util::isStandaloneMessage(mb)) {
-        mRetrievedMsgs.append(mMsgList.takeFirst());
-        Q_EMIT messagesTransfered(OK);
+        deliverMsgs({mMsgList.takeFirst()});
         return;
     }
 
@@ -274,109 +307,217 @@ Akonadi::ItemFetchJob *KMCommand::createFetchJob(const Akonadi::Item::List &item
     return new Akonadi::ItemFetchJob(items, this);
 }
 
-void KMCommand::transferSelectedMsgs()
+void KMCommand::deliverMsgs(const Akonadi::Item::List &msgs)
 {
-    // make sure no other transfer is active
-    if (KMCommand::mCountJobs > 0) {
-        Q_EMIT messagesTransfered(Failed);
+    if (!mProcessesChunks) {
+        mRetrievedMsgs = msgs;
+        Q_EMIT messagesTransfered(OK);
         return;
     }
+    Result result = prepareChunks();
+    if (result == OK) {
+        result = processChunk(msgs);
+    }
+    Q_EMIT messagesTransfered(result);
+}
+
+void KMCommand::createChunks()
+{
+    mChunks.clear();
+    mTotalSize = 0;
+    bool sizesKnown = true;
+    Akonadi::Item::List chunk;
+    qint64 chunkSize = 0;
+    for (const Akonadi::Item &item : std::as_const(mMsgList)) {
+        // the size is unknown for items which didn't come from the message list
+        const qint64 size = qMax<qint64>(0, item.size());
+        sizesKnown = sizesKnown && size > 0;
+        if (!chunk.isEmpty() && (chunk.count() >= MaximumChunkMsgs || chunkSize + size > MaximumChunkSize)) {
+            mChunks.append(chunk);
+            chunk.clear();
+            chunkSize = 0;
+        }
+        chunk.append(item);
+        chunkSize += size;
+        mTotalSize += size;
+    }
+    if (!chunk.isEmpty()) {
+        mChunks.append(chunk);
+    }
+    if (!sizesKnown) {
+        // the progress is counted in messages then
+        mTotalSize = 0;
+    }
+}
 
-    bool complete = true;
-    KMCommand::mCountJobs = 0;
-    mCountMsgs = 0;
+void KMCommand::transferSelectedMsgs()
+{
     mRetrievedMsgs.clear();
     mCountMsgs = mMsgList.count();
-    uint totalSize = 0;
+
+    // TODO once the message list is based on ETM and we get the more advanced caching we need to make that check a bit more clever
+    if (mFetchScope.isEmpty()) {
+        // no need to fetch anything
+        deliverMsgs(mMsgList);
+        return;
+    }
+
+    if (mProcessesChunks) {
+        const Result result = prepareChunks();
+        if (result != OK) {
+            Q_EMIT messagesTransfered(result);
+            return;
+        }
+    }
+
+    createChunks();
+    mCurrentChunk = 0;
+    mTransferredMsgs = 0;
+    mTransferredSize = 0;
+
     // the QProgressDialog for the user-feedback. Only enable it if it's needed.
     // For some commands like KMSetStatusCommand it's not needed. Note, that
     // for some reason the QProgressDialog eats the MouseReleaseEvent (if a
     // command is executed after the MousePressEvent), cf. bug #71761.
-    if (mCountMsgs > 0) {
-        mProgressDialog = new QProgressDialog(mParent);
-        mProgressDialog.data()->setWindowTitle(i18nc("@title:window", "Please wait"));
+    mProgressDialog = new QProgressDialog(mParent);
+    mProgressDialog.data()->setWindowTitle(i18nc("@title:window", "Please wait"));
+    mProgressDialog.data()->setLabelText(i18n("Waiting for other transfers to finish"));
+    mProgressDialog.data()->setModal(true);
+    mProgressDialog.data()->setMinimumDuration(1000);
+    // in KiB when the sizes are known, so that large selections fit in an int
+    mProgressDialog.data()->setMaximum(mTotalSize > 0 ? static_cast<int>((mTotalSize + 1023) / 1024) : mCountMsgs);
+    connect(mProgressDialog.data(), &QProgressDialog::canceled, this, &KMCommand::slotTransferCancelled);
 
-        mProgressDialog.data()->setLabelText(
-            i18np("Please wait while the message is transferred", "Please wait while the %1 messages are transferred", mMsgList.count()));
-        mProgressDialog.data()->setModal(true);
-        mProgressDialog.data()->setMinimumDuration(1000);
-    }
+    mTransferring = true;
+    enqueueNextChunk();
+}
 
-    // TODO once the message list is based on ETM and we get the more advanced caching we need to make that check a bit more clever
-    if (!mFetchScope.isEmpty()) {
-        complete = false;
-        ++KMCommand::mCountJobs;
-        Akonadi::ItemFetchJob *fetch = createFetchJob(mMsgList);
-        mFetchScope.fetchAttribute<MailCommon::MDNStateAttribute>();
-        fetch->setFetchScope(mFetchScope);
-        connect(fetch, &Akonadi::ItemFetchJob::itemsReceived, this, &KMCommand::slotMsgTransfered);
-        connect(fetch, &Akonadi::ItemFetchJob::result, this, &KMCommand::slotJobFinished);
-    } else {
-        // no need to fetch anything
-        if (!mMsgList.isEmpty()) {
-            mRetrievedMsgs = mMsgList;
-        }
+void KMCommand::enqueueNextChunk()
+{
+    // other commands may be transferring messages too, wait for our turn
+    FetchScheduler::self()->enqueue(this, [this]() {
+        startFetchJob();
+    });
+}
+
+void KMCommand::startFetchJob()
+{
+    // a modal progress dialog processes events when updated, the user may cancel from there
+    updateProgress();
+    if (!mTransferring) {
+        FetchScheduler::self()->release(this);
+        return;
     }
+    Akonadi::ItemFetchJob *fetch = createFetchJob(mChunks.at(mCurrentChunk));
+    mFetchScope.fetchAttribute<MailCommon::MDNStateAttribute>();
+    fetch->setFetchScope(mFetchScope);
+    connect(fetch, &Akonadi::ItemFetchJob::itemsReceived, this, &KMCommand::slotMsgTransfered);
+    connect(fetch, &Akonadi::ItemFetchJob::result, this, &KMCommand::slotJobFinished);
+    mFetchJob = fetch;
+}
 
-    if (complete) {
-        delete mProgressDialog.data();
-        mProgressDialog.clear();
-        Q_EMIT messagesTransfered(OK);
+void KMCommand::updateProgress()
+{
+    QProgressDialog *dialog = mProgressDialog.data();
+    if (!dialog) {
+        return;
+    }
+    if (mTotalSize > 0) {
+        dialog->setLabelText(i18np("Please wait while the message is transferred (%2 of %3)",
+                                   "Please wait while the %1 messages are transferred (%2 of %3)",
+                                   mCountMsgs,
+                                   KFormat().formatByteSize(qMin(mTransferredSize, mTotalSize)),
+                                   KFormat().formatByteSize(mTotalSize)));
+        dialog->setValue(qMin(dialog->maximum(), static_cast<int>(mTransferredSize / 1024)));
     } else {
-        // wait for the transfer and tell the progressBar the necessary steps
-        if (mProgressDialog.data()) {
-            connect(mProgressDialog.data(), &QProgressDialog::canceled, this, &KMCommand::slotTransferCancelled);
-            mProgressDialog.data()->setMaximum(totalSize);
-        }
+        dialog->setLabelText(i18np("Please wait while the message is transferred", "Please wait while the %1 messages are transferred", mCountMsgs));
+        dialog->setValue(qMin(dialog->maximum(), mTransferredMsgs));
     }
 }
 
 void KMCommand::slotMsgTransfered(const Akonadi::Item::List &msgs)
 {
-    if (mProgressDialog.data() && mProgressDialog.data()->wasCanceled()) {
-        Q_EMIT messagesTransfered(Canceled);
+    if (!mTransferring) {
         return;
     }
     // save the complete messages
-    mRetrievedMsgs.append(msgs);
+    mChunkMsgs.append(msgs);
+    mTransferredMsgs += msgs.count();
+    for (const Akonadi::Item &item : msgs) {
+        mTransferredSize += qMax<qint64>(0, item.size());
+    }
+    updateProgress();
 }
 
-void KMCommand::slotJobFinished()
+void KMCommand::slotJobFinished(KJob *job)
 {
     // the job is finished (with / without error)
-    KMCommand::mCountJobs--;
-
-    if (mProgressDialog.data() && mProgressDialog.data()->wasCanceled()) {
+    FetchScheduler::self()->release(this);
+    mFetchJob.clear();
+    if (!mTransferring) {
         return;
     }
 
-    if (mCountMsgs > mRetrievedMsgs.count()) {
+    if (mChunks.at(mCurrentChunk).count() > mChunkMsgs.count()) {
         // the message wasn't retrieved before => error
+        if (job->error()) {
+            qCWarning(KMAIL_LOG) << "Unable to retrieve the messages:" << job->errorString();
+        }
         if (mProgressDialog.data()) {
             mProgressDialog.data()->hide();
         }
         slotTransferCancelled();
         return;
     }
-    // update the progressbar
-    if (mProgressDialog.data()) {
-        mProgressDialog.data()->setLabelText(
-            i18np("Please wait while the message is transferred", "Please wait while the %1 messages are transferred", KMCommand::mCountJobs));
+
+    const Akonadi::Item::List msgs = mChunkMsgs;
+    mChunkMsgs.clear();
+    if (mProcessesChunks) {
+        const Result result = processChunk(msgs);
+        if (result != OK) {
+            finishTransfer(result);
+            return;
+        }
+    } else {
+        mRetrievedMsgs += msgs;
+    }
+
+    if (++mCurrentChunk < mChunks.count()) {
+        enqueueNextChunk();
+        return;
+    }
+    // all done
+    finishTransfer(OK);
+}
+
+void KMCommand::finishTransfer(Result result)
+{
+    mTransferring = false;
+    FetchScheduler::self()->cancel(this);
+    if (mFetchJob) {
+        mFetchJob->kill(KJob::Quietly);
+        mFetchJob.clear();
     }
-    if (KMCommand::mCountJobs == 0) {
-        // all done
-        delete mProgressDialog.data();
+    if (mProgressDialog.data()) {
+        // we may be called from its canceled() signal
+        mProgressDialog.data()->deleteLater();
         mProgressDialog.clear();
-        Q_EMIT messagesTransfered(OK);
     }
+    mChunks.clear();
+    mChunkMsgs.clear();
+    if (result != OK) {
+        mCountMsgs = 0;
+        mRetrievedMsgs.clear();
+    }
+    Q_EMIT messagesTransfered(result);
 }
 
 void KMCommand::slotTransferCancelled()
 {
-    KMCommand::mCountJobs = 0;
-    mCountMsgs = 0;
-    mRetrievedMsgs.clear();
-    Q_EMIT messagesTransfered(Canceled);
+    if (!mTransferring) {
+        return;
+    }
+    finishTransfer(Canceled);
 }
 
 KMMailtoComposeCommand::KMMailtoComposeCommand(const QUrl &url, const Akonadi::Item &msg)
@@ -663,22 +804,101 @@ KMCommand::Result KMUseTemplateCommand::execute()
 
 KMSaveMsgCommand::KMSaveMsgCommand(QWidget *parent, const Akonadi::Item::List &msgList)
     : KMCommand(parent, msgList)
+    , mMsgCount(msgList.count())
 {
     if (msgList.empty()) {
         return;
     }
+    mFirstMsg = msgList.constFirst();
 
     fetchScope().fetchFullPayload(true); // ### unless we call the corresponding KMCommand ctor, this has no effect
+    // the messages are written to the file as they arrive, instead of being kept in memory
+    setProcessesChunks(true);
 }
 
-KMCommand::Result KMSaveMsgCommand::execute()
+KMSaveMsgCommand::~KMSaveMsgCommand() = default;
+
+QString KMSaveMsgCommand::defaultFileName() const
+{
+    // the messages are not retrieved yet, but the message list and the search
+    // window already fetched the envelope of the selected ones
+    QString fileName;
+    if (mFirstMsg.hasPayload<KMime::Message::Ptr>()) {
+        fileName = MessageCore::StringUtil::cleanFileName(mFirstMsg.payload<KMime::Message::Ptr>()->subject()->asUnicodeString().trimmed());
+    }
+    if (fileName.isEmpty()) {
+        fileName = i18n("message");
+    }
+    return fileName + QLatin1String(".mbox");
+}
+
+KMCommand::Result KMSaveMsgCommand::prepareChunks()
+{
+    mUrl = QFileDialog::getSaveFileUrl(parentWidget(),
+                                       i18np("Save Message", "Save Messages", mMsgCount),
+                                       QUrl::fromLocalFile(defaultFileName()),
+                                       i18n("email messages (*.mbox);;all files (*)"));
+    if (mUrl.isEmpty()) {
+        return Canceled;
+    }
+
+    mFile = new QTemporaryFile(this);
+    if (!mFile->open()) {
+        KMessageBox::error(parentWidget(), i18n("Unable to create a temporary file to save the messages."));
+        return Failed;
+    }
+    mFile->close();
+    mMbox = std::make_unique<KMBox::MBox>();
+    if (!mMbox->load(mFile->fileName())) {
+        KMessageBox::error(parentWidget(), i18n("Unable to create a temporary file to save the messages."));
+        return Failed;
+    }
+    return OK;
+}
+
+KMCommand::Result KMSaveMsgCommand::processChunk(const Akonadi::Item::List &msgs)
 {
-    if (!MessageViewer::Util::saveMessageInMbox(retrievedMsgs(), parentWidget())) {
+    for (const Akonadi::Item &item : msgs) {
+        if (item.hasPayload<KMime::Message::Ptr>()) {
+            mMbox->appendMessage(item.payload<KMime::Message::Ptr>());
+        }
+    }
+    // write the chunk right away, KMBox keeps the appended messages in memory until then
+    if (!mMbox->save()) {
+        KMessageBox::error(parentWidget(), i18n("Unable to write to %1.", mUrl.toDisplayString()));
         return Failed;
     }
     return OK;
 }
 
+KMCommand::Result KMSaveMsgCommand::execute()
+{
+    if (!mMbox) {
+        // nothing was selected
+        return OK;
+    }
+    // closes the file
+    mMbox.reset();
+
+    KIO::Job *job = KIO::file_copy(QUrl::fromLocalFile(mFile->fileName()), mUrl, -1, KIO::Overwrite);
+    connect(job, &KIO::Job::result, this, &KMSaveMsgCommand::slotUploadResult);
+    setEmitsCompletedItself(true);
+    setDeletesItself(true);
+    return OK;
+}
+
+void KMSaveMsgCommand::slotUploadResult(KJob *job)
+{
+    if (job->error()) {
+        showJobError(job);
+        setResult(Failed);
+    } else {
+        setResult(OK);
+    }
+    Q_EMIT completed(this);
+    deleteLater();
+}
+
 //-----------------------------------------------------------------------------
 
 KMOpenMsgCommand::KMOpenMsgCommand(QWidget *parent, const QUrl &url, const QString &encoding, KMMainWidget *main)
@@ -703,21 +923,44 @@ KMCommand::Result KMOpenMsgCommand::execute()
         mMainWidget->addRecentFile(mUrl);
     }
 
+    if (mUrl.isLocalFile()) {
+        setDeletesItself(true);
+        setEmitsCompletedItself(true);
+        // Delay it like the download of remote files, completed() is emitted from there
+        QTimer::singleShot(0, this, [this]() {
+            showMessages(new QFile(mUrl.toLocalFile()));
+        });
+        return OK;
+    }
+
+    mTempFile = new QTemporaryFile(this);
+    if (!mTempFile->open()) {
+        KMessageBox::sorry(parentWidget(), i18n("Unable to create a temporary file to download the message."));
+        return Failed;
+    }
     setDeletesItself(true);
+    setEmitsCompletedItself(true);
     mJob = KIO::get(mUrl, KIO::NoReload, KIO::HideProgressInfo);
     connect(mJob, &KIO::TransferJob::data, this, &KMOpenMsgCommand::slotDataArrived);
     connect(mJob, &KJob::result, this, &KMOpenMsgCommand::slotResult);
-    setEmitsCompletedItself(true);
     return OK;
 }
 
-void KMOpenMsgCommand::slotDataArrived(KIO::Job *, const QByteArray &data)
+void KMOpenMsgCommand::slotDataArrived(KIO::Job *job, const QByteArray &data)
 {
     if (data.isEmpty()) {
         return;
     }
 
-    mMsgString.append(QString::fromLatin1(data.data()));
+    if (mTempFile->write(data) != data.size()) {
+        qCWarning(KMAIL_LOG) << "Unable to write the downloaded message:" << mTempFile->errorString();
+        job->kill(KJob::Quietly);
+        mJob = nullptr;
+        KMessageBox::error(parentWidget(), i18n("Unable to download the message: %1", mTempFile->errorString()));
+        setResult(Failed);
+        Q_EMIT completed(this);
+        deleteLater();
+    }
 }
 
 void KMOpenMsgCommand::doesNotContainMessage()
@@ -740,66 +983,31 @@ void KMOpenMsgCommand::slotResult(KJob *job)
         // handle errors
         showJobError(job);
         setResult(Failed);
-    } else {
-        if (mMsgString.isEmpty()) {
-            qCDebug(KMAIL_LOG) << " Message not found. There is a problem";
-            doesNotContainMessage();
-            return;
-        }
-        int startOfMessage = 0;
-        if (mMsgString.startsWith(QLatin1String("From "))) {
-            startOfMessage = mMsgString.indexOf(QLatin1Char('\n'));
-            if (startOfMessage == -1) {
-                doesNotContainMessage();
-                return;
-            }
-            startOfMessage += 1; // the message starts after the '\n'
-        }
-        QVector<KMime::Message::Ptr> listMessages;
-
-        // check for multiple messages in the file
-        bool multipleMessages = true;
-        int endOfMessage = mMsgString.indexOf(QLatin1String("\nFrom "), startOfMessage);
-        while (endOfMessage != -1) {
-            auto msg = new KMime::Message;
-            msg->setContent(KMime::CRLFtoLF(mMsgString.mid(startOfMessage, endOfMessage - startOfMessage).toUtf8()));
-            msg->parse();
-            if (!msg->hasContent()) {
-                delete msg;
-                msg = nullptr;
-                doesNotContainMessage();
-                return;
-            }
-            KMime::Message::Ptr mMsg(msg);
-            listMessages << mMsg;
-            startOfMessage = endOfMessage + 1;
-            endOfMessage = mMsgString.indexOf(QLatin1String("\nFrom "), startOfMessage);
-        }
-        if (endOfMessage == -1) {
-            endOfMessage = mMsgString.length();
-            multipleMessages = false;
-            auto msg = new KMime::Message;
-            msg->setContent(KMime::CRLFtoLF(mMsgString.mid(startOfMessage, endOfMessage - startOfMessage).toUtf8()));
-            msg->parse();
-            if (!msg->hasContent()) {
-                delete msg;
-                msg = nullptr;
-                doesNotContainMessage();
-                return;
-            }
-            KMime::Message::Ptr mMsg(msg);
-            listMessages << mMsg;
-        }
-        auto win = new KMReaderMainWin();
-        win->showMessage(mEncoding, listMessages);
-        win->show();
-        if (multipleMessages) {
-            KMessageBox::information(win,
-                                     i18n("The file contains multiple messages. "
-                                          "Only the first message is shown."));
-        }
-        setResult(OK);
+        Q_EMIT completed(this);
+        deleteLater();
+        return;
     }
+    mTempFile->close();
+    // The reader owns it from now on
+    mTempFile->setParent(nullptr);
+    QTemporaryFile *file = mTempFile;
+    mTempFile = nullptr;
+    showMessages(file);
+}
+
+void KMOpenMsgCommand::showMessages(QFile *file)
+{
+    auto reader = new MboxFileReader;
+    if (!reader->open(file) || reader->count() == 0 || !reader->message(0)) {
+        qCDebug(KMAIL_LOG) << " Message not found. There is a problem";
+        delete reader;
+        doesNotContainMessage();
+        return;
+    }
+    auto win = new KMReaderMainWin();
+    win->showMessages(mEncoding, reader);
+    win->show();
+    setResult(OK);
     Q_EMIT completed(this);
     deleteLater();
 }
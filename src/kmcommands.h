@@ -19,11 +19,20 @@
 #include <QList>
 #include <QPointer>
 #include <QUrl>
+
+#include <memory>
+class QFile;
+class QTemporaryFile;
 namespace Akonadi
 {
 class Tag;
 }
 
+namespace KMBox
+{
+class MBox;
+}
+
 namespace KPIM
 {
 class ProgressItem;
@@ -124,6 +133,27 @@ protected:
     */
     void setEmitsCompletedItself(bool emitsCompletedItself);
 
+    bool processesChunks() const;
+    /** Specify whether the subclass processes the messages chunk by chunk while
+      they are retrieved. By default all the messages are retrieved first and
+      are available through retrievedMsgs() in execute().
+      @param processesChunks true if prepareChunks() and processChunk() should
+                             be called, retrievedMsgs() stays empty then
+    */
+    void setProcessesChunks(bool processesChunks);
+
+    /** Called before the first chunk is retrieved, when the command processes
+      chunks. A result other than OK ends the command.
+    */
+    virtual Result prepareChunks();
+
+    /** Called with each chunk of retrieved messages, in the order of the
+      selection, when the command processes chunks. The messages are not kept
+      afterwards. A result other than OK ends the command. execute() is called
+      once all the chunks were processed.
+    */
+    virtual Result processChunk(const Akonadi::Item::List &msgs);
+
     /** Use this to set the result of the command.
       @param result The result of the command.
     */
@@ -138,12 +168,23 @@ private:
      *  this is a necessary preparation for e.g. forwarding */
     void transferSelectedMsgs();
 
+    /** splits the selection into chunks of a bounded number of messages and bytes */
+    void createChunks();
+    /** waits for a slot of the fetch scheduler to retrieve the next chunk */
+    void enqueueNextChunk();
+    /** starts the fetch job once the fetch scheduler gave us a slot */
+    void startFetchJob();
+    /** hands messages which didn't need to be transferred over */
+    void deliverMsgs(const Akonadi::Item::List &msgs);
+    void finishTransfer(Result result);
+    void updateProgress();
+
 private Q_SLOTS:
     void slotPostTransfer(KMCommand::Result result);
     /** the msg has been transferred */
     void slotMsgTransfered(const Akonadi::Item::List &msgs);
-    /** the KMImapJob is finished */
-    void slotJobFinished();
+    /** the fetch job is finished */
+    void slotJobFinished(KJob *job);
     /** the transfer was canceled */
     void slotTransferCancelled();
 
@@ -153,9 +194,17 @@ protected:
 private:
     // ProgressDialog for transferring messages
     QPointer<QProgressDialog> mProgressDialog;
-    // Currently only one async command allowed at a time
-    static int mCountJobs;
+    QPointer<Akonadi::ItemFetchJob> mFetchJob;
+    QVector<Akonadi::Item::List> mChunks;
+    // the messages of the current chunk retrieved so far
+    Akonadi::Item::List mChunkMsgs;
+    int mCurrentChunk = 0;
     int mCountMsgs = 0;
+    int mTransferredMsgs = 0;
+    qint64 mTotalSize = 0;
+    qint64 mTransferredSize = 0;
+    bool mTransferring = false;
+    bool mProcessesChunks = false;
     Result mResult = Undefined;
     bool mDeletesItself : 1;
     bool mEmitsCompletedItself : 1;
@@ -282,9 +331,24 @@ class KMAILTESTS_TESTS_EXPORT KMSaveMsgCommand : public KMCommand
 
 public:
     KMSaveMsgCommand(QWidget *parent, const Akonadi::Item::List &msgList);
+    ~KMSaveMsgCommand() override;
+
+private Q_SLOTS:
+    void slotUploadResult(KJob *job);
 
 private:
+    Result prepareChunks() override;
+    Result processChunk(const Akonadi::Item::List &msgs) override;
     Result execute() override;
+    Q_REQUIRED_RESULT QString defaultFileName() const;
+
+    Akonadi::Item mFirstMsg;
+    QUrl mUrl;
+    // KMBox appends to the file it loads, so the messages are written to a
+    // new temporary file which is copied to mUrl at the end
+    QTemporaryFile *mFile = nullptr;
+    std::unique_ptr<KMBox::MBox> mMbox;
+    int mMsgCount = 0;
 };
 
 class KMAILTESTS_TESTS_EXPORT KMOpenMsgCommand : public KMCommand
@@ -303,9 +367,10 @@ private Q_SLOTS:
 
 private:
     void doesNotContainMessage();
-    static const int MAX_CHUNK_SIZE = 64 * 1024;
+    void showMessages(QFile *file);
     QUrl mUrl;
-    QString mMsgString;
+    // Remote files are downloaded to it, so that they can be read like local ones
+    QTemporaryFile *mTempFile = nullptr;
     KIO::TransferJob *mJob = nullptr;
     const QString mEncoding;
     KMMainWidget *mMainWidget = nullptr;
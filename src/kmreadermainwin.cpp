@@ -17,6 +17,7 @@
 #include "job/composenewmessagejob.h"
 #include "kmmainwidget.h"
 #include "kmreaderwin.h"
+#include "mbox/mboxfilereader.h"
 #include "widgets/zoomlabelwidget.h"
 
 #include "kmail_debug.h"
@@ -176,20 +177,48 @@ void KMReaderMainWin::showMessage(const QString &encoding, const Akonadi::Item &
 
 void KMReaderMainWin::updateButtons()
 {
-    if (mListMessage.count() <= 1) {
+    if (messageCount() <= 1) {
         return;
     }
-    mReaderWin->updateShowMultiMessagesButton((mCurrentMessageIndex > 0), (mCurrentMessageIndex < (mListMessage.count() - 1)));
+    mReaderWin->updateShowMultiMessagesButton((mCurrentMessageIndex > 0), (mCurrentMessageIndex < (messageCount() - 1)));
+}
+
+int KMReaderMainWin::messageCount() const
+{
+    return mMboxReader ? mMboxReader->count() : mListMessage.count();
+}
+
+void KMReaderMainWin::showMessageAt(int index)
+{
+    mCurrentMessageIndex = index;
+    const KMime::Message::Ptr message = mMboxReader ? mMboxReader->message(index) : mListMessage.at(index);
+    if (message) {
+        initializeMessage(message);
+    } else {
+        // Keep the other messages of the file reachable
+        mMsg = Akonadi::Item();
+        mMsgActions->setCurrentMessage(mMsg);
+        mReaderWin->clear(true);
+        mAkonadiStandardActionManager->setItems({});
+        updateActions();
+    }
+    const int count = messageCount();
+    if (count > 1) {
+        if (message) {
+            slotShowMessageStatusBar(i18n("Message %1 of %2", index + 1, count));
+        } else {
+            slotShowMessageStatusBar(i18n("Message %1 of %2 is not a valid message.", index + 1, count));
+        }
+    }
+    updateButtons();
 }
 
 void KMReaderMainWin::showNextMessage()
 {
-    if (mCurrentMessageIndex >= (mListMessage.count() - 1)) {
+    if (mCurrentMessageIndex >= (messageCount() - 1)) {
         return;
     }
-    mCurrentMessageIndex++;
-    initializeMessage(mListMessage.at(mCurrentMessageIndex));
-    updateButtons();
+    showMessageAt(mCurrentMessageIndex + 1);
 }
 
 void KMReaderMainWin::showPreviousMessage()
@@ -197,24 +226,21 @@ void KMReaderMainWin::showPreviousMessage()
     if (mCurrentMessageIndex <= 0) {
         return;
     }
-    mCurrentMessageIndex--;
-    initializeMessage(mListMessage.at(mCurrentMessageIndex));
-    updateButtons();
+    showMessageAt(mCurrentMessageIndex - 1);
 }
 
-void KMReaderMainWin::showMessage(const QString &encoding, const QVector<KMime::Message::Ptr> &message)
+void KMReaderMainWin::showMessages(const QString &encoding, MboxFileReader *reader)
 {
-    if (message.isEmpty()) {
+    mMboxReader.reset(reader);
+    mListMessage.clear();
+    if (messageCount() == 0) {
         return;
     }
 
-    mListMessage = message;
     mReaderWin->setOverrideEncoding(encoding);
-    mCurrentMessageIndex = 0;
-    initializeMessage(mListMessage.at(mCurrentMessageIndex));
-    mReaderWin->hasMultiMessages(message.count() > 1);
+    mReaderWin->hasMultiMessages(messageCount() > 1);
     mAkonadiStandardActionManager->setItems({});
-    updateButtons();
+    showMessageAt(0);
 }
 
 void KMReaderMainWin::initializeMessage(const KMime::Message::Ptr &message)
@@ -240,8 +266,12 @@ void KMReaderMainWin::showMessage(const QString &encoding, const KMime::Message:
     if (!message) {
         return;
     }
-    const QVector<KMime::Message::Ptr> lst{message};
-    showMessage(encoding, lst);
+    mMboxReader.reset();
+    mListMessage = {message};
+    mReaderWin->setOverrideEncoding(encoding);
+    mReaderWin->hasMultiMessages(false);
+    mAkonadiStandardActionManager->setItems({});
+    showMessageAt(0);
 }
 
 void KMReaderMainWin::updateActions()
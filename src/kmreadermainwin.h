@@ -13,7 +13,11 @@
 #include <AkonadiCore/item.h>
 #include <MessageViewer/Viewer>
 #include <QModelIndex>
+
+#include <memory>
+
 class KMReaderWin;
+class MboxFileReader;
 class QAction;
 class KJob;
 class ZoomLabelWidget;
@@ -61,8 +65,14 @@ public:
      */
     void showMessage(const QString &encoding, const Akonadi::Item &msg, const Akonadi::Collection &parentCollection = Akonadi::Collection());
 
-    void showMessage(const QString &encoding, const QVector<KMime::Message::Ptr> &message);
     void showMessage(const QString &encoding, const KMime::Message::Ptr &message);
+
+    /**
+     * take ownership of @p reader and show its messages, one at a time
+     *
+     * The messages are parsed when the user pages to them.
+     */
+    void showMessages(const QString &encoding, MboxFileReader *reader);
     void showMessagePopup(const Akonadi::Item &msg,
                           const QUrl &aUrl,
                           const QUrl &imageUrl,
@@ -110,6 +120,8 @@ private:
     void toggleMessageSetTag(const Akonadi::Item::List &select, const Akonadi::Tag &tag);
     void slotUpdateMessageTagList(const Akonadi::Tag &tag);
     void initializeMessage(const KMime::Message::Ptr &message);
+    Q_REQUIRED_RESULT int messageCount() const;
+    void showMessageAt(int index);
     void showNextMessage();
     void showPreviousMessage();
     void updateButtons();
@@ -118,6 +130,7 @@ private:
     void slotMarkMailAs();
 
     QVector<KMime::Message::Ptr> mListMessage;
+    std::unique_ptr<MboxFileReader> mMboxReader;
     int mCurrentMessageIndex = 0;
     Akonadi::Collection mParentCollection;
     Akonadi::Item mMsg;
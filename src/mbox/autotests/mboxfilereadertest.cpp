@@ -0,0 +1,172 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "mboxfilereadertest.h"
+#include "mbox/mboxfilereader.h"
+
+#include <KMbox/MBox>
+
+#include <QTemporaryFile>
+#include <QTest>
+
+QTEST_GUILESS_MAIN(MboxFileReaderTest)
+
+namespace
+{
+QTemporaryFile *createFile(const QByteArray &content)
+{
+    auto file = new QTemporaryFile;
+    if (file->open()) {
+        file->write(content);
+        file->close();
+    }
+    return file;
+}
+}
+
+MboxFileReaderTest::MboxFileReaderTest(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void MboxFileReaderTest::shouldHaveDefaultValues()
+{
+    MboxFileReader reader;
+    QCOMPARE(reader.count(), 0);
+    QVERIFY(reader.rawMessage(0).isEmpty());
+    QVERIFY(!reader.message(0));
+    QVERIFY(!reader.open(QStringLiteral("/does/not/exist.mbox")));
+}
+
+void MboxFileReaderTest::shouldIndexMessages_data()
+{
+    QTest::addColumn<QByteArray>("content");
+    QTest::addColumn<QList<QByteArray>>("messages");
+
+    QTest::newRow("empty") << QByteArray() << QList<QByteArray>();
+    QTest::newRow("single message") << QByteArrayLiteral("Subject: a\n\nbody\n") << QList<QByteArray>{QByteArrayLiteral("Subject: a\n\nbody\n")};
+    QTest::newRow("single mbox message") << QByteArrayLiteral("From a@example.com Mon Jan 1 00:00:00 2021\nSubject: a\n\nbody\n")
+                                         << QList<QByteArray>{QByteArrayLiteral("Subject: a\n\nbody\n")};
+    QTest::newRow("several messages") << QByteArrayLiteral(
+        "From a@example.com Mon Jan 1 00:00:00 2021\nSubject: a\n\nbody a\n\nFrom b@example.com Mon Jan 1 00:00:00 2021\nSubject: b\n\nbody b\n")
+                                      << QList<QByteArray>{QByteArrayLiteral("Subject: a\n\nbody a\n"), QByteArrayLiteral("Subject: b\n\nbody b\n")};
+    QTest::newRow("quoted from") << QByteArrayLiteral("From a@example.com\nSubject: a\n\n>From here\n")
+                                 << QList<QByteArray>{QByteArrayLiteral("Subject: a\n\n>From here\n")};
+    QTest::newRow("separator only") << QByteArrayLiteral("From a@example.com\n") << QList<QByteArray>();
+    QTest::newRow("empty message") << QByteArrayLiteral("From a@example.com\nFrom b@example.com\nSubject: b\n")
+                                   << QList<QByteArray>{QByteArrayLiteral("Subject: b\n")};
+}
+
+void MboxFileReaderTest::shouldIndexMessages()
+{
+    QFETCH(QByteArray, content);
+    QFETCH(QList<QByteArray>, messages);
+
+    MboxFileReader reader;
+    QVERIFY(reader.open(createFile(content)));
+    QCOMPARE(reader.count(), messages.count());
+    for (int i = 0; i < messages.count(); ++i) {
+        QCOMPARE(reader.rawMessage(i), messages.at(i));
+    }
+    QVERIFY(reader.rawMessage(messages.count()).isEmpty());
+}
+
+void MboxFileReaderTest::shouldParseMessagesOnDemand()
+{
+    MboxFileReader reader;
+    QVERIFY(reader.open(createFile(QByteArrayLiteral(
+        "From a@example.com\r\nSubject: first\r\n\r\nbody\r\n\nFrom b@example.com\nSubject: second\n\nbody\n"))));
+    QCOMPARE(reader.count(), 2);
+
+    const KMime::Message::Ptr second = reader.message(1);
+    QVERIFY(second);
+    QCOMPARE(second->subject()->asUnicodeString(), QStringLiteral("second"));
+    const KMime::Message::Ptr first = reader.message(0);
+    QVERIFY(first);
+    QCOMPARE(first->subject()->asUnicodeString(), QStringLiteral("first"));
+
+    // The messages don't depend on the reader
+    reader.close();
+    QCOMPARE(reader.count(), 0);
+    QCOMPARE(first->subject()->asUnicodeString(), QStringLiteral("first"));
+}
+
+void MboxFileReaderTest::shouldKeepBinaryContent()
+{
+    const QByteArray body = QByteArrayLiteral("Subject: a\n\n\xc3\xa9t\xc3\xa9") + QByteArray(1, '\0') + QByteArrayLiteral("end\n");
+    MboxFileReader reader;
+    QVERIFY(reader.open(createFile(QByteArrayLiteral("From a@example.com\n") + body)));
+    QCOMPARE(reader.count(), 1);
+    QCOMPARE(reader.rawMessage(0), body);
+}
+
+void MboxFileReaderTest::shouldIndexAcrossBlocks()
+{
+    // Larger than a block of the index, with lines on the block boundaries
+    QByteArray content;
+    QList<QByteArray> messages;
+    for (int i = 0; content.size() < 3 * 1024 * 1024; ++i) {
+        const QByteArray message = QByteArrayLiteral("Subject: ") + QByteArray::number(i) + QByteArrayLiteral("\n\n") + QByteArray(1000 + i % 7, 'a') + '\n';
+        content += QByteArrayLiteral("From a@example.com\n") + message + '\n';
+        messages.append(message);
+    }
+    MboxFileReader reader;
+    QVERIFY(reader.open(createFile(content)));
+    QCOMPARE(reader.count(), messages.count());
+    for (int i = 0; i < messages.count(); ++i) {
+        QCOMPARE(reader.rawMessage(i), messages.at(i));
+    }
+}
+
+void MboxFileReaderTest::shouldNotReadTruncatedMessages()
+{
+    QTemporaryFile *file = createFile(
+        QByteArrayLiteral("From a@example.com\nSubject: first\n\nbody\n\nFrom b@example.com\nSubject: second\n\nbody\n"));
+    const QString fileName = file->fileName();
+    MboxFileReader reader;
+    QVERIFY(reader.open(file));
+    QCOMPARE(reader.count(), 2);
+
+    // Another program truncates the file while it's open
+    QFile truncated(fileName);
+    QVERIFY(truncated.open(QIODevice::ReadWrite));
+    QVERIFY(truncated.resize(45));
+    truncated.close();
+
+    QCOMPARE(reader.rawMessage(0), QByteArrayLiteral("Subject: first\n\nbody\n"));
+    QVERIFY(reader.rawMessage(1).isEmpty());
+    QVERIFY(!reader.message(1));
+}
+
+void MboxFileReaderTest::shouldReadKMBoxFiles()
+{
+    // Saving messages writes them with KMBox
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.close();
+    {
+        KMBox::MBox mbox;
+        QVERIFY(mbox.load(file.fileName()));
+        const QList<QByteArray> contents = {QByteArrayLiteral("From: foo@example.com\nSubject: first\n\nFrom the start\n>From a quote\n"),
+                                            QByteArrayLiteral("From: bar@example.com\nSubject: second\n\nbody")};
+        for (const QByteArray &content : contents) {
+            KMime::Message::Ptr message(new KMime::Message);
+            message->setContent(content);
+            message->parse();
+            mbox.appendMessage(message);
+        }
+        QVERIFY(mbox.save());
+    }
+
+    MboxFileReader reader;
+    QVERIFY(reader.open(file.fileName()));
+    QCOMPARE(reader.count(), 2);
+    QCOMPARE(reader.message(0)->subject()->asUnicodeString(), QStringLiteral("first"));
+    QCOMPARE(reader.message(1)->subject()->asUnicodeString(), QStringLiteral("second"));
+    // KMBox escapes the lines starting with >*From, they are read back unchanged
+    QVERIFY(reader.rawMessage(0).contains("\nFrom the start\n>From a quote\n"));
+    QVERIFY(reader.message(0)->body().startsWith("From the start\n>From a quote\n"));
+}
@@ -0,0 +1,26 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+
+class MboxFileReaderTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MboxFileReaderTest(QObject *parent = nullptr);
+    ~MboxFileReaderTest() override = default;
+private Q_SLOTS:
+    void shouldHaveDefaultValues();
+    void shouldIndexMessages_data();
+    void shouldIndexMessages();
+    void shouldParseMessagesOnDemand();
+    void shouldKeepBinaryContent();
+    void shouldIndexAcrossBlocks();
+    void shouldNotReadTruncatedMessages();
+    void shouldReadKMBoxFiles();
+};
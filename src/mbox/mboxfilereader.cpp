@@ -0,0 +1,182 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "mboxfilereader.h"
+#include "kmail_debug.h"
+
+#include <QFile>
+
+#include <climits>
+#include <cstring>
+
+namespace
+{
+constexpr char SeparatorPrefix[] = "From ";
+constexpr int SeparatorPrefixLength = sizeof(SeparatorPrefix) - 1;
+// The file is indexed by reading blocks of that size
+constexpr qint64 IndexBlockSize = 1024 * 1024;
+
+bool isSeparatorLine(const QByteArray &buffer, int position)
+{
+    return buffer.size() - position >= SeparatorPrefixLength && std::memcmp(buffer.constData() + position, SeparatorPrefix, SeparatorPrefixLength) == 0;
+}
+
+// Writers quote the lines of a message matching ^>*From with one more '>', remove it
+// the way KMBox::MBox does: ">From " becomes "From ", ">>From " becomes ">From "
+void unescapeFrom(QByteArray &content)
+{
+    int from = content.indexOf("\n>");
+    if (from < 0) {
+        return;
+    }
+    char *data = content.data();
+    const int size = content.size();
+    int out = from;
+    while (from < size) {
+        if (data[from] == '\n' && from + 1 < size && data[from + 1] == '>') {
+            data[out++] = data[from++]; // '\n'
+            int quotes = from;
+            while (quotes < size && data[quotes] == '>') {
+                ++quotes;
+            }
+            // skip the first '>' if the quotes are followed by "From "
+            if (isSeparatorLine(content, quotes)) {
+                ++from;
+            }
+            while (from < quotes) {
+                data[out++] = data[from++];
+            }
+            continue;
+        }
+        data[out++] = data[from++];
+    }
+    content.truncate(out);
+}
+}
+
+MboxFileReader::MboxFileReader() = default;
+
+MboxFileReader::~MboxFileReader()
+{
+    close();
+}
+
+bool MboxFileReader::open(const QString &fileName)
+{
+    return open(new QFile(fileName));
+}
+
+bool MboxFileReader::open(QFile *file)
+{
+    close();
+    mFile.reset(file);
+    if (!mFile->open(QIODevice::ReadOnly)) {
+        qCWarning(KMAIL_LOG) << "Unable to open" << mFile->fileName() << mFile->errorString();
+        mFile.reset();
+        return false;
+    }
+    buildIndex();
+    return true;
+}
+
+void MboxFileReader::close()
+{
+    mEntries.clear();
+    mFile.reset();
+}
+
+int MboxFileReader::count() const
+{
+    return mEntries.count();
+}
+
+void MboxFileReader::buildIndex()
+{
+    qint64 messageStart = -1;
+    // The buffer holds the lines not indexed yet, it starts at bufferOffset in the file
+    QByteArray buffer;
+    qint64 bufferOffset = 0;
+    int lineStart = 0;
+    int searchFrom = 0;
+    bool atEnd = false;
+    while (true) {
+        const int newLine = buffer.indexOf('\n', searchFrom);
+        if (newLine < 0 && !atEnd) {
+            // Keep the incomplete line and read the next block
+            buffer.remove(0, lineStart);
+            bufferOffset += lineStart;
+            lineStart = 0;
+            searchFrom = buffer.size();
+            const QByteArray block = mFile->read(IndexBlockSize);
+            if (block.isEmpty()) {
+                atEnd = true;
+            } else {
+                buffer += block;
+            }
+            continue;
+        }
+        if (lineStart >= buffer.size()) {
+            break;
+        }
+        const int lineEnd = (newLine < 0) ? buffer.size() : newLine + 1;
+        const qint64 lineOffset = bufferOffset + lineStart;
+        if (isSeparatorLine(buffer, lineStart)) {
+            // The newline before the separator belongs to the separator
+            if (messageStart >= 0 && lineOffset - 1 > messageStart) {
+                mEntries.append({messageStart, lineOffset - 1 - messageStart});
+            }
+            messageStart = bufferOffset + lineEnd;
+        } else if (messageStart < 0) {
+            // A single message file has no "From " line before the message
+            messageStart = lineOffset;
+        }
+        lineStart = lineEnd;
+        searchFrom = lineEnd;
+    }
+    const qint64 size = bufferOffset + buffer.size();
+    if (messageStart >= 0 && messageStart < size) {
+        mEntries.append({messageStart, size - messageStart});
+    }
+}
+
+QByteArray MboxFileReader::rawMessage(int index) const
+{
+    if (index < 0 || index >= mEntries.count()) {
+        return {};
+    }
+    const Entry &entry = mEntries.at(index);
+    if (entry.size > INT_MAX) {
+        qCWarning(KMAIL_LOG) << "Message" << index << "is too large:" << entry.size;
+        return {};
+    }
+    if (!mFile->seek(entry.offset)) {
+        qCWarning(KMAIL_LOG) << "Unable to read message" << index << "of" << mFile->fileName() << mFile->errorString();
+        return {};
+    }
+    QByteArray content = mFile->read(entry.size);
+    if (content.size() != entry.size) {
+        // Another program changed the file since it was indexed
+        qCWarning(KMAIL_LOG) << "Unable to read message" << index << "of" << mFile->fileName() << ", the file was truncated";
+        return {};
+    }
+    unescapeFrom(content);
+    return content;
+}
+
+KMime::Message::Ptr MboxFileReader::message(int index) const
+{
+    const QByteArray content = rawMessage(index);
+    if (content.isEmpty()) {
+        return {};
+    }
+    KMime::Message::Ptr message(new KMime::Message);
+    message->setContent(KMime::CRLFtoLF(content));
+    message->parse();
+    if (!message->hasContent()) {
+        return {};
+    }
+    return message;
+}
@@ -0,0 +1,71 @@
+/*
+   SPDX-FileCopyrightText: 2021 KDE PIM Developers <kde-pim@kde.org>
+
+   SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "kmail_private_export.h"
+
+#include <KMime/Message>
+
+#include <QVector>
+
+#include <memory>
+
+class QFile;
+
+/**
+ * Reads the messages of an mbox file, or of a single message file.
+ *
+ * The file is scanned once for the "From " separator lines to build an index
+ * of the message offsets. The messages are only read and parsed when they are
+ * requested, so that opening a large mbox file doesn't need much more memory
+ * than the index. The file isn't memory mapped, another program may truncate
+ * it while it's open: the messages that are gone then just can't be read.
+ */
+class KMAILTESTS_TESTS_EXPORT MboxFileReader
+{
+public:
+    MboxFileReader();
+    ~MboxFileReader();
+
+    /**
+     * Opens the file @p fileName and indexes its messages.
+     */
+    bool open(const QString &fileName);
+
+    /**
+     * Same as above, the reader takes ownership of @p file, which must not be
+     * opened yet. A QTemporaryFile is removed when the reader is destroyed.
+     */
+    bool open(QFile *file);
+
+    void close();
+
+    Q_REQUIRED_RESULT int count() const;
+
+    /**
+     * Returns the raw content of the message @p index, without its "From " line
+     * and with the escaped ">From " lines of its body restored.
+     */
+    Q_REQUIRED_RESULT QByteArray rawMessage(int index) const;
+
+    /**
+     * Parses the message @p index. Returns nullptr if it isn't a valid message.
+     */
+    Q_REQUIRED_RESULT KMime::Message::Ptr message(int index) const;
+
+private:
+    Q_DISABLE_COPY(MboxFileReader)
+    struct Entry {
+        qint64 offset = 0;
+        qint64 size = 0;
+    };
+
+    void buildIndex();
+
+    std::unique_ptr<QFile> mFile;
+    QVector<Entry> mEntries;
+};